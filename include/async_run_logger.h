@@ -0,0 +1,207 @@
+// asyncrunlogger class, runlogger on a background writer thread
+
+#ifndef ASYNC_RUN_LOGGER_H
+#define ASYNC_RUN_LOGGER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "body2d.hpp"
+#include "nbody_system2d.h"
+#include "run_logger.h"
+
+/**
+ * @brief RunLogger with formatting, energy and file writes moved off the stepping thread
+ * Stores:
+ *      a ring of capacity preallocated snapshots, each holding t and a copy of the bodies and their ids
+ *      a private NBodySystem2D<T> with the same G, eps2 and force engine, used to compute energies
+ *      the RunLogger that owns the output file
+ * Responsible for:
+ *      logState(): copy the state into the next free slot and return, blocks only when every slot is taken
+ *      writer thread: take slots in order, compute totalEnergy() if asked, write them through RunLogger
+ *          when the stepping system already has the potential of its last force pass,
+ *          the energy is taken on the calling thread for O(n) and the writer skips the pair sum
+ *      flush() / waitFlushed(): let another thread, e.g. the checkpoint writer, wait until
+ *          the frames logged so far are in the file
+ *      close(): drain the ring, stop the writer and close the file
+ *
+ * capacity 0 writes on the calling thread, exactly like RunLogger.
+ * The output file is identical to the synchronous one, energies can differ in the last digit
+ * when the stepping system sums them over several threads.
+ */
+template<typename T>
+class AsyncRunLogger{
+public:
+    /**
+     * @brief construct a closed logger
+     *
+     * @param capacity snapshots that can wait for the writer, 0 = no writer thread
+     */
+    explicit AsyncRunLogger(std::size_t capacity);
+
+    /**
+     * @brief drain pending snapshots and close
+     *
+     */
+    ~AsyncRunLogger();
+
+    AsyncRunLogger(const AsyncRunLogger &) = delete;
+    AsyncRunLogger &operator=(const AsyncRunLogger &) = delete;
+
+    /**
+     * @brief set the error bounds and block length of Compressed output, see RunLogger::setCompression
+     *        call before writeHeader()
+     *
+     * @param positionError largest position error, > 0
+     * @param velocityError largest velocity error, > 0
+     * @param keyframeEvery most frames per block
+     */
+    void setCompression(double positionError, double velocityError, unsigned int keyframeEvery);
+
+    /**
+     * @brief open output file for writing and start the writer thread
+     *
+     * @param path file path to open
+     * @param format Csv, Binary or Compressed
+     * @return true if file stream is valid and available for writing
+     * @return false otherwise
+     */
+    bool open(const std::string &path, LogFormat format = LogFormat::Csv);
+
+    /**
+     * @brief reopen an existing trajectory to continue it and start the writer thread, see RunLogger::openAppend
+     *        framesLogged() counts on from framesKept
+     *
+     * @param path file path to open
+     * @param format Csv, Binary or Compressed, must match the existing file
+     * @param framesKept rows or frames to keep
+     * @param framesFound set to the rows or frames kept, less than framesKept if the file was shorter
+     * @return true if file stream is valid and available for writing
+     * @return false otherwise
+     */
+    bool openAppend(const std::string &path, LogFormat format, unsigned long long framesKept, unsigned long long &framesFound);
+
+    /**
+     * @brief write the header on the calling thread and copy the energy settings of system
+     *
+     * @param system the NBodySystem2D with bodies to define columns
+     * @param includeEnergy if true, append E_total column at the end
+     * @param outputEvery steps between logged states, stored in the binary header
+     * @param dt time step, stored in the binary header
+     */
+    void writeHeader(const NBodySystem2D<T> &system, bool includeEnergy, long long outputEvery = 1, double dt = 0.0);
+
+    /**
+     * @brief queue one state for writing, same output as RunLogger::logState
+     *        blocks only while the ring is full
+     *
+     * @param t current simulation time
+     * @param system current N-body system state
+     * @param includeEnergy if true, the writer appends totalEnergy()
+     */
+    void logState(T t, const NBodySystem2D<T> &system, bool includeEnergy);
+
+    /**
+     * @brief ask for every state logged so far to reach the file, without waiting for it
+     *        with capacity 0 the file is flushed right away, otherwise the writer flushes
+     *        once it has written the states queued before this call
+     *
+     */
+    void flush();
+
+    /**
+     * @brief block until framesLogged() reached frames at a flush() and those frames reached the file
+     *        returns at once after close(), safe to call from another thread
+     *
+     * @param frames frame count to wait for
+     */
+    void waitFlushed(unsigned long long frames);
+
+    /**
+     * @brief logState() calls since open(), plus framesKept after openAppend()
+     *
+     * @return unsigned long long
+     */
+    unsigned long long framesLogged() const;
+
+    /**
+     * @brief write everything still queued, stop the writer and close the file
+     *
+     */
+    void close();
+
+    /**
+     * @brief number of logState() calls that had to wait for a free slot
+     *
+     * @return unsigned long long
+     */
+    unsigned long long fullWaits() const;
+
+    /**
+     * @brief size of the file written, valid after close()
+     *
+     * @return unsigned long long
+     */
+    unsigned long long bytesWritten() const;
+
+    /**
+     * @brief number of snapshots the ring holds
+     *
+     * @return std::size_t
+     */
+    std::size_t capacity() const;
+
+private:
+    /**
+     * @brief one queued state
+     *
+     */
+    struct Snapshot{
+        T t; // simulation time
+        bool includeEnergy; // writer appends totalEnergy()
+        bool hasEnergy; // energy was taken from the stepping system's cached potential
+        T energy; // total energy, valid if hasEnergy
+        std::vector<Body2D<T>> bodies; // copy of the body list, allocated once
+        std::vector<std::size_t> ids; // copy of the body ids, allocated once
+        std::size_t idCount; // ids handed out at the time of the snapshot
+    };
+
+    /**
+     * @brief reset the ring and the frame counters and start the writer thread, if there is a ring
+     *
+     * @param frames frame count the counters start from
+     */
+    void start(unsigned long long frames);
+
+    /**
+     * @brief writer thread body, writes snapshots until close() and the ring is empty
+     *        also flushes the file when flush() asked for frames it has written
+     *
+     */
+    void writerLoop();
+
+    RunLogger m_logger; // output file, only touched by the writer while it runs
+    NBodySystem2D<T> m_energySystem; // writer-side copy of the system for totalEnergy()
+    std::vector<Snapshot> m_ring; // preallocated snapshots
+    std::size_t m_head; // next slot logState() fills
+    std::size_t m_tail; // next slot the writer empties
+    std::size_t m_queued; // filled slots not yet written
+    unsigned long long m_fullWaits; // logState() calls that found the ring full
+    bool m_stopping; // set by close(), writer exits once the ring is empty
+    unsigned long long m_framesLogged; // logState() calls, only touched by the logging thread
+    unsigned long long m_framesWritten; // frames handed to the file by the writer
+    unsigned long long m_flushTarget; // flush() asked for this many frames to reach the file
+    unsigned long long m_framesFlushed; // frames known to be in the file, all of them once closed
+    bool m_closed; // close() ran, waitFlushed() stops waiting
+    mutable std::mutex m_mutex; // guards m_head, m_tail, m_queued, m_fullWaits, m_stopping, the frame counters and m_closed
+    std::condition_variable m_notEmpty; // writer waits here for snapshots
+    std::condition_variable m_notFull; // logState() waits here for a free slot
+    std::condition_variable m_flushed; // waitFlushed() waits here for m_framesFlushed
+    std::thread m_writer; // background writer, not started for capacity 0
+};
+
+#endif
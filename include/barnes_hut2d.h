@@ -0,0 +1,103 @@
+// barneshuttree2d class, quadtree for O(n log n) forces
+
+#ifndef BARNES_HUT2D_H
+#define BARNES_HUT2D_H
+
+#include "vec2.hpp"
+#include "body_arrays2d.hpp"
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Barnes-Hut quadtree over a set of bodies stored as arrays
+ * Stores:
+ *      flat list of quadtree cells, each with its bounds, total mass, and center of mass
+ *      permutation of body indices so every cell owns a contiguous range of bodies
+ * Responsible for:
+ *      building the tree from the current body positions, O(n log n)
+ *      accumulating approximate gravitational accelerations into ax, ay
+ *          cells far enough away (size / distance < theta) are treated as a single point mass
+ *          theta = 0 opens every cell and reproduces the direct sum
+ */
+template<typename T>
+class BarnesHutTree2D{
+public:
+    /**
+     * @brief construct an empty tree
+     *
+     */
+    BarnesHutTree2D();
+
+    /**
+     * @brief rebuild the tree from the current body positions
+     *        storage from previous builds is reused
+     *
+     * @param bodies bodies to sort into the tree
+     */
+    void build(const BodyArrays2D<T> &bodies);
+
+    /**
+     * @brief add approximate gravitational acceleration on every body to ax, ay
+     *        does not clear the accumulators, caller is responsible
+     *        tree must have been built from the same bodies
+     *
+     * @param bodies bodies to receive accelerations
+     * @param G gravitational constant
+     * @param eps2 softening value added to r^2
+     * @param theta opening angle, cell is opened if size / distance >= theta
+     */
+    void accumulateAccelerations(BodyArrays2D<T> &bodies, T G, T eps2, T theta) const;
+
+    /**
+     * @brief same as above for bodies [iBegin, iEnd) only
+     *        only ax[i], ay[i] of those bodies are written, disjoint ranges can run on different threads
+     *
+     * @param bodies bodies to receive accelerations
+     * @param G gravitational constant
+     * @param eps2 softening value added to r^2
+     * @param theta opening angle, cell is opened if size / distance >= theta
+     * @param iBegin first body
+     * @param iEnd one past last body
+     */
+    void accumulateAccelerations(BodyArrays2D<T> &bodies, T G, T eps2, T theta, std::size_t iBegin, std::size_t iEnd) const;
+
+    /**
+     * @brief returns number of cells in the last built tree
+     *
+     * @return std::size_t number of cells
+     */
+    std::size_t nodeCount() const;
+
+private:
+    /**
+     * @brief one square cell of the quadtree
+     * children are stored as four consecutive entries in m_nodes
+     */
+    struct Node{
+        Vec2<T> center; // geometric center of the cell
+        T halfSize; // half of the cell side length
+        T mass; // total mass inside the cell
+        Vec2<T> com; // center of mass of the cell
+        std::size_t begin; // first index into m_order owned by this cell
+        std::size_t end; // one past the last index into m_order
+        std::size_t firstChild; // index of first child in m_nodes, 0 if leaf
+    };
+
+    /**
+     * @brief recursively split a cell into quadrants and compute its mass moments
+     *
+     * @param nodeIndex index of cell in m_nodes
+     * @param bodies bodies being sorted into the tree
+     * @param depth depth of the cell, root = 0
+     */
+    void buildNode(std::size_t nodeIndex, const BodyArrays2D<T> &bodies, int depth);
+
+    static constexpr std::size_t LEAF_CAPACITY = 8; // max bodies in a leaf before it is split
+    static constexpr int MAX_DEPTH = 48; // stop splitting here, handles coincident bodies
+
+    std::vector<Node> m_nodes; // all cells, root at index 0
+    std::vector<std::size_t> m_order; // body indices grouped by cell
+};
+
+#endif
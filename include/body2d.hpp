@@ -3,11 +3,10 @@
 #ifndef BODY2D_HPP
 #define BODY2D_HPP
 
-#include "real_type.hpp"
 #include "vec2.hpp"
 
 /**
- * @brief represents a body on a 2D plane
+ * @brief represents a body on a 2D plane, using scalar type T
  * Stores:
  *      m = mass
  *      r = current position (x, y)
@@ -19,12 +18,13 @@
  * After accumulating forces, uses m, r, v, and f to update the body's state
  * 
  */
+template<typename T>
 class Body2D{
 public:
-    Real m; // mass of body
-    Vec2 r; // current position vector (x, y)
-    Vec2 v; // current velocity vector (vx, vy)
-    Vec2 f; // accumulated force vector (Fx, Fy)
+    T m; // mass of body
+    Vec2<T> r; // current position vector (x, y)
+    Vec2<T> v; // current velocity vector (vx, vy)
+    Vec2<T> f; // accumulated force vector (Fx, Fy)
 
     /**
      * @brief default constructor
@@ -35,7 +35,7 @@ public:
      *      force = (0, 0)
      * 
      */
-    Body2D() : m(static_cast<Real>(0)), r(), v(), f(){}
+    Body2D() : m(static_cast<T>(0)), r(), v(), f(){}
     /**
      * @brief Construct body given mass, position, and velocity
      * Initializes:
@@ -44,14 +44,14 @@ public:
      * @param position initial position (x, y)
      * @param velocity initial velocity (vx, vy)
      */
-    Body2D(Real mass, const Vec2 &position, const Vec2 &velocity) : m(mass), r(position), v(velocity), f(){}
+    Body2D(T mass, const Vec2<T> &position, const Vec2<T> &velocity) : m(mass), r(position), v(velocity), f(){}
     /**
      * @brief clear accumulated force on body
      * called once per each force accumulation step before additions
      */
     void clearForce(){
-        f.x = static_cast<Real>(0);
-        f.y = static_cast<Real>(0);
+        f.x = static_cast<T>(0);
+        f.y = static_cast<T>(0);
     }
     /**
      * @brief force addition for the body's accumulator
@@ -59,7 +59,7 @@ public:
      * 
      * @param F force vector to add to accumulator
      */
-    void addForce(const Vec2 &F){
+    void addForce(const Vec2<T> &F){
         f.x += F.x;
         f.y += F.y;
     }
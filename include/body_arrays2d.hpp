@@ -0,0 +1,128 @@
+// bodyarrays2d class = all bodies as separate arrays, structure of arrays
+
+#ifndef BODY_ARRAYS2D_HPP
+#define BODY_ARRAYS2D_HPP
+
+#include "vec2.hpp"
+#include "body2d.hpp"
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief structure-of-arrays storage for a set of bodies, using scalar type T
+ * Stores one contiguous array per field:
+ *      x, y = positions
+ *      vx, vy = velocities
+ *      m = masses
+ *      ax, ay = accumulated accelerations (not forces)
+ *
+ * force loops only stream through x, y, m and ax, ay,
+ * so velocities never get pulled through cache and the j-loop can be vectorized
+ * converts to and from the Body2D list with load() and store()
+ */
+template<typename T>
+class BodyArrays2D{
+public:
+    std::vector<T> x; // x positions
+    std::vector<T> y; // y positions
+    std::vector<T> vx; // x velocities
+    std::vector<T> vy; // y velocities
+    std::vector<T> m; // masses
+    std::vector<T> ax; // x accelerations
+    std::vector<T> ay; // y accelerations
+
+    /**
+     * @brief returns number of bodies stored
+     *
+     * @return std::size_t number of bodies
+     */
+    std::size_t size() const{
+        return x.size();
+    }
+    /**
+     * @brief reserve room for n bodies in every array
+     *
+     * @param n number of bodies
+     */
+    void reserve(std::size_t n){
+        x.reserve(n);
+        y.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        m.reserve(n);
+        ax.reserve(n);
+        ay.reserve(n);
+    }
+    /**
+     * @brief append one body, acceleration taken as F / m
+     *
+     * @param body body to append
+     */
+    void pushBack(const Body2D<T> &body){
+        x.push_back(body.r.x);
+        y.push_back(body.r.y);
+        vx.push_back(body.v.x);
+        vy.push_back(body.v.y);
+        m.push_back(body.m);
+        ax.push_back(body.m != static_cast<T>(0) ? body.f.x / body.m : static_cast<T>(0));
+        ay.push_back(body.m != static_cast<T>(0) ? body.f.y / body.m : static_cast<T>(0));
+    }
+    /**
+     * @brief replace contents with a copy of a body list
+     *
+     * @param bodies bodies to copy
+     */
+    void load(const std::vector<Body2D<T>> &bodies){
+        x.clear();
+        y.clear();
+        vx.clear();
+        vy.clear();
+        m.clear();
+        ax.clear();
+        ay.clear();
+        reserve(bodies.size());
+        for(std::size_t i = 0; i < bodies.size(); ++i){
+            pushBack(bodies[i]);
+        }
+    }
+    /**
+     * @brief write contents back as a body list, F = m * a
+     *
+     * @param bodies list resized and overwritten
+     */
+    void store(std::vector<Body2D<T>> &bodies) const{
+        const std::size_t n = size();
+        bodies.resize(n);
+        for(std::size_t i = 0; i < n; ++i){
+            Body2D<T> &b = bodies[i];
+            b.m = m[i];
+            b.r = Vec2<T>(x[i], y[i]);
+            b.v = Vec2<T>(vx[i], vy[i]);
+            b.f = Vec2<T>(m[i] * ax[i], m[i] * ay[i]);
+        }
+    }
+    /**
+     * @brief add m * a of every body to the matching Body2D force accumulator
+     *
+     * @param bodies list of the same size
+     */
+    void addForcesTo(std::vector<Body2D<T>> &bodies) const{
+        const std::size_t n = size();
+        for(std::size_t i = 0; i < n; ++i){
+            bodies[i].addForce(Vec2<T>(m[i] * ax[i], m[i] * ay[i]));
+        }
+    }
+    /**
+     * @brief clear accumulated accelerations
+     * called once per force evaluation before additions
+     */
+    void clearAccelerations(){
+        for(std::size_t i = 0; i < ax.size(); ++i){
+            ax[i] = static_cast<T>(0);
+            ay[i] = static_cast<T>(0);
+        }
+    }
+};
+
+#endif
@@ -3,28 +3,104 @@
 #ifndef BODY_IO_H
 #define BODY_IO_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include <cctype>
-#include <cmath>
+#include <vector>
 
 #include "nbody_system2d.h"
 
+template<typename T>
 class NBodySystem2D;
+
+/**
+ * @brief first 32 bytes of a binary initial-conditions file
+ *
+ * File layout:
+ *      header
+ *      bodyCount records of mass, x, y, vx, vy, each value valueBytes wide (float or double, native byte order)
+ * the values are stored exactly, loading needs no parsing and gives the same bodies as the csv it came from
+ */
+struct BodyFileHeader{
+    char magic[8]; // "NBODYICF"
+    std::uint32_t version; // format version, BODY_FILE_VERSION
+    std::uint32_t valueBytes; // bytes per stored value, 4 = float, 8 = double
+    std::uint64_t bodyCount; // number of records
+    std::uint64_t reserved; // zero
+};
+
+static_assert(sizeof(BodyFileHeader) == 32, "BodyFileHeader must stay 32 bytes");
+
+constexpr std::uint32_t BODY_FILE_VERSION = 1U; // current binary initial-conditions format version
+
 /**
  * @brief read body data from csv and add them to the simulation system
- *         Expected formats: 
+ *         Expected formats:
  *              1. mass,x,y,vx,vy for velocity components
  *              2. mass,x,y,speed,direction_deg for magnitude + direction converted to (vx, vy)
  *         Skipped if empty, begins with '#', has fewer than 5 tokens, or fails parsing
+ *         The file is memory mapped and split into chunks at line boundaries that are parsed in parallel,
+ *         bodies keep the file order
  * @param path path to CSV file
+ * @tparam T scalar type of the system, values are parsed directly as T, speed and direction as long double
  * @param system reference to NBodySystem2D to which bodies are added to
+ * @param threadCount threads parsing chunks, 0 = all hardware threads
  * @return true if file could be open
  * @return false otherwise
  */
 // reads CSV file and adds bodies to given NBodySystem2D
-bool loadBodiesFromCsv(const std::string &path, NBodySystem2D &system);
+template<typename T>
+bool loadBodiesFromCsv(const std::string &path, NBodySystem2D<T> &system, std::size_t threadCount = 1);
+
+/**
+ * @brief read a binary initial-conditions file and add its bodies to the system
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the binary file
+ * @param system reference to NBodySystem2D to which bodies are added to
+ * @return true if the file could be opened and has a valid header
+ * @return false otherwise
+ */
+template<typename T>
+bool loadBodiesFromBinary(const std::string &path, NBodySystem2D<T> &system);
+
+/**
+ * @brief load a binary initial-conditions file if path starts with the binary magic, csv otherwise
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the bodies file
+ * @param system reference to NBodySystem2D to which bodies are added to
+ * @param threadCount threads parsing csv chunks, 0 = all hardware threads
+ * @return true if the file could be opened
+ * @return false otherwise
+ */
+template<typename T>
+bool loadBodies(const std::string &path, NBodySystem2D<T> &system, std::size_t threadCount = 1);
+
+/**
+ * @brief write the bodies of the system as a binary initial-conditions file
+ *        float systems store float, double and long double systems store double
+ *
+ * @tparam T scalar type of the system
+ * @param path output path
+ * @param system system whose bodies are written
+ * @return true if the file was written
+ * @return false otherwise
+ */
+template<typename T>
+bool saveBodiesToBinary(const std::string &path, const NBodySystem2D<T> &system);
+
+/**
+ * @brief read one collision radius per line, in the order of the bodies file
+ *        blank lines and lines starting with '#' are skipped
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the radii file
+ * @param radii overwritten with the radii read
+ * @return true if the file was opened and every other line is a finite radius >= 0
+ * @return false otherwise
+ */
+template<typename T>
+bool loadRadii(const std::string &path, std::vector<T> &radii);
 
-#endif
\ No newline at end of file
+#endif
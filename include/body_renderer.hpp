@@ -0,0 +1,290 @@
+// bodyrenderer2d class = every body drawn from one vertex array with a single draw call, or a density heatmap
+
+#ifndef BODY_RENDERER_HPP
+#define BODY_RENDERER_HPP
+
+#include "body2d.hpp"
+#include "density_map2d.h"
+#include "thread_pool.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * @brief draws all bodies as textured quads in one sf::VertexArray, or as a density heatmap above a body count
+ * Stores:
+ *      one color per body id, so a body keeps its color when others are merged away
+ *      a small disc texture, every quad samples it so the bodies come out round
+ *      the vertex array, 6 vertices (two triangles) per body, and screen position scratch arrays
+ *      the density map, its window-sized texture and the threads that bin into it
+ * Responsible for:
+ *      update(): map positions to the screen and rewrite the vertex array,
+ *          or above the heatmap threshold bin them into the density map and upload it
+ *      draw(): one draw call for all bodies
+ *
+ * SFML 3 has no quads and no point size, so a body is two triangles.
+ * The arrays only grow, after the first frame nothing is allocated.
+ * Screen positions are computed in flat loops over plain float arrays, one per axis, so they can be
+ * vectorized, the vertex writes are a second pass.
+ * The sprite radius shrinks with the number of bodies so large systems do not turn into one blob.
+ * Far beyond one body per pixel sprites only overdraw each other; the heatmap costs O(n) to bin
+ * and O(pixels) to color and upload, and the switch is checked every frame, so a run that loses
+ * bodies to merges goes back to sprites.
+ */
+template<typename T>
+class BodyRenderer2D{
+public:
+    /**
+     * @brief build colors and the disc texture
+     *        id 0 red, id 1 green, id 2 blue, the rest random
+     *
+     * @param idCount ids handed out so far, one color each
+     * @param width window width in pixels
+     * @param height window height in pixels
+     * @param viewScale pixels per simulation length unit
+     */
+    BodyRenderer2D(std::size_t idCount, unsigned int width, unsigned int height, float viewScale)
+        : m_centerX(static_cast<float>(width) / 2.0f),
+          m_centerY(static_cast<float>(height) / 2.0f),
+          m_viewScale(viewScale),
+          m_radius(MAX_RADIUS),
+          m_texture(sf::Vector2u(TEXTURE_SIZE, TEXTURE_SIZE)),
+          m_vertices(sf::PrimitiveType::Triangles),
+          m_heatmapAbove(std::numeric_limits<std::size_t>::max()),
+          m_threads(1),
+          m_heatmap(false),
+          m_heatmapFailed(false),
+          m_density(width, height, viewScale),
+          m_heatTextureReady(false),
+          m_heatQuad(sf::PrimitiveType::Triangles, 6U){
+        // random color gen
+        std::random_device rd;
+        std::mt19937 rng(rd());
+        std::uniform_int_distribution<int> colorDist(50, 255);
+        m_colors.reserve(idCount);
+        for(std::size_t i = 0; i < idCount; ++i){
+            if(i == 0U){
+                m_colors.push_back(sf::Color::Red);
+            }
+            else if(i == 1U){
+                m_colors.push_back(sf::Color::Green);
+            }
+            else if(i == 2U){
+                m_colors.push_back(sf::Color::Blue);
+            }
+            else{
+                // outside of the three main bodies, set to random color
+                const std::uint8_t r = static_cast<std::uint8_t>(colorDist(rng));
+                const std::uint8_t g = static_cast<std::uint8_t>(colorDist(rng));
+                const std::uint8_t b = static_cast<std::uint8_t>(colorDist(rng));
+                m_colors.push_back(sf::Color(r, g, b));
+            }
+        }
+
+        // radius 16 for a handful of bodies, down to MIN_RADIUS for 10^4 and more
+        const float shrunk = 64.0f / std::sqrt(static_cast<float>(std::max<std::size_t>(idCount, 1U)));
+        m_radius = std::max(MIN_RADIUS, std::min(MAX_RADIUS, shrunk));
+
+        // white disc, alpha falls off over the last pixel so small sprites stay round
+        std::vector<std::uint8_t> pixels(static_cast<std::size_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4U);
+        const float half = static_cast<float>(TEXTURE_SIZE) / 2.0f;
+        for(unsigned int py = 0; py < TEXTURE_SIZE; ++py){
+            for(unsigned int px = 0; px < TEXTURE_SIZE; ++px){
+                const float dx = static_cast<float>(px) + 0.5f - half;
+                const float dy = static_cast<float>(py) + 0.5f - half;
+                const float edge = half - std::sqrt(dx * dx + dy * dy);
+                const float alpha = std::max(0.0f, std::min(1.0f, edge));
+                const std::size_t k = (static_cast<std::size_t>(py) * TEXTURE_SIZE + px) * 4U;
+                pixels[k] = 255U;
+                pixels[k + 1U] = 255U;
+                pixels[k + 2U] = 255U;
+                pixels[k + 3U] = static_cast<std::uint8_t>(alpha * 255.0f);
+            }
+        }
+        m_texture.update(pixels.data());
+        m_texture.setSmooth(true);
+    }
+
+    /**
+     * @brief switch to the density heatmap when there are more than above bodies
+     *
+     * @param above body count the sprites stop at, 0 = always the heatmap
+     * @param massWeighted heatmap pixels sum masses instead of counting bodies
+     * @param threads threads that bin the heatmap, 0 = all hardware threads
+     */
+    void setHeatmap(std::size_t above, bool massWeighted, std::size_t threads){
+        m_heatmapAbove = above;
+        m_density.setMassWeighted(massWeighted);
+        m_threads = (threads == 0) ? ThreadPool::hardwareThreads() : threads;
+        m_pool.reset();
+    }
+
+    /**
+     * @brief convert positions to screen coordinates and rewrite the vertex array,
+     *        or bin them into the heatmap above the threshold
+     *        simulation origin at the window center, y-axis inverted so y points up
+     *
+     * @param bodies bodies to draw
+     * @param ids id of every body, all below the idCount given to the constructor
+     */
+    void update(const std::vector<Body2D<T>> &bodies, const std::vector<std::size_t> &ids){
+        const std::size_t n = bodies.size();
+        m_heatmap = n > m_heatmapAbove && prepareHeatmap();
+        if(m_heatmap){
+            m_density.bin(bodies, m_pool.get());
+            m_density.colorize(m_pool.get());
+            m_heatTexture.update(m_density.pixels().data());
+            return;
+        }
+        m_screenX.resize(n);
+        m_screenY.resize(n);
+        for(std::size_t i = 0; i < n; ++i){
+            m_screenX[i] = static_cast<float>(bodies[i].r.x);
+            m_screenY[i] = static_cast<float>(bodies[i].r.y);
+        }
+
+        // toScreen, one flat loop per axis so neither has to check for overlap with the other
+        const float scale = m_viewScale;
+        const float cx = m_centerX;
+        const float cy = m_centerY;
+        float *sx = m_screenX.data();
+        float *sy = m_screenY.data();
+        for(std::size_t i = 0; i < n; ++i){
+            sx[i] = sx[i] * scale + cx;
+        }
+        for(std::size_t i = 0; i < n; ++i){
+            sy[i] = cy - sy[i] * scale;
+        }
+
+        // two triangles per body, corners in texture pixels
+        m_vertices.resize(n * 6U);
+        const float rad = m_radius;
+        const float tex = static_cast<float>(TEXTURE_SIZE);
+        for(std::size_t i = 0; i < n; ++i){
+            const sf::Color color = m_colors[ids[i]];
+            const float left = sx[i] - rad;
+            const float right = sx[i] + rad;
+            const float top = sy[i] - rad;
+            const float bottom = sy[i] + rad;
+            sf::Vertex *v = &m_vertices[i * 6U];
+            v[0].position = sf::Vector2f(left, top);
+            v[0].texCoords = sf::Vector2f(0.0f, 0.0f);
+            v[1].position = sf::Vector2f(right, top);
+            v[1].texCoords = sf::Vector2f(tex, 0.0f);
+            v[2].position = sf::Vector2f(left, bottom);
+            v[2].texCoords = sf::Vector2f(0.0f, tex);
+            v[3].position = sf::Vector2f(left, bottom);
+            v[3].texCoords = sf::Vector2f(0.0f, tex);
+            v[4].position = sf::Vector2f(right, top);
+            v[4].texCoords = sf::Vector2f(tex, 0.0f);
+            v[5].position = sf::Vector2f(right, bottom);
+            v[5].texCoords = sf::Vector2f(tex, tex);
+            for(std::size_t c = 0; c < 6U; ++c){
+                v[c].color = color;
+            }
+        }
+    }
+
+    /**
+     * @brief draw every body from the last update() with one draw call
+     *
+     * @param window target window
+     */
+    void draw(sf::RenderWindow &window) const{
+        sf::RenderStates states;
+        if(m_heatmap){
+            states.texture = &m_heatTexture;
+            window.draw(m_heatQuad, states);
+            return;
+        }
+        states.texture = &m_texture;
+        window.draw(m_vertices, states);
+    }
+
+    /**
+     * @brief returns whether the last update() drew the heatmap
+     *
+     * @return true for the heatmap, false for sprites
+     */
+    bool heatmapActive() const{
+        return m_heatmap;
+    }
+
+    /**
+     * @brief returns sprite radius in pixels
+     *
+     * @return float radius
+     */
+    float radius() const{
+        return m_radius;
+    }
+
+    static constexpr float MAX_RADIUS = 16.0f; // sprite radius for a handful of bodies
+    static constexpr float MIN_RADIUS = 1.5f; // sprite radius floor for large systems
+    static constexpr unsigned int TEXTURE_SIZE = 32U; // side of the disc texture in pixels
+
+private:
+    /**
+     * @brief create the heatmap texture, its window-covering quad and the binning threads on first use
+     *        a texture the graphics driver refuses is reported once, the renderer then stays with sprites
+     *
+     * @return true if the heatmap can be drawn
+     */
+    bool prepareHeatmap(){
+        if(m_heatmapFailed){
+            return false;
+        }
+        if(!m_heatTextureReady){
+            const unsigned int w = static_cast<unsigned int>(m_density.width());
+            const unsigned int h = static_cast<unsigned int>(m_density.height());
+            if(!m_heatTexture.resize(sf::Vector2u(w, h))){
+                std::cerr << "Could not create a " << w << " x " << h << " heatmap texture, drawing every body instead.\n";
+                m_heatmapFailed = true;
+                return false;
+            }
+            const float fw = static_cast<float>(w);
+            const float fh = static_cast<float>(h);
+            const sf::Vector2f corners[6] = {{0.0f, 0.0f}, {fw, 0.0f}, {0.0f, fh}, {0.0f, fh}, {fw, 0.0f}, {fw, fh}};
+            for(std::size_t c = 0; c < 6U; ++c){
+                m_heatQuad[c].position = corners[c];
+                m_heatQuad[c].texCoords = corners[c];
+                m_heatQuad[c].color = sf::Color::White;
+            }
+            m_heatTextureReady = true;
+        }
+        if(!m_pool && m_threads > 1){
+            m_pool = std::make_unique<ThreadPool>(m_threads);
+        }
+        return true;
+    }
+
+    float m_centerX; // screen x of the simulation origin
+    float m_centerY; // screen y of the simulation origin
+    float m_viewScale; // pixels per length unit
+    float m_radius; // sprite radius in pixels
+    std::vector<sf::Color> m_colors; // color of every body id
+    sf::Texture m_texture; // white disc sampled by every quad
+    sf::VertexArray m_vertices; // 6 vertices per body
+    std::vector<float> m_screenX; // screen x of every body, scratch
+    std::vector<float> m_screenY; // screen y of every body, scratch
+    std::size_t m_heatmapAbove; // more bodies than this draw the heatmap
+    std::size_t m_threads; // threads binning the heatmap
+    bool m_heatmap; // last update() chose the heatmap
+    bool m_heatmapFailed; // heatmap texture could not be created
+    DensityMap2D<T> m_density; // window-sized histogram and its colors
+    std::unique_ptr<ThreadPool> m_pool; // heatmap binning threads, created on first use, null for one thread
+    sf::Texture m_heatTexture; // density map pixels
+    bool m_heatTextureReady; // m_heatTexture and m_heatQuad are set up
+    sf::VertexArray m_heatQuad; // two triangles covering the window
+};
+
+#endif
@@ -0,0 +1,213 @@
+// checkpoint files, full-precision binary snapshots of a run and their background writer
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "nbody_system2d.h"
+
+/**
+ * @brief bits of CheckpointHeader::flags
+ *      ForcesValid = SystemState2D::forcesValid
+ *      HermiteValid = SystemState2D::hermiteValid, the jerk arrays follow the accelerations
+ *      ForcesInArrays = SystemState2D::forcesInArrays
+ *      BodyIds = bodies were merged away, idCount and the ids follow
+ *      Radii = SystemState2D::radii follow
+ */
+enum class CheckpointFlag : std::uint32_t{
+    ForcesValid = 1U,
+    HermiteValid = 2U,
+    ForcesInArrays = 4U,
+    BodyIds = 8U,
+    Radii = 16U
+};
+
+/**
+ * @brief first 96 bytes of a checkpoint file
+ *
+ * File layout:
+ *      header, headerBytes long
+ *      t, dt, G, eps2
+ *      m[N], x[N], y[N], vx[N], vy[N], ax[N], ay[N]
+ *      jerkX[N], jerkY[N] if HermiteValid
+ *      idCount, ids[N] as 64-bit integers if BodyIds
+ *      radius[N] if Radii
+ * every value is valueBytes wide, the run's own scalar type in native byte order, so nothing is rounded
+ * and a checkpoint only loads into a run of the same precision on the same kind of machine
+ */
+struct CheckpointHeader{
+    char magic[8]; // "NBODYCKP"
+    std::uint32_t version; // format version, CHECKPOINT_VERSION
+    std::uint32_t headerBytes; // offset of the values
+    std::uint32_t precision; // precision of the run, 0 = float, 1 = double, 2 = long double
+    std::uint32_t valueBytes; // sizeof the scalar type
+    std::uint32_t flags; // CheckpointFlag bits
+    std::uint32_t reserved; // zero
+    std::uint64_t bodyCount; // N
+    std::int64_t step; // steps taken
+    std::uint64_t framesLogged; // trajectory frames written up to and including step
+    std::uint64_t forceEvaluations; // force pass counter of the system
+    std::uint64_t pairInteractions; // pair interaction counter of the system
+    std::uint64_t payloadBytes; // bytes after the header, a shorter file is rejected
+    char method[16]; // integrator name, zero padded
+};
+
+static_assert(sizeof(CheckpointHeader) == 96, "CheckpointHeader must stay 96 bytes");
+
+constexpr std::uint32_t CHECKPOINT_VERSION = 1U; // current checkpoint format version
+
+/**
+ * @brief one checkpoint, the system state plus where the run was
+ *
+ */
+template<typename T>
+struct CheckpointData{
+    SystemState2D<T> state; // bodies and integrator state
+    T t; // simulation time
+    T dt; // time step of the run
+    T G; // gravitational constant
+    T eps2; // softening parameter
+    long long step; // steps taken
+    unsigned long long framesLogged; // trajectory frames written up to and including step
+    std::string method; // integrator name
+};
+
+/**
+ * @brief write a checkpoint to path + ".tmp" and rename it over path
+ *        a crash while writing leaves the previous checkpoint in place
+ *
+ * @tparam T scalar type of the run
+ * @param path checkpoint path
+ * @param data checkpoint to write
+ * @return true if the file was written and renamed
+ * @return false otherwise
+ */
+template<typename T>
+bool writeCheckpoint(const std::string &path, const CheckpointData<T> &data);
+
+/**
+ * @brief read a checkpoint written by a run of the same precision
+ *
+ * @tparam T scalar type of the run
+ * @param path checkpoint path
+ * @param data filled from the file
+ * @return true if the file was read
+ * @return false if it could not be opened, is not a checkpoint, has another precision or is cut short
+ */
+template<typename T>
+bool readCheckpoint(const std::string &path, CheckpointData<T> &data);
+
+/**
+ * @brief takes checkpoints without holding up the stepping loop
+ * Stores:
+ *      one pending CheckpointData filled by submit() and one the writer thread is writing
+ * Responsible for:
+ *      submit(): O(n) copy of the system on the calling thread, then return
+ *          blocks only if the previous checkpoint is still waiting to be picked up
+ *      writer thread: run the submitted commit hook, e.g. wait until the trajectory holds the
+ *          checkpoint's frames, then write the file with writeCheckpoint()
+ *      close(): finish the pending checkpoint and stop the writer
+ */
+template<typename T>
+class CheckpointWriter{
+public:
+    /**
+     * @brief construct a writer without a thread
+     *
+     */
+    CheckpointWriter();
+
+    /**
+     * @brief finish the pending checkpoint and stop
+     *
+     */
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    /**
+     * @brief set the checkpoint path and start the writer thread
+     *
+     * @param path every checkpoint replaces this file
+     */
+    void open(const std::string &path);
+
+    /**
+     * @brief copy the system and hand the checkpoint to the writer
+     *
+     * @param system system to save
+     * @param t simulation time
+     * @param dt time step of the run
+     * @param step steps taken
+     * @param framesLogged trajectory frames written up to and including step
+     * @param method integrator name
+     * @param beforeCommit run on the writer thread before the file is written, may be empty
+     */
+    void submit(const NBodySystem2D<T> &system, T t, T dt, long long step, unsigned long long framesLogged, const std::string &method, const std::function<void()> &beforeCommit);
+
+    /**
+     * @brief write the pending checkpoint and stop the writer
+     *
+     */
+    void close();
+
+    /**
+     * @brief checkpoints written so far, valid after close()
+     *
+     * @return unsigned long long
+     */
+    unsigned long long written() const;
+
+    /**
+     * @brief checkpoints that could not be written, valid after close()
+     *
+     * @return unsigned long long
+     */
+    unsigned long long failures() const;
+
+    /**
+     * @brief submit() calls that had to wait for the writer
+     *
+     * @return unsigned long long
+     */
+    unsigned long long waits() const;
+
+    /**
+     * @brief step of the last checkpoint written, -1 if none, valid after close()
+     *
+     * @return long long
+     */
+    long long lastStep() const;
+
+private:
+    /**
+     * @brief writer thread body, writes checkpoints until close() and nothing is pending
+     *
+     */
+    void writerLoop();
+
+    std::string m_path; // checkpoint file
+    CheckpointData<T> m_pending; // filled by submit(), swapped out by the writer
+    CheckpointData<T> m_writing; // owned by the writer thread
+    std::function<void()> m_pendingCommit; // hook of the pending checkpoint
+    std::function<void()> m_writingCommit; // hook of the checkpoint being written
+    bool m_hasPending; // m_pending holds a checkpoint the writer has not taken
+    bool m_stopping; // set by close(), writer exits once nothing is pending
+    unsigned long long m_written; // checkpoints written
+    unsigned long long m_failures; // checkpoints that failed to write
+    unsigned long long m_waits; // submit() calls that found m_pending taken
+    long long m_lastStep; // step of the last written checkpoint
+    mutable std::mutex m_mutex; // guards every member above except m_path and m_writing
+    std::condition_variable m_pendingReady; // writer waits here for a checkpoint
+    std::condition_variable m_pendingFree; // submit() waits here for the writer to take m_pending
+    std::thread m_writer; // background writer
+};
+
+#endif
@@ -0,0 +1,271 @@
+// compressed trajectory format, quantized delta frames in entropy-coded blocks
+
+#ifndef COMPRESSED_TRAJECTORY_H
+#define COMPRESSED_TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "trajectory_file.h"
+
+/**
+ * @brief entropy coder of the blocks of a compressed trajectory
+ *      Builtin = adaptive binary range coder over the bytes, always available
+ *      Zlib = deflate, only in builds with NBODY_ZLIB (make detects zlib and sets it)
+ */
+enum class TrajectoryCodec : std::uint32_t{
+    Builtin = 0U,
+    Zlib = 1U
+};
+
+/**
+ * @brief first 72 bytes of a compressed trajectory file
+ *
+ * File layout:
+ *      header, headerBytes long
+ *      block 0, block 1, ... each a CompressedBlockHeader followed by storedBytes of coded data
+ * A block holds up to keyframeEvery frames. Its first frame is a keyframe, it depends on nothing
+ * before it, so any block decodes on its own and seeking costs at most one block.
+ * Frame values are those of the binary format, t, x1, y1, vx1, vy1, ..., [E_total]:
+ *      positions and velocities are rounded to multiples of 2 * positionError and 2 * velocityError,
+ *      so a decoded value is within the error bound of the logged one, stored as the difference
+ *      to a linear prediction from the body's last two frames in the block
+ *      t and E_total are exact doubles, XORed with the previous frame's
+ *      a body merged away, or with a non-finite or huge value, is nan
+ * frame count = sum of the block frame counts, a partly written last block is ignored
+ */
+struct CompressedTrajectoryHeader{
+    char magic[8]; // "NBODYCTJ"
+    std::uint32_t version; // format version, COMPRESSED_TRAJECTORY_VERSION
+    std::uint32_t headerBytes; // offset of block 0
+    std::uint32_t precision; // precision of the run, 0 = float, 1 = double, 2 = long double
+    std::uint32_t codec; // TrajectoryCodec of every block
+    std::uint32_t fields; // TrajectoryField bits
+    std::uint32_t keyframeEvery; // most frames per block
+    std::uint64_t bodyCount; // N, body ids of the run, merged bodies included
+    std::uint64_t outputEvery; // steps between frames
+    double dt; // time step of the run
+    double positionError; // largest difference between a logged and a decoded position
+    double velocityError; // largest difference between a logged and a decoded velocity
+};
+
+static_assert(sizeof(CompressedTrajectoryHeader) == 72, "CompressedTrajectoryHeader must stay 72 bytes");
+
+/**
+ * @brief header in front of every block
+ *        rawBytes == storedBytes means the codec could not shrink the block and it is stored as is
+ */
+struct CompressedBlockHeader{
+    std::uint32_t frames; // frames in the block, 1..keyframeEvery
+    std::uint32_t rawBytes; // size of the delta stream before entropy coding
+    std::uint32_t storedBytes; // size of the coded data after this header
+    std::uint32_t checksum; // FNV-1a of the delta stream
+};
+
+static_assert(sizeof(CompressedBlockHeader) == 16, "CompressedBlockHeader must stay 16 bytes");
+
+constexpr std::uint32_t COMPRESSED_TRAJECTORY_VERSION = 1U; // current compressed format version
+
+/**
+ * @brief codec new files are written with, Zlib when the build has it, Builtin otherwise
+ *
+ * @return TrajectoryCodec
+ */
+TrajectoryCodec defaultTrajectoryCodec();
+
+/**
+ * @brief whether this build can read and write a codec
+ *
+ * @param codec codec to check
+ * @return true if available
+ */
+bool trajectoryCodecAvailable(TrajectoryCodec codec);
+
+/**
+ * @brief name of a codec for messages
+ *
+ * @param codec codec
+ * @return const char* "builtin", "zlib" or "unknown"
+ */
+const char *trajectoryCodecName(TrajectoryCodec codec);
+
+/**
+ * @brief fill a header for a run
+ *
+ * @param precisionCode 0 = float, 1 = double, 2 = long double
+ * @param bodyCount number of bodies
+ * @param includeEnergy frames carry E_total
+ * @param outputEvery steps between frames
+ * @param dt time step
+ * @param positionError absolute error bound of positions, > 0
+ * @param velocityError absolute error bound of velocities, > 0
+ * @param keyframeEvery most frames per block, > 0
+ * @return CompressedTrajectoryHeader
+ */
+CompressedTrajectoryHeader makeCompressedTrajectoryHeader(std::uint32_t precisionCode, std::uint64_t bodyCount, bool includeEnergy, std::uint64_t outputEvery, double dt, double positionError, double velocityError, std::uint32_t keyframeEvery);
+
+/**
+ * @brief turns frames into blocks of the compressed format
+ * Stores:
+ *      the file header, the delta stream of the open block and the frames in it
+ *      the last two quantized values of every body, the last t and E_total
+ * Responsible for:
+ *      addFrame(): quantize one frame and append it to the open block
+ *      finishBlock(): entropy code the open block, the next frame starts a new one with a keyframe
+ */
+class TrajectoryCompressor{
+public:
+    /**
+     * @brief construct a compressor with no header, begin() must come first
+     *
+     */
+    TrajectoryCompressor();
+
+    /**
+     * @brief start a file, drops any open block
+     *
+     * @param header header the file was written with
+     */
+    void begin(const CompressedTrajectoryHeader &header);
+
+    /**
+     * @brief quantize a frame and append it to the open block
+     *
+     * @param values 1 + 4 * N [+ 1] values in binary frame order
+     */
+    void addFrame(const double *values);
+
+    /**
+     * @brief returns frames in the open block
+     *
+     * @return std::size_t
+     */
+    std::size_t pendingFrames() const;
+
+    /**
+     * @brief whether the open block holds keyframeEvery frames
+     *
+     * @return true if it should be finished
+     */
+    bool blockFull() const;
+
+    /**
+     * @brief entropy code the open block and append header and data to out, nothing without frames
+     *
+     * @param out bytes to append the block to
+     */
+    void finishBlock(std::vector<unsigned char> &out);
+
+private:
+    CompressedTrajectoryHeader m_header; // file header
+    std::vector<unsigned char> m_raw; // delta stream of the open block
+    std::size_t m_frames; // frames in the open block
+    std::vector<long long> m_last; // last quantized value, 4 per body, component-major
+    std::vector<long long> m_beforeLast; // the one before
+    std::vector<unsigned char> m_history; // frames of the block each body was present in, up to 2
+    std::vector<long long> m_quantized; // scratch, current frame
+    std::vector<unsigned char> m_present; // scratch, current frame
+    std::uint64_t m_lastTime; // bits of the last t
+    std::uint64_t m_lastEnergy; // bits of the last E_total
+};
+
+/**
+ * @brief read-only view of a compressed trajectory file
+ *        open() walks the block headers once, frame(k) decodes the block holding frame k
+ *        and keeps it, so reading frames in order decodes each block once
+ */
+class CompressedTrajectoryReader{
+public:
+    /**
+     * @brief construct a closed reader
+     *
+     */
+    CompressedTrajectoryReader();
+
+    CompressedTrajectoryReader(const CompressedTrajectoryReader &) = delete;
+    CompressedTrajectoryReader &operator=(const CompressedTrajectoryReader &) = delete;
+
+    /**
+     * @brief map a file, check its header and index its blocks
+     *
+     * @param path compressed trajectory file
+     * @param err stream for error messages
+     * @return true if the file is a valid compressed trajectory
+     * @return false otherwise
+     */
+    bool open(const std::string &path, std::ostream &err);
+
+    /**
+     * @brief unmap and release the file
+     *
+     */
+    void close();
+
+    /**
+     * @brief header of the open file
+     *
+     * @return const CompressedTrajectoryHeader&
+     */
+    const CompressedTrajectoryHeader &header() const;
+
+    /**
+     * @brief number of frames in complete blocks
+     *
+     * @return std::size_t
+     */
+    std::size_t frameCount() const;
+
+    /**
+     * @brief number of values in one frame, 1 + 4 * N [+ 1]
+     *
+     * @return std::size_t
+     */
+    std::size_t valuesPerFrame() const;
+
+    /**
+     * @brief number of complete blocks
+     *
+     * @return std::size_t
+     */
+    std::size_t blockCount() const;
+
+    /**
+     * @brief file offset of block b, blockOffset(blockCount()) = end of the last complete block
+     *
+     * @param b block index, at most blockCount()
+     * @return std::uint64_t
+     */
+    std::uint64_t blockOffset(std::size_t b) const;
+
+    /**
+     * @brief index of the first frame of block b, blockFirstFrame(blockCount()) = frameCount()
+     *
+     * @param b block index, at most blockCount()
+     * @return std::size_t
+     */
+    std::size_t blockFirstFrame(std::size_t b) const;
+
+    /**
+     * @brief values of frame k, decoding its block if it is not the cached one
+     *
+     * @param k frame index, less than frameCount()
+     * @param err stream for error messages
+     * @return const double* valuesPerFrame() values, null if the block is corrupt
+     */
+    const double *frame(std::size_t k, std::ostream &err);
+
+private:
+    MappedFile m_file; // bytes of the open file
+    CompressedTrajectoryHeader m_header; // copy of the header
+    std::vector<std::uint64_t> m_blockOffsets; // offset of every block, then the end
+    std::vector<std::size_t> m_blockFrames; // first frame of every block, then the frame count
+    std::size_t m_cachedBlock; // block held in m_cache, blockCount() = none
+    std::vector<double> m_cache; // decoded frames of m_cachedBlock
+    std::vector<unsigned char> m_raw; // scratch, delta stream of a block
+};
+
+#endif
@@ -0,0 +1,114 @@
+// densitymap2d class, screen-resolution histogram of body positions with log scaling and a colormap
+
+#ifndef DENSITY_MAP2D_H
+#define DENSITY_MAP2D_H
+
+#include "body2d.hpp"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief bins bodies into one cell per pixel and turns the counts into an RGBA image
+ * Stores:
+ *      image size and the mapping from simulation to pixel coordinates
+ *      one float histogram per binning band, band 0 holds the sum after bin()
+ *      the RGBA pixels of the last colorize() and a 256 entry colormap
+ * Responsible for:
+ *      bin(): count bodies, or sum their masses, per pixel
+ *      colorize(): log-scale the histogram between its smallest and largest non-empty pixel
+ *          and look the result up in the colormap, empty pixels stay black
+ *
+ * Cost is O(n) to bin plus O(width * height) to reduce and colorize, no matter how many bodies share a pixel.
+ * Bodies are split into bands, each band bins into its own histogram and the histograms are summed
+ * afterwards, so threads never write the same pixel. A band only pays off once it holds a good
+ * fraction of a histogram's worth of bodies, fewer bodies use fewer bands.
+ * The mapping matches the window: origin at the image center, y up, viewScale pixels per length unit.
+ */
+template<typename T>
+class DensityMap2D{
+public:
+    /**
+     * @brief construct an image of width x height pixels, histograms are allocated by the first bin()
+     *
+     * @param width image width in pixels
+     * @param height image height in pixels
+     * @param viewScale pixels per simulation length unit
+     */
+    DensityMap2D(std::size_t width, std::size_t height, float viewScale);
+
+    /**
+     * @brief set whether pixels sum masses instead of counting bodies
+     *
+     * @param massWeighted true to sum masses
+     */
+    void setMassWeighted(bool massWeighted);
+
+    /**
+     * @brief Get whether pixels sum masses
+     *
+     * @return true if mass weighted
+     */
+    bool getMassWeighted() const;
+
+    /**
+     * @brief rebuild the histogram from the current positions
+     *        bodies off the image or with a non-finite position are left out
+     *
+     * @param bodies bodies to bin
+     * @param pool worker threads, null = calling thread only
+     */
+    void bin(const std::vector<Body2D<T>> &bodies, ThreadPool *pool);
+
+    /**
+     * @brief map the histogram of the last bin() to RGBA pixels
+     *
+     * @param pool worker threads, null = calling thread only
+     */
+    void colorize(ThreadPool *pool);
+
+    /**
+     * @brief returns RGBA pixels of the last colorize(), row-major, top row first
+     *
+     * @return const std::vector<std::uint8_t>& width * height * 4 bytes
+     */
+    const std::vector<std::uint8_t> &pixels() const;
+
+    /**
+     * @brief returns image width in pixels
+     *
+     * @return std::size_t width
+     */
+    std::size_t width() const;
+
+    /**
+     * @brief returns image height in pixels
+     *
+     * @return std::size_t height
+     */
+    std::size_t height() const;
+
+    /**
+     * @brief returns largest pixel value of the last colorize(), bodies or mass
+     *
+     * @return float maximum
+     */
+    float maxDensity() const;
+
+    static constexpr std::size_t PIXELS_PER_BAND_BODY = 4; // a band needs at least pixels / this many bodies
+    static constexpr std::size_t PIXEL_GRAIN = 16384; // pixels per task when summing and colorizing
+
+private:
+    std::size_t m_width; // image width
+    std::size_t m_height; // image height
+    float m_viewScale; // pixels per length unit
+    bool m_massWeighted; // sum masses instead of counting
+    float m_maxDensity; // largest pixel value of the last colorize()
+    std::vector<float> m_bands; // one width * height histogram per band, band 0 is the total
+    std::vector<std::uint8_t> m_pixels; // RGBA image
+    std::vector<std::uint8_t> m_colormap; // 256 RGB entries, dark to bright
+};
+
+#endif
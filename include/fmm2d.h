@@ -0,0 +1,178 @@
+// fmmsolver2d class, fast multipole method for O(n) forces
+
+#ifndef FMM2D_H
+#define FMM2D_H
+
+#include "vec2.hpp"
+#include "body_arrays2d.hpp"
+#include "real_type.hpp"
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief fast multipole method for the softened 1/r kernel on a 2D plane
+ * Stores:
+ *      quadtree of cells, each with center of mass, radius, multipole and local expansions
+ *      per-body potential and potential gradient from the last evaluation
+ * Responsible for:
+ *      building the tree and upward pass (P2M, M2M)
+ *      dual tree walk: well separated cell pairs get M2L, close leaf pairs get P2P
+ *      downward pass (L2L, L2P) to every body
+ *
+ * Expansions are Cartesian Taylor series of g(R) = (|R|^2 + eps2)^(-1/2) up to a given order.
+ * The complex Laurent series of the classic 2D FMM only fit a log potential,
+ * the kernel here is the 3D Newtonian one restricted to the plane.
+ * Two cells A and B are well separated when (radius_A + radius_B) < theta * |com_A - com_B|.
+ * Complexity = O(n) for a fixed order and theta.
+ */
+template<typename T>
+class FmmSolver2D{
+public:
+    /**
+     * @brief construct a solver with expansion order 4
+     *
+     */
+    FmmSolver2D();
+
+    /**
+     * @brief set expansion order p, clamped to [1, MAX_ORDER]
+     *        error falls roughly like theta^(p+1)
+     *
+     * @param order highest derivative kept in the expansions
+     */
+    void setOrder(int order);
+
+    /**
+     * @brief Get expansion order
+     *
+     * @return int
+     */
+    int getOrder() const;
+
+    /**
+     * @brief build tree and evaluate potential and its gradient at every body
+     *        results stay in the solver until the next evaluate()
+     *
+     * @param bodies bodies acting as sources and targets
+     * @param eps2 softening value added to r^2
+     * @param theta separation parameter for M2L
+     */
+    void evaluate(const BodyArrays2D<T> &bodies, T eps2, T theta);
+
+    /**
+     * @brief add acceleration from the last evaluate() to each body's accumulator
+     *        a_i = G * grad(psi)(r_i)
+     *
+     * @param bodies same bodies that were evaluated
+     * @param G gravitational constant
+     */
+    void accumulateAccelerations(BodyArrays2D<T> &bodies, T G) const;
+
+    /**
+     * @brief potential energy from the last evaluate()
+     *        U = -0.5 * G * sum(m_i * psi(r_i))
+     *
+     * @param bodies same bodies that were evaluated
+     * @param G gravitational constant
+     * @return T potential energy
+     */
+    T potentialEnergy(const BodyArrays2D<T> &bodies, T G) const;
+
+    static constexpr int MAX_ORDER = 12; // highest supported expansion order
+
+private:
+    /**
+     * @brief one square cell of the quadtree
+     * children are stored as four consecutive entries in m_nodes
+     */
+    struct Node{
+        Vec2<T> center; // geometric center of the cell
+        T halfSize; // half of the cell side length
+        T mass; // total mass inside the cell
+        Vec2<T> com; // center of mass, expansion center
+        T radius; // max distance from com to any body in the cell
+        std::size_t begin; // first index into m_order owned by this cell
+        std::size_t end; // one past the last index into m_order
+        std::size_t firstChild; // index of first child in m_nodes, 0 if leaf
+    };
+
+    /**
+     * @brief recursively split a cell, then compute mass, com, radius and multipoles (P2M, M2M)
+     *
+     * @param nodeIndex index of cell in m_nodes
+     * @param bodies bodies being sorted into the tree
+     * @param depth depth of the cell, root = 0
+     */
+    void buildNode(std::size_t nodeIndex, const BodyArrays2D<T> &bodies, int depth);
+
+    /**
+     * @brief dual tree walk, cell a receives the field of cell b
+     *
+     * @param a target cell
+     * @param b source cell
+     * @param bodies bodies in the tree
+     */
+    void interact(std::size_t a, std::size_t b, const BodyArrays2D<T> &bodies);
+
+    /**
+     * @brief direct interaction of bodies in leaf b on bodies in leaf a
+     *
+     * @param a target cell
+     * @param b source cell
+     * @param bodies bodies in the tree
+     */
+    void particleToParticle(std::size_t a, std::size_t b, const BodyArrays2D<T> &bodies);
+
+    /**
+     * @brief translate multipole of b into local expansion of a
+     *
+     * @param a target cell
+     * @param b source cell
+     */
+    void multipoleToLocal(std::size_t a, std::size_t b);
+
+    /**
+     * @brief push local expansions down the tree and evaluate them at the bodies (L2L, L2P)
+     *
+     * @param bodies bodies in the tree
+     */
+    void downwardPass(const BodyArrays2D<T> &bodies);
+
+    /**
+     * @brief derivatives D_(a,b) = d^a/dx^a d^b/dy^b of g(R) for a + b <= order
+     *
+     * @param R separation vector
+     * @param D output, m_coeffs entries in coefficient order
+     */
+    void kernelDerivatives(const Vec2<T> &R, T *D) const;
+
+    /**
+     * @brief position of coefficient (a, b) in a packed expansion
+     *
+     * @param a power of x
+     * @param b power of y
+     * @return std::size_t index
+     */
+    static std::size_t coeffIndex(int a, int b);
+
+    static constexpr std::size_t LEAF_CAPACITY = 16; // max bodies in a leaf before it is split
+    static constexpr int MAX_DEPTH = 48; // stop splitting here, handles coincident bodies
+    static constexpr std::size_t MAX_COEFFS = (MAX_ORDER + 1) * (MAX_ORDER + 2) / 2; // coefficients at MAX_ORDER
+
+    int m_expansionOrder; // expansion order p
+    std::size_t m_coeffs; // coefficients per expansion, (p + 1)(p + 2) / 2
+    T m_eps2; // softening used by the current evaluation
+    T m_theta; // separation parameter used by the current evaluation
+    std::vector<T> m_invFactorial; // 1 / a! for a <= p
+    std::vector<T> m_hermite; // a! / (2^k k! (a - 2k)!) at [a * (p + 1) + k]
+
+    std::vector<Node> m_nodes; // all cells, root at index 0
+    std::vector<std::size_t> m_order; // body indices grouped by cell
+    std::vector<T> m_multipoles; // m_coeffs multipole moments per cell
+    std::vector<T> m_locals; // m_coeffs local coefficients per cell
+    std::vector<T> m_psi; // psi(r_i) = sum over j != i of m_j * g(r_i - r_j)
+    std::vector<Vec2<T>> m_grad; // gradient of psi at r_i
+};
+
+#endif
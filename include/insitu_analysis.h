@@ -0,0 +1,250 @@
+// insituanalysis class, reductions of the running state written as a small csv time series
+
+#ifndef INSITU_ANALYSIS_H
+#define INSITU_ANALYSIS_H
+
+#include "body2d.hpp"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+template<typename T>
+class NBodySystem2D;
+
+/**
+ * @brief parameters of the built-in probes
+ *
+ */
+struct AnalysisSettings{
+    std::size_t radialBins = 16; // radial: annuli of the surface density profile
+    double radialMax = 0.0; // radial: outer radius of the profile, 0 = radius holding every body of the first row
+    double escapeRadius = 0.0; // escapers: smallest distance from the centre of mass to count, 0 = any
+    double G = 1.0; // escapers: gravitational constant of the run
+};
+
+/**
+ * @brief quantities shared by all probes, computed once per row
+ *        positions and velocities are those of the bodies still in the system, merged bodies are gone
+ *
+ */
+template<typename T>
+struct AnalysisFrame{
+    double t = 0.0; // simulation time
+    const std::vector<Body2D<T>> *bodies = nullptr; // current bodies
+    double mass = 0.0; // total mass
+    double comX = 0.0; // centre of mass
+    double comY = 0.0;
+    double comVx = 0.0; // centre of mass velocity
+    double comVy = 0.0;
+    double energy = 0.0; // totalEnergy(), only set when a probe needs it
+    ThreadPool *pool = nullptr; // threads for the probe's own loops, null = calling thread only
+};
+
+/**
+ * @brief one pluggable reduction, adds a fixed set of columns to every row
+ *        measure(frame, settings, reference, out) writes columns.size() values to out,
+ *        reference holds this probe's values of the first row of the series, null while that row is measured,
+ *        so drifts need no state of their own and survive a resume
+ *
+ */
+template<typename T>
+struct AnalysisProbe2D{
+    std::string name; // name in the analysis config key
+    std::vector<std::string> columns; // csv column names
+    bool needsEnergy = false; // frame.energy must be computed
+    std::function<void(const AnalysisFrame<T> &, const AnalysisSettings &, const double *, double *)> measure;
+};
+
+/**
+ * @brief names of the built-in probes, in the order they are documented
+ *
+ * @return const std::vector<std::string>&
+ */
+const std::vector<std::string> &analysisProbeNames();
+
+/**
+ * @brief split a comma separated probe list, spaces around names are dropped
+ *
+ * @param list value of the analysis config key, empty or "off" = no probes
+ * @param names receives the names in list order
+ * @param err stream for an unknown or repeated name
+ * @return true if every name is a built-in probe
+ * @return false otherwise
+ */
+bool parseAnalysisProbes(const std::string &list, std::vector<std::string> &names, std::ostream &err);
+
+/**
+ * @brief build a built-in probe
+ *      energy = E_total, dE_rel = (E - E0) / |E0|
+ *      com = com_x, com_y, com_vx, com_vy, centre of mass and its velocity
+ *      angmom = L_z, dL_z = L - L0, angular momentum about the origin
+ *      radial = r_half, r_max, sigma_1 .. sigma_B, half-mass radius and the surface density of
+ *          radialBins equal-width annuli about the centre of mass out to r_max
+ *      escapers = escapers, escaped_mass, bodies past escapeRadius whose energy relative to the
+ *          centre of mass, with the total mass as a point potential, is positive
+ *
+ * @param name one of analysisProbeNames()
+ * @param settings bin count, sizes the radial columns
+ * @param probe receives the probe
+ * @return true if the name is known
+ * @return false otherwise
+ */
+template<typename T>
+bool makeAnalysisProbe(const std::string &name, const AnalysisSettings &settings, AnalysisProbe2D<T> &probe);
+
+/**
+ * @brief in-situ analysis stage run next to RunLogger
+ * Stores:
+ *      the probes, their settings and the column layout of a row
+ *      the first row of the series, the reference of every drift
+ *      the csv stream and a worker pool for the reductions
+ * Responsible for:
+ *      analyze(): reduce the current state to one row of the time series
+ *      open(), openAppend(), writeHeader(), flush(), close(): the csv file, in the manner of RunLogger
+ *
+ * Row layout: t, N, then the columns of every probe in the order they were added.
+ * A row costs O(N) per probe on the worker pool, radial adds an O(N log N) sort for r_half,
+ * energy one totalEnergy() call, O(N) when the step before tracked the potential.
+ * Sums run over fixed chunks of bodies, so rows do not depend on the thread count.
+ */
+template<typename T>
+class InSituAnalysis2D{
+public:
+    /**
+     * @brief construct a stage with no probes and no file
+     *
+     */
+    InSituAnalysis2D();
+
+    InSituAnalysis2D(const InSituAnalysis2D &) = delete;
+    InSituAnalysis2D &operator=(const InSituAnalysis2D &) = delete;
+
+    /**
+     * @brief set the parameters of built-in probes added afterwards
+     *
+     * @param settings probe parameters
+     */
+    void setSettings(const AnalysisSettings &settings);
+
+    /**
+     * @brief set the worker threads of the reductions, the pool starts with the first analyze()
+     *
+     * @param threads total threads, 0 = all hardware threads
+     */
+    void setThreadCount(std::size_t threads);
+
+    /**
+     * @brief add a built-in probe by name
+     *
+     * @param name one of analysisProbeNames()
+     * @return true if the name is known
+     * @return false otherwise
+     */
+    bool addProbe(const std::string &name);
+
+    /**
+     * @brief add a probe, built-in or custom, before the header is written
+     *
+     * @param probe probe to add
+     */
+    void addProbe(const AnalysisProbe2D<T> &probe);
+
+    /**
+     * @brief whether any probe was added
+     *
+     * @return true if analyze() writes rows
+     */
+    bool active() const;
+
+    /**
+     * @brief whether a probe needs totalEnergy()
+     *
+     * @return true if steps ending on a row should track the potential
+     */
+    bool needsEnergy() const;
+
+    /**
+     * @brief open the csv file for writing
+     *
+     * @param path file path
+     * @return true if the file is open
+     * @return false otherwise
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief reopen an existing series to continue it, e.g. after resuming from a checkpoint
+     *        keeps the header and the first rowsKept rows, cuts anything after them and appends from there,
+     *        the first kept row becomes the drift reference again, writeHeader() then does nothing
+     *        a missing file is opened like open()
+     *
+     * @param path file path
+     * @param rowsKept rows up to the checkpoint
+     * @param rowsFound receives rows actually kept, fewer if the file was shorter
+     * @return true if the file is open
+     * @return false otherwise
+     */
+    bool openAppend(const std::string &path, unsigned long long rowsKept, unsigned long long &rowsFound);
+
+    /**
+     * @brief write the column names, once
+     *
+     */
+    void writeHeader();
+
+    /**
+     * @brief reduce the current state to one row and write it
+     *
+     * @param t simulation time
+     * @param system system to reduce, read only
+     */
+    void analyze(T t, const NBodySystem2D<T> &system);
+
+    /**
+     * @brief push written rows to the file
+     *
+     */
+    void flush();
+
+    /**
+     * @brief close the file
+     *
+     */
+    void close();
+
+    /**
+     * @brief returns rows written since open, kept rows of openAppend() not included
+     *
+     * @return unsigned long long
+     */
+    unsigned long long rowsWritten() const;
+
+    /**
+     * @brief returns the names of the added probes, comma separated
+     *
+     * @return std::string
+     */
+    std::string probeList() const;
+
+    static constexpr std::size_t SUM_GRAIN = 8192; // bodies per chunk of a reduction
+
+private:
+    AnalysisSettings m_settings; // parameters of built-in probes
+    std::vector<AnalysisProbe2D<T>> m_probes; // probes in column order
+    std::vector<std::size_t> m_offsets; // first value of every probe within the probe columns
+    std::size_t m_values; // probe columns of a row
+    std::vector<double> m_row; // scratch, probe values of the current row
+    std::vector<double> m_reference; // probe values of the first row, empty until it exists
+    std::size_t m_threads; // worker threads of the reductions
+    std::unique_ptr<ThreadPool> m_pool; // reduction threads, created on first use, null for one thread
+    std::ofstream m_out; // csv stream
+    bool m_wroteHeader; // header line is in the file
+    unsigned long long m_rows; // rows written since open
+};
+
+#endif
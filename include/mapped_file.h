@@ -0,0 +1,68 @@
+// mappedfile class, read-only view of a whole file
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief read-only bytes of a file
+ *        memory mapped where the OS allows it, read into memory otherwise
+ *        pages are only loaded when they are touched, so opening a large file is instant
+ */
+class MappedFile{
+public:
+    /**
+     * @brief construct a closed file
+     *
+     */
+    MappedFile();
+
+    /**
+     * @brief unmap and close
+     *
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief map a file
+     *
+     * @param path file to open
+     * @return true if the file could be opened, an empty file has size() 0
+     * @return false otherwise
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief unmap and release the file
+     *
+     */
+    void close();
+
+    /**
+     * @brief first byte of the file, nullptr when closed or empty
+     *
+     * @return const char*
+     */
+    const char *data() const;
+
+    /**
+     * @brief file size in bytes
+     *
+     * @return std::size_t
+     */
+    std::size_t size() const;
+
+private:
+    const char *m_data; // start of the file
+    std::size_t m_size; // file size in bytes
+    bool m_mapped; // m_data comes from mmap, otherwise from m_buffer
+    std::vector<char> m_buffer; // whole file, when mapping is not available
+};
+
+#endif
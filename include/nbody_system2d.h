@@ -3,23 +3,119 @@
 #ifndef NBODY_SYSTEM2D_H
 #define NBODY_SYSTEM2D_H
 
-#include "real_type.hpp"
+#include "vec2.hpp"
 #include "body2d.hpp"
+#include "body_arrays2d.hpp"
+#include "barnes_hut2d.h"
+#include "fmm2d.h"
+#include "pm2d.h"
+#include "real_type.hpp"
+#include "simd_kernels.h"
+#include "spatial_hash2d.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+
 /**
- * @brief 2d newtonian n-body system
+ * @brief selects how computeForces() evaluates gravity
+ *      Direct = exact pairwise sum, O(n^2)
+ *      BarnesHut = quadtree approximation controlled by theta, O(n log n)
+ *      Fmm = fast multipole method controlled by theta and expansion order, O(n)
+ *      Pm = particle mesh, masses on a grid convolved with the kernel by FFT, O(n + M^2 log M)
+ */
+enum class ForceEngine{
+    Direct,
+    BarnesHut,
+    Fmm,
+    Pm
+};
+
+/**
+ * @brief selects how NBodySystem2D lays out its bodies in memory
+ *      AoS = std::vector<Body2D<T>>, one record per body, symmetric i<j force loop
+ *      SoA = BodyArrays2D<T>, one dense array per field, vectorizable force loop
+ * bodies() works in both modes, in SoA mode it returns a synchronized copy
+ */
+enum class StorageMode{
+    AoS,
+    SoA
+};
+
+/**
+ * @brief accuracy of an approximate force engine against the direct sum
+ *        relative error per body = |F - F_direct| / |F_direct|
+ */
+struct ForceErrorReport{
+    std::size_t samples; // number of bodies compared
+    double rmsRelError; // root mean square relative error
+    double maxRelError; // worst relative error
+};
+
+/**
+ * @brief what resolveCollisions() does with bodies closer than the sum of their radii
+ *      Off = nothing
+ *      Detect = report every overlapping pair, the bodies pass through each other
+ *      Merge = perfectly inelastic merging, every group of touching bodies becomes its most massive member
+ */
+enum class CollisionMode{
+    Off,
+    Detect,
+    Merge
+};
+
+/**
+ * @brief one collision found by resolveCollisions(), bodies are named by their stable id
+ */
+struct CollisionEvent{
+    std::size_t idA; // Detect: lower id of the pair, Merge: the body that survives
+    std::size_t idB; // Detect: higher id of the pair, Merge: the body merged into idA
+};
+
+/**
+ * @brief everything NBodySystem2D needs to continue a run exactly where captureState() was called
+ *        the values are copied bit for bit, so a restore in the same storage mode and precision
+ *        steps on exactly like the original run
+ */
+template<typename T>
+struct SystemState2D{
+    BodyArrays2D<T> arrays; // masses, positions, velocities and the force-pass result the integrators carry over
+    bool forcesInArrays; // ax, ay hold forces F (AoS capture) instead of accelerations F / m (SoA capture)
+    bool forcesValid; // ax, ay belong to the positions, leapfrog, yoshida and block reuse them
+    bool hermiteValid; // ax, ay and the jerks start the next Hermite step
+    std::vector<T> jerkX; // Hermite x jerks, empty unless hermiteValid
+    std::vector<T> jerkY; // Hermite y jerks, empty unless hermiteValid
+    unsigned long long forceEvaluations; // forceEvaluations() at capture
+    unsigned long long pairInteractions; // pairInteractions() at capture
+    std::vector<std::size_t> ids; // stable id of every body, ascending, empty = 0 .. n-1
+    std::size_t idCount; // ids handed out so far
+    std::vector<T> radii; // collision radius of every body, empty if none were set
+};
+
+/**
+ * @brief 2d newtonian n-body system, using scalar type T for all state and arithmetic
+ *        T = float, double or long double, picked at startup by the precision config key
  * Stores:
- *      list of Body2D objects with masses, positions, velocities, and forces
+ *      list of Body2D<T> objects with masses, positions, velocities, and forces
+ *          or, in SoA mode, one array per field plus a Body2D<T> copy refreshed on demand
  *      graviational constant G
  *      softening parameter eps2 for when bodies get close
  * Responsbile for:
  *      managing list of bodies: add, query
- *      computing pairwise gravitational forces O(n^2)
+ *      computing gravitational forces, pairwise O(n^2), Barnes-Hut O(n log n), FMM O(n) or particle mesh
  *      computing total energy = kinetic + potential
- *      advancing the system with either euler, semieuler, or verlet
+ *      advancing the system with either euler, semieuler, verlet, kick-drift-kick leapfrog, block timesteps,
+ *      4th-order yoshida or 4th-order hermite
+ *      keeping the last forces while positions and parameters are unchanged, so leapfrog reuses them
+ *      optionally summing the potential energy in the force pass, so totalEnergy() only adds kinetic energy
+ *      spreading force, energy and update loops over an owned persistent thread pool
+ *      giving every body a stable id that survives bodies being merged away
+ *      finding overlapping bodies with a uniform spatial hash grid and merging or reporting them
  */
+template<typename T>
 class NBodySystem2D{
 public:
     /**
@@ -37,14 +133,14 @@ public:
      * @param GValue gravitational constant
      * @param eps2Value softening value added to r^2
      */
-    NBodySystem2D(Real GValue, Real eps2Value);
+    NBodySystem2D(T GValue, T eps2Value);
 
     /**
      * @brief set gravitational constant
      * 
      * @param GValue gravitational constant
      */
-    void setG(Real GValue);
+    void setG(T GValue);
 
     /**
      * @brief Set softening parameter
@@ -52,28 +148,349 @@ public:
      * 
      * @param eps2Value softening parameter
      */
-    void setEps2(Real eps2Value);
+    void setEps2(T eps2Value);
 
     /**
      * @brief Get gravitational constant
      * 
-     * @return Real 
+     * @return T 
      */
-    Real getG() const;
+    T getG() const;
 
     /**
      * @brief Get softening parameter
      * 
-     * @return Real 
+     * @return T 
+     */
+    T getEps2() const;
+
+    /**
+     * @brief select memory layout of the bodies
+     *        existing bodies are converted, forces/accelerations are kept
+     * 
+     * @param mode AoS or SoA
      */
-    Real getEps2() const;
+    void setStorageMode(StorageMode mode);
+
+    /**
+     * @brief Get memory layout of the bodies
+     * 
+     * @return StorageMode 
+     */
+    StorageMode getStorageMode() const;
+
+    /**
+     * @brief select the force evaluation engine used by computeForces()
+     * 
+     * @param engine Direct, BarnesHut, Fmm or Pm
+     */
+    void setForceEngine(ForceEngine engine);
+
+    /**
+     * @brief Get force evaluation engine
+     * 
+     * @return ForceEngine 
+     */
+    ForceEngine getForceEngine() const;
+
+    /**
+     * @brief set Barnes-Hut opening angle
+     *        smaller is more accurate and slower, 0 reproduces the direct sum
+     * 
+     * @param thetaValue opening angle, cell size / distance threshold
+     */
+    void setTheta(T thetaValue);
+
+    /**
+     * @brief Get Barnes-Hut opening angle
+     * 
+     * @return T 
+     */
+    T getTheta() const;
+
+    /**
+     * @brief set FMM expansion order
+     *        higher is more accurate and slower
+     * 
+     * @param order highest derivative kept, clamped to [1, FmmSolver2D<T>::MAX_ORDER]
+     */
+    void setFmmOrder(int order);
+
+    /**
+     * @brief Get FMM expansion order
+     * 
+     * @return int 
+     */
+    int getFmmOrder() const;
+
+    /**
+     * @brief set particle-mesh grid
+     *        structure below the cell size is smoothed away, the error drops fast once sqrt(eps2) spans a few cells
+     * 
+     * @param cells cells per side, rounded up to a power of two in [PmSolver2D<T>::MIN_GRID, PmSolver2D<T>::MAX_GRID]
+     * @param assignment Cic or Tsc
+     */
+    void setPmGrid(std::size_t cells, PmAssignment assignment);
+
+    /**
+     * @brief set particle-mesh boundary condition
+     * 
+     * @param boundary Isolated or Periodic
+     * @param boxSize side of the periodic box centred on the origin, ignored for Isolated
+     */
+    void setPmBoundary(PmBoundary boundary, T boxSize);
+
+    /**
+     * @brief Get particle-mesh solver, for its settings and the cell size and smoothing length of the last pass
+     * 
+     * @return const PmSolver2D<T>& 
+     */
+    const PmSolver2D<T> &pmSolver() const;
+
+    /**
+     * @brief copy G, eps2 and every setting that changes forces or energies from another system
+     *        engine, theta, FMM order, particle-mesh grid and boundary, SIMD level, fast rsqrt and float pairs
+     *        bodies, storage, threads and block timestep settings are left as they are
+     * 
+     * @param other system whose forces and energies this one should reproduce
+     */
+    void copyForceSettings(const NBodySystem2D<T> &other);
+
+    /**
+     * @brief select instruction set for the direct-sum kernel
+     *        clamped to what the running CPU supports, long double always runs the scalar loop
+     * 
+     * @param level Scalar, Avx2 or Avx512
+     */
+    void setSimdLevel(SimdLevel level);
+
+    /**
+     * @brief Get instruction set used by the direct-sum kernel, after clamping
+     * 
+     * @return SimdLevel 
+     */
+    SimdLevel getSimdLevel() const;
+
+    /**
+     * @brief use reciprocal square root estimate + Newton refinement in the SIMD kernel
+     *        slightly less accurate than 1 / sqrt, no effect on the scalar loop
+     * 
+     * @param enabled true to use the fast path
+     */
+    void setFastRsqrt(bool enabled);
+
+    /**
+     * @brief Get whether the SIMD kernel uses the fast reciprocal square root
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool getFastRsqrt() const;
+
+    /**
+     * @brief mixed precision for the direct sum: float pair terms, double row sums, state and integration stay in T
+     *        each pass subtracts a local origin, the centre of the bodies' bounding box, before rounding positions
+     *        to float, so the float bits go to the separations instead of the absolute position
+     *        only useful for T = double or long double, float runs ignore it; the tree engines and the
+     *        Hermite jerk sum are not affected, direct rows of block substeps are
+     * 
+     * @param enabled true for float pair terms
+     */
+    void setFloatPairs(bool enabled);
+
+    /**
+     * @brief Get whether the direct sum evaluates pair terms in float
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool getFloatPairs() const;
+
+    /**
+     * @brief set number of power-of-two time bins used by stepBlock()
+     *        bin k steps with dt / 2^k, so the smallest step is dt / 2^(levels - 1)
+     * 
+     * @param levels number of bins, clamped to [1, MAX_BLOCK_LEVELS]
+     */
+    void setBlockLevels(int levels);
+
+    /**
+     * @brief Get number of time bins used by stepBlock()
+     * 
+     * @return int 
+     */
+    int getBlockLevels() const;
+
+    /**
+     * @brief set accuracy parameter of the block timestep criterion
+     *        a body wants the step sqrt(2 * eta * sqrt(eps2) / |a|), smaller eta = smaller steps
+     * 
+     * @param eta accuracy parameter, > 0
+     */
+    void setBlockEta(T eta);
+
+    /**
+     * @brief Get accuracy parameter of the block timestep criterion
+     * 
+     * @return T 
+     */
+    T getBlockEta() const;
+
+    /**
+     * @brief number of bodies in each time bin after the last stepBlock()
+     * 
+     * @return std::vector<std::size_t> index = bin, empty before the first block step
+     */
+    std::vector<std::size_t> blockBinCounts() const;
+
+    /**
+     * @brief set number of threads used by force, energy and update loops
+     *        workers are started once here and reused by every step, 1 runs everything on the caller
+     * 
+     * @param count total threads, 0 = all hardware threads
+     */
+    void setThreadCount(std::size_t count);
+
+    /**
+     * @brief Get number of threads used by force, energy and update loops
+     * 
+     * @return std::size_t 
+     */
+    std::size_t getThreadCount() const;
+
+    /**
+     * @brief let force passes also sum the potential energy from the 1 / r they already compute
+     *        totalEnergy() then adds the kinetic energy to it while positions are unchanged
+     *        Direct, Fmm and Pm engines, with Barnes-Hut totalEnergy() keeps the exact pair sum
+     * 
+     * @param enabled true to fuse the potential into the following force passes
+     */
+    void setTrackPotential(bool enabled);
+
+    /**
+     * @brief Get whether force passes also sum the potential energy
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool getTrackPotential() const;
+
+    /**
+     * @brief true if the last force pass summed the potential and positions have not changed since
+     * 
+     * @return true totalEnergy() is O(n)
+     * @return false totalEnergy() runs the full potential sum
+     */
+    bool potentialCached() const;
+
+    /**
+     * @brief number of force passes since construction, block steps count only the ticks where some step ends
+     * 
+     * @return unsigned long long
+     */
+    unsigned long long forceEvaluations() const;
+
+    /**
+     * @brief pair interactions of all force passes so far, direct-sum equivalent
+     *        a full pass counts n(n-1)/2, a block substep counts n-1 per active body
+     * 
+     * @return unsigned long long
+     */
+    unsigned long long pairInteractions() const;
+
+    /**
+     * @brief copy bodies and integrator state, the O(n) part of a checkpoint
+     *        G, eps2 and the engine settings are not included, they have their own getters
+     * 
+     * @param state overwritten, its buffers are reused
+     */
+    void captureState(SystemState2D<T> &state) const;
+
+    /**
+     * @brief replace bodies and integrator state with a captured state
+     *        set G and eps2 first, their setters discard the carried forces
+     * 
+     * @param state state from captureState(), possibly of a system in the other storage mode
+     */
+    void restoreState(const SystemState2D<T> &state);
 
     /**
      * @brief add new body to system
      * 
-     * @param body instance of Body2D to append to vector
+     * @param body instance of Body2D<T> to append to vector
+     */
+    void addBody(const Body2D<T> &body);
+
+    /**
+     * @brief reserve room for count bodies in total, so following addBody()/addBodies() calls do not reallocate
+     * 
+     * @param count total number of bodies expected
+     */
+    void reserveBodies(std::size_t count);
+
+    /**
+     * @brief append count bodies at once, same result as count addBody() calls
+     * 
+     * @param first pointer to the first body to append
+     * @param count number of bodies
+     */
+    void addBodies(const Body2D<T> *first, std::size_t count);
+
+    /**
+     * @brief set the collision radius of every body, in body order
+     *        missing entries are 0, a body with radius 0 only collides with bodies that have a radius
+     * 
+     * @param radii radius per body, >= 0
+     */
+    void setRadii(const std::vector<T> &radii);
+
+    /**
+     * @brief collision radius of every body
+     * 
+     * @return const std::vector<T>& one per body, empty if setRadii() was never called
+     */
+    const std::vector<T> &radii() const;
+
+    /**
+     * @brief stable id of every body, in body order
+     *        bodies get ids 0, 1, 2, ... as they are added, an id is never reused,
+     *        so ids stay ascending when merged bodies are compacted out
+     * 
+     * @return const std::vector<std::size_t>& one per body
+     */
+    const std::vector<std::size_t> &bodyIds() const;
+
+    /**
+     * @brief number of ids handed out so far, every id is below it
+     *        equals bodyCount() until bodies are merged
+     * 
+     * @return std::size_t
+     */
+    std::size_t idCount() const;
+
+    /**
+     * @brief replace the ids, e.g. for a copy of another system's bodies
+     * 
+     * @param ids one per body, ascending, all below idCount
+     * @param idCount ids handed out so far
+     */
+    void setBodyIds(const std::vector<std::size_t> &ids, std::size_t idCount);
+
+    /**
+     * @brief find bodies closer than the sum of their radii and report or merge them
+     *        candidates come from a uniform spatial hash grid rebuilt from the current positions, O(n)
+     *        Merge: a group of touching bodies keeps the id and index of its most massive member,
+     *        lowest id on ties, with the total mass, the centre of mass, the total momentum and
+     *        the radius sqrt(sum r^2) of a body of the same surface density;
+     *        the others are compacted out keeping the order
+     *        carried forces are patched for the merged bodies instead of a new pass while the groups
+     *        are small, O(n) per member, exact for the direct sum, Pm always recomputes; call between steps, when every body is synchronized
+     * 
+     * @param mode Off, Detect or Merge
+     * @param events overwritten with the collisions found, by ascending id
+     * @return std::size_t number of bodies merged away
      */
-    void addBody(const Body2D &body);
+    std::size_t resolveCollisions(CollisionMode mode, std::vector<CollisionEvent> &events);
 
     /**
      * @brief returns number of bodies in system
@@ -84,29 +501,53 @@ public:
 
     /**
      * @brief non-const access to body list
+     *        in SoA mode edits to the list are copied back into the arrays before the next step
      * 
-     * @return std::vector<Body2D>& 
+     * @return std::vector<Body2D<T>>& 
      */
-    std::vector<Body2D> &bodies();
+    std::vector<Body2D<T>> &bodies();
 
     /**
      * @brief const access to body list
+     *        in SoA mode the list is refreshed from the arrays first
      * 
-     * @return const std::vector<Body2D>& 
+     * @return const std::vector<Body2D<T>>& 
      */
-    const std::vector<Body2D> &bodies() const;
+    const std::vector<Body2D<T>> &bodies() const;
 
     /**
      * @brief compute gravitational forces on all bodies
      * 
      * Steps:
      *      clear all force accumulators
-     *      for each pair (i, j) compute gravitational force
+     *      in SoA mode engines fill accelerations ax, ay instead of forces
+     *      Direct: for each pair (i, j) compute gravitational force
      *          F = G * m_i * m_j * r_hat / (|r|^2 + eps2)^(3/2) and add +F to body i and -F to body j
+     *          in SoA mode every row i sums all j instead, no writes to body j
+     *          with threads, rows are split into bands of equal pair count,
+     *          each band adds into its own force accumulator and the accumulators are summed after
+     *          float/double with a SIMD level: rows of the SoA arrays go through the
+     *          AVX2/AVX-512 kernel, AoS mode gathers into arrays first
      *          Complexity = O(n^2) for n bodies
+     *      BarnesHut: build quadtree, then walk it once per body, walks are spread over threads
+     *          Complexity = O(n log n) for n bodies
+     *      Fmm: build quadtree with expansions, dual tree walk
+     *          Complexity = O(n) for n bodies
+     *      Pm: assign masses to the grid, FFT convolution, interpolate back, interpolation is spread over threads
+     *          Complexity = O(n + M^2 log M) for n bodies and an M x M transform
      * 
      */
     void computeForces();
+    /**
+     * @brief compare forces of the current engine against the direct sum
+     *        calls computeForces(), then sums exact forces in long double for up to maxSamples evenly spaced bodies
+     *        with a periodic Pm boundary the exact sum takes the nearest image of every body
+     *        Complexity = O(n * maxSamples)
+     * 
+     * @param maxSamples number of bodies to check
+     * @return ForceErrorReport rms and max relative error
+     */
+    ForceErrorReport measureForceError(std::size_t maxSamples);
     /**
      * @brief compute total energy of the system
      * 
@@ -114,28 +555,32 @@ public:
      *      kinetic = sum(0.5 * m * v^2) over all bodies
      *      potential = sum over i<j of (-G * m_i * m_j / |r_ij|)
      *      uses eps2 for softening
+     *      with the Fmm engine the potential comes from the multipole expansions, O(n), with Pm from the mesh
+     *      otherwise the pair sum is split over the thread pool in bands of equal pair count
+     *      if potentialCached(), the potential of the last force pass is used and only kinetic is summed
+     *      kinetic and potential are summed in EnergySum<T>, at least double, and rounded to T once
      * 
-     * @return Real Total Energy
+     * @return T Total Energy
      */
-    Real totalEnergy() const;
+    T totalEnergy() const;
     /**
      * @brief advance system by one time step using euler
      * Algo:
      *      computeForces()
      *      a = F / m
-     *      r_{n+1} = r_n + v_n * dt
-     *      v_{n+1} = v_n + a * dt
+     *      r_{n+1} = r_n + v_n * dt    (drift)
+     *      v_{n+1} = v_n + a * dt      (kick)
      */
-    void stepEuler(Real dt);
+    void stepEuler(T dt);
     /**
      * @brief advance system by one time step using semieuler
      *      * Algo:
      *      computeForces()
      *      a = F / m
-     *      v_{n+1} = v_n + a * dt
-     *      r_{n+1} = r_n + v_{n+1} * dt
+     *      v_{n+1} = v_n + a * dt          (kick)
+     *      r_{n+1} = r_n + v_{n+1} * dt    (drift)
      */
-    void stepSemiEuler(Real dt);
+    void stepSemiEuler(T dt);
     /**
      * @brief advance system by one time step using verlet
      * Algo:
@@ -145,13 +590,246 @@ public:
      *      computeForces() again to get acceleration a_new
      *      update velocities: 
      *          v_{n+1} = v_n + 0.5 * (a_old + a_new) * dt
+     *      done as half kick with a_old, drift, computeForces(), half kick with a_new
+     */
+    void stepVerlet(T dt);
+    /**
+     * @brief advance system by one time step using kick-drift-kick leapfrog
+     * Algo:
+     *      v_{n+1/2} = v_n + 0.5 * a_n * dt            (kick)
+     *      r_{n+1} = r_n + v_{n+1/2} * dt              (drift)
+     *      computeForces() to get a_{n+1}
+     *      v_{n+1} = v_{n+1/2} + 0.5 * a_{n+1} * dt    (kick)
+     *      same trajectory as stepVerlet, but a_n is the a_{n+1} kept from the previous step,
+     *      so only one force evaluation per step
+     *      a_n is recomputed first if bodies or parameters changed since the last computeForces()
      */
-    void stepVerlet(Real dt);
-    
+    void stepLeapfrog(T dt);
+    /**
+     * @brief advance system by one time step with the 4th-order Yoshida / Forest-Ruth composition
+     * Algo:
+     *      w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 * w1 (negative)
+     *      stepLeapfrog(w1 * dt), stepLeapfrog(w0 * dt), stepLeapfrog(w1 * dt)
+     *      symmetric and symplectic like leapfrog, the middle backwards substep cancels the dt^3 error
+     *      three force evaluations per step, the last one is kept for the next step
+     */
+    void stepYoshida(T dt);
+    /**
+     * @brief advance system by one time step with the 4th-order Hermite predictor-corrector
+     * Algo:
+     *      a_0 and jerk j_0 = da/dt at the start of the step, kept from the previous step
+     *      predict:
+     *          r_p = r_0 + v_0 * dt + a_0 * dt^2 / 2 + j_0 * dt^3 / 6
+     *          v_p = v_0 + a_0 * dt + j_0 * dt^2 / 2
+     *      a_1, j_1 from the predicted positions and velocities
+     *      correct:
+     *          v_1 = v_0 + (a_0 + a_1) * dt / 2 + (j_0 - j_1) * dt^2 / 12
+     *          r_1 = r_0 + (v_0 + v_1) * dt / 2 + (a_0 - a_1) * dt^2 / 12
+     *      a_1, j_1 are used as a_0, j_0 of the next step, so one force evaluation per step
+     *      always uses the direct sum, the tree engines have no jerk
+     */
+    void stepHermite(T dt);
+    /**
+     * @brief advance system by dt with individual power-of-two timesteps (hierarchical block steps)
+     * Algo:
+     *      every body sits in a bin k and steps with dt_k = dt / 2^k, the step is split into
+     *      2^(levels - 1) ticks h of the smallest bin
+     *      at the start of the step every body is synchronized and gets its opening half kick
+     *          v += 0.5 * a * dt_k
+     *      each tick where a step ends, the next multiple of the finest occupied bin's length:
+     *          drift every body by the ticks since the last one, r += v * h * ticks
+     *          bodies whose step ends now are active: accelerations for active bodies only,
+     *          from all bodies at the current positions, then their closing half kick
+     *          active bodies pick a new bin from the criterion, a larger step only where the
+     *          time is aligned to it, and open their next step with a half kick
+     *      the last tick ends every bin, so all bodies are synchronized and the final
+     *      accelerations are kept for the next step, like stepLeapfrog
+     *      with one bin, or every body in bin 0, this is exactly stepLeapfrog, one force pass per step
+     *      Direct and Barnes-Hut sum active rows only, Fmm evaluates every body and uses the active ones,
+     *      or sums few active rows directly, Pm always evaluates every body
+     */
+    void stepBlock(T dt);
+
+    static constexpr int MAX_BLOCK_LEVELS = 20; // bins beyond this would need over a million substeps per step
+
 private:
-    std::vector<Body2D> m_bodies; // list of all simulated bodies
-    Real m_G; // gravitation constant
-    Real m_eps2; // softening parameter
+    /**
+     * @brief exact pairwise force sum, accumulators must already be cleared
+     *        with threads each band of rows writes into its own accumulator, no data races on body j
+     * 
+     */
+    void computeForcesDirect();
+    /**
+     * @brief run the current engine on arrays, accumulators must already be cleared
+     * 
+     * @param arrays bodies to receive accelerations
+     */
+    void computeAccelerations(BodyArrays2D<T> &arrays);
+    /**
+     * @brief exact acceleration sum over arrays, accumulators must already be cleared
+     *        each row i reads every j and writes only ax[i], ay[i]
+     *        uses the SIMD kernel when one is available for T
+     * 
+     * @param arrays bodies to receive accelerations
+     * @param rows rows to sum, nullptr = every row; a row list never sums the potential
+     */
+    void computeAccelerationsDirect(BodyArrays2D<T> &arrays, const std::vector<std::size_t> *rows = nullptr);
+    /**
+     * @brief true if the direct engine runs through the SIMD kernel for this T
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool simdDirectActive() const;
+    /**
+     * @brief true if the direct sum runs with float pair terms for this T
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool floatPairsActive() const;
+    /**
+     * @brief mixed-precision acceleration sum over arrays, float pair terms and double row sums
+     *        rows are independent as in computeAccelerationsDirect()
+     * 
+     * @param arrays bodies to receive accelerations
+     * @param rows rows to sum, nullptr = every row; a row list never sums the potential
+     */
+    void computeAccelerationsMixed(BodyArrays2D<T> &arrays, const std::vector<std::size_t> *rows);
+    /**
+     * @brief call body(begin, end) on chunks of [0, n), spread over the pool if there is one
+     * 
+     * @param n number of indices
+     * @param grain minimum chunk length
+     * @param body function taking a chunk [begin, end)
+     */
+    void parallelRanges(std::size_t n, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body) const;
+    /**
+     * @brief first row of band k when rows of the i<j pair triangle are split into bands of equal pair count
+     * 
+     * @param n number of bodies
+     * @param bands number of bands
+     * @param k band index, k = bands returns n
+     * @return std::size_t row index
+     */
+    static std::size_t triangularRowSplit(std::size_t n, std::size_t bands, std::size_t k);
+
+    static constexpr std::size_t PARALLEL_GRAIN = 4096; // minimum pair evaluations or body updates per parallel chunk
+    static constexpr std::size_t FMM_ACTIVE_DIRECT_LIMIT = 256; // block substeps: exact rows cost n each, an Fmm pass roughly a thousand n
+    static constexpr unsigned char COLLISION_ALIVE = 0; // m_collisionDead: body not in a merged group
+    static constexpr unsigned char COLLISION_DEAD = 1; // m_collisionDead: body merged away
+    static constexpr unsigned char COLLISION_SURVIVOR = 2; // m_collisionDead: body that holds a merged group
+    /**
+     * @brief accelerations of the listed bodies from all bodies, other rows are left as they are
+     *        Fmm evaluates every body, or sums the active rows directly when there are at most FMM_ACTIVE_DIRECT_LIMIT
+     *        Pm always evaluates every body, exact rows would not match the mesh forces of the others
+     * 
+     * @param arrays bodies with current positions
+     * @param active indices whose accelerations are recomputed
+     */
+    void computeAccelerationsActive(BodyArrays2D<T> &arrays, const std::vector<std::size_t> &active);
+    /**
+     * @brief direct-sum accelerations and jerks of every body, overwrites arrays.ax, ay and m_jerkX, m_jerkY
+     *        jerk_i = G * sum_j m_j * (v_ij / s^3 - 3 * (r_ij . v_ij) * r_ij / s^5), s^2 = |r_ij|^2 + eps2
+     * 
+     * @param arrays bodies with current positions and velocities
+     */
+    void computeAccelerationsJerk(BodyArrays2D<T> &arrays);
+    /**
+     * @brief bin a body wants for its acceleration, 0 = dt, levels - 1 = smallest step
+     * 
+     * @param ax x acceleration
+     * @param ay y acceleration
+     * @param dt step of bin 0
+     * @return int bin index
+     */
+    int blockBinFor(T ax, T ay, T dt) const;
+    /**
+     * @brief v += a * dt for every body
+     * 
+     * @param dt time step
+     */
+    void kick(T dt);
+    /**
+     * @brief r += v * dt for every body
+     * 
+     * @param dt time step
+     */
+    void drift(T dt);
+    /**
+     * @brief SoA mode: refresh the Body2D<T> copy if the arrays changed since the last refresh
+     * 
+     */
+    void syncMirror() const;
+    /**
+     * @brief SoA mode: reload the arrays if the Body2D<T> copy was handed out for editing
+     * 
+     */
+    void syncArrays();
+    /**
+     * @brief fit ids and radii to the body count after the list was edited through bodies()
+     *        new bodies get fresh ids and radius 0
+     * 
+     */
+    void syncPerBody() const;
+    /**
+     * @brief drop the bodies marked COLLISION_DEAD in m_collisionDead, keeping the order of the rest
+     *        forces of the remaining bodies move along, the cached potential is dropped
+     * 
+     */
+    void compactBodies();
+
+    mutable std::vector<Body2D<T>> m_bodies; // list of all simulated bodies, a refreshed copy in SoA mode
+    BodyArrays2D<T> m_soa; // bodies as arrays, used in SoA mode
+    BodyArrays2D<T> m_scratch; // gather buffer for tree engines and the SIMD kernel in AoS mode
+    StorageMode m_storage; // memory layout in use
+    mutable bool m_mirrorStale; // SoA mode: m_bodies is older than m_soa
+    bool m_arraysStale; // SoA mode: m_bodies may have been edited, m_soa is older
+    T m_G; // gravitation constant
+    T m_eps2; // softening parameter
+    ForceEngine m_engine; // engine used by computeForces()
+    T m_theta; // Barnes-Hut opening angle
+    SimdLevel m_simd; // instruction set of the direct-sum kernel, already clamped
+    bool m_fastRsqrt; // SIMD kernel uses rsqrt estimate + Newton refinement
+    bool m_floatPairs; // direct sum evaluates pair terms in float, see setFloatPairs()
+    std::vector<float> m_pairX; // float x offsets from the local origin of the last mixed pass
+    std::vector<float> m_pairY; // float y offsets from the local origin of the last mixed pass
+    std::vector<float> m_pairM; // float masses of the last mixed pass
+    std::vector<double> m_pairAx; // double row sums of the last mixed pass, without G
+    std::vector<double> m_pairAy; // double row sums of the last mixed pass, without G
+    std::vector<double> m_pairPhi; // double potential row sums of the last mixed pass, without G
+    BarnesHutTree2D<T> m_tree; // quadtree reused between force evaluations
+    FmmSolver2D<T> m_fmm; // multipole solver reused between force evaluations
+    PmSolver2D<T> m_pm; // particle-mesh solver, keeps its kernel transforms between force evaluations
+    std::unique_ptr<ThreadPool> m_pool; // worker threads, null when running on one thread
+    std::vector<std::vector<Vec2<T>>> m_bandForces; // per-band force accumulators of the threaded AoS direct sum
+    std::vector<std::size_t> m_bandRows; // first row of each band, plus n
+    bool m_forcesValid; // forces/accelerations belong to the current positions and parameters
+    bool m_trackPotential; // force passes also sum the potential energy
+    bool m_potentialValid; // m_potential was summed by the last force pass
+    T m_potential; // potential energy of the last force pass
+    std::vector<T> m_rowPotential; // per-body potential -G * sum_j m_j / r_ij of the array direct sum
+    std::vector<EnergySum<T>> m_bandPotential; // per-band potential of the threaded AoS direct sum
+    unsigned long long m_forceEvaluations; // computeForces() calls so far
+    unsigned long long m_pairInteractions; // direct-sum equivalent pair interactions so far
+    int m_blockLevels; // number of stepBlock() time bins
+    T m_blockEta; // stepBlock() accuracy parameter
+    std::vector<int> m_blockBin; // time bin of each body, empty until the first block step
+    std::vector<std::size_t> m_blockActive; // bodies whose step ends in the current substep
+    std::vector<T> m_jerkX; // x jerk of every body from the last Hermite force pass
+    std::vector<T> m_jerkY; // y jerk of every body from the last Hermite force pass
+    std::vector<T> m_jerkStartX; // x jerk at the start of the current Hermite step
+    std::vector<T> m_jerkStartY; // y jerk at the start of the current Hermite step
+    BodyArrays2D<T> m_hermiteStart; // positions, velocities and accelerations at the start of the current Hermite step
+    unsigned long long m_hermiteEvaluation; // m_forceEvaluations right after the last Hermite pass
+    mutable std::vector<std::size_t> m_ids; // stable id of every body, ascending
+    mutable std::size_t m_idCount; // ids handed out so far
+    mutable std::vector<T> m_radius; // collision radius of every body, empty if none were set
+    SpatialHashGrid2D<T> m_grid; // collision grid reused between calls
+    std::vector<std::pair<std::size_t, std::size_t>> m_collisionPairs; // overlapping pairs of the last resolveCollisions()
+    std::vector<std::size_t> m_collisionRoot; // union-find parent of every body
+    std::vector<std::size_t> m_collisionMembers; // bodies of the merged groups, grouped by root
+    std::vector<unsigned char> m_collisionDead; // COLLISION_ALIVE, COLLISION_DEAD or COLLISION_SURVIVOR per body
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+// phaseprofiler class, scoped wall-clock timers for the phases of a run
+
+#ifndef PHASE_PROFILER_H
+#define PHASE_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief phases of a run that get their own timer
+ *      Forces = computeForces()
+ *      Integrate = kick and drift updates of the integrators
+ *      Energy = totalEnergy()
+ *      Logging = snapshot copies, formatting and file writes of the trajectory loggers
+ *      Events = SFML event polling
+ *      Render = drawing and presenting a frame, includes the frame limit wait
+ *      Checkpoint = state copies and file writes of checkpoints
+ *      Collisions = spatial hash grid, overlap search and merging
+ *      Analysis = in-situ reductions of InSituAnalysis2D, energy included
+ */
+enum class Phase{
+    Forces,
+    Integrate,
+    Energy,
+    Logging,
+    Events,
+    Render,
+    Checkpoint,
+    Collisions,
+    Analysis,
+    Count
+};
+
+/**
+ * @brief end-of-run counters that are not times
+ *
+ */
+struct RunCounters{
+    long long steps; // integration steps taken
+    double interactions; // pair interactions, N(N-1)/2 per force evaluation
+    unsigned long long bytesWritten; // trajectory file size
+};
+
+/**
+ * @brief process-wide accumulator behind ScopedPhase
+ * Stores:
+ *      per phase, total nanoseconds and call count, split into the thread that called start() and all others
+ *      optionally every timed scope as a trace event, up to MAX_TRACE_EVENTS
+ * Responsible for:
+ *      record(): add one finished scope, lock-free unless trace events are kept
+ *      printReport(): time per phase, share of the wall time, steps/s, interactions/s, bytes written
+ *      writeJson(): the same report as JSON
+ *      writeTrace(): Chrome trace-event file, opens in chrome://tracing or Perfetto
+ *
+ * Build with -D NBODY_NO_PROFILE to compile every ScopedPhase down to nothing.
+ */
+class PhaseProfiler{
+public:
+    /**
+     * @brief construct a disabled profiler with empty totals
+     *
+     */
+    PhaseProfiler();
+
+    PhaseProfiler(const PhaseProfiler &) = delete;
+    PhaseProfiler &operator=(const PhaseProfiler &) = delete;
+
+    /**
+     * @brief clear totals and events, start the wall clock and enable timing
+     *        the calling thread is reported as the main thread
+     *
+     * @param keepTrace true to also record every scope for writeTrace()
+     */
+    void start(bool keepTrace);
+
+    /**
+     * @brief disable timing and stop the wall clock, scopes already running are still added
+     *
+     */
+    void stop();
+
+    /**
+     * @brief true between start() and stop(), ScopedPhase checks this once on entry
+     *
+     * @return true
+     * @return false
+     */
+    bool enabled() const{
+        // acquire pairs with start(), so a thread that sees true also sees the reset totals
+        return m_enabled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief add one finished scope
+     *
+     * @param phase phase the scope belongs to
+     * @param begin scope start
+     * @param end scope end
+     */
+    void record(Phase phase, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+    /**
+     * @brief seconds between start() and stop()
+     *
+     * @return double
+     */
+    double wallSeconds() const;
+
+    /**
+     * @brief print the per-phase table and the run rates
+     *
+     * @param out stream to print to
+     * @param counters steps, interactions and bytes of the run
+     */
+    void printReport(std::ostream &out, const RunCounters &counters) const;
+
+    /**
+     * @brief write the report as a JSON object
+     *
+     * @param path output file
+     * @param counters steps, interactions and bytes of the run
+     * @return true if the file was written
+     * @return false otherwise
+     */
+    bool writeJson(const std::string &path, const RunCounters &counters) const;
+
+    /**
+     * @brief write the recorded scopes as Chrome trace events, one complete ("X") event per scope
+     *
+     * @param path output file
+     * @return true if the file was written
+     * @return false otherwise
+     */
+    bool writeTrace(const std::string &path) const;
+
+    /**
+     * @brief short lowercase name of a phase, used in the report and the trace
+     *
+     * @param phase phase to name
+     * @return const char*
+     */
+    static const char *phaseName(Phase phase);
+
+    static constexpr std::size_t MAX_TRACE_EVENTS = 1U << 20; // trace memory cap, later scopes are counted but not kept
+
+private:
+    static constexpr std::size_t PHASE_COUNT = static_cast<std::size_t>(Phase::Count);
+
+    /**
+     * @brief one recorded scope for the trace
+     *
+     */
+    struct TraceEvent{
+        Phase phase; // phase of the scope
+        std::size_t thread; // small thread number, 0 = main
+        long long beginNs; // start, nanoseconds after start()
+        long long durationNs; // length in nanoseconds
+    };
+
+    /**
+     * @brief small stable number for the calling thread, 0 for the thread that called start()
+     *        caller must hold m_traceMutex
+     *
+     * @param id thread to number
+     * @return std::size_t
+     */
+    std::size_t threadNumber(std::thread::id id);
+
+    std::atomic<bool> m_enabled; // scopes are timed, set last by start()
+    bool m_keepTrace; // record() stores trace events
+    std::thread::id m_mainThread; // thread that called start()
+    std::chrono::steady_clock::time_point m_begin; // start() time
+    std::chrono::steady_clock::time_point m_end; // stop() time
+    std::atomic<long long> m_nanos[PHASE_COUNT][2]; // [phase][0 main, 1 other threads] total time
+    std::atomic<long long> m_calls[PHASE_COUNT][2]; // [phase][0 main, 1 other threads] scope count
+    mutable std::mutex m_traceMutex; // guards m_events, m_threads, m_droppedEvents
+    std::vector<TraceEvent> m_events; // recorded scopes
+    std::vector<std::thread::id> m_threads; // index = thread number in the trace
+    unsigned long long m_droppedEvents; // scopes past MAX_TRACE_EVENTS
+};
+
+/**
+ * @brief the profiler every ScopedPhase reports to
+ *
+ * @return PhaseProfiler&
+ */
+PhaseProfiler &phaseProfiler();
+
+/**
+ * @brief times its own lifetime as one call of a phase
+ *        costs two clock reads when profiling is on, one atomic load when off,
+ *        nothing when built with NBODY_NO_PROFILE
+ */
+class ScopedPhase{
+public:
+#ifdef NBODY_NO_PROFILE
+    explicit ScopedPhase(Phase){}
+#else
+    /**
+     * @brief start timing phase if the profiler is enabled
+     *
+     * @param phase phase this scope belongs to
+     */
+    explicit ScopedPhase(Phase phase) : m_phase(phase), m_active(phaseProfiler().enabled()), m_begin(m_active ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()){}
+
+    /**
+     * @brief add the elapsed time to the profiler
+     *
+     */
+    ~ScopedPhase(){
+        if(m_active){
+            phaseProfiler().record(m_phase, m_begin, std::chrono::steady_clock::now());
+        }
+    }
+#endif
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+#ifndef NBODY_NO_PROFILE
+private:
+    Phase m_phase; // phase being timed
+    bool m_active; // profiler was enabled on entry
+    std::chrono::steady_clock::time_point m_begin; // entry time
+#endif
+};
+
+#endif
@@ -0,0 +1,255 @@
+// pmsolver2d class, particle-mesh gravity through FFT convolution on a square grid
+
+#ifndef PM2D_H
+#define PM2D_H
+
+#include "body_arrays2d.hpp"
+#include "real_type.hpp"
+#include "thread_pool.h"
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief how PmSolver2D spreads a body's mass over the grid, the same weights interpolate the field back
+ *      Cic = cloud in cell, the 2x2 nearest cells, linear weights
+ *      Tsc = triangular shaped cloud, the 3x3 nearest cells, quadratic weights, smoother and more accurate
+ */
+enum class PmAssignment{
+    Cic,
+    Tsc
+};
+
+/**
+ * @brief what lies beyond the grid
+ *      Isolated = nothing, the grid follows the bodies and is zero padded to twice its size so the
+ *          periodic FFT convolution never wraps around
+ *      Periodic = a square box of fixed size centred on the origin repeats forever,
+ *          every body feels the nearest image of every other mass
+ */
+enum class PmBoundary{
+    Isolated,
+    Periodic
+};
+
+/**
+ * @brief particle-mesh solver for the softened 1/r kernel on a 2D plane
+ * Stores:
+ *      grid size, assignment scheme, boundary and periodic box size
+ *      transforms of the force and potential kernels for the current cell size and smoothing
+ *      the acceleration field and, on request, the potential field of the last evaluation
+ *      radix-2 FFT tables and per-thread mass grids
+ * Responsible for:
+ *      evaluate(): assign masses to the grid, FFT, multiply by the kernel transform, inverse FFT
+ *      accumulateAccelerations(): interpolate the acceleration field back to the bodies
+ *      potentialEnergy(): interpolate the potential field, minus every body's own contribution
+ *
+ * The kernel is the one the other engines sum, the 3D Newtonian potential restricted to the plane,
+ * so the mesh does not solve the 2D Poisson equation with its log potential: the grid holds masses,
+ * and the potential and acceleration are the convolution of the masses with the sampled kernel
+ *      psi(d) = 1 / sqrt(|d|^2 + s^2), a(d) = -d / (|d|^2 + s^2)^(3/2)
+ * done as a product of transforms. Assigning and interpolating with the same window smooths twice,
+ * so the kernel transforms are divided by the window transform squared, which mostly undoes it.
+ * The acceleration kernel stays odd and the same weights assign and interpolate, so a body exerts
+ * no force on itself and pair forces are equal and opposite.
+ * The smoothing length s is sqrt(eps2), but never below SMOOTHING_CELLS cells, the mesh cannot
+ * resolve anything smaller. The isolated grid spans the bodies' bounding box; its cell size moves
+ * in steps of 2^(1/8), so the kernel transforms are reused until the system grows or shrinks a step.
+ * Complexity = O(n) to assign and interpolate + O(M^2 log M) for the FFTs, M = 2 * grid isolated, grid periodic.
+ */
+template<typename T>
+class PmSolver2D{
+public:
+    /**
+     * @brief construct a solver with a 256 x 256 cloud in cell grid and isolated boundaries
+     *
+     */
+    PmSolver2D();
+
+    /**
+     * @brief set cells per side, rounded up to a power of two and clamped to [MIN_GRID, MAX_GRID]
+     *        structure below the cell size is smoothed away, the error drops fast once sqrt(eps2) spans a few cells
+     *
+     * @param cells cells per side
+     */
+    void setGridSize(std::size_t cells);
+
+    /**
+     * @brief Get cells per side
+     *
+     * @return std::size_t
+     */
+    std::size_t getGridSize() const;
+
+    /**
+     * @brief set mass assignment scheme
+     *
+     * @param assignment Cic or Tsc
+     */
+    void setAssignment(PmAssignment assignment);
+
+    /**
+     * @brief Get mass assignment scheme
+     *
+     * @return PmAssignment
+     */
+    PmAssignment getAssignment() const;
+
+    /**
+     * @brief set boundary condition
+     *
+     * @param boundary Isolated or Periodic
+     * @param boxSize side of the periodic box centred on the origin, ignored for Isolated
+     */
+    void setBoundary(PmBoundary boundary, T boxSize);
+
+    /**
+     * @brief Get boundary condition
+     *
+     * @return PmBoundary
+     */
+    PmBoundary getBoundary() const;
+
+    /**
+     * @brief Get side of the periodic box
+     *
+     * @return T
+     */
+    T getBoxSize() const;
+
+    /**
+     * @brief assign masses, convolve with the kernels and keep the fields until the next evaluate()
+     *
+     * @param bodies bodies acting as sources, non-finite positions are left out
+     * @param eps2 softening value added to r^2
+     * @param withPotential also compute the potential field for potentialEnergy()
+     * @param pool worker threads for assignment and FFTs, null = calling thread only
+     */
+    void evaluate(const BodyArrays2D<T> &bodies, T eps2, bool withPotential, ThreadPool *pool);
+
+    /**
+     * @brief add acceleration from the last evaluate() to the accumulators of bodies [begin, end)
+     *        ranges do not share writes, so they can run on different threads
+     *
+     * @param bodies same bodies that were evaluated
+     * @param G gravitational constant
+     * @param begin first body
+     * @param end one past the last body
+     */
+    void accumulateAccelerations(BodyArrays2D<T> &bodies, T G, std::size_t begin, std::size_t end) const;
+
+    /**
+     * @brief potential energy from the last evaluate(), which must have been asked for the potential
+     *        U = -0.5 * G * sum(m_i * psi(r_i)), each body's own mass removed from its psi
+     *
+     * @param bodies same bodies that were evaluated
+     * @param G gravitational constant
+     * @return T potential energy
+     */
+    T potentialEnergy(const BodyArrays2D<T> &bodies, T G) const;
+
+    /**
+     * @brief returns cell size of the last evaluate()
+     *
+     * @return T cell side length
+     */
+    T cellSize() const;
+
+    /**
+     * @brief returns smoothing length s of the last evaluate()
+     *
+     * @return T max(sqrt(eps2), SMOOTHING_CELLS * cell size)
+     */
+    T smoothingLength() const;
+
+    static constexpr std::size_t MIN_GRID = 16; // fewest cells per side
+    static constexpr std::size_t MAX_GRID = 8192; // most cells per side
+    static constexpr double SMOOTHING_CELLS = 1.0; // smallest smoothing length, in cells
+    static constexpr std::size_t COLUMN_BLOCK = 8; // columns gathered together by the column FFT pass
+
+private:
+    /**
+     * @brief cells and weights a position is spread over, the same for assignment and interpolation
+     *
+     * @param x x position
+     * @param y y position
+     * @param cellX set to the grid columns, periodic indices already wrapped
+     * @param cellY set to the grid rows
+     * @param weightX set to the weight of each column
+     * @param weightY set to the weight of each row
+     * @return std::size_t cells per axis, 2 for Cic, 3 for Tsc, 0 for a non-finite position
+     */
+    std::size_t stencil(T x, T y, std::size_t *cellX, std::size_t *cellY, T *weightX, T *weightY) const;
+
+    /**
+     * @brief place the grid for this evaluation: cell size, origin and smoothing length
+     *        rebuilds the kernel transforms if the cell size or smoothing changed
+     *
+     * @param bodies bodies to cover
+     * @param eps2 softening value
+     * @param withPotential potential kernel is needed too
+     * @param pool worker threads
+     */
+    void placeGrid(const BodyArrays2D<T> &bodies, T eps2, bool withPotential, ThreadPool *pool);
+
+    /**
+     * @brief sample a kernel at every grid offset, transform it and divide out the assignment window
+     *        offsets past half the transform size wrap to negative, the offset of exactly half is
+     *        ambiguous and gets 0 in the odd acceleration kernels
+     *        the potential kernel also refreshes m_nearPotential
+     *
+     * @param potential true for psi, false for the acceleration pair ax + i ay
+     * @param out transformed kernel, M x M
+     * @param pool worker threads
+     */
+    void buildKernel(bool potential, std::vector<std::complex<T>> &out, ThreadPool *pool);
+
+    /**
+     * @brief in-place 2D FFT of an M x M row-major array
+     *        forward transforms rows [0, rows) then every column, inverse every column then rows [0, rows),
+     *        rows past that are zero going in (forward) or not needed coming out (inverse)
+     *        the inverse is not scaled by 1 / M^2
+     *
+     * @param data array to transform
+     * @param rows rows that matter
+     * @param inverse true for the inverse transform
+     * @param pool worker threads
+     */
+    void transform2D(std::vector<std::complex<T>> &data, std::size_t rows, bool inverse, ThreadPool *pool) const;
+
+    /**
+     * @brief in-place radix-2 FFT of M contiguous values
+     *
+     * @param data first value
+     * @param inverse true for the inverse transform, not scaled
+     */
+    void transform1D(std::complex<T> *data, bool inverse) const;
+
+    std::size_t m_grid; // cells per side holding mass
+    std::size_t m_size; // FFT size M, 2 * m_grid isolated, m_grid periodic
+    PmAssignment m_assignment; // mass assignment scheme
+    PmBoundary m_boundary; // boundary condition
+    T m_boxSize; // side of the periodic box
+
+    T m_cell; // cell size of the current evaluation
+    T m_originX; // x of the centre of cell 0
+    T m_originY; // y of the centre of cell 0
+    T m_smoothing; // smoothing length s of the current evaluation
+    T m_kernelCell; // cell size the kernel transforms were built for, 0 = none
+    T m_kernelSmoothing; // smoothing length the kernel transforms were built for
+    bool m_potentialKernelValid; // m_potentialKernel matches the cell size and smoothing
+    bool m_hasPotential; // last evaluate() computed m_potentialField
+    T m_nearPotential[25]; // applied psi kernel at cell offsets -2..2 in each axis, for the self terms
+
+    std::vector<std::complex<T>> m_twiddle; // exp(-2 pi i k / M) for k < M / 2
+    std::vector<std::size_t> m_bitReverse; // bit-reversed index of every k < M
+    std::vector<std::complex<T>> m_forceKernel; // transform of ax + i ay kernel
+    std::vector<std::complex<T>> m_potentialKernel; // transform of psi kernel
+    std::vector<std::complex<T>> m_density; // masses on the zero padded grid, then their transform
+    std::vector<std::complex<T>> m_forceField; // ax + i ay on the grid, times M^2
+    std::vector<std::complex<T>> m_potentialField; // psi on the grid, times M^2
+    std::vector<T> m_massGrids; // one m_grid x m_grid mass grid per assignment band
+};
+
+#endif
@@ -3,11 +3,22 @@
 #ifndef REAL_TYPE_HPP
 #define REAL_TYPE_HPP
 
+#include <type_traits>
+
 /**
- * @brief defines type used for all simulation real numbers
- *        primarily precision purposes, can be changed to:
- *          float, double, long double, etc depending on how precise the user wants.
+ * @brief defines type used for config values and parsing
+ *        simulation classes are templates on their scalar type,
+ *        main picks float, double or long double at startup from the precision config key
+ *        Real is the widest of those so config values lose nothing before conversion
  */
 using Real = double long;
 
+/**
+ * @brief accumulator of energy sums in a simulation of scalar type T
+ *        at least double, so a float run adding up O(n^2) pair terms keeps its digits,
+ *        long double when T is
+ */
+template<typename T>
+using EnergySum = typename std::conditional<std::is_same<T, long double>::value, long double, double>::type;
+
 #endif
\ No newline at end of file
@@ -7,13 +7,28 @@
 #include <string>
 #include <vector>
 
-#include "real_type.hpp"
+#include "compressed_trajectory.h"
+#include "trajectory_file.h"
 
+template<typename T>
 class NBodySystem2D;
 
+/**
+ * @brief trajectory file format written by RunLogger
+ *      Csv = text, one row per logged state
+ *      Binary = TrajectoryHeader + fixed-stride frames, see trajectory_file.h
+ *      Compressed = quantized delta frames in entropy-coded blocks, see compressed_trajectory.h
+ */
+enum class LogFormat{
+    Csv,
+    Binary,
+    Compressed
+};
+
 /**
  * @brief declares and defines RunLogger, helper class for CSV output
  *        writes time evolution of NBodySystem2D to a CSV file
+ *        works with any scalar type the system was instantiated with
  *        writes header row, then appends one row each time logState() is created
  * 
  * Columns:
@@ -23,6 +38,13 @@ class NBodySystem2D;
  *  ...
  *  x3,y3,vx3,vy3
  * [E_total] (optional)
+ *
+ * In Binary format the same values are written as raw float/double frames,
+ * in Compressed format as blocks of frames within a set error bound,
+ * tools/traj2csv turns either back into this csv layout.
+ *
+ * Columns belong to body ids, not positions in the body list: body k of the header is the body
+ * with id k - 1 for the whole file, and a body merged away by a collision writes nan from then on.
  */
 class RunLogger{
 public:
@@ -32,21 +54,49 @@ public:
      */
     RunLogger();
     /**
-     * @brief open csv file for writing
+     * @brief set the error bounds and block length of Compressed output, read by writeHeader()
+     *        a file continued by openAppend() keeps the settings in its header
+     * 
+     * @param positionError largest position error, > 0
+     * @param velocityError largest velocity error, > 0
+     * @param keyframeEvery most frames per block, every block starts with a keyframe
+     */
+    void setCompression(double positionError, double velocityError, unsigned int keyframeEvery);
+    /**
+     * @brief open output file for writing
      * 
      * @param path file path to open
+     * @param format Csv, Binary or Compressed
      * @return true if file stream is valid and available for writing
      * @return false otherwise
      */
-    bool open(const std::string &path);
+    bool open(const std::string &path, LogFormat format = LogFormat::Csv);
+    /**
+     * @brief reopen an existing trajectory to continue it, e.g. after resuming from a checkpoint
+     *        keeps the header and the first framesKept rows or frames, cuts anything after them
+     *        and appends from there, writeHeader() then does nothing
+     *        a missing file is opened like open(), so the caller writes the header as usual
+     * 
+     * @param path file path to open
+     * @param format Csv, Binary or Compressed, must match the existing file
+     * @param framesKept rows or frames to keep
+     * @param framesFound set to the rows or frames kept, less than framesKept if the file was shorter
+     * @return true if file stream is valid and available for writing
+     * @return false otherwise, also for a binary or compressed file that is not a trajectory
+     */
+    bool openAppend(const std::string &path, LogFormat format, unsigned long long framesKept, unsigned long long &framesFound);
     /**
-     * @brief write csv header row
+     * @brief write csv header row, or the binary file header
      *        writes once per file
+     *        in Binary and Compressed format the body count and energy flag are fixed from here on
      * 
      * @param system the NBodySystem2D with bodies to define columns
      * @param includeEnergy if true, append E_total column at the end
+     * @param outputEvery steps between logged states, stored in the binary header
+     * @param dt time step, stored in the binary header
      */
-    void writeHeader(const NBodySystem2D &system, bool includeEnergy);
+    template<typename T>
+    void writeHeader(const NBodySystem2D<T> &system, bool includeEnergy, long long outputEvery = 1, double dt = 0.0);
     /**
      * @brief append a single simulation state row to csv file
      *        Writes:
@@ -56,19 +106,81 @@ public:
      *          ...
      *          x3,y3,vx3,vy3,
      *          [E_total]
+     *        Binary format writes one frame of the same values with a single write call,
+     *        Compressed format adds it to the open block and writes the block once it is full
      * @param t current simulation time
      * @param system current N-body system state
-     * @param includeEnergy if true, append totalEnergy() to last column
+     * @param includeEnergy if true, append totalEnergy() to last column, Binary and Compressed format use the header's choice
+     */
+    template<typename T>
+    void logState(T t, const NBodySystem2D<T> &system, bool includeEnergy);
+    /**
+     * @brief append a state row with an energy the caller already has, e.g. from a snapshot
+     *        same row as logState() with includeEnergy, totalEnergy() is not called
+     * @param t current simulation time
+     * @param system current N-body system state
+     * @param energy total energy written to the last column
+     */
+    template<typename T>
+    void logStateWithEnergy(T t, const NBodySystem2D<T> &system, T energy);
+    /**
+     * @brief hand everything written so far to the operating system
+     *        Compressed format first writes the open block, short, so every frame logged is on file
+     * 
      */
-    void logState(Real t, const NBodySystem2D &system, bool includeEnergy);
+    void flush();
     /**
      * @brief close output file and reset state
      * 
      */
     void close();
+    /**
+     * @brief size of the file written before the last close()
+     * 
+     * @return unsigned long long bytes, 0 before the first close()
+     */
+    unsigned long long bytesWritten() const;
 private:
+    /**
+     * @brief write one csv row or binary frame
+     * 
+     * @param t current simulation time
+     * @param system current N-body system state
+     * @param includeEnergy if true, append energy to last column
+     * @param energy total energy, only read with includeEnergy
+     */
+    template<typename T>
+    void writeState(T t, const NBodySystem2D<T> &system, bool includeEnergy, T energy);
+    /**
+     * @brief pack t, positions, velocities and energy into m_frame as values of type V
+     * 
+     * @param t current simulation time
+     * @param system current N-body system state
+     * @param energy total energy, only written with withEnergy
+     * @param slots body ids in the header
+     * @param withEnergy the header has the Energy field
+     */
+    template<typename V, typename T>
+    void packFrame(T t, const NBodySystem2D<T> &system, T energy, std::size_t slots, bool withEnergy);
+    /**
+     * @brief Compressed format: entropy code the open block and write it
+     * 
+     */
+    void writeBlock();
+
     std::ofstream m_trajOfs; // output file stream
     bool m_wroteHeader; // tracks whether header row has been written
+    LogFormat m_format; // csv or binary output
+    TrajectoryHeader m_binaryHeader; // Binary format: header written at the start of the file
+    std::vector<unsigned char> m_frame; // Binary and Compressed format: reused frame buffer
+    CompressedTrajectoryHeader m_compressedHeader; // Compressed format: header written at the start of the file
+    TrajectoryCompressor m_compressor; // Compressed format: block being filled
+    std::vector<unsigned char> m_block; // Compressed format: reused buffer of a coded block
+    std::vector<double> m_values; // Compressed format: m_frame as doubles
+    double m_positionError; // Compressed format: position error bound for new files
+    double m_velocityError; // Compressed format: velocity error bound for new files
+    unsigned int m_keyframeEvery; // Compressed format: frames per block for new files
+    unsigned long long m_bytesWritten; // file size at the last close()
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+// simd direct-sum kernels, avx2/avx-512 with runtime cpu dispatch
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief instruction set used by the hand-vectorized direct-sum kernel
+ *      Scalar = plain C++ loop, no explicit SIMD
+ *      Avx2 = 256-bit, 4 doubles or 8 floats per instruction
+ *      Avx512 = 512-bit, 8 doubles or 16 floats per instruction
+ */
+enum class SimdLevel{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+/**
+ * @brief best SIMD level the running CPU supports
+ *        checked once through cpuid, x86 with GCC/Clang only, Scalar elsewhere
+ *
+ * @return SimdLevel
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * @brief clamp a requested level to what the CPU supports
+ *
+ * @param requested wanted level
+ * @return SimdLevel the lower of requested and detectSimdLevel()
+ */
+SimdLevel resolveSimdLevel(SimdLevel requested);
+
+/**
+ * @brief parse a config value, auto|off|avx2|avx512
+ *        auto means the best level of the running CPU
+ *
+ * @param value config string
+ * @param out parsed level
+ * @return true if value was recognized
+ * @return false otherwise
+ */
+bool parseSimdLevel(const std::string &value, SimdLevel &out);
+
+/**
+ * @brief printable name of a level
+ *
+ * @param level SIMD level
+ * @return const char* scalar, avx2 or avx512
+ */
+const char *simdLevelName(SimdLevel level);
+
+/**
+ * @brief add exact-sum gravitational accelerations for rows [iBegin, iEnd)
+ *        every row i reads all j, only ax[i], ay[i] and phi[i] are written,
+ *        so disjoint row ranges can run on different threads
+ *        pairs at zero separation (the i = j term, or coincident bodies with eps2 = 0) add nothing
+ *        with phi, the same pass subtracts G * sum_j m_j / r_ij into phi[i], reusing 1 / r
+ *
+ * fastRsqrt replaces 1 / sqrt(r^2) with the hardware reciprocal square root estimate
+ * refined by Newton steps y = y * (1.5 - 0.5 * r^2 * y^2), one for float and two for double,
+ * which is close to full precision. It converts r^2 through float, so separations must fit in float range.
+ *
+ * @param x, y positions
+ * @param m masses
+ * @param ax, ay accelerations, added to
+ * @param phi per-body potential -G * sum_j m_j / r_ij, added to, nullptr skips it
+ * @param n number of bodies
+ * @param iBegin first row
+ * @param iEnd one past last row
+ * @param G gravitational constant
+ * @param eps2 softening value added to r^2
+ * @param level resolved SIMD level to use
+ * @param fastRsqrt use reciprocal square root estimate + Newton refinement
+ * @return true if a SIMD kernel ran
+ * @return false if level is Scalar, nothing was written and the caller must use its own loop
+ */
+bool simdDirectAccelerations(const float *x, const float *y, const float *m, float *ax, float *ay, float *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float G, float eps2, SimdLevel level, bool fastRsqrt);
+bool simdDirectAccelerations(const double *x, const double *y, const double *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, double G, double eps2, SimdLevel level, bool fastRsqrt);
+/**
+ * @brief long double has no SIMD form, always returns false
+ */
+bool simdDirectAccelerations(const long double *x, const long double *y, const long double *m, long double *ax, long double *ay, long double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, long double G, long double eps2, SimdLevel level, bool fastRsqrt);
+
+constexpr std::size_t MIXED_FLUSH_PAIRS = 256; // pairs a float lane sum covers before it is added into the double row sum
+
+/**
+ * @brief mixed-precision rows [iBegin, iEnd): float pair terms, double sums
+ *        writes sum_j m_j * (r_j - r_i) / r_ij^3 into ax[i], ay[i], without G,
+ *        and with phi, sum_j m_j / r_ij into phi[i]
+ *        the float lanes are widened into double every MIXED_FLUSH_PAIRS pairs, so the float
+ *        rounding of a row sum does not grow with n
+ *
+ * Positions are meant to be offsets from a local origin near the bodies, see NBodySystem2D::setFloatPairs(),
+ * so float keeps its 24 bits for the separations. Zero separations add nothing, as in simdDirectAccelerations().
+ *
+ * @param x, y positions relative to the local origin
+ * @param m masses
+ * @param ax, ay acceleration sums without G, overwritten
+ * @param phi potential sums without G and sign, overwritten, nullptr skips it
+ * @param n number of bodies
+ * @param iBegin first row
+ * @param iEnd one past last row
+ * @param eps2 softening value added to r^2
+ * @param level Avx2 or Avx512, already resolved against the CPU
+ * @param fastRsqrt use the reciprocal square root estimate
+ * @return true if a SIMD kernel ran
+ * @return false if level is Scalar, nothing was written and the caller must use its own loop
+ */
+bool simdMixedAccelerations(const float *x, const float *y, const float *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float eps2, SimdLevel level, bool fastRsqrt);
+
+#endif
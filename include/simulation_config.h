@@ -19,7 +19,7 @@
  * validating that loaded settings are usable
  * 
  * config.txt example:
- *      precision = long long
+ *      precision = double
  *      method = verlet
  *      dt = 0.01
  *      steps = 100000
@@ -28,13 +28,53 @@
  *      eps2 = 0.0001
  *      bodiesFile = bodies.csv
  *      outTrajFile = trajectories.csv
+ *      outFormat = csv
+ *      compressPosError = 1e-6
+ *      compressVelError = 1e-6
+ *      keyframeEvery = 64
+ *      asyncLog = true
+ *      logBuffer = 8
  *      includeEnergy = true
+ *      analysis = energy,com,angmom,radial,escapers
+ *      analysisFile = analysis.csv
+ *      dumpEvery = 10000
+ *      radialBins = 16
+ *      radialMax = 0
+ *      escapeRadius = 0
+ *      forceEngine = barneshut
+ *      theta = 0.5
+ *      fmmOrder = 4
+ *      pmGrid = 512
+ *      pmAssign = tsc
+ *      pmBoundary = isolated
+ *      pmBoxSize = 100
+ *      blockLevels = 8
+ *      blockEta = 0.025
+ *      storage = soa
+ *      accuracySamples = 256
+ *      simd = auto
+ *      fastRsqrt = false
+ *      forcePrecision = native
+ *      threads = 8
+ *      headless = false
+ *      heatmapAbove = 200000
+ *      heatmapMass = true
+ *      profile = true
+ *      profileJson = profile.json
+ *      profileTrace = trace.json
+ *      checkpointEvery = 10000
+ *      checkpointFile = checkpoint.bin
+ *      resumeFrom = checkpoint.bin
+ *      collisions = merge
+ *      collisionRadius = 0.001
+ *      radiiFile = radii.txt
+ *      collisionLog = collisions.csv
  * 
  * Lines starting with '#' or blank lines are ignored
  */
 class SimulationConfig{
 public:
-    std::string precision; // precision
+    std::string precision; // scalar type of the simulation, float, double or long double
     std::string method; // method name
 
     Real dt; // time step size for each integration step
@@ -46,8 +86,49 @@ public:
 
     std::string bodiesFile; // path to csv file with initial body conditions
     std::string outTrajFile; // path to csv file to store trajectory output
+    std::string outFormat; // trajectory file format, csv, binary or compressed
+    Real compressPosError; // compressed output: largest position error
+    Real compressVelError; // compressed output: largest velocity error
+    int keyframeEvery; // compressed output: frames per block, each block starts with a keyframe
+    bool asyncLog; // format, compute energy and write on a background thread
+    int logBuffer; // snapshots that can wait for the background writer
 
     bool includeEnergy; // whether or not to include total energy in csv output
+    std::string analysis; // in-situ probes, comma separated, a row every outputEvery steps, empty = none
+    std::string analysisFile; // csv of the in-situ time series
+    long long dumpEvery; // steps between full trajectory frames, 0 = every outputEvery
+    int radialBins; // radial probe: annuli of the surface density profile
+    Real radialMax; // radial probe: outer radius, 0 = fixed by the first row
+    Real escapeRadius; // escapers probe: smallest distance from the centre of mass counted
+
+    std::string forceEngine; // force engine name, direct, barneshut or fmm
+    Real theta; // Barnes-Hut opening angle, FMM separation parameter
+    int fmmOrder; // FMM expansion order
+    int pmGrid; // particle mesh: cells per side, a power of two
+    std::string pmAssign; // particle mesh: mass assignment, cic or tsc
+    std::string pmBoundary; // particle mesh: isolated or periodic
+    Real pmBoxSize; // particle mesh: side of the periodic box centred on the origin
+    int blockLevels; // block timesteps: number of power-of-two time bins
+    Real blockEta; // block timesteps: accuracy parameter of the acceleration criterion
+    int accuracySamples; // bodies checked against the direct sum at startup, 0 disables
+    std::string storage; // body memory layout, aos or soa
+    std::string simd; // direct-sum instruction set, auto, avx2, avx512 or off
+    bool fastRsqrt; // SIMD kernel uses rsqrt estimate + Newton refinement
+    std::string forcePrecision; // direct-sum pair terms, native = the run's precision, float = float terms with double sums
+    int threads; // worker threads for force, energy and update loops, 0 = all hardware threads
+    bool headless; // run without a window, only trajectory output
+    long long heatmapAbove; // window: draw a density heatmap instead of one sprite per body above this many bodies
+    bool heatmapMass; // window: heatmap pixels sum masses instead of counting bodies
+    bool profile; // time the run phases and print a report at exit
+    std::string profileJson; // optional path for the report as JSON, empty = none
+    std::string profileTrace; // optional path for a Chrome trace-event file, empty = none
+    long long checkpointEvery; // steps between checkpoints, 0 = none
+    std::string checkpointFile; // checkpoint path, every checkpoint replaces it
+    std::string resumeFrom; // checkpoint to continue from instead of bodiesFile, empty = fresh start
+    std::string collisions; // overlapping bodies, off, detect or merge
+    Real collisionRadius; // radius of every body not given one by radiiFile
+    std::string radiiFile; // optional file with one radius per body, in bodies file order
+    std::string collisionLog; // optional csv of collision events, empty = none
 
     /**
      * @brief Construct a config with defaults
@@ -63,9 +144,25 @@ public:
      * @return false otherwise
      */
     bool loadFromFile(const std::string &path);
+    /**
+     * @brief set one configuration value from its key=value text
+     *        shared by loadFromFile() and tools that override keys, e.g. tools/ensemble
+     *
+     * @param key config key
+     * @param value value text, numbers throw std::invalid_argument or std::out_of_range if malformed
+     * @return true if the key is known
+     * @return false if it was ignored
+     */
+    bool setValue(const std::string &key, const std::string &value);
     /**
      * @brief validate configuration values are usable
      *        checks for positive dt, steps, and outputEvery
+     *        checks for known precision, method, force engine, storage, simd and outFormat, non-negative theta and threads, valid fmmOrder and blockLevels, positive logBuffer and blockEta,
+     *        positive compressPosError, compressVelError and keyframeEvery,
+     *        hermite only with the direct engine, float pair terms only for double or long double direct sums, non-negative checkpointEvery,
+     *        known collisions mode with a non-negative collisionRadius or a radiiFile,
+     *        power of two pmGrid, known pmAssign and pmBoundary, positive pmBoxSize for a periodic mesh, non-negative heatmapAbove,
+     *        known analysis probes with an analysisFile, non-negative dumpEvery, radialMax and escapeRadius, positive radialBins
      * @param err stream to print error messages into
      * @return true if all checks pass
      * @return false otherwise
@@ -0,0 +1,88 @@
+// spatialhashgrid2d class, uniform hash grid for O(n) collision candidates
+
+#ifndef SPATIAL_HASH2D_H
+#define SPATIAL_HASH2D_H
+
+#include "body_arrays2d.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief uniform grid of square cells over a set of bodies, hashed into a table of about n buckets
+ * Stores:
+ *      integer cell coordinates of every body
+ *      body indices sorted by bucket with a counting sort, plus the first index of every bucket
+ *      bodies too large for the cell size, checked against everyone directly
+ * Responsible for:
+ *      findOverlaps(): rebuild the grid from the current positions and radii, O(n),
+ *          then list every pair of bodies closer than the sum of their radii
+ *          cells are twice the largest radius of the ordinary bodies, so an overlapping pair
+ *          always sits in the same or in neighbouring cells and each body only looks at 9 cells
+ *
+ * Only cells that hold bodies take room, the hash table has a power of two buckets, at least n.
+ * A few very large bodies, e.g. a central star among small planetesimals, would make every cell
+ * huge; bodies with a radius above LARGE_RADIUS_FACTOR times the mean positive radius are left
+ * out of the grid and compared with every body instead, O(n) each.
+ */
+template<typename T>
+class SpatialHashGrid2D{
+public:
+    /**
+     * @brief construct an empty grid
+     *
+     */
+    SpatialHashGrid2D();
+
+    /**
+     * @brief rebuild the grid and collect every overlapping pair
+     *        storage from previous calls is reused
+     *        bodies with a non-finite position or radius never overlap
+     *
+     * @param bodies current positions, only x and y are read
+     * @param radii radius of every body, same order, 0 = point
+     * @param pairs overwritten with (i, j), i < j, |r_i - r_j| < radius_i + radius_j, sorted
+     */
+    void findOverlaps(const BodyArrays2D<T> &bodies, const std::vector<T> &radii, std::vector<std::pair<std::size_t, std::size_t>> &pairs);
+
+    /**
+     * @brief returns number of hash buckets of the last build
+     *
+     * @return std::size_t bucket count
+     */
+    std::size_t bucketCount() const;
+
+    /**
+     * @brief returns number of bodies compared directly in the last build
+     *
+     * @return std::size_t large body count
+     */
+    std::size_t largeCount() const;
+
+    static constexpr double LARGE_RADIUS_FACTOR = 8.0; // a radius above this many times the mean is checked directly
+
+private:
+    /**
+     * @brief bucket of a cell
+     *
+     * @param cx cell x coordinate
+     * @param cy cell y coordinate
+     * @return std::size_t bucket index
+     */
+    std::size_t bucketOf(long long cx, long long cy) const;
+
+    static constexpr unsigned char SKIPPED = 0; // non-finite position or radius, never overlaps
+    static constexpr unsigned char GRID = 1; // sorted into the grid
+    static constexpr unsigned char LARGE = 2; // compared with every body directly
+
+    std::vector<long long> m_cellX; // cell x coordinate of every body
+    std::vector<long long> m_cellY; // cell y coordinate of every body
+    std::vector<unsigned char> m_role; // SKIPPED, GRID or LARGE for every body
+    std::vector<std::size_t> m_bucketStart; // first entry of m_order for every bucket, plus the total
+    std::vector<std::size_t> m_order; // grid body indices grouped by bucket
+    std::vector<std::size_t> m_large; // bodies left out of the grid
+    std::size_t m_mask; // bucket count - 1
+};
+
+#endif
@@ -0,0 +1,103 @@
+// threadpool class, persistent workers for parallel loops
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief fixed set of worker threads that stay alive between parallel loops
+ * Stores:
+ *      threadCount - 1 sleeping workers, the calling thread is the last one
+ *      the task of the current run() and a shared counter handing out task indices
+ * Responsible for:
+ *      run(): call task(k) for every k in [0, taskCount) across all threads, return when all are done
+ *      parallelFor(): split an index range into chunks and run them
+ *
+ * Tasks are handed out dynamically, so uneven tasks still balance.
+ * run() must not be called from inside a task.
+ */
+class ThreadPool{
+public:
+    /**
+     * @brief start threadCount - 1 workers
+     *
+     * @param threadCount total threads including the caller, 0 = hardwareThreads()
+     */
+    explicit ThreadPool(std::size_t threadCount);
+
+    /**
+     * @brief stop and join all workers
+     *
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief returns number of threads working on a run(), including the caller
+     *
+     * @return std::size_t thread count
+     */
+    std::size_t threadCount() const;
+
+    /**
+     * @brief call task(k) once for every k in [0, taskCount), blocks until all calls returned
+     *
+     * @param taskCount number of tasks
+     * @param task function taking the task index
+     */
+    void run(std::size_t taskCount, const std::function<void(std::size_t)> &task);
+
+    /**
+     * @brief split [begin, end) into chunks of at least grain indices and call body(chunkBegin, chunkEnd) on each
+     *        ranges shorter than two grains run on the calling thread only
+     *
+     * @param begin first index
+     * @param end one past last index
+     * @param grain minimum chunk length
+     * @param body function taking a chunk [chunkBegin, chunkEnd)
+     */
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body);
+
+    /**
+     * @brief number of hardware threads, at least 1
+     *
+     * @return std::size_t
+     */
+    static std::size_t hardwareThreads();
+
+private:
+    /**
+     * @brief worker thread body, sleeps until a run() starts or the pool stops
+     *
+     */
+    void workerLoop();
+
+    /**
+     * @brief take and run tasks of the current run() until none are left
+     *
+     */
+    void drainTasks();
+
+    std::vector<std::thread> m_workers; // threadCount - 1 worker threads
+    std::mutex m_mutex; // guards everything below except m_nextTask
+    std::condition_variable m_wake; // workers wait here for a new run()
+    std::condition_variable m_done; // run() waits here for the workers
+    const std::function<void(std::size_t)> *m_task; // task of the current run()
+    std::size_t m_taskCount; // tasks in the current run()
+    std::atomic<std::size_t> m_nextTask; // next task index to hand out
+    std::size_t m_busyWorkers; // workers still inside the current run()
+    std::uint64_t m_generation; // bumped by each run(), wakes the workers
+    bool m_stopping; // set by the destructor
+};
+
+#endif
@@ -0,0 +1,143 @@
+// trajectory file format, fixed header + fixed-stride binary frames
+
+#ifndef TRAJECTORY_FILE_H
+#define TRAJECTORY_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "mapped_file.h"
+
+/**
+ * @brief bits of TrajectoryHeader::fields, which values every frame holds
+ *      Time = t
+ *      Position = x, y per body
+ *      Velocity = vx, vy per body
+ *      Energy = total energy at the end of the frame
+ */
+enum class TrajectoryField : std::uint32_t{
+    Time = 1U,
+    Position = 2U,
+    Velocity = 4U,
+    Energy = 8U
+};
+
+/**
+ * @brief first 64 bytes of a binary trajectory file
+ *
+ * File layout:
+ *      header, headerBytes long
+ *      frame 0, frame 1, ... each frameBytes long, frame k starts at headerBytes + k * frameBytes
+ * Frame layout, all values valueBytes wide (float or double, native byte order):
+ *      t, x1, y1, vx1, vy1, x2, y2, vx2, vy2, ..., [E_total]
+ * same column order as the csv output, so a frame maps one to one onto a csv row
+ * body k is the body with id k - 1, a body merged away by a collision is nan from then on
+ * frame count = (file size - headerBytes) / frameBytes, a partly written last frame is ignored
+ */
+struct TrajectoryHeader{
+    char magic[8]; // "NBODYTRJ"
+    std::uint32_t version; // format version, TRAJECTORY_VERSION
+    std::uint32_t headerBytes; // offset of frame 0
+    std::uint32_t precision; // precision of the run, 0 = float, 1 = double, 2 = long double
+    std::uint32_t valueBytes; // bytes per stored value, 4 = float, 8 = double
+    std::uint32_t fields; // TrajectoryField bits
+    std::uint32_t reserved; // zero
+    std::uint64_t bodyCount; // N, body ids of the run, merged bodies included
+    std::uint64_t outputEvery; // steps between frames
+    double dt; // time step of the run
+    std::uint64_t frameBytes; // bytes per frame
+};
+
+static_assert(sizeof(TrajectoryHeader) == 64, "TrajectoryHeader must stay 64 bytes");
+
+constexpr std::uint32_t TRAJECTORY_VERSION = 1U; // current binary format version
+
+/**
+ * @brief fill a header for a run
+ *        long double runs are stored as double, long double has no portable binary layout
+ *
+ * @param precisionCode 0 = float, 1 = double, 2 = long double
+ * @param bodyCount number of bodies
+ * @param includeEnergy frames carry E_total
+ * @param outputEvery steps between frames
+ * @param dt time step
+ * @return TrajectoryHeader
+ */
+TrajectoryHeader makeTrajectoryHeader(std::uint32_t precisionCode, std::uint64_t bodyCount, bool includeEnergy, std::uint64_t outputEvery, double dt);
+
+/**
+ * @brief read-only view of a binary trajectory file
+ *        the file is a MappedFile, memory mapped where the OS allows it
+ *        value(k, v) is O(1) for any frame, nothing is parsed up front
+ */
+class TrajectoryReader{
+public:
+    /**
+     * @brief construct a closed reader
+     *
+     */
+    TrajectoryReader();
+
+    /**
+     * @brief unmap and close
+     *
+     */
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader &) = delete;
+    TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+    /**
+     * @brief map a file and check its header
+     *
+     * @param path binary trajectory file
+     * @param err stream for error messages
+     * @return true if the file is a valid trajectory
+     * @return false otherwise
+     */
+    bool open(const std::string &path, std::ostream &err);
+
+    /**
+     * @brief unmap and release the file
+     *
+     */
+    void close();
+
+    /**
+     * @brief header of the open file
+     *
+     * @return const TrajectoryHeader&
+     */
+    const TrajectoryHeader &header() const;
+
+    /**
+     * @brief number of complete frames in the file
+     *
+     * @return std::size_t
+     */
+    std::size_t frameCount() const;
+
+    /**
+     * @brief number of values in one frame, 1 + 4 * N [+ 1]
+     *
+     * @return std::size_t
+     */
+    std::size_t valuesPerFrame() const;
+
+    /**
+     * @brief value v of frame k, widened to double
+     *
+     * @param k frame index, less than frameCount()
+     * @param v value index, less than valuesPerFrame()
+     * @return double
+     */
+    double value(std::size_t k, std::size_t v) const;
+
+private:
+    MappedFile m_file; // bytes of the open file
+    TrajectoryHeader m_header; // copy of the header
+};
+
+#endif
@@ -3,12 +3,12 @@
 #ifndef VEC2_HPP
 #define VEC2_HPP
 
-#include "real_type.hpp"
 #include <cmath>
 
 /**
  * @brief simple 2D vector class for positions, velocities, and forces
- *        math helper that represents a 2D vector (x, y) using the Real type
+ *        math helper that represents a 2D vector (x, y) using scalar type T
+ *        T = float, double or long double
  * Has:
  *  vector addition
  *  vector subtraction
@@ -16,10 +16,11 @@
  *  euclidian length
  * 
  */
+template<typename T>
 class Vec2{
 public:
-    Real x; // x component of vector
-    Real y; // y component of vector
+    T x; // x component of vector
+    T y; // y component of vector
 
     /**
      * @brief default constructor
@@ -27,14 +28,14 @@ public:
      *      vector = (0, 0)
      * 
      */
-    Vec2() : x(static_cast<Real>(0)), y(static_cast<Real>(0)){}
+    Vec2() : x(static_cast<T>(0)), y(static_cast<T>(0)){}
     /**
      * @brief Construct a vector with explicit x and y components
      * 
      * @param xVal initial x component
      * @param yVal initial y component
      */
-    Vec2(Real xVal, Real yVal) : x(xVal), y(yVal){}
+    Vec2(T xVal, T yVal) : x(xVal), y(yVal){}
     /**
      * @brief return the sum of this vector and another
      * 
@@ -59,16 +60,16 @@ public:
      * @param k scalar multiplier
      * @return Vec2 new Vec2 containing the scaled components
      */
-    Vec2 scale(Real k) const{
+    Vec2 scale(T k) const{
         return Vec2(k * x, k * y);
     }
     /**
      * @brief compute euclidean length of vector
      *        ||v|| = sqrt(x^2 + y^2)
-     * @return Real the length of the vector
+     * @return T the length of the vector
      */
-    Real norm() const{
-        return static_cast<Real>(std::sqrt(x * x + y * y));
+    T norm() const{
+        return static_cast<T>(std::sqrt(x * x + y * y));
     }
 };
 
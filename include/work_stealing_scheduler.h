@@ -0,0 +1,126 @@
+// workstealingscheduler class, runs independent tasks of uneven length on per-thread queues with stealing
+
+#ifndef WORK_STEALING_SCHEDULER_H
+#define WORK_STEALING_SCHEDULER_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief what one thread did during a WorkStealingScheduler::run()
+ *
+ */
+struct WorkerStats{
+    unsigned long long tasks; // tasks run, stolen ones included
+    unsigned long long stolen; // tasks taken from another thread's queue
+    double busySeconds; // wall time spent inside tasks
+};
+
+/**
+ * @brief runs a batch of independent, long and uneven tasks, e.g. whole simulations, across threads
+ * Stores:
+ *      one queue of task indices per thread, each guarded by its own mutex
+ *      the estimated cost still waiting in every queue
+ * Responsible for:
+ *      run(): deal the tasks out by estimated cost, largest first to the least loaded queue,
+ *          then let every thread work through its own queue from the front (largest first)
+ *          and, once it is empty, steal from the back of the queue with the most cost left
+ *
+ * The estimates only need to be roughly proportional to the run time, stealing evens out the rest.
+ * Unlike ThreadPool there is no shared counter, threads only meet when one runs dry.
+ * Threads are started by run() and joined before it returns, the calling thread is thread 0.
+ */
+class WorkStealingScheduler{
+public:
+    /**
+     * @brief set the thread count, no threads are started until run()
+     *
+     * @param threadCount total threads including the caller, 0 = ThreadPool::hardwareThreads()
+     */
+    explicit WorkStealingScheduler(std::size_t threadCount);
+
+    WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+    WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+    /**
+     * @brief returns number of threads a run() uses, including the caller
+     *
+     * @return std::size_t thread count
+     */
+    std::size_t threadCount() const;
+
+    /**
+     * @brief call task(k, thread) once for every k in [0, costs.size()), blocks until all calls returned
+     *        task must not throw
+     *
+     * @param costs estimated cost of every task, any unit, larger runs first
+     * @param task function taking the task index and the number of the thread running it
+     */
+    void run(const std::vector<double> &costs, const std::function<void(std::size_t, std::size_t)> &task);
+
+    /**
+     * @brief per-thread counts and busy time of the last run()
+     *
+     * @return const std::vector<WorkerStats>& one entry per thread
+     */
+    const std::vector<WorkerStats> &workerStats() const;
+
+    /**
+     * @brief tasks stolen during the last run()
+     *
+     * @return unsigned long long
+     */
+    unsigned long long steals() const;
+
+private:
+    /**
+     * @brief task indices dealt to one thread
+     *
+     */
+    struct TaskQueue{
+        std::mutex mutex; // guards tasks and cost
+        std::deque<std::size_t> tasks; // largest estimate at the front
+        double cost; // sum of the estimates still queued
+    };
+
+    /**
+     * @brief thread body, own queue first, then steal until every queue is empty
+     *
+     * @param thread thread number
+     * @param costs estimates of the current run()
+     * @param task task function of the current run()
+     */
+    void workerLoop(std::size_t thread, const std::vector<double> &costs, const std::function<void(std::size_t, std::size_t)> &task);
+
+    /**
+     * @brief pop the front of the thread's own queue
+     *
+     * @param thread thread number
+     * @param costs estimates of the current run()
+     * @param taskIndex set to the task taken
+     * @return true if a task was taken
+     * @return false if the queue is empty
+     */
+    bool takeOwn(std::size_t thread, const std::vector<double> &costs, std::size_t &taskIndex);
+
+    /**
+     * @brief pop the back of the other queue with the most estimated cost left
+     *
+     * @param thread thread number of the thief
+     * @param costs estimates of the current run()
+     * @param taskIndex set to the task taken
+     * @return true if a task was stolen
+     * @return false if every other queue is empty
+     */
+    bool steal(std::size_t thread, const std::vector<double> &costs, std::size_t &taskIndex);
+
+    std::size_t m_threadCount; // threads of a run(), caller included
+    std::vector<std::unique_ptr<TaskQueue>> m_queues; // one per thread
+    std::vector<WorkerStats> m_stats; // one per thread, each written only by its thread during run()
+};
+
+#endif
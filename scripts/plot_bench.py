@@ -3,12 +3,21 @@ import matplotlib.pyplot as plt
 
 bench = pd.read_csv('results/bench.csv')
 
+# make bench varies steps per case, so compare the time of one step
+bench["seconds_per_step"] = bench["seconds"] / bench["steps"]
+series = [c for c in ["method", "precision", "engine"] if c in bench.columns]
+
 plt.figure()
-plt.plot(bench['N'], bench["seconds"], marker='o')
+for key, group in bench.groupby(series):
+    label = " ".join(key) if isinstance(key, tuple) else str(key)
+    group = group.sort_values("N")
+    plt.plot(group['N'], group["seconds_per_step"], marker='o', label=label)
 plt.xlabel("N bodies")
-plt.ylabel("seconds (log scale)")
+plt.ylabel("seconds per step (log scale)")
 plt.title("Runtime vs N")
+plt.xscale("log")
 plt.yscale("log")
 plt.grid(True, which="both", linestyle="--", linewidth=0.5)
+plt.legend(fontsize=6)
 plt.savefig("assets/bench.png", dpi=200, bbox_inches='tight')
-print("Wrote bench.png to /assets")
\ No newline at end of file
+print("Wrote bench.png to /assets")
@@ -0,0 +1,339 @@
+// asyncrunlogger class, runlogger on a background writer thread
+
+#include "async_run_logger.h"
+#include "phase_profiler.h"
+
+#include <utility>
+
+/**
+ * @brief construct a closed logger
+ *
+ * @param capacity snapshots that can wait for the writer, 0 = no writer thread
+ */
+template<typename T>
+AsyncRunLogger<T>::AsyncRunLogger(std::size_t capacity) : m_logger(), m_energySystem(), m_ring(capacity), m_head(0), m_tail(0), m_queued(0), m_fullWaits(0), m_stopping(false), m_framesLogged(0), m_framesWritten(0), m_flushTarget(0), m_framesFlushed(0), m_closed(false), m_mutex(), m_notEmpty(), m_notFull(), m_flushed(), m_writer(){}
+
+/**
+ * @brief drain pending snapshots and close
+ *
+ */
+template<typename T>
+AsyncRunLogger<T>::~AsyncRunLogger(){
+    close();
+}
+
+/**
+ * @brief set the error bounds and block length of Compressed output, see RunLogger::setCompression
+ *        call before writeHeader()
+ *
+ * @param positionError largest position error, > 0
+ * @param velocityError largest velocity error, > 0
+ * @param keyframeEvery most frames per block
+ */
+template<typename T>
+void AsyncRunLogger<T>::setCompression(double positionError, double velocityError, unsigned int keyframeEvery){
+    m_logger.setCompression(positionError, velocityError, keyframeEvery);
+}
+
+/**
+ * @brief open output file for writing and start the writer thread
+ *
+ * @param path file path to open
+ * @param format Csv, Binary or Compressed
+ * @return true if file stream is valid and available for writing
+ * @return false otherwise
+ */
+template<typename T>
+bool AsyncRunLogger<T>::open(const std::string &path, LogFormat format){
+    close();
+    const bool ok = m_logger.open(path, format);
+    start(0);
+    return ok;
+}
+
+/**
+ * @brief reopen an existing trajectory to continue it and start the writer thread, see RunLogger::openAppend
+ *        framesLogged() counts on from framesKept
+ *
+ * @param path file path to open
+ * @param format Csv, Binary or Compressed, must match the existing file
+ * @param framesKept rows or frames to keep
+ * @param framesFound set to the rows or frames kept, less than framesKept if the file was shorter
+ * @return true if file stream is valid and available for writing
+ * @return false otherwise
+ */
+template<typename T>
+bool AsyncRunLogger<T>::openAppend(const std::string &path, LogFormat format, unsigned long long framesKept, unsigned long long &framesFound){
+    close();
+    const bool ok = m_logger.openAppend(path, format, framesKept, framesFound);
+    start(framesKept);
+    return ok;
+}
+
+/**
+ * @brief reset the ring and the frame counters and start the writer thread, if there is a ring
+ *
+ * @param frames frame count the counters start from
+ */
+template<typename T>
+void AsyncRunLogger<T>::start(unsigned long long frames){
+    m_framesLogged = frames;
+    m_framesWritten = frames;
+    m_flushTarget = frames;
+    m_framesFlushed = frames;
+    m_closed = false;
+    if(!m_ring.empty()){
+        m_head = 0;
+        m_tail = 0;
+        m_queued = 0;
+        m_stopping = false;
+        m_writer = std::thread(&AsyncRunLogger<T>::writerLoop, this);
+    }
+}
+
+/**
+ * @brief write the header on the calling thread and copy the energy settings of system
+ *
+ * @param system the NBodySystem2D with bodies to define columns
+ * @param includeEnergy if true, append E_total column at the end
+ * @param outputEvery steps between logged states, stored in the binary header
+ * @param dt time step, stored in the binary header
+ */
+template<typename T>
+void AsyncRunLogger<T>::writeHeader(const NBodySystem2D<T> &system, bool includeEnergy, long long outputEvery, double dt){
+    // nothing is queued yet, so the writer is not using the logger or the energy system
+    m_logger.writeHeader(system, includeEnergy, outputEvery, dt);
+
+    // energies on the writer must come out of the same engine with the same parameters
+    m_energySystem.copyForceSettings(system);
+
+    // size every buffer now so logging never allocates while the body count stays fixed
+    m_energySystem.bodies() = system.bodies();
+    m_energySystem.setBodyIds(system.bodyIds(), system.idCount());
+    for(std::size_t k = 0; k < m_ring.size(); ++k){
+        m_ring[k].bodies.reserve(system.bodyCount());
+        m_ring[k].ids.reserve(system.bodyCount());
+    }
+}
+
+/**
+ * @brief queue one state for writing, same output as RunLogger::logState
+ *        blocks only while the ring is full
+ *
+ * @param t current simulation time
+ * @param system current N-body system state
+ * @param includeEnergy if true, the writer appends totalEnergy()
+ */
+template<typename T>
+void AsyncRunLogger<T>::logState(T t, const NBodySystem2D<T> &system, bool includeEnergy){
+    ++m_framesLogged;
+    if(m_ring.empty()){
+        m_logger.logState(t, system, includeEnergy);
+        return;
+    }
+
+    // with a cached potential the energy is O(n), cheaper here than a pair sum on the writer
+    const bool hasEnergy = includeEnergy && system.potentialCached();
+    const T energy = hasEnergy ? system.totalEnergy() : static_cast<T>(0);
+
+    // waiting for a slot and the copy are the logging cost the stepping thread sees
+    ScopedPhase timer(Phase::Logging);
+    std::size_t slot = 0;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_queued == m_ring.size()){
+            ++m_fullWaits;
+            m_notFull.wait(lock, [this](){ return m_queued < m_ring.size(); });
+        }
+        slot = m_head;
+    }
+
+    // the writer never touches a slot that is not queued, so the copy needs no lock
+    Snapshot &snapshot = m_ring[slot];
+    snapshot.t = t;
+    snapshot.includeEnergy = includeEnergy;
+    snapshot.hasEnergy = hasEnergy;
+    snapshot.energy = energy;
+    snapshot.bodies = system.bodies();
+    snapshot.ids = system.bodyIds();
+    snapshot.idCount = system.idCount();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_head = (m_head + 1) % m_ring.size();
+        ++m_queued;
+    }
+    m_notEmpty.notify_one();
+}
+
+/**
+ * @brief ask for every state logged so far to reach the file, without waiting for it
+ *        with capacity 0 the file is flushed right away, otherwise the writer flushes
+ *        once it has written the states queued before this call
+ *
+ */
+template<typename T>
+void AsyncRunLogger<T>::flush(){
+    if(m_ring.empty()){
+        m_logger.flush();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_framesFlushed = m_framesLogged;
+        }
+        m_flushed.notify_all();
+        return;
+    }
+    // only the writer touches the file while it runs, it picks the request up when idle or after a write
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_flushTarget = m_framesLogged;
+    }
+    m_notEmpty.notify_one();
+}
+
+/**
+ * @brief block until framesLogged() reached frames at a flush() and those frames reached the file
+ *        returns at once after close(), safe to call from another thread
+ *
+ * @param frames frame count to wait for
+ */
+template<typename T>
+void AsyncRunLogger<T>::waitFlushed(unsigned long long frames){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_flushed.wait(lock, [this, frames](){ return m_framesFlushed >= frames || m_closed; });
+}
+
+/**
+ * @brief logState() calls since open(), plus framesKept after openAppend()
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long AsyncRunLogger<T>::framesLogged() const{
+    return m_framesLogged;
+}
+
+/**
+ * @brief write everything still queued, stop the writer and close the file
+ *
+ */
+template<typename T>
+void AsyncRunLogger<T>::close(){
+    if(m_writer.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_notEmpty.notify_one();
+        m_writer.join();
+    }
+    m_logger.close();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_framesFlushed = m_framesLogged;
+        m_closed = true;
+    }
+    m_flushed.notify_all();
+}
+
+/**
+ * @brief number of logState() calls that had to wait for a free slot
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long AsyncRunLogger<T>::fullWaits() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fullWaits;
+}
+
+/**
+ * @brief size of the file written, valid after close()
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long AsyncRunLogger<T>::bytesWritten() const{
+    return m_logger.bytesWritten();
+}
+
+/**
+ * @brief number of snapshots the ring holds
+ *
+ * @return std::size_t
+ */
+template<typename T>
+std::size_t AsyncRunLogger<T>::capacity() const{
+    return m_ring.size();
+}
+
+/**
+ * @brief writer thread body, writes snapshots until close() and the ring is empty
+ *        also flushes the file when flush() asked for frames it has written
+ *
+ */
+template<typename T>
+void AsyncRunLogger<T>::writerLoop(){
+    for(;;){
+        std::size_t slot = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this](){ return m_queued > 0 || m_stopping || m_flushTarget > m_framesFlushed; });
+            if(m_queued == 0){
+                if(m_flushTarget > m_framesFlushed){
+                    // everything logged is written, a flush() is still waiting for the file
+                    const unsigned long long written = m_framesWritten;
+                    lock.unlock();
+                    m_logger.flush();
+                    lock.lock();
+                    m_framesFlushed = written;
+                    lock.unlock();
+                    m_flushed.notify_all();
+                    continue;
+                }
+                return;
+            }
+            slot = m_tail;
+        }
+
+        // swap instead of copy, the slot gets the old buffer back with the right size
+        Snapshot &snapshot = m_ring[slot];
+        std::swap(m_energySystem.bodies(), snapshot.bodies);
+        m_energySystem.setBodyIds(snapshot.ids, snapshot.idCount);
+        if(snapshot.hasEnergy){
+            m_logger.logStateWithEnergy(snapshot.t, m_energySystem, snapshot.energy);
+        }
+        else{
+            m_logger.logState(snapshot.t, m_energySystem, snapshot.includeEnergy);
+        }
+
+        bool flushNow = false;
+        unsigned long long written = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            written = ++m_framesWritten;
+            flushNow = written >= m_flushTarget && m_framesFlushed < m_flushTarget;
+        }
+        if(flushNow){
+            m_logger.flush();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(flushNow){
+                m_framesFlushed = written;
+            }
+            m_tail = (m_tail + 1) % m_ring.size();
+            --m_queued;
+        }
+        m_notFull.notify_one();
+        if(flushNow){
+            m_flushed.notify_all();
+        }
+    }
+}
+
+// precisions selectable through the precision config key
+template class AsyncRunLogger<float>;
+template class AsyncRunLogger<double>;
+template class AsyncRunLogger<long double>;
@@ -0,0 +1,243 @@
+// barneshuttree2d class, quadtree for O(n log n) forces
+
+#include "barnes_hut2d.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief construct an empty tree
+ *
+ */
+template<typename T>
+BarnesHutTree2D<T>::BarnesHutTree2D() : m_nodes(), m_order(){}
+
+/**
+ * @brief rebuild the tree from the current body positions
+ *        storage from previous builds is reused
+ *
+ * @param bodies bodies to sort into the tree
+ */
+template<typename T>
+void BarnesHutTree2D<T>::build(const BodyArrays2D<T> &bodies){
+    const std::size_t n = bodies.size();
+    m_nodes.clear();
+    m_order.resize(n);
+    for(std::size_t i = 0; i < n; ++i){
+        m_order[i] = i;
+    }
+    if(n == 0){
+        return;
+    }
+
+    // bounding box of all bodies
+    T minX = bodies.x[0];
+    T maxX = bodies.x[0];
+    T minY = bodies.y[0];
+    T maxY = bodies.y[0];
+    for(std::size_t i = 1; i < n; ++i){
+        minX = std::min(minX, bodies.x[i]);
+        maxX = std::max(maxX, bodies.x[i]);
+        minY = std::min(minY, bodies.y[i]);
+        maxY = std::max(maxY, bodies.y[i]);
+    }
+
+    // root is the smallest square containing the box
+    T halfSize = static_cast<T>(0.5) * std::max(maxX - minX, maxY - minY);
+    if(halfSize <= static_cast<T>(0)){
+        // all bodies coincide, any positive size works
+        halfSize = static_cast<T>(1);
+    }
+
+    Node root;
+    root.center = Vec2<T>(static_cast<T>(0.5) * (minX + maxX), static_cast<T>(0.5) * (minY + maxY));
+    root.halfSize = halfSize;
+    root.mass = static_cast<T>(0);
+    root.com = root.center;
+    root.begin = 0;
+    root.end = n;
+    root.firstChild = 0;
+    m_nodes.push_back(root);
+
+    buildNode(0, bodies, 0);
+}
+
+/**
+ * @brief recursively split a cell into quadrants and compute its mass moments
+ *
+ * @param nodeIndex index of cell in m_nodes
+ * @param bodies bodies being sorted into the tree
+ * @param depth depth of the cell, root = 0
+ */
+template<typename T>
+void BarnesHutTree2D<T>::buildNode(std::size_t nodeIndex, const BodyArrays2D<T> &bodies, int depth){
+    const std::size_t begin = m_nodes[nodeIndex].begin;
+    const std::size_t end = m_nodes[nodeIndex].end;
+
+    T mass = static_cast<T>(0);
+    T mx = static_cast<T>(0);
+    T my = static_cast<T>(0);
+
+    if(end - begin > LEAF_CAPACITY && depth < MAX_DEPTH){
+        const Vec2<T> c = m_nodes[nodeIndex].center;
+        const T quarter = static_cast<T>(0.5) * m_nodes[nodeIndex].halfSize;
+
+        // split range by y first, then each half by x
+        // quadrant order: (-x,-y), (+x,-y), (-x,+y), (+x,+y)
+        const std::vector<std::size_t>::iterator first = m_order.begin();
+        const auto below = [&](std::size_t k){ return bodies.y[k] < c.y; };
+        const auto left = [&](std::size_t k){ return bodies.x[k] < c.x; };
+        const std::size_t midY = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(begin), first + static_cast<std::ptrdiff_t>(end), below) - first);
+        const std::size_t q0End = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(begin), first + static_cast<std::ptrdiff_t>(midY), left) - first);
+        const std::size_t q2End = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(midY), first + static_cast<std::ptrdiff_t>(end), left) - first);
+        const std::size_t bounds[5] = {begin, q0End, midY, q2End, end};
+
+        // children are appended as four consecutive cells
+        const std::size_t firstChild = m_nodes.size();
+        m_nodes[nodeIndex].firstChild = firstChild;
+        for(std::size_t q = 0; q < 4; ++q){
+            Node child;
+            child.center = Vec2<T>(c.x + ((q & 1U) != 0 ? quarter : -quarter), c.y + ((q & 2U) != 0 ? quarter : -quarter));
+            child.halfSize = quarter;
+            child.mass = static_cast<T>(0);
+            child.com = child.center;
+            child.begin = bounds[q];
+            child.end = bounds[q + 1];
+            child.firstChild = 0;
+            m_nodes.push_back(child);
+        }
+        for(std::size_t q = 0; q < 4; ++q){
+            buildNode(firstChild + q, bodies, depth + 1);
+        }
+
+        // combine child moments
+        for(std::size_t q = 0; q < 4; ++q){
+            const Node &child = m_nodes[firstChild + q];
+            mass += child.mass;
+            mx += child.mass * child.com.x;
+            my += child.mass * child.com.y;
+        }
+    }
+    else{
+        // leaf, sum its bodies directly
+        for(std::size_t k = begin; k < end; ++k){
+            const std::size_t j = m_order[k];
+            mass += bodies.m[j];
+            mx += bodies.m[j] * bodies.x[j];
+            my += bodies.m[j] * bodies.y[j];
+        }
+    }
+
+    Node &node = m_nodes[nodeIndex];
+    node.mass = mass;
+    if(mass != static_cast<T>(0)){
+        node.com = Vec2<T>(mx / mass, my / mass);
+    }
+}
+
+/**
+ * @brief add approximate gravitational acceleration on every body to ax, ay
+ *        does not clear the accumulators, caller is responsible
+ *        tree must have been built from the same bodies
+ *
+ * @param bodies bodies to receive accelerations
+ * @param G gravitational constant
+ * @param eps2 softening value added to r^2
+ * @param theta opening angle, cell is opened if size / distance >= theta
+ */
+template<typename T>
+void BarnesHutTree2D<T>::accumulateAccelerations(BodyArrays2D<T> &bodies, T G, T eps2, T theta) const{
+    accumulateAccelerations(bodies, G, eps2, theta, 0, bodies.size());
+}
+
+/**
+ * @brief same as above for bodies [iBegin, iEnd) only
+ *        only ax[i], ay[i] of those bodies are written, disjoint ranges can run on different threads
+ *
+ * @param bodies bodies to receive accelerations
+ * @param G gravitational constant
+ * @param eps2 softening value added to r^2
+ * @param theta opening angle, cell is opened if size / distance >= theta
+ * @param iBegin first body
+ * @param iEnd one past last body
+ */
+template<typename T>
+void BarnesHutTree2D<T>::accumulateAccelerations(BodyArrays2D<T> &bodies, T G, T eps2, T theta, std::size_t iBegin, std::size_t iEnd) const{
+    if(m_nodes.empty()){
+        return;
+    }
+    const T theta2 = theta * theta;
+
+    // cells still to visit for the current body
+    std::vector<std::size_t> stack;
+    stack.reserve(4 * static_cast<std::size_t>(MAX_DEPTH));
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        const Vec2<T> ri(bodies.x[i], bodies.y[i]);
+        T sx = static_cast<T>(0);
+        T sy = static_cast<T>(0);
+
+        stack.clear();
+        stack.push_back(0);
+        while(!stack.empty()){
+            const Node &node = m_nodes[stack.back()];
+            stack.pop_back();
+            if(node.mass == static_cast<T>(0)){
+                continue;
+            }
+
+            // displacement from body to cell center of mass
+            const Vec2<T> dr = node.com.sub(ri);
+            const T dist2 = dr.x * dr.x + dr.y * dr.y;
+            const T size = static_cast<T>(2) * node.halfSize;
+
+            // a cell holding the body itself must always be opened
+            const bool inside = std::fabs(ri.x - node.center.x) <= node.halfSize && std::fabs(ri.y - node.center.y) <= node.halfSize;
+
+            if(!inside && size * size < theta2 * dist2){
+                // far enough, treat whole cell as one point mass
+                const T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dist2 + eps2));
+                const T accMag = node.mass * invDist * invDist * invDist;
+                sx += dr.x * accMag;
+                sy += dr.y * accMag;
+            }
+            else if(node.firstChild == 0){
+                // leaf too close, sum its bodies directly
+                for(std::size_t k = node.begin; k < node.end; ++k){
+                    const std::size_t j = m_order[k];
+                    if(j == i){
+                        continue;
+                    }
+                    const Vec2<T> drj(bodies.x[j] - ri.x, bodies.y[j] - ri.y);
+                    const T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(drj.x * drj.x + drj.y * drj.y + eps2));
+                    const T accMag = bodies.m[j] * invDist * invDist * invDist;
+                    sx += drj.x * accMag;
+                    sy += drj.y * accMag;
+                }
+            }
+            else{
+                // too close, look at the children instead
+                for(std::size_t q = 0; q < 4; ++q){
+                    stack.push_back(node.firstChild + q);
+                }
+            }
+        }
+        bodies.ax[i] += G * sx;
+        bodies.ay[i] += G * sy;
+    }
+}
+
+/**
+ * @brief returns number of cells in the last built tree
+ *
+ * @return std::size_t number of cells
+ */
+template<typename T>
+std::size_t BarnesHutTree2D<T>::nodeCount() const{
+    return m_nodes.size();
+}
+
+// precisions selectable through the precision config key
+template class BarnesHutTree2D<float>;
+template class BarnesHutTree2D<double>;
+template class BarnesHutTree2D<long double>;
@@ -1,107 +1,516 @@
 // load bodies from csv, lines=mass+x+y+vx+vy
 
-#include <string>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <sstream>
 #include <iostream>
-#include <cctype>
-#include <cmath>
+#include <string>
+#include <type_traits>
+#include <vector>
 
-#include "nbody_system2d.h"
 #include "body_io.h"
-#include "real_type.hpp"
 #include "body2d.hpp"
+#include "mapped_file.h"
+#include "nbody_system2d.h"
+#include "thread_pool.h"
 #include "vec2.hpp"
 
+namespace{
+
+// below this size a csv file is parsed on the calling thread only
+constexpr std::size_t PARALLEL_PARSE_BYTES = 1U << 20;
+
+// bodies copied per batch when reading the binary format
+constexpr std::size_t BINARY_BATCH = 4096;
+
+/**
+ * @brief whitespace as std::isspace sees it in the C locale
+ *
+ * @param c character
+ * @return true for space, \t, \n, \v, \f, \r
+ */
+bool isSpace(char c){
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * @brief std::stold on [first, last) without a heap allocation for normal length fields
+ *        mapped memory has no terminating zero, so the field is copied first
+ *
+ * @param first first character of the field
+ * @param last one past the last character
+ * @param out parsed value
+ * @return true if strtold parsed a value and it is in range, where std::stold would not throw
+ */
+bool parseFieldStrtold(const char *first, const char *last, long double &out){
+    const std::size_t length = static_cast<std::size_t>(last - first);
+    char small[64];
+    std::string large;
+    const char *text = small;
+    if(length < sizeof(small)){
+        std::memcpy(small, first, length);
+        small[length] = '\0';
+    }
+    else{
+        large.assign(first, last);
+        text = large.c_str();
+    }
+    char *end = nullptr;
+    errno = 0;
+    out = std::strtold(text, &end);
+    return end != text && errno != ERANGE;
+}
+
+/**
+ * @brief parse one csv field, accepting and rejecting exactly what std::stold does
+ *        plain decimal fields of float and double go through std::from_chars,
+ *        long double, signs, hex, inf/nan and out of range values go through strtold and are converted to V
+ *
+ * @tparam V value type
+ * @param first first character of the field
+ * @param last one past the last character
+ * @param out parsed value
+ * @return true if a value was parsed
+ */
+template<typename V>
+bool parseField(const char *first, const char *last, V &out){
+#if defined(__cpp_lib_to_chars)
+    if(!std::is_same<V, long double>::value){
+        const char *start = first;
+        while(start != last && isSpace(*start)){
+            ++start;
+        }
+        const char *digits = (start != last && *start == '-') ? start + 1 : start;
+        // anything but [-]digits or [-]. is rare, leave it to strtold
+        if(digits != last && ((*digits >= '0' && *digits <= '9') || *digits == '.') && !(digits + 1 != last && *digits == '0' && (digits[1] == 'x' || digits[1] == 'X'))){
+            const std::from_chars_result result = std::from_chars(start, last, out);
+            if(result.ec == std::errc()){
+                return true;
+            }
+            // a value outside V is still valid for std::stold, it becomes inf or 0 below
+            if(result.ec != std::errc::result_out_of_range){
+                return false;
+            }
+        }
+    }
+#endif
+    long double value;
+    if(!parseFieldStrtold(first, last, value)){
+        return false;
+    }
+    out = static_cast<V>(value);
+    return true;
+}
+
+/**
+ * @brief parse one csv line and append the body if the line is valid
+ *        tokens are split on ',' like std::getline, a trailing ',' adds no empty token,
+ *        one trailing '\r' per token is dropped
+ *
+ * @tparam T scalar type of the system
+ * @param first first character of the line
+ * @param last one past the last character, the '\n' is not included
+ * @param out bodies of the current chunk
+ */
+template<typename T>
+void parseCsvLine(const char *first, const char *last, std::vector<Body2D<T>> &out){
+    // pi precision to 50 decimals
+    const long double PI = 3.14159265358979323846264338327950288419716939937510L;
+
+    // skip empty lines and comments starting with '#'
+    if(first == last || *first == '#'){
+        return;
+    }
+
+    // split line on commas, only the first 5 tokens are needed
+    const char *fieldBegin[5];
+    const char *fieldEnd[5];
+    std::size_t tokens = 0;
+    const char *tokenStart = first;
+    for(const char *p = first;; ++p){
+        if(p == last || *p == ','){
+            if(tokens < 5){
+                fieldBegin[tokens] = tokenStart;
+                // remove any '\r's
+                fieldEnd[tokens] = (p != tokenStart && p[-1] == '\r') ? p - 1 : p;
+            }
+            ++tokens;
+            if(p == last){
+                break;
+            }
+            tokenStart = p + 1;
+        }
+    }
+    if(last[-1] == ','){
+        --tokens;
+    }
+    // requires at least 5 tokens
+    if(tokens < 5){
+        return;
+    }
+
+    // parse mass and position, if anything fails to parse, skip
+    T mass;
+    T x;
+    T y;
+    if(!parseField(fieldBegin[0], fieldEnd[0], mass) || !parseField(fieldBegin[1], fieldEnd[1], x) || !parseField(fieldBegin[2], fieldEnd[2], y)){
+        return;
+    }
+
+    // velocity components to be filled
+    T vx = static_cast<T>(0);
+    T vy = static_cast<T>(0);
+
+    if(tokens == 5){
+        // for mass,x,y,vx,vy
+        if(!parseField(fieldBegin[3], fieldEnd[3], vx) || !parseField(fieldBegin[4], fieldEnd[4], vy)){
+            return;
+        }
+    }
+    else{
+        // for mass,x,y,speed,direction_deg, etc
+        // convert speed + angle to vx,vy
+        long double speed;
+        long double directionDeg;
+        if(!parseField(fieldBegin[3], fieldEnd[3], speed) || !parseField(fieldBegin[4], fieldEnd[4], directionDeg)){
+            return;
+        }
+        const long double directionRad = directionDeg * (PI / 180.0L);
+
+        vx = static_cast<T>(speed * std::cos(directionRad));
+        vy = static_cast<T>(speed * std::sin(directionRad));
+    }
+    out.emplace_back(mass, Vec2<T>(x, y), Vec2<T>(vx, vy));
+}
+
+/**
+ * @brief parse every line that starts in [first, last)
+ *
+ * @tparam T scalar type of the system
+ * @param first first character of the chunk, start of a line
+ * @param last one past the last character, end of a line or of the file
+ * @param out bodies of the chunk in file order
+ */
+template<typename T>
+void parseCsvChunk(const char *first, const char *last, std::vector<Body2D<T>> &out){
+    // one body per line at most, counting newlines is far cheaper than growing the vector
+    out.reserve(static_cast<std::size_t>(std::count(first, last, '\n')) + 1);
+    while(first < last){
+        const void *found = std::memchr(first, '\n', static_cast<std::size_t>(last - first));
+        const char *lineEnd = found != nullptr ? static_cast<const char *>(found) : last;
+        parseCsvLine(first, lineEnd, out);
+        first = lineEnd + 1;
+    }
+}
+
+/**
+ * @brief parse a mapped csv file, in parallel chunks for large files
+ *
+ * @tparam T scalar type of the system
+ * @param file mapped csv file
+ * @param system system the bodies are appended to
+ * @param threadCount threads parsing chunks, 0 = all hardware threads
+ */
+template<typename T>
+void parseCsvFile(const MappedFile &file, NBodySystem2D<T> &system, std::size_t threadCount){
+    const char *data = file.data();
+    const std::size_t size = file.size();
+    if(size == 0){
+        return;
+    }
+
+    ThreadPool pool(size >= PARALLEL_PARSE_BYTES ? threadCount : 1);
+    const std::size_t chunks = pool.threadCount() > 1 ? 4 * pool.threadCount() : 1;
+
+    // cut at even byte offsets, then move each cut just past the next newline
+    // so every line belongs to exactly one chunk
+    std::vector<std::size_t> cuts(chunks + 1, size);
+    cuts[0] = 0;
+    for(std::size_t k = 1; k < chunks; ++k){
+        const std::size_t offset = std::max(size / chunks * k, cuts[k - 1]);
+        if(offset == 0){
+            cuts[k] = 0;
+            continue;
+        }
+        const void *found = std::memchr(data + offset - 1, '\n', size - offset + 1);
+        cuts[k] = found != nullptr ? static_cast<std::size_t>(static_cast<const char *>(found) - data) + 1 : size;
+    }
+
+    std::vector<std::vector<Body2D<T>>> parts(chunks);
+    pool.run(chunks, [&](std::size_t k){
+        parseCsvChunk(data + cuts[k], data + cuts[k + 1], parts[k]);
+    });
+
+    // append in chunk order so bodies keep their file order
+    std::size_t total = system.bodyCount();
+    for(std::size_t k = 0; k < chunks; ++k){
+        total += parts[k].size();
+    }
+    system.reserveBodies(total);
+    for(std::size_t k = 0; k < chunks; ++k){
+        system.addBodies(parts[k].data(), parts[k].size());
+        std::vector<Body2D<T>>().swap(parts[k]);
+    }
+}
+
+/**
+ * @brief read the records of a mapped binary initial-conditions file
+ *
+ * @tparam T scalar type of the system
+ * @tparam V stored value type
+ * @param records first record
+ * @param count number of records
+ * @param system system the bodies are appended to
+ */
+template<typename T, typename V>
+void readBinaryRecords(const char *records, std::size_t count, NBodySystem2D<T> &system){
+    std::vector<Body2D<T>> batch;
+    batch.reserve(std::min(count, BINARY_BATCH));
+    system.reserveBodies(system.bodyCount() + count);
+    V values[5];
+    for(std::size_t i = 0; i < count; ++i){
+        std::memcpy(values, records + i * sizeof(values), sizeof(values));
+        batch.emplace_back(static_cast<T>(values[0]), Vec2<T>(static_cast<T>(values[1]), static_cast<T>(values[2])), Vec2<T>(static_cast<T>(values[3]), static_cast<T>(values[4])));
+        if(batch.size() == BINARY_BATCH){
+            system.addBodies(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+    system.addBodies(batch.data(), batch.size());
+}
+
+/**
+ * @brief check the header of a mapped binary initial-conditions file and add its bodies
+ *
+ * @tparam T scalar type of the system
+ * @param file mapped file
+ * @param path path, for error messages
+ * @param system system the bodies are appended to
+ * @return true if the header is valid and the file holds every record
+ */
+template<typename T>
+bool parseBinaryFile(const MappedFile &file, const std::string &path, NBodySystem2D<T> &system){
+    BodyFileHeader header;
+    if(file.size() < sizeof(header)){
+        std::cerr << "Bodies file " << path << " is too short for a header.\n";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(std::memcmp(header.magic, "NBODYICF", 8) != 0){
+        std::cerr << path << " is not a binary bodies file.\n";
+        return false;
+    }
+    if(header.version != BODY_FILE_VERSION || (header.valueBytes != 4U && header.valueBytes != 8U)){
+        std::cerr << path << " has an unsupported version or value size.\n";
+        return false;
+    }
+    const std::uint64_t recordBytes = 5U * header.valueBytes;
+    if((file.size() - sizeof(header)) / recordBytes < header.bodyCount){
+        std::cerr << "Bodies file " << path << " is truncated.\n";
+        return false;
+    }
+
+    const std::size_t count = static_cast<std::size_t>(header.bodyCount);
+    if(header.valueBytes == 4U){
+        readBinaryRecords<T, float>(file.data() + sizeof(header), count, system);
+    }
+    else{
+        readBinaryRecords<T, double>(file.data() + sizeof(header), count, system);
+    }
+    return true;
+}
+
+/**
+ * @brief true if the mapped file starts with the binary initial-conditions magic
+ *
+ * @param file mapped file
+ * @return true for a binary bodies file
+ */
+bool isBinaryBodyFile(const MappedFile &file){
+    return file.size() >= 8 && std::memcmp(file.data(), "NBODYICF", 8) == 0;
+}
+
+}
+
 // reads CSV file and adds bodies to given NBodySystem2D
 /**
  * @brief read body data from csv and add them to the simulation system
- *         Expected formats: 
+ *         Expected formats:
  *              1. mass,x,y,vx,vy for velocity components
  *              2. mass,x,y,speed,direction_deg for magnitude + direction converted to (vx, vy)
  *         Skipped if empty, begins with '#', has fewer than 5 tokens, or fails parsing
+ *         The file is memory mapped and split into chunks at line boundaries that are parsed in parallel,
+ *         bodies keep the file order
  * @param path path to CSV file
+ * @tparam T scalar type of the system, values are parsed directly as T, speed and direction as long double
  * @param system reference to NBodySystem2D to which bodies are added to
+ * @param threadCount threads parsing chunks, 0 = all hardware threads
  * @return true if file could be open
  * @return false otherwise
  */
-bool loadBodiesFromCsv(const std::string &path, NBodySystem2D &system){
+template<typename T>
+bool loadBodiesFromCsv(const std::string &path, NBodySystem2D<T> &system, std::size_t threadCount){
     // try opening file for reading
-    std::ifstream input(path);
+    MappedFile file;
+    if(!file.open(path)){
+        std::cerr << "Could not open bodies file " << path << ".\n";
+        return false;
+    }
+    parseCsvFile(file, system, threadCount);
+    // always return true if file opened even if invalid
+    return true;
+}
 
-    if(!input){
+/**
+ * @brief read a binary initial-conditions file and add its bodies to the system
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the binary file
+ * @param system reference to NBodySystem2D to which bodies are added to
+ * @return true if the file could be opened and has a valid header
+ * @return false otherwise
+ */
+template<typename T>
+bool loadBodiesFromBinary(const std::string &path, NBodySystem2D<T> &system){
+    MappedFile file;
+    if(!file.open(path)){
         std::cerr << "Could not open bodies file " << path << ".\n";
         return false;
     }
+    return parseBinaryFile(file, path, system);
+}
 
-    // pi precision to 50 decimals
-    const long double PI = 3.14159265358979323846264338327950288419716939937510L;
+/**
+ * @brief load a binary initial-conditions file if path starts with the binary magic, csv otherwise
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the bodies file
+ * @param system reference to NBodySystem2D to which bodies are added to
+ * @param threadCount threads parsing csv chunks, 0 = all hardware threads
+ * @return true if the file could be opened
+ * @return false otherwise
+ */
+template<typename T>
+bool loadBodies(const std::string &path, NBodySystem2D<T> &system, std::size_t threadCount){
+    MappedFile file;
+    if(!file.open(path)){
+        std::cerr << "Could not open bodies file " << path << ".\n";
+        return false;
+    }
+    if(isBinaryBodyFile(file)){
+        return parseBinaryFile(file, path, system);
+    }
+    parseCsvFile(file, system, threadCount);
+    return true;
+}
 
-    std::string line;
-    int validCount = 0; // count how many lines made a valid body
+/**
+ * @brief write the bodies of the system as a binary initial-conditions file
+ *        float systems store float, double and long double systems store double
+ *
+ * @tparam T scalar type of the system
+ * @param path output path
+ * @param system system whose bodies are written
+ * @return true if the file was written
+ * @return false otherwise
+ */
+template<typename T>
+bool saveBodiesToBinary(const std::string &path, const NBodySystem2D<T> &system){
+    using Stored = typename std::conditional<std::is_same<T, float>::value, float, double>::type;
 
-    // process file line by line
-    while(std::getline(input, line)){
-        // skip empty lines
-        if(line.empty()){
-            continue;
-        }
-        // skip comment starting with '#'
-        if(line[0] == '#'){
-            continue;
-        }
+    std::ofstream output(path, std::ios::out | std::ios::binary);
+    if(!output){
+        std::cerr << "Could not open bodies file " << path << " for writing.\n";
+        return false;
+    }
 
-        std::stringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
+    const std::vector<Body2D<T>> &bodies = system.bodies();
+    BodyFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "NBODYICF", 8);
+    header.version = BODY_FILE_VERSION;
+    header.valueBytes = static_cast<std::uint32_t>(sizeof(Stored));
+    header.bodyCount = bodies.size();
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
 
-        // split line on commas into tokens
-        while(std::getline(ss, token, ',')){
-            // remove any '\r's
-            if(!token.empty() && token.back() == '\r'){
-                token.pop_back();
-            }
-            tokens.push_back(token);
+    // one write per batch instead of per value
+    std::vector<Stored> batch;
+    batch.reserve(5 * BINARY_BATCH);
+    for(std::size_t i = 0; i < bodies.size(); ++i){
+        const Body2D<T> &b = bodies[i];
+        batch.push_back(static_cast<Stored>(b.m));
+        batch.push_back(static_cast<Stored>(b.r.x));
+        batch.push_back(static_cast<Stored>(b.r.y));
+        batch.push_back(static_cast<Stored>(b.v.x));
+        batch.push_back(static_cast<Stored>(b.v.y));
+        if(batch.size() == 5 * BINARY_BATCH || i + 1 == bodies.size()){
+            output.write(reinterpret_cast<const char *>(batch.data()), static_cast<std::streamsize>(batch.size() * sizeof(Stored)));
+            batch.clear();
         }
-        // requires at least 5 tokens
-        if(tokens.size() < 5){
-            continue;
+    }
+    return static_cast<bool>(output);
+}
+
+/**
+ * @brief read one collision radius per line, in the order of the bodies file
+ *        blank lines and lines starting with '#' are skipped
+ *
+ * @tparam T scalar type of the system
+ * @param path path to the radii file
+ * @param radii overwritten with the radii read
+ * @return true if the file was opened and every other line is a finite radius >= 0
+ * @return false otherwise
+ */
+template<typename T>
+bool loadRadii(const std::string &path, std::vector<T> &radii){
+    radii.clear();
+    std::ifstream input(path);
+    if(!input){
+        std::cerr << "Could not open radii file " << path << ".\n";
+        return false;
+    }
+    std::string line;
+    std::size_t lineNumber = 0;
+    while(std::getline(input, line)){
+        ++lineNumber;
+        std::size_t first = 0;
+        std::size_t last = line.size();
+        while(first < last && isSpace(line[first])){
+            ++first;
         }
-        try{
-            // parse mass and position
-            const Real mass = static_cast<Real>(std::stold(tokens[0]));
-            const Real x = static_cast<Real>(std::stold(tokens[1]));
-            const Real y = static_cast<Real>(std::stold(tokens[2]));
-
-            // velocity components to be filled
-            Real vx = static_cast<Real>(0);
-            Real vy = static_cast<Real>(0);
-
-            if(tokens.size() == 5){
-                // for mass,x,y,vx,vy
-                vx = static_cast<Real>(std::stold(tokens[3]));
-                vy = static_cast<Real>(std::stold(tokens[4]));
-            }
-            else{
-                // for mass,x,y,speed,direction_deg, etc
-                // convert speed + angle to vx,vy
-                const long double speed = std::stold(tokens[3]);
-                const long double directionDeg = std::stold(tokens[4]);
-                const long double directionRad = directionDeg * (PI / 180.0L);
-
-                vx = static_cast<Real>(speed * std::cos(directionRad));
-                vy = static_cast<Real>(speed * std::sin(directionRad));
-            }
-            // construct Body2D and addit to NBodySystem2D
-            Body2D body(mass, Vec2(x, y), Vec2(vx, vy));
-            system.addBody(body);
-            ++validCount;
+        while(last > first && isSpace(line[last - 1])){
+            --last;
         }
-        // if anything fails to parse, skip
-        catch(const std::exception &){
+        if(first == last || line[first] == '#'){
             continue;
         }
+        T radius;
+        if(!parseField(line.data() + first, line.data() + last, radius) || !std::isfinite(radius) || radius < static_cast<T>(0)){
+            std::cerr << "Radii file " << path << ", line " << lineNumber << ": expected a radius >= 0.\n";
+            return false;
+        }
+        radii.push_back(radius);
     }
-    // always return true if file opened even if invalid
     return true;
 }
+
+// precisions selectable through the precision config key
+template bool loadBodiesFromCsv<float>(const std::string &path, NBodySystem2D<float> &system, std::size_t threadCount);
+template bool loadBodiesFromCsv<double>(const std::string &path, NBodySystem2D<double> &system, std::size_t threadCount);
+template bool loadBodiesFromCsv<long double>(const std::string &path, NBodySystem2D<long double> &system, std::size_t threadCount);
+template bool loadBodiesFromBinary<float>(const std::string &path, NBodySystem2D<float> &system);
+template bool loadBodiesFromBinary<double>(const std::string &path, NBodySystem2D<double> &system);
+template bool loadBodiesFromBinary<long double>(const std::string &path, NBodySystem2D<long double> &system);
+template bool loadBodies<float>(const std::string &path, NBodySystem2D<float> &system, std::size_t threadCount);
+template bool loadBodies<double>(const std::string &path, NBodySystem2D<double> &system, std::size_t threadCount);
+template bool loadBodies<long double>(const std::string &path, NBodySystem2D<long double> &system, std::size_t threadCount);
+template bool saveBodiesToBinary<float>(const std::string &path, const NBodySystem2D<float> &system);
+template bool saveBodiesToBinary<double>(const std::string &path, const NBodySystem2D<double> &system);
+template bool saveBodiesToBinary<long double>(const std::string &path, const NBodySystem2D<long double> &system);
+template bool loadRadii<float>(const std::string &path, std::vector<float> &radii);
+template bool loadRadii<double>(const std::string &path, std::vector<double> &radii);
+template bool loadRadii<long double>(const std::string &path, std::vector<long double> &radii);
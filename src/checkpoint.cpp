@@ -0,0 +1,400 @@
+// checkpoint files, full-precision binary snapshots of a run and their background writer
+
+#include "checkpoint.h"
+#include "phase_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace{
+
+/**
+ * @brief precision code of T, same numbering as the trajectory header
+ *
+ * @tparam T scalar type of the run
+ * @return std::uint32_t 0 = float, 1 = double, 2 = long double
+ */
+template<typename T>
+std::uint32_t checkpointPrecision(){
+    return std::is_same<T, float>::value ? 0U : (std::is_same<T, double>::value ? 1U : 2U);
+}
+
+/**
+ * @brief bytes after the header
+ *
+ * @tparam T scalar type of the run
+ * @param n body count
+ * @param arrays per-body arrays of T, 7 or 9 with jerks
+ * @param ids idCount and ids follow
+ * @param radii radii follow
+ * @return std::uint64_t payload size
+ */
+template<typename T>
+std::uint64_t payloadBytes(std::size_t n, std::size_t arrays, bool ids, bool radii){
+    const std::size_t values = 4 + (arrays + (radii ? 1 : 0)) * n;
+    const std::size_t integers = ids ? 1 + n : 0;
+    return static_cast<std::uint64_t>(values * sizeof(T) + integers * sizeof(std::uint64_t));
+}
+
+}
+
+/**
+ * @brief write a checkpoint to path + ".tmp" and rename it over path
+ *        a crash while writing leaves the previous checkpoint in place
+ *
+ * @tparam T scalar type of the run
+ * @param path checkpoint path
+ * @param data checkpoint to write
+ * @return true if the file was written and renamed
+ * @return false otherwise
+ */
+template<typename T>
+bool writeCheckpoint(const std::string &path, const CheckpointData<T> &data){
+    const SystemState2D<T> &state = data.state;
+    const BodyArrays2D<T> &a = state.arrays;
+    const std::size_t n = a.size();
+    const std::size_t arrays = state.hermiteValid ? 9 : 7;
+    // ids are only stored once they differ from 0 .. n-1, which is when bodies were merged away
+    const bool ids = state.ids.size() == n && state.idCount != n;
+    const bool radii = state.radii.size() == n && n > 0;
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "NBODYCKP", 8);
+    header.version = CHECKPOINT_VERSION;
+    header.headerBytes = static_cast<std::uint32_t>(sizeof(CheckpointHeader));
+    header.precision = checkpointPrecision<T>();
+    header.valueBytes = static_cast<std::uint32_t>(sizeof(T));
+    header.flags = (state.forcesValid ? static_cast<std::uint32_t>(CheckpointFlag::ForcesValid) : 0U)
+                 | (state.hermiteValid ? static_cast<std::uint32_t>(CheckpointFlag::HermiteValid) : 0U)
+                 | (state.forcesInArrays ? static_cast<std::uint32_t>(CheckpointFlag::ForcesInArrays) : 0U)
+                 | (ids ? static_cast<std::uint32_t>(CheckpointFlag::BodyIds) : 0U)
+                 | (radii ? static_cast<std::uint32_t>(CheckpointFlag::Radii) : 0U);
+    header.bodyCount = n;
+    header.step = data.step;
+    header.framesLogged = data.framesLogged;
+    header.forceEvaluations = state.forceEvaluations;
+    header.pairInteractions = state.pairInteractions;
+    header.payloadBytes = payloadBytes<T>(n, arrays, ids, radii);
+    // longer names are cut, the name is only compared to warn about a changed method
+    std::memcpy(header.method, data.method.data(), std::min(data.method.size(), sizeof(header.method) - 1));
+
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!out){
+            std::cerr << "Could not open checkpoint file " << temp << " for writing.\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const T scalars[4] = {data.t, data.dt, data.G, data.eps2};
+        out.write(reinterpret_cast<const char *>(scalars), sizeof(scalars));
+        const std::vector<T> *columns[9] = {&a.m, &a.x, &a.y, &a.vx, &a.vy, &a.ax, &a.ay, &state.jerkX, &state.jerkY};
+        for(std::size_t k = 0; k < arrays; ++k){
+            out.write(reinterpret_cast<const char *>(columns[k]->data()), static_cast<std::streamsize>(n * sizeof(T)));
+        }
+        if(ids){
+            std::vector<std::uint64_t> stored(state.ids.begin(), state.ids.end());
+            const std::uint64_t idCount = state.idCount;
+            out.write(reinterpret_cast<const char *>(&idCount), sizeof(idCount));
+            out.write(reinterpret_cast<const char *>(stored.data()), static_cast<std::streamsize>(n * sizeof(std::uint64_t)));
+        }
+        if(radii){
+            out.write(reinterpret_cast<const char *>(state.radii.data()), static_cast<std::streamsize>(n * sizeof(T)));
+        }
+        if(!out.flush()){
+            std::cerr << "Could not write checkpoint file " << temp << ".\n";
+            return false;
+        }
+    }
+
+    // rename replaces the old file in one step on POSIX, Windows needs the target gone first
+    if(std::rename(temp.c_str(), path.c_str()) != 0){
+        std::remove(path.c_str());
+        if(std::rename(temp.c_str(), path.c_str()) != 0){
+            std::cerr << "Could not move checkpoint " << temp << " to " << path << ".\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief read a checkpoint written by a run of the same precision
+ *
+ * @tparam T scalar type of the run
+ * @param path checkpoint path
+ * @param data filled from the file
+ * @return true if the file was read
+ * @return false if it could not be opened, is not a checkpoint, has another precision or is cut short
+ */
+template<typename T>
+bool readCheckpoint(const std::string &path, CheckpointData<T> &data){
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if(!in){
+        std::cerr << "Could not open checkpoint file " << path << ".\n";
+        return false;
+    }
+    CheckpointHeader header;
+    if(!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, "NBODYCKP", 8) != 0){
+        std::cerr << path << " is not a checkpoint file.\n";
+        return false;
+    }
+    if(header.version != CHECKPOINT_VERSION || header.headerBytes < sizeof(CheckpointHeader)){
+        std::cerr << path << " has checkpoint version " << header.version << ", expected " << CHECKPOINT_VERSION << ".\n";
+        return false;
+    }
+    if(header.precision != checkpointPrecision<T>() || header.valueBytes != sizeof(T)){
+        std::cerr << path << " was written by a run with another precision, set precision to match it.\n";
+        return false;
+    }
+
+    const bool hermite = (header.flags & static_cast<std::uint32_t>(CheckpointFlag::HermiteValid)) != 0U;
+    const std::size_t n = static_cast<std::size_t>(header.bodyCount);
+    const std::size_t arrays = hermite ? 9 : 7;
+    const bool ids = (header.flags & static_cast<std::uint32_t>(CheckpointFlag::BodyIds)) != 0U;
+    const bool radii = (header.flags & static_cast<std::uint32_t>(CheckpointFlag::Radii)) != 0U;
+    if(header.payloadBytes != payloadBytes<T>(n, arrays, ids, radii)){
+        std::cerr << path << " has an inconsistent header.\n";
+        return false;
+    }
+    in.seekg(static_cast<std::streamoff>(header.headerBytes));
+
+    T scalars[4];
+    in.read(reinterpret_cast<char *>(scalars), sizeof(scalars));
+    SystemState2D<T> &state = data.state;
+    BodyArrays2D<T> &a = state.arrays;
+    std::vector<T> *columns[9] = {&a.m, &a.x, &a.y, &a.vx, &a.vy, &a.ax, &a.ay, &state.jerkX, &state.jerkY};
+    for(std::size_t k = 0; k < 9; ++k){
+        columns[k]->assign(k < arrays ? n : 0, static_cast<T>(0));
+        if(k < arrays){
+            in.read(reinterpret_cast<char *>(columns[k]->data()), static_cast<std::streamsize>(n * sizeof(T)));
+        }
+    }
+    state.ids.clear();
+    state.idCount = 0;
+    if(ids){
+        std::uint64_t idCount = 0;
+        std::vector<std::uint64_t> stored(n);
+        in.read(reinterpret_cast<char *>(&idCount), sizeof(idCount));
+        in.read(reinterpret_cast<char *>(stored.data()), static_cast<std::streamsize>(n * sizeof(std::uint64_t)));
+        state.ids.assign(stored.begin(), stored.end());
+        state.idCount = static_cast<std::size_t>(idCount);
+    }
+    state.radii.assign(radii ? n : 0, static_cast<T>(0));
+    if(radii){
+        in.read(reinterpret_cast<char *>(state.radii.data()), static_cast<std::streamsize>(n * sizeof(T)));
+    }
+    if(!in){
+        std::cerr << path << " is cut short.\n";
+        return false;
+    }
+
+    state.forcesValid = (header.flags & static_cast<std::uint32_t>(CheckpointFlag::ForcesValid)) != 0U;
+    state.hermiteValid = hermite;
+    state.forcesInArrays = (header.flags & static_cast<std::uint32_t>(CheckpointFlag::ForcesInArrays)) != 0U;
+    state.forceEvaluations = header.forceEvaluations;
+    state.pairInteractions = header.pairInteractions;
+    data.t = scalars[0];
+    data.dt = scalars[1];
+    data.G = scalars[2];
+    data.eps2 = scalars[3];
+    data.step = header.step;
+    data.framesLogged = header.framesLogged;
+    std::size_t methodLength = 0;
+    while(methodLength < sizeof(header.method) && header.method[methodLength] != '\0'){
+        ++methodLength;
+    }
+    data.method = std::string(header.method, methodLength);
+    return true;
+}
+
+/**
+ * @brief construct a writer without a thread
+ *
+ */
+template<typename T>
+CheckpointWriter<T>::CheckpointWriter() : m_path(), m_pending(), m_writing(), m_pendingCommit(), m_writingCommit(), m_hasPending(false), m_stopping(false), m_written(0), m_failures(0), m_waits(0), m_lastStep(-1), m_mutex(), m_pendingReady(), m_pendingFree(), m_writer(){}
+
+/**
+ * @brief finish the pending checkpoint and stop
+ *
+ */
+template<typename T>
+CheckpointWriter<T>::~CheckpointWriter(){
+    close();
+}
+
+/**
+ * @brief set the checkpoint path and start the writer thread
+ *
+ * @param path every checkpoint replaces this file
+ */
+template<typename T>
+void CheckpointWriter<T>::open(const std::string &path){
+    close();
+    m_path = path;
+    m_hasPending = false;
+    m_stopping = false;
+    m_writer = std::thread(&CheckpointWriter<T>::writerLoop, this);
+}
+
+/**
+ * @brief copy the system and hand the checkpoint to the writer
+ *        the copy is O(n), serializing and writing happen on the writer thread
+ *
+ * @param system system to save
+ * @param t simulation time
+ * @param dt time step of the run
+ * @param step steps taken
+ * @param framesLogged trajectory frames written up to and including step
+ * @param method integrator name
+ * @param beforeCommit run on the writer thread before the file is written, may be empty
+ */
+template<typename T>
+void CheckpointWriter<T>::submit(const NBodySystem2D<T> &system, T t, T dt, long long step, unsigned long long framesLogged, const std::string &method, const std::function<void()> &beforeCommit){
+    if(!m_writer.joinable()){
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_hasPending){
+            ++m_waits;
+            m_pendingFree.wait(lock, [this](){ return !m_hasPending; });
+        }
+    }
+
+    // the writer only reads m_pending while m_hasPending is set, so the copy needs no lock
+    system.captureState(m_pending.state);
+    m_pending.t = t;
+    m_pending.dt = dt;
+    m_pending.G = system.getG();
+    m_pending.eps2 = system.getEps2();
+    m_pending.step = step;
+    m_pending.framesLogged = framesLogged;
+    m_pending.method = method;
+    m_pendingCommit = beforeCommit;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hasPending = true;
+    }
+    m_pendingReady.notify_one();
+}
+
+/**
+ * @brief write the pending checkpoint and stop the writer
+ *
+ */
+template<typename T>
+void CheckpointWriter<T>::close(){
+    if(m_writer.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_pendingReady.notify_one();
+        m_writer.join();
+    }
+}
+
+/**
+ * @brief checkpoints written so far, valid after close()
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long CheckpointWriter<T>::written() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+/**
+ * @brief checkpoints that could not be written, valid after close()
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long CheckpointWriter<T>::failures() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failures;
+}
+
+/**
+ * @brief submit() calls that had to wait for the writer
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long CheckpointWriter<T>::waits() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_waits;
+}
+
+/**
+ * @brief step of the last checkpoint written, -1 if none, valid after close()
+ *
+ * @return long long
+ */
+template<typename T>
+long long CheckpointWriter<T>::lastStep() const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastStep;
+}
+
+/**
+ * @brief writer thread body, writes checkpoints until close() and nothing is pending
+ *
+ */
+template<typename T>
+void CheckpointWriter<T>::writerLoop(){
+    for(;;){
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_pendingReady.wait(lock, [this](){ return m_hasPending || m_stopping; });
+            if(!m_hasPending){
+                return;
+            }
+            // swap keeps both buffers allocated, the next submit() copies without allocating
+            std::swap(m_pending, m_writing);
+            std::swap(m_pendingCommit, m_writingCommit);
+            m_hasPending = false;
+        }
+        m_pendingFree.notify_one();
+
+        if(m_writingCommit){
+            m_writingCommit();
+        }
+        bool ok = false;
+        {
+            ScopedPhase timer(Phase::Checkpoint);
+            ok = writeCheckpoint(m_path, m_writing);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(ok){
+            ++m_written;
+            m_lastStep = m_writing.step;
+        }
+        else{
+            ++m_failures;
+        }
+    }
+}
+
+// precisions selectable through the precision config key
+template bool writeCheckpoint<float>(const std::string &path, const CheckpointData<float> &data);
+template bool writeCheckpoint<double>(const std::string &path, const CheckpointData<double> &data);
+template bool writeCheckpoint<long double>(const std::string &path, const CheckpointData<long double> &data);
+template bool readCheckpoint<float>(const std::string &path, CheckpointData<float> &data);
+template bool readCheckpoint<double>(const std::string &path, CheckpointData<double> &data);
+template bool readCheckpoint<long double>(const std::string &path, CheckpointData<long double> &data);
+template class CheckpointWriter<float>;
+template class CheckpointWriter<double>;
+template class CheckpointWriter<long double>;
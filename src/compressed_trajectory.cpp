@@ -0,0 +1,913 @@
+// compressed trajectory format, quantized delta frames in entropy-coded blocks
+
+#include "compressed_trajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
+#ifdef NBODY_ZLIB
+#include <zlib.h>
+#endif
+
+namespace{
+
+// quantized values stay below 2^60 in magnitude, so predictions and differences fit in 63 bits
+constexpr double QUANTIZED_LIMIT = 1152921504606846976.0;
+
+// range coder: 11-bit probabilities, adapted by 1/32 of the distance each bit
+constexpr std::uint32_t PROBABILITY_BITS = 11U;
+constexpr std::uint32_t PROBABILITY_ONE = 1U << PROBABILITY_BITS;
+constexpr std::uint32_t ADAPT_SHIFT = 5U;
+constexpr std::uint32_t RANGE_TOP = 1U << 24;
+// byte contexts: position inside a varint, 0, 1, 2 or later
+constexpr std::size_t BYTE_CONTEXTS = 4;
+
+/**
+ * @brief FNV-1a hash of a byte range
+ *
+ * @param data first byte
+ * @param size byte count
+ * @return std::uint32_t
+ */
+std::uint32_t fnv1a(const unsigned char *data, std::size_t size){
+    std::uint32_t h = 2166136261U;
+    for(std::size_t i = 0; i < size; ++i){
+        h ^= data[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+/**
+ * @brief bit pattern of a double
+ *
+ * @param value value
+ * @return std::uint64_t
+ */
+std::uint64_t doubleBits(double value){
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/**
+ * @brief double with a bit pattern
+ *
+ * @param bits bit pattern
+ * @return double
+ */
+double bitsDouble(std::uint64_t bits){
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief append 8 bytes, little endian
+ *
+ * @param out byte stream
+ * @param bits value
+ */
+void putWord(std::vector<unsigned char> &out, std::uint64_t bits){
+    for(unsigned int k = 0; k < 8U; ++k){
+        out.push_back(static_cast<unsigned char>(bits >> (8U * k)));
+    }
+}
+
+/**
+ * @brief append a varint, 7 bits per byte, high bit = more bytes follow
+ *
+ * @param out byte stream
+ * @param value value
+ */
+void putVarint(std::vector<unsigned char> &out, std::uint64_t value){
+    while(value >= 0x80U){
+        out.push_back(static_cast<unsigned char>(value | 0x80U));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+/**
+ * @brief bounds-checked reader over a delta stream
+ *
+ */
+struct ByteCursor{
+    const unsigned char *at; // next byte
+    const unsigned char *end; // one past the last byte
+
+    /**
+     * @brief read 8 bytes, little endian
+     *
+     * @param bits set to the value
+     * @return true if there were 8 bytes
+     */
+    bool word(std::uint64_t &bits){
+        if(end - at < 8){
+            return false;
+        }
+        bits = 0;
+        for(unsigned int k = 0; k < 8U; ++k){
+            bits |= static_cast<std::uint64_t>(at[k]) << (8U * k);
+        }
+        at += 8;
+        return true;
+    }
+
+    /**
+     * @brief read a varint
+     *
+     * @param value set to the value
+     * @return true if a complete varint of at most 10 bytes was there
+     */
+    bool varint(std::uint64_t &value){
+        value = 0;
+        for(unsigned int shift = 0; shift < 64U; shift += 7U){
+            if(at == end){
+                return false;
+            }
+            const unsigned char byte = *at++;
+            value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+            if((byte & 0x80U) == 0U){
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief signed to unsigned, small magnitudes to small numbers: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+ *
+ * @param value signed value
+ * @return std::uint64_t
+ */
+std::uint64_t zigzag(long long value){
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+/**
+ * @brief inverse of zigzag()
+ *
+ * @param value unsigned value
+ * @return long long
+ */
+long long unzigzag(std::uint64_t value){
+    return static_cast<long long>((value >> 1) ^ (~(value & 1U) + 1U));
+}
+
+/**
+ * @brief predicted quantized value from the body's history in the block
+ *        none = 0, one frame = repeat it, two frames = extend the line through them
+ *
+ * @param history frames in the history, 0, 1 or 2
+ * @param last last value
+ * @param beforeLast value before it
+ * @return long long
+ */
+long long predict(unsigned char history, long long last, long long beforeLast){
+    if(history == 0U){
+        return 0;
+    }
+    if(history == 1U){
+        return last;
+    }
+    return 2 * last - beforeLast;
+}
+
+/**
+ * @brief per-frame layout derived from a header
+ *
+ */
+struct FrameShape{
+    std::size_t bodies; // N
+    bool energy; // frames carry E_total
+    std::size_t values; // 1 + 4 * N [+ 1]
+    double step[4]; // quantization step of x, y, vx, vy
+};
+
+/**
+ * @brief frame layout of a header
+ *
+ * @param header file header
+ * @return FrameShape
+ */
+FrameShape frameShape(const CompressedTrajectoryHeader &header){
+    FrameShape shape;
+    shape.bodies = static_cast<std::size_t>(header.bodyCount);
+    shape.energy = (header.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+    shape.values = 1U + 4U * shape.bodies + (shape.energy ? 1U : 0U);
+    shape.step[0] = 2.0 * header.positionError;
+    shape.step[1] = 2.0 * header.positionError;
+    shape.step[2] = 2.0 * header.velocityError;
+    shape.step[3] = 2.0 * header.velocityError;
+    return shape;
+}
+
+/**
+ * @brief adaptive binary range coder, bytes are coded as 8 bits down a 256 entry tree
+ *        the tree is picked by how many varint continuation bytes came right before
+ *
+ */
+class RangeEncoder{
+public:
+    /**
+     * @brief start coding into out
+     *
+     * @param out coded bytes are appended here
+     */
+    explicit RangeEncoder(std::vector<unsigned char> &out) : m_out(out), m_low(0), m_range(0xFFFFFFFFU), m_cache(0), m_cacheSize(1), m_context(0), m_probabilities(BYTE_CONTEXTS * 256U, static_cast<std::uint16_t>(PROBABILITY_ONE / 2U)){}
+
+    /**
+     * @brief code one byte
+     *
+     * @param byte byte
+     */
+    void encodeByte(unsigned char byte){
+        std::uint16_t *tree = m_probabilities.data() + m_context * 256U;
+        std::size_t node = 1;
+        for(int k = 7; k >= 0; --k){
+            const unsigned int bit = (static_cast<unsigned int>(byte) >> k) & 1U;
+            encodeBit(tree[node], bit);
+            node = node * 2U + bit;
+        }
+        m_context = (byte & 0x80U) != 0U ? std::min<std::size_t>(m_context + 1U, BYTE_CONTEXTS - 1U) : 0U;
+    }
+
+    /**
+     * @brief write out the last bytes of the code
+     *
+     */
+    void finish(){
+        for(int k = 0; k < 5; ++k){
+            shiftLow();
+        }
+    }
+
+private:
+    /**
+     * @brief code one bit with an adaptive probability
+     *
+     * @param probability probability of a 0, in PROBABILITY_ONE units, updated
+     * @param bit bit
+     */
+    void encodeBit(std::uint16_t &probability, unsigned int bit){
+        const std::uint32_t bound = (m_range >> PROBABILITY_BITS) * probability;
+        if(bit == 0U){
+            m_range = bound;
+            probability = static_cast<std::uint16_t>(probability + ((PROBABILITY_ONE - probability) >> ADAPT_SHIFT));
+        }
+        else{
+            m_low += bound;
+            m_range -= bound;
+            probability = static_cast<std::uint16_t>(probability - (probability >> ADAPT_SHIFT));
+        }
+        while(m_range < RANGE_TOP){
+            m_range <<= 8;
+            shiftLow();
+        }
+    }
+
+    /**
+     * @brief move the top byte of low out, holding back 0xFF bytes a carry could still change
+     *
+     */
+    void shiftLow(){
+        if(static_cast<std::uint32_t>(m_low) < 0xFF000000U || (m_low >> 32) != 0U){
+            const unsigned char carry = static_cast<unsigned char>(m_low >> 32);
+            unsigned char held = m_cache;
+            do{
+                m_out.push_back(static_cast<unsigned char>(held + carry));
+                held = 0xFFU;
+            } while(--m_cacheSize != 0U);
+            m_cache = static_cast<unsigned char>(m_low >> 24);
+        }
+        ++m_cacheSize;
+        m_low = (m_low & 0x00FFFFFFU) << 8;
+    }
+
+    std::vector<unsigned char> &m_out; // coded bytes
+    std::uint64_t m_low; // low end of the interval, bit 32 is a pending carry
+    std::uint32_t m_range; // interval width
+    unsigned char m_cache; // byte held back for a possible carry
+    std::uint64_t m_cacheSize; // held byte plus the 0xFF bytes after it
+    std::size_t m_context; // tree of the next byte
+    std::vector<std::uint16_t> m_probabilities; // BYTE_CONTEXTS trees of 256 probabilities
+};
+
+/**
+ * @brief decoder matching RangeEncoder
+ *
+ */
+class RangeDecoder{
+public:
+    /**
+     * @brief start decoding a coded range
+     *
+     * @param data first coded byte
+     * @param size coded byte count
+     */
+    RangeDecoder(const unsigned char *data, std::size_t size) : m_at(data), m_end(data + size), m_range(0xFFFFFFFFU), m_code(0), m_context(0), m_probabilities(BYTE_CONTEXTS * 256U, static_cast<std::uint16_t>(PROBABILITY_ONE / 2U)){
+        for(int k = 0; k < 5; ++k){
+            m_code = (m_code << 8) | nextByte();
+        }
+    }
+
+    /**
+     * @brief decode one byte
+     *
+     * @return unsigned char
+     */
+    unsigned char decodeByte(){
+        std::uint16_t *tree = m_probabilities.data() + m_context * 256U;
+        std::size_t node = 1;
+        for(int k = 0; k < 8; ++k){
+            node = node * 2U + decodeBit(tree[node]);
+        }
+        const unsigned char byte = static_cast<unsigned char>(node - 256U);
+        m_context = (byte & 0x80U) != 0U ? std::min<std::size_t>(m_context + 1U, BYTE_CONTEXTS - 1U) : 0U;
+        return byte;
+    }
+
+private:
+    /**
+     * @brief decode one bit with an adaptive probability
+     *
+     * @param probability probability of a 0, updated as the encoder did
+     * @return unsigned int bit
+     */
+    unsigned int decodeBit(std::uint16_t &probability){
+        const std::uint32_t bound = (m_range >> PROBABILITY_BITS) * probability;
+        unsigned int bit = 0;
+        if(m_code < bound){
+            m_range = bound;
+            probability = static_cast<std::uint16_t>(probability + ((PROBABILITY_ONE - probability) >> ADAPT_SHIFT));
+        }
+        else{
+            m_code -= bound;
+            m_range -= bound;
+            probability = static_cast<std::uint16_t>(probability - (probability >> ADAPT_SHIFT));
+            bit = 1U;
+        }
+        while(m_range < RANGE_TOP){
+            m_range <<= 8;
+            m_code = (m_code << 8) | nextByte();
+        }
+        return bit;
+    }
+
+    /**
+     * @brief next coded byte, 0 past the end, a corrupt block then fails its checksum
+     *
+     * @return std::uint32_t
+     */
+    std::uint32_t nextByte(){
+        return m_at < m_end ? *m_at++ : 0U;
+    }
+
+    const unsigned char *m_at; // next coded byte
+    const unsigned char *m_end; // one past the last coded byte
+    std::uint32_t m_range; // interval width
+    std::uint32_t m_code; // coded value minus the low end of the interval
+    std::size_t m_context; // tree of the next byte
+    std::vector<std::uint16_t> m_probabilities; // BYTE_CONTEXTS trees of 256 probabilities
+};
+
+/**
+ * @brief entropy code a delta stream
+ *
+ * @param codec codec
+ * @param raw delta stream
+ * @param out set to the coded bytes
+ * @return true if the codec is available and succeeded
+ */
+bool compressBytes(TrajectoryCodec codec, const std::vector<unsigned char> &raw, std::vector<unsigned char> &out){
+    out.clear();
+    if(codec == TrajectoryCodec::Builtin){
+        out.reserve(raw.size() / 2U + 16U);
+        RangeEncoder encoder(out);
+        for(std::size_t i = 0; i < raw.size(); ++i){
+            encoder.encodeByte(raw[i]);
+        }
+        encoder.finish();
+        return true;
+    }
+#ifdef NBODY_ZLIB
+    if(codec == TrajectoryCodec::Zlib){
+        uLongf size = compressBound(static_cast<uLong>(raw.size()));
+        out.resize(static_cast<std::size_t>(size));
+        if(compress2(out.data(), &size, raw.data(), static_cast<uLong>(raw.size()), 6) != Z_OK){
+            return false;
+        }
+        out.resize(static_cast<std::size_t>(size));
+        return true;
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief decode an entropy coded block
+ *
+ * @param codec codec
+ * @param data coded bytes
+ * @param size coded byte count
+ * @param rawBytes size of the delta stream
+ * @param out set to the delta stream
+ * @return true if the codec is available and the data decoded to rawBytes bytes
+ */
+bool decompressBytes(TrajectoryCodec codec, const unsigned char *data, std::size_t size, std::size_t rawBytes, std::vector<unsigned char> &out){
+    out.resize(rawBytes);
+    if(codec == TrajectoryCodec::Builtin){
+        RangeDecoder decoder(data, size);
+        for(std::size_t i = 0; i < rawBytes; ++i){
+            out[i] = decoder.decodeByte();
+        }
+        return true;
+    }
+#ifdef NBODY_ZLIB
+    if(codec == TrajectoryCodec::Zlib){
+        uLongf length = static_cast<uLongf>(rawBytes);
+        return uncompress(out.data(), &length, data, static_cast<uLong>(size)) == Z_OK && length == static_cast<uLongf>(rawBytes);
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief decode the delta stream of a block into frames, the inverse of TrajectoryCompressor::addFrame
+ *
+ * @param header file header
+ * @param raw delta stream
+ * @param frames frames in the block
+ * @param out set to frames * valuesPerFrame values
+ * @return true if the stream held exactly that many frames
+ */
+bool decodeFrames(const CompressedTrajectoryHeader &header, const std::vector<unsigned char> &raw, std::size_t frames, std::vector<double> &out){
+    const FrameShape shape = frameShape(header);
+    const std::size_t N = shape.bodies;
+    std::vector<long long> last(4U * N, 0);
+    std::vector<long long> beforeLast(4U * N, 0);
+    std::vector<unsigned char> history(N, 0U);
+    std::vector<unsigned char> present(N, 1U);
+    std::uint64_t lastTime = 0;
+    std::uint64_t lastEnergy = 0;
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    out.resize(frames * shape.values);
+
+    ByteCursor in{raw.data(), raw.data() + raw.size()};
+    for(std::size_t f = 0; f < frames; ++f){
+        double *values = out.data() + f * shape.values;
+        if(in.at == in.end){
+            return false;
+        }
+        const unsigned char flags = *in.at++;
+        if((flags & 1U) != 0U){
+            const std::size_t maskBytes = (N + 7U) / 8U;
+            if(static_cast<std::size_t>(in.end - in.at) < maskBytes){
+                return false;
+            }
+            for(std::size_t b = 0; b < N; ++b){
+                present[b] = static_cast<unsigned char>((in.at[b / 8U] >> (b % 8U)) & 1U);
+            }
+            in.at += maskBytes;
+        }
+        else{
+            std::fill(present.begin(), present.end(), static_cast<unsigned char>(1U));
+        }
+
+        std::uint64_t bits = 0;
+        if(!in.word(bits)){
+            return false;
+        }
+        lastTime ^= bits;
+        values[0] = bitsDouble(lastTime);
+
+        for(std::size_t c = 0; c < 4U; ++c){
+            for(std::size_t b = 0; b < N; ++b){
+                const std::size_t k = c * N + b;
+                if(present[b] == 0U){
+                    values[1U + 4U * b + c] = missing;
+                    continue;
+                }
+                std::uint64_t coded = 0;
+                if(!in.varint(coded)){
+                    return false;
+                }
+                const long long q = predict(history[b], last[k], beforeLast[k]) + unzigzag(coded);
+                beforeLast[k] = last[k];
+                last[k] = q;
+                values[1U + 4U * b + c] = static_cast<double>(q) * shape.step[c];
+            }
+        }
+        for(std::size_t b = 0; b < N; ++b){
+            history[b] = present[b] != 0U ? static_cast<unsigned char>(std::min(history[b] + 1, 2)) : static_cast<unsigned char>(0U);
+        }
+
+        if(shape.energy){
+            if(!in.word(bits)){
+                return false;
+            }
+            lastEnergy ^= bits;
+            values[shape.values - 1U] = bitsDouble(lastEnergy);
+        }
+    }
+    return in.at == in.end;
+}
+
+}
+
+/**
+ * @brief codec new files are written with, Zlib when the build has it, Builtin otherwise
+ *
+ * @return TrajectoryCodec
+ */
+TrajectoryCodec defaultTrajectoryCodec(){
+#ifdef NBODY_ZLIB
+    return TrajectoryCodec::Zlib;
+#else
+    return TrajectoryCodec::Builtin;
+#endif
+}
+
+/**
+ * @brief whether this build can read and write a codec
+ *
+ * @param codec codec to check
+ * @return true if available
+ */
+bool trajectoryCodecAvailable(TrajectoryCodec codec){
+#ifdef NBODY_ZLIB
+    if(codec == TrajectoryCodec::Zlib){
+        return true;
+    }
+#endif
+    return codec == TrajectoryCodec::Builtin;
+}
+
+/**
+ * @brief name of a codec for messages
+ *
+ * @param codec codec
+ * @return const char* "builtin", "zlib" or "unknown"
+ */
+const char *trajectoryCodecName(TrajectoryCodec codec){
+    if(codec == TrajectoryCodec::Builtin){
+        return "builtin";
+    }
+    if(codec == TrajectoryCodec::Zlib){
+        return "zlib";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief fill a header for a run
+ *
+ * @param precisionCode 0 = float, 1 = double, 2 = long double
+ * @param bodyCount number of bodies
+ * @param includeEnergy frames carry E_total
+ * @param outputEvery steps between frames
+ * @param dt time step
+ * @param positionError absolute error bound of positions, > 0
+ * @param velocityError absolute error bound of velocities, > 0
+ * @param keyframeEvery most frames per block, > 0
+ * @return CompressedTrajectoryHeader
+ */
+CompressedTrajectoryHeader makeCompressedTrajectoryHeader(std::uint32_t precisionCode, std::uint64_t bodyCount, bool includeEnergy, std::uint64_t outputEvery, double dt, double positionError, double velocityError, std::uint32_t keyframeEvery){
+    CompressedTrajectoryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "NBODYCTJ", 8);
+    header.version = COMPRESSED_TRAJECTORY_VERSION;
+    header.headerBytes = static_cast<std::uint32_t>(sizeof(CompressedTrajectoryHeader));
+    header.precision = precisionCode;
+    header.codec = static_cast<std::uint32_t>(defaultTrajectoryCodec());
+    header.fields = static_cast<std::uint32_t>(TrajectoryField::Time) | static_cast<std::uint32_t>(TrajectoryField::Position) | static_cast<std::uint32_t>(TrajectoryField::Velocity);
+    if(includeEnergy){
+        header.fields |= static_cast<std::uint32_t>(TrajectoryField::Energy);
+    }
+    header.keyframeEvery = keyframeEvery;
+    header.bodyCount = bodyCount;
+    header.outputEvery = outputEvery;
+    header.dt = dt;
+    header.positionError = positionError;
+    header.velocityError = velocityError;
+    return header;
+}
+
+/**
+ * @brief construct a compressor with no header, begin() must come first
+ *
+ */
+TrajectoryCompressor::TrajectoryCompressor() : m_header(), m_raw(), m_frames(0), m_last(), m_beforeLast(), m_history(), m_quantized(), m_present(), m_lastTime(0), m_lastEnergy(0){
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+/**
+ * @brief start a file, drops any open block
+ *
+ * @param header header the file was written with
+ */
+void TrajectoryCompressor::begin(const CompressedTrajectoryHeader &header){
+    m_header = header;
+    const std::size_t N = static_cast<std::size_t>(header.bodyCount);
+    m_raw.clear();
+    m_frames = 0;
+    m_last.assign(4U * N, 0);
+    m_beforeLast.assign(4U * N, 0);
+    m_history.assign(N, 0U);
+    m_quantized.assign(4U * N, 0);
+    m_present.assign(N, 0U);
+    m_lastTime = 0;
+    m_lastEnergy = 0;
+}
+
+/**
+ * @brief quantize a frame and append it to the open block
+ *
+ * @param values 1 + 4 * N [+ 1] values in binary frame order
+ */
+void TrajectoryCompressor::addFrame(const double *values){
+    const FrameShape shape = frameShape(m_header);
+    const std::size_t N = shape.bodies;
+
+    // a body is stored only if all four values are finite and quantize below the limit
+    bool anyMissing = false;
+    for(std::size_t b = 0; b < N; ++b){
+        bool ok = true;
+        for(std::size_t c = 0; c < 4U; ++c){
+            const double scaled = values[1U + 4U * b + c] / shape.step[c];
+            if(!(std::fabs(scaled) < QUANTIZED_LIMIT)){
+                ok = false;
+                break;
+            }
+            m_quantized[c * N + b] = std::llround(scaled);
+        }
+        m_present[b] = ok ? 1U : 0U;
+        anyMissing = anyMissing || !ok;
+    }
+
+    m_raw.push_back(anyMissing ? 1U : 0U);
+    if(anyMissing){
+        const std::size_t first = m_raw.size();
+        m_raw.resize(first + (N + 7U) / 8U, 0U);
+        for(std::size_t b = 0; b < N; ++b){
+            if(m_present[b] != 0U){
+                m_raw[first + b / 8U] = static_cast<unsigned char>(m_raw[first + b / 8U] | (1U << (b % 8U)));
+            }
+        }
+    }
+
+    const std::uint64_t timeBits = doubleBits(values[0]);
+    putWord(m_raw, timeBits ^ m_lastTime);
+    m_lastTime = timeBits;
+
+    // component-major, all x differences, then all y, ..., similar magnitudes sit together
+    for(std::size_t c = 0; c < 4U; ++c){
+        for(std::size_t b = 0; b < N; ++b){
+            if(m_present[b] == 0U){
+                continue;
+            }
+            const std::size_t k = c * N + b;
+            const long long q = m_quantized[k];
+            putVarint(m_raw, zigzag(q - predict(m_history[b], m_last[k], m_beforeLast[k])));
+            m_beforeLast[k] = m_last[k];
+            m_last[k] = q;
+        }
+    }
+    for(std::size_t b = 0; b < N; ++b){
+        m_history[b] = m_present[b] != 0U ? static_cast<unsigned char>(std::min(m_history[b] + 1, 2)) : static_cast<unsigned char>(0U);
+    }
+
+    if(shape.energy){
+        const std::uint64_t energyBits = doubleBits(values[shape.values - 1U]);
+        putWord(m_raw, energyBits ^ m_lastEnergy);
+        m_lastEnergy = energyBits;
+    }
+    ++m_frames;
+}
+
+/**
+ * @brief returns frames in the open block
+ *
+ * @return std::size_t
+ */
+std::size_t TrajectoryCompressor::pendingFrames() const{
+    return m_frames;
+}
+
+/**
+ * @brief whether the open block holds keyframeEvery frames
+ *
+ * @return true if it should be finished
+ */
+bool TrajectoryCompressor::blockFull() const{
+    return m_frames >= m_header.keyframeEvery;
+}
+
+/**
+ * @brief entropy code the open block and append header and data to out, nothing without frames
+ *
+ * @param out bytes to append the block to
+ */
+void TrajectoryCompressor::finishBlock(std::vector<unsigned char> &out){
+    if(m_frames == 0){
+        return;
+    }
+    std::vector<unsigned char> coded;
+    const bool compressed = compressBytes(static_cast<TrajectoryCodec>(m_header.codec), m_raw, coded) && coded.size() < m_raw.size();
+    const std::vector<unsigned char> &stored = compressed ? coded : m_raw;
+
+    CompressedBlockHeader block;
+    block.frames = static_cast<std::uint32_t>(m_frames);
+    block.rawBytes = static_cast<std::uint32_t>(m_raw.size());
+    block.storedBytes = static_cast<std::uint32_t>(stored.size());
+    block.checksum = fnv1a(m_raw.data(), m_raw.size());
+    const unsigned char *blockBytes = reinterpret_cast<const unsigned char *>(&block);
+    out.insert(out.end(), blockBytes, blockBytes + sizeof(block));
+    out.insert(out.end(), stored.begin(), stored.end());
+
+    // the next frame is a keyframe
+    m_raw.clear();
+    m_frames = 0;
+    std::fill(m_history.begin(), m_history.end(), static_cast<unsigned char>(0U));
+    m_lastTime = 0;
+    m_lastEnergy = 0;
+}
+
+/**
+ * @brief construct a closed reader
+ *
+ */
+CompressedTrajectoryReader::CompressedTrajectoryReader() : m_file(), m_header(), m_blockOffsets(), m_blockFrames(), m_cachedBlock(0), m_cache(), m_raw(){
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+/**
+ * @brief map a file, check its header and index its blocks
+ *
+ * @param path compressed trajectory file
+ * @param err stream for error messages
+ * @return true if the file is a valid compressed trajectory
+ * @return false otherwise
+ */
+bool CompressedTrajectoryReader::open(const std::string &path, std::ostream &err){
+    close();
+    if(!m_file.open(path)){
+        err << "Could not open trajectory file " << path << ".\n";
+        return false;
+    }
+    if(m_file.size() < sizeof(CompressedTrajectoryHeader)){
+        err << "Trajectory file " << path << " is too short for a header.\n";
+        close();
+        return false;
+    }
+    std::memcpy(&m_header, m_file.data(), sizeof(CompressedTrajectoryHeader));
+    if(std::memcmp(m_header.magic, "NBODYCTJ", 8) != 0){
+        err << path << " is not a compressed trajectory file.\n";
+        close();
+        return false;
+    }
+    if(m_header.version != COMPRESSED_TRAJECTORY_VERSION){
+        err << path << " has unsupported format version " << m_header.version << ".\n";
+        close();
+        return false;
+    }
+    if(m_header.headerBytes < sizeof(CompressedTrajectoryHeader) || m_header.headerBytes > m_file.size() || m_header.keyframeEvery == 0U || !(m_header.positionError > 0.0) || !(m_header.velocityError > 0.0)){
+        err << path << " has an inconsistent header.\n";
+        close();
+        return false;
+    }
+    if(!trajectoryCodecAvailable(static_cast<TrajectoryCodec>(m_header.codec))){
+        err << path << " uses the " << trajectoryCodecName(static_cast<TrajectoryCodec>(m_header.codec)) << " codec, which this build does not have.\n";
+        close();
+        return false;
+    }
+
+    // walk the block headers, a block running past the end of the file was torn by a crash
+    const std::uint64_t size = m_file.size();
+    std::uint64_t offset = m_header.headerBytes;
+    std::size_t frames = 0;
+    while(size - offset >= sizeof(CompressedBlockHeader)){
+        CompressedBlockHeader block;
+        std::memcpy(&block, m_file.data() + offset, sizeof(block));
+        if(block.frames == 0U || block.frames > m_header.keyframeEvery || block.storedBytes > size - offset - sizeof(block)){
+            break;
+        }
+        m_blockOffsets.push_back(offset);
+        m_blockFrames.push_back(frames);
+        offset += sizeof(block) + block.storedBytes;
+        frames += block.frames;
+    }
+    m_blockOffsets.push_back(offset);
+    m_blockFrames.push_back(frames);
+    m_cachedBlock = blockCount();
+    return true;
+}
+
+/**
+ * @brief unmap and release the file
+ *
+ */
+void CompressedTrajectoryReader::close(){
+    m_file.close();
+    m_blockOffsets.clear();
+    m_blockFrames.clear();
+    m_cachedBlock = 0;
+    m_cache.clear();
+}
+
+/**
+ * @brief header of the open file
+ *
+ * @return const CompressedTrajectoryHeader&
+ */
+const CompressedTrajectoryHeader &CompressedTrajectoryReader::header() const{
+    return m_header;
+}
+
+/**
+ * @brief number of frames in complete blocks
+ *
+ * @return std::size_t
+ */
+std::size_t CompressedTrajectoryReader::frameCount() const{
+    return m_blockFrames.empty() ? 0 : m_blockFrames.back();
+}
+
+/**
+ * @brief number of values in one frame, 1 + 4 * N [+ 1]
+ *
+ * @return std::size_t
+ */
+std::size_t CompressedTrajectoryReader::valuesPerFrame() const{
+    return frameShape(m_header).values;
+}
+
+/**
+ * @brief number of complete blocks
+ *
+ * @return std::size_t
+ */
+std::size_t CompressedTrajectoryReader::blockCount() const{
+    return m_blockOffsets.empty() ? 0 : m_blockOffsets.size() - 1U;
+}
+
+/**
+ * @brief file offset of block b, blockOffset(blockCount()) = end of the last complete block
+ *
+ * @param b block index, at most blockCount()
+ * @return std::uint64_t
+ */
+std::uint64_t CompressedTrajectoryReader::blockOffset(std::size_t b) const{
+    return m_blockOffsets[b];
+}
+
+/**
+ * @brief index of the first frame of block b, blockFirstFrame(blockCount()) = frameCount()
+ *
+ * @param b block index, at most blockCount()
+ * @return std::size_t
+ */
+std::size_t CompressedTrajectoryReader::blockFirstFrame(std::size_t b) const{
+    return m_blockFrames[b];
+}
+
+/**
+ * @brief values of frame k, decoding its block if it is not the cached one
+ *
+ * @param k frame index, less than frameCount()
+ * @param err stream for error messages
+ * @return const double* valuesPerFrame() values, null if the block is corrupt
+ */
+const double *CompressedTrajectoryReader::frame(std::size_t k, std::ostream &err){
+    if(k >= frameCount()){
+        return nullptr;
+    }
+    // last block starting at or before k
+    const std::size_t b = static_cast<std::size_t>(std::upper_bound(m_blockFrames.begin(), m_blockFrames.end() - 1, k) - m_blockFrames.begin()) - 1U;
+    if(b != m_cachedBlock){
+        m_cachedBlock = blockCount();
+        CompressedBlockHeader block;
+        const char *at = m_file.data() + m_blockOffsets[b];
+        std::memcpy(&block, at, sizeof(block));
+        const unsigned char *stored = reinterpret_cast<const unsigned char *>(at + sizeof(block));
+        bool ok = true;
+        if(block.storedBytes == block.rawBytes){
+            m_raw.assign(stored, stored + block.storedBytes);
+        }
+        else{
+            ok = decompressBytes(static_cast<TrajectoryCodec>(m_header.codec), stored, block.storedBytes, block.rawBytes, m_raw);
+        }
+        ok = ok && fnv1a(m_raw.data(), m_raw.size()) == block.checksum && decodeFrames(m_header, m_raw, block.frames, m_cache);
+        if(!ok){
+            err << "Block " << b << " of the trajectory is corrupt.\n";
+            return nullptr;
+        }
+        m_cachedBlock = b;
+    }
+    return m_cache.data() + (k - m_blockFrames[b]) * valuesPerFrame();
+}
@@ -0,0 +1,255 @@
+// densitymap2d class, screen-resolution histogram of body positions with log scaling and a colormap
+
+#include "density_map2d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace{
+
+// colormap anchors, black through purple and orange to pale yellow, spaced evenly over 0..255
+constexpr unsigned char COLORMAP_ANCHORS[][3] = {
+    {0, 0, 4},
+    {40, 11, 84},
+    {101, 21, 110},
+    {159, 42, 99},
+    {212, 72, 66},
+    {245, 125, 21},
+    {250, 193, 39},
+    {252, 255, 164}
+};
+
+/**
+ * @brief run body(begin, end) over [0, n) on the pool, or on the calling thread without one
+ *
+ * @param pool worker threads, may be null
+ * @param n range size
+ * @param grain smallest chunk
+ * @param body function taking a chunk
+ */
+void forRanges(ThreadPool *pool, std::size_t n, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body){
+    if(pool){
+        pool->parallelFor(0, n, grain, body);
+    }
+    else if(n > 0){
+        body(0, n);
+    }
+}
+
+}
+
+/**
+ * @brief construct an image of width x height pixels, histograms are allocated by the first bin()
+ *
+ * @param width image width in pixels
+ * @param height image height in pixels
+ * @param viewScale pixels per simulation length unit
+ */
+template<typename T>
+DensityMap2D<T>::DensityMap2D(std::size_t width, std::size_t height, float viewScale) : m_width(width), m_height(height), m_viewScale(viewScale), m_massWeighted(false), m_maxDensity(0.0f), m_bands(), m_pixels(width * height * 4U, 0U), m_colormap(256U * 3U){
+    const std::size_t segments = sizeof(COLORMAP_ANCHORS) / sizeof(COLORMAP_ANCHORS[0]) - 1U;
+    for(std::size_t k = 0; k < 256U; ++k){
+        const float t = static_cast<float>(k) / 255.0f * static_cast<float>(segments);
+        const std::size_t s = std::min(segments - 1U, static_cast<std::size_t>(t));
+        const float f = t - static_cast<float>(s);
+        for(std::size_t c = 0; c < 3U; ++c){
+            const float lo = static_cast<float>(COLORMAP_ANCHORS[s][c]);
+            const float hi = static_cast<float>(COLORMAP_ANCHORS[s + 1U][c]);
+            m_colormap[k * 3U + c] = static_cast<std::uint8_t>(lo + (hi - lo) * f + 0.5f);
+        }
+    }
+    // opaque black until the first colorize()
+    for(std::size_t p = 0; p < width * height; ++p){
+        m_pixels[p * 4U + 3U] = 255U;
+    }
+}
+
+/**
+ * @brief set whether pixels sum masses instead of counting bodies
+ *
+ * @param massWeighted true to sum masses
+ */
+template<typename T>
+void DensityMap2D<T>::setMassWeighted(bool massWeighted){
+    m_massWeighted = massWeighted;
+}
+
+/**
+ * @brief Get whether pixels sum masses
+ *
+ * @return true if mass weighted
+ */
+template<typename T>
+bool DensityMap2D<T>::getMassWeighted() const{
+    return m_massWeighted;
+}
+
+/**
+ * @brief rebuild the histogram from the current positions
+ *        bodies off the image or with a non-finite position are left out
+ *
+ * @param bodies bodies to bin
+ * @param pool worker threads, null = calling thread only
+ */
+template<typename T>
+void DensityMap2D<T>::bin(const std::vector<Body2D<T>> &bodies, ThreadPool *pool){
+    const std::size_t n = bodies.size();
+    const std::size_t P = m_width * m_height;
+
+    // scatter writes collide between threads, each band gets its own histogram once there are
+    // enough bodies per pixel to pay for adding the histograms up
+    std::size_t bands = 1;
+    if(pool && pool->threadCount() > 1){
+        bands = std::max<std::size_t>(1, std::min(pool->threadCount(), n / std::max<std::size_t>(1, P / PIXELS_PER_BAND_BODY)));
+    }
+    m_bands.assign(bands * P, 0.0f);
+
+    const float scale = m_viewScale;
+    const float cx = static_cast<float>(m_width) / 2.0f;
+    const float cy = static_cast<float>(m_height) / 2.0f;
+    const float w = static_cast<float>(m_width);
+    const float h = static_cast<float>(m_height);
+    const bool massWeighted = m_massWeighted;
+    const auto binBand = [&](std::size_t k){
+        float *histogram = m_bands.data() + k * P;
+        const std::size_t end = n * (k + 1) / bands;
+        for(std::size_t i = n * k / bands; i < end; ++i){
+            const float sx = static_cast<float>(bodies[i].r.x) * scale + cx;
+            const float sy = cy - static_cast<float>(bodies[i].r.y) * scale;
+            // also false for nan
+            if(!(sx >= 0.0f && sx < w && sy >= 0.0f && sy < h)){
+                continue;
+            }
+            const std::size_t p = static_cast<std::size_t>(sy) * m_width + static_cast<std::size_t>(sx);
+            histogram[p] += massWeighted ? static_cast<float>(bodies[i].m) : 1.0f;
+        }
+    };
+    if(bands > 1){
+        pool->run(bands, binBand);
+    }
+    else{
+        binBand(0);
+    }
+
+    // add the other bands into band 0
+    if(bands > 1){
+        forRanges(pool, P, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            float *total = m_bands.data();
+            for(std::size_t k = 1; k < bands; ++k){
+                const float *histogram = m_bands.data() + k * P;
+                for(std::size_t p = begin; p < end; ++p){
+                    total[p] += histogram[p];
+                }
+            }
+        });
+    }
+}
+
+/**
+ * @brief map the histogram of the last bin() to RGBA pixels
+ *
+ * @param pool worker threads, null = calling thread only
+ */
+template<typename T>
+void DensityMap2D<T>::colorize(ThreadPool *pool){
+    const std::size_t P = m_width * m_height;
+    if(m_bands.size() < P){
+        m_bands.assign(P, 0.0f);
+    }
+    const float *total = m_bands.data();
+
+    // smallest and largest non-empty pixel, per chunk then combined
+    const std::size_t chunks = (P + PIXEL_GRAIN - 1) / PIXEL_GRAIN;
+    std::vector<float> chunkMin(chunks, 0.0f);
+    std::vector<float> chunkMax(chunks, 0.0f);
+    forRanges(pool, chunks, 1, [&](std::size_t chunkBegin, std::size_t chunkEnd){
+        for(std::size_t c = chunkBegin; c < chunkEnd; ++c){
+            float lo = 0.0f;
+            float hi = 0.0f;
+            const std::size_t end = std::min(P, (c + 1) * PIXEL_GRAIN);
+            for(std::size_t p = c * PIXEL_GRAIN; p < end; ++p){
+                const float v = total[p];
+                if(v > 0.0f){
+                    lo = (lo > 0.0f) ? std::min(lo, v) : v;
+                    hi = std::max(hi, v);
+                }
+            }
+            chunkMin[c] = lo;
+            chunkMax[c] = hi;
+        }
+    });
+    float lo = 0.0f;
+    float hi = 0.0f;
+    for(std::size_t c = 0; c < chunks; ++c){
+        if(chunkMin[c] > 0.0f){
+            lo = (lo > 0.0f) ? std::min(lo, chunkMin[c]) : chunkMin[c];
+        }
+        hi = std::max(hi, chunkMax[c]);
+    }
+    m_maxDensity = hi;
+
+    // log(1 + v / lo) / log(1 + hi / lo), a single body is the faintest color but never black
+    const float invLo = (lo > 0.0f) ? 1.0f / lo : 0.0f;
+    const float range = std::log1p(hi * invLo);
+    const float invRange = (range > 0.0f) ? 254.0f / range : 0.0f;
+    forRanges(pool, P, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end){
+        for(std::size_t p = begin; p < end; ++p){
+            const float v = total[p];
+            std::size_t index = 0;
+            if(v > 0.0f){
+                index = std::min<std::size_t>(255U, 1U + static_cast<std::size_t>(std::log1p(v * invLo) * invRange));
+            }
+            std::uint8_t *pixel = m_pixels.data() + p * 4U;
+            const std::uint8_t *color = m_colormap.data() + index * 3U;
+            pixel[0] = color[0];
+            pixel[1] = color[1];
+            pixel[2] = color[2];
+        }
+    });
+}
+
+/**
+ * @brief returns RGBA pixels of the last colorize(), row-major, top row first
+ *
+ * @return const std::vector<std::uint8_t>& width * height * 4 bytes
+ */
+template<typename T>
+const std::vector<std::uint8_t> &DensityMap2D<T>::pixels() const{
+    return m_pixels;
+}
+
+/**
+ * @brief returns image width in pixels
+ *
+ * @return std::size_t width
+ */
+template<typename T>
+std::size_t DensityMap2D<T>::width() const{
+    return m_width;
+}
+
+/**
+ * @brief returns image height in pixels
+ *
+ * @return std::size_t height
+ */
+template<typename T>
+std::size_t DensityMap2D<T>::height() const{
+    return m_height;
+}
+
+/**
+ * @brief returns largest pixel value of the last colorize(), bodies or mass
+ *
+ * @return float maximum
+ */
+template<typename T>
+float DensityMap2D<T>::maxDensity() const{
+    return m_maxDensity;
+}
+
+// precisions selectable through the precision config key
+template class DensityMap2D<float>;
+template class DensityMap2D<double>;
+template class DensityMap2D<long double>;
@@ -0,0 +1,579 @@
+// fmmsolver2d class, fast multipole method for O(n) forces
+
+#include "fmm2d.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief construct a solver with expansion order 4
+ *
+ */
+template<typename T>
+FmmSolver2D<T>::FmmSolver2D() : m_expansionOrder(0), m_coeffs(0), m_eps2(static_cast<T>(0)), m_theta(static_cast<T>(0.5)), m_invFactorial(), m_hermite(), m_nodes(), m_order(), m_multipoles(), m_locals(), m_psi(), m_grad(){
+    setOrder(4);
+}
+
+/**
+ * @brief set expansion order p, clamped to [1, MAX_ORDER]
+ *        error falls roughly like theta^(p+1)
+ *
+ * @param order highest derivative kept in the expansions
+ */
+template<typename T>
+void FmmSolver2D<T>::setOrder(int order){
+    m_expansionOrder = std::max(1, std::min(order, MAX_ORDER));
+    const std::size_t p = static_cast<std::size_t>(m_expansionOrder);
+    m_coeffs = (p + 1) * (p + 2) / 2;
+
+    // a! and 1 / a!
+    std::vector<T> factorial(p + 1, static_cast<T>(1));
+    for(std::size_t a = 1; a <= p; ++a){
+        factorial[a] = factorial[a - 1] * static_cast<T>(a);
+    }
+    m_invFactorial.assign(p + 1, static_cast<T>(1));
+    for(std::size_t a = 0; a <= p; ++a){
+        m_invFactorial[a] = static_cast<T>(1) / factorial[a];
+    }
+
+    // coefficients of d^a/dx^a h(x^2 / 2) = sum_k c(a, k) x^(a - 2k) h^(a - k)
+    m_hermite.assign((p + 1) * (p + 1), static_cast<T>(0));
+    for(std::size_t a = 0; a <= p; ++a){
+        T twoPow = static_cast<T>(1);
+        for(std::size_t k = 0; 2 * k <= a; ++k){
+            m_hermite[a * (p + 1) + k] = factorial[a] / (twoPow * factorial[k] * factorial[a - 2 * k]);
+            twoPow *= static_cast<T>(2);
+        }
+    }
+}
+
+/**
+ * @brief Get expansion order
+ *
+ * @return int
+ */
+template<typename T>
+int FmmSolver2D<T>::getOrder() const{
+    return m_expansionOrder;
+}
+
+/**
+ * @brief position of coefficient (a, b) in a packed expansion
+ *
+ * @param a power of x
+ * @param b power of y
+ * @return std::size_t index
+ */
+template<typename T>
+std::size_t FmmSolver2D<T>::coeffIndex(int a, int b){
+    const std::size_t n = static_cast<std::size_t>(a + b);
+    return n * (n + 1) / 2 + static_cast<std::size_t>(b);
+}
+
+/**
+ * @brief build tree and evaluate potential and its gradient at every body
+ *        results stay in the solver until the next evaluate()
+ *
+ * @param bodies bodies acting as sources and targets
+ * @param eps2 softening value added to r^2
+ * @param theta separation parameter for M2L
+ */
+template<typename T>
+void FmmSolver2D<T>::evaluate(const BodyArrays2D<T> &bodies, T eps2, T theta){
+    m_eps2 = eps2;
+    m_theta = theta;
+
+    const std::size_t n = bodies.size();
+    m_nodes.clear();
+    m_multipoles.clear();
+    m_order.resize(n);
+    for(std::size_t i = 0; i < n; ++i){
+        m_order[i] = i;
+    }
+    m_psi.assign(n, static_cast<T>(0));
+    m_grad.assign(n, Vec2<T>());
+    if(n == 0){
+        return;
+    }
+
+    // bounding box of all bodies
+    T minX = bodies.x[0];
+    T maxX = bodies.x[0];
+    T minY = bodies.y[0];
+    T maxY = bodies.y[0];
+    for(std::size_t i = 1; i < n; ++i){
+        minX = std::min(minX, bodies.x[i]);
+        maxX = std::max(maxX, bodies.x[i]);
+        minY = std::min(minY, bodies.y[i]);
+        maxY = std::max(maxY, bodies.y[i]);
+    }
+    T halfSize = static_cast<T>(0.5) * std::max(maxX - minX, maxY - minY);
+    if(halfSize <= static_cast<T>(0)){
+        halfSize = static_cast<T>(1);
+    }
+
+    Node root;
+    root.center = Vec2<T>(static_cast<T>(0.5) * (minX + maxX), static_cast<T>(0.5) * (minY + maxY));
+    root.halfSize = halfSize;
+    root.mass = static_cast<T>(0);
+    root.com = root.center;
+    root.radius = static_cast<T>(0);
+    root.begin = 0;
+    root.end = n;
+    root.firstChild = 0;
+    m_nodes.push_back(root);
+    m_multipoles.assign(m_coeffs, static_cast<T>(0));
+
+    // upward pass happens while the tree is built
+    buildNode(0, bodies, 0);
+
+    // far field into local expansions, near field directly
+    m_locals.assign(m_nodes.size() * m_coeffs, static_cast<T>(0));
+    interact(0, 0, bodies);
+
+    downwardPass(bodies);
+}
+
+/**
+ * @brief recursively split a cell, then compute mass, com, radius and multipoles (P2M, M2M)
+ *
+ * @param nodeIndex index of cell in m_nodes
+ * @param bodies bodies being sorted into the tree
+ * @param depth depth of the cell, root = 0
+ */
+template<typename T>
+void FmmSolver2D<T>::buildNode(std::size_t nodeIndex, const BodyArrays2D<T> &bodies, int depth){
+    const std::size_t begin = m_nodes[nodeIndex].begin;
+    const std::size_t end = m_nodes[nodeIndex].end;
+    const int p = m_expansionOrder;
+
+    T mass = static_cast<T>(0);
+    T mx = static_cast<T>(0);
+    T my = static_cast<T>(0);
+
+    if(end - begin > LEAF_CAPACITY && depth < MAX_DEPTH){
+        const Vec2<T> c = m_nodes[nodeIndex].center;
+        const T quarter = static_cast<T>(0.5) * m_nodes[nodeIndex].halfSize;
+
+        // same quadrant split as the Barnes-Hut tree
+        const std::vector<std::size_t>::iterator first = m_order.begin();
+        const auto below = [&](std::size_t k){ return bodies.y[k] < c.y; };
+        const auto left = [&](std::size_t k){ return bodies.x[k] < c.x; };
+        const std::size_t midY = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(begin), first + static_cast<std::ptrdiff_t>(end), below) - first);
+        const std::size_t q0End = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(begin), first + static_cast<std::ptrdiff_t>(midY), left) - first);
+        const std::size_t q2End = static_cast<std::size_t>(std::partition(first + static_cast<std::ptrdiff_t>(midY), first + static_cast<std::ptrdiff_t>(end), left) - first);
+        const std::size_t bounds[5] = {begin, q0End, midY, q2End, end};
+
+        const std::size_t firstChild = m_nodes.size();
+        m_nodes[nodeIndex].firstChild = firstChild;
+        for(std::size_t q = 0; q < 4; ++q){
+            Node child;
+            child.center = Vec2<T>(c.x + ((q & 1U) != 0 ? quarter : -quarter), c.y + ((q & 2U) != 0 ? quarter : -quarter));
+            child.halfSize = quarter;
+            child.mass = static_cast<T>(0);
+            child.com = child.center;
+            child.radius = static_cast<T>(0);
+            child.begin = bounds[q];
+            child.end = bounds[q + 1];
+            child.firstChild = 0;
+            m_nodes.push_back(child);
+        }
+        m_multipoles.resize(m_nodes.size() * m_coeffs, static_cast<T>(0));
+        for(std::size_t q = 0; q < 4; ++q){
+            buildNode(firstChild + q, bodies, depth + 1);
+        }
+
+        for(std::size_t q = 0; q < 4; ++q){
+            const Node &child = m_nodes[firstChild + q];
+            mass += child.mass;
+            mx += child.mass * child.com.x;
+            my += child.mass * child.com.y;
+        }
+        const Vec2<T> com = mass != static_cast<T>(0) ? Vec2<T>(mx / mass, my / mass) : c;
+
+        // M2M, shift each child expansion to this cell's com
+        T radius = static_cast<T>(0);
+        T dxPow[MAX_ORDER + 1];
+        T dyPow[MAX_ORDER + 1];
+        T *M = &m_multipoles[nodeIndex * m_coeffs];
+        for(std::size_t q = 0; q < 4; ++q){
+            const std::size_t childIndex = firstChild + q;
+            const Node &child = m_nodes[childIndex];
+            if(child.begin == child.end){
+                continue;
+            }
+            const Vec2<T> d = child.com.sub(com);
+            radius = std::max(radius, d.norm() + child.radius);
+
+            dxPow[0] = static_cast<T>(1);
+            dyPow[0] = static_cast<T>(1);
+            for(int a = 1; a <= p; ++a){
+                dxPow[a] = dxPow[a - 1] * d.x;
+                dyPow[a] = dyPow[a - 1] * d.y;
+            }
+            for(int a = 0; a <= p; ++a){
+                dxPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+                dyPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+            }
+
+            const T *Mc = &m_multipoles[childIndex * m_coeffs];
+            for(int nOrd = 0; nOrd <= p; ++nOrd){
+                for(int b = 0; b <= nOrd; ++b){
+                    const int a = nOrd - b;
+                    T sum = static_cast<T>(0);
+                    for(int i = 0; i <= a; ++i){
+                        for(int j = 0; j <= b; ++j){
+                            sum += Mc[coeffIndex(a - i, b - j)] * dxPow[i] * dyPow[j];
+                        }
+                    }
+                    M[coeffIndex(a, b)] += sum;
+                }
+            }
+        }
+
+        Node &node = m_nodes[nodeIndex];
+        node.mass = mass;
+        node.com = com;
+        node.radius = radius;
+    }
+    else{
+        // leaf, P2M from its bodies
+        for(std::size_t k = begin; k < end; ++k){
+            const std::size_t j = m_order[k];
+            mass += bodies.m[j];
+            mx += bodies.m[j] * bodies.x[j];
+            my += bodies.m[j] * bodies.y[j];
+        }
+        const Vec2<T> com = mass != static_cast<T>(0) ? Vec2<T>(mx / mass, my / mass) : m_nodes[nodeIndex].center;
+
+        T radius = static_cast<T>(0);
+        T dxPow[MAX_ORDER + 1];
+        T dyPow[MAX_ORDER + 1];
+        T *M = &m_multipoles[nodeIndex * m_coeffs];
+        for(std::size_t k = begin; k < end; ++k){
+            const std::size_t j = m_order[k];
+            const Vec2<T> d(bodies.x[j] - com.x, bodies.y[j] - com.y);
+            radius = std::max(radius, d.norm());
+
+            dxPow[0] = bodies.m[j];
+            dyPow[0] = static_cast<T>(1);
+            for(int a = 1; a <= p; ++a){
+                dxPow[a] = dxPow[a - 1] * d.x;
+                dyPow[a] = dyPow[a - 1] * d.y;
+            }
+            for(int nOrd = 0; nOrd <= p; ++nOrd){
+                for(int bPow = 0; bPow <= nOrd; ++bPow){
+                    const int a = nOrd - bPow;
+                    M[coeffIndex(a, bPow)] += dxPow[a] * dyPow[bPow] * m_invFactorial[static_cast<std::size_t>(a)] * m_invFactorial[static_cast<std::size_t>(bPow)];
+                }
+            }
+        }
+
+        Node &node = m_nodes[nodeIndex];
+        node.mass = mass;
+        node.com = com;
+        node.radius = radius;
+    }
+}
+
+/**
+ * @brief dual tree walk, cell a receives the field of cell b
+ *
+ * @param a target cell
+ * @param b source cell
+ * @param bodies bodies in the tree
+ */
+template<typename T>
+void FmmSolver2D<T>::interact(std::size_t a, std::size_t b, const BodyArrays2D<T> &bodies){
+    const Node &A = m_nodes[a];
+    const Node &B = m_nodes[b];
+    if(A.begin == A.end || B.begin == B.end){
+        return;
+    }
+    const bool aLeaf = A.firstChild == 0;
+    const bool bLeaf = B.firstChild == 0;
+
+    // a cell with itself, interact all its children pairwise
+    if(a == b){
+        if(aLeaf){
+            particleToParticle(a, a, bodies);
+            return;
+        }
+        for(std::size_t qa = 0; qa < 4; ++qa){
+            for(std::size_t qb = 0; qb < 4; ++qb){
+                interact(A.firstChild + qa, A.firstChild + qb, bodies);
+            }
+        }
+        return;
+    }
+    // massless sources have no field
+    if(B.mass == static_cast<T>(0)){
+        return;
+    }
+
+    const Vec2<T> dr = A.com.sub(B.com);
+    const T dist2 = dr.x * dr.x + dr.y * dr.y;
+    const T reach = A.radius + B.radius;
+    if(reach * reach < m_theta * m_theta * dist2){
+        multipoleToLocal(a, b);
+    }
+    else if(aLeaf && bLeaf){
+        particleToParticle(a, b, bodies);
+    }
+    else if(bLeaf || (!aLeaf && A.radius >= B.radius)){
+        // split the bigger cell
+        for(std::size_t q = 0; q < 4; ++q){
+            interact(A.firstChild + q, b, bodies);
+        }
+    }
+    else{
+        for(std::size_t q = 0; q < 4; ++q){
+            interact(a, B.firstChild + q, bodies);
+        }
+    }
+}
+
+/**
+ * @brief direct interaction of bodies in leaf b on bodies in leaf a
+ *
+ * @param a target cell
+ * @param b source cell
+ * @param bodies bodies in the tree
+ */
+template<typename T>
+void FmmSolver2D<T>::particleToParticle(std::size_t a, std::size_t b, const BodyArrays2D<T> &bodies){
+    const Node &A = m_nodes[a];
+    const Node &B = m_nodes[b];
+    for(std::size_t k = A.begin; k < A.end; ++k){
+        const std::size_t i = m_order[k];
+        const Vec2<T> ri(bodies.x[i], bodies.y[i]);
+        T psi = static_cast<T>(0);
+        T gx = static_cast<T>(0);
+        T gy = static_cast<T>(0);
+        for(std::size_t l = B.begin; l < B.end; ++l){
+            const std::size_t j = m_order[l];
+            if(j == i){
+                continue;
+            }
+            const Vec2<T> R(ri.x - bodies.x[j], ri.y - bodies.y[j]);
+            const T s = static_cast<T>(1) / (R.x * R.x + R.y * R.y + m_eps2);
+            const T mInvDist = bodies.m[j] * static_cast<T>(std::sqrt(s));
+            psi += mInvDist;
+            gx -= R.x * s * mInvDist;
+            gy -= R.y * s * mInvDist;
+        }
+        m_psi[i] += psi;
+        m_grad[i].x += gx;
+        m_grad[i].y += gy;
+    }
+}
+
+/**
+ * @brief translate multipole of b into local expansion of a
+ *
+ * @param a target cell
+ * @param b source cell
+ */
+template<typename T>
+void FmmSolver2D<T>::multipoleToLocal(std::size_t a, std::size_t b){
+    const int p = m_expansionOrder;
+    T D[MAX_COEFFS];
+    kernelDerivatives(m_nodes[a].com.sub(m_nodes[b].com), D);
+
+    const T *M = &m_multipoles[b * m_coeffs];
+    T *L = &m_locals[a * m_coeffs];
+
+    // L_k += sum over n of (-1)^|n| M_n D_(n + k), truncated at |n| + |k| <= p
+    for(int kOrd = 0; kOrd <= p; ++kOrd){
+        for(int kb = 0; kb <= kOrd; ++kb){
+            const int ka = kOrd - kb;
+            T sum = static_cast<T>(0);
+            for(int nOrd = 0; nOrd <= p - kOrd; ++nOrd){
+                T partial = static_cast<T>(0);
+                for(int nb = 0; nb <= nOrd; ++nb){
+                    const int na = nOrd - nb;
+                    partial += M[coeffIndex(na, nb)] * D[coeffIndex(na + ka, nb + kb)];
+                }
+                sum += (nOrd % 2 == 0) ? partial : -partial;
+            }
+            L[coeffIndex(ka, kb)] += sum;
+        }
+    }
+}
+
+/**
+ * @brief push local expansions down the tree and evaluate them at the bodies (L2L, L2P)
+ *
+ * @param bodies bodies in the tree
+ */
+template<typename T>
+void FmmSolver2D<T>::downwardPass(const BodyArrays2D<T> &bodies){
+    const int p = m_expansionOrder;
+    T xPow[MAX_ORDER + 1];
+    T yPow[MAX_ORDER + 1];
+
+    // parents are always stored before their children
+    for(std::size_t nodeIndex = 0; nodeIndex < m_nodes.size(); ++nodeIndex){
+        const Node &node = m_nodes[nodeIndex];
+        if(node.begin == node.end){
+            continue;
+        }
+        const T *L = &m_locals[nodeIndex * m_coeffs];
+
+        if(node.firstChild != 0){
+            // L2L, shift this expansion to each child's com
+            for(std::size_t q = 0; q < 4; ++q){
+                const std::size_t childIndex = node.firstChild + q;
+                const Node &child = m_nodes[childIndex];
+                if(child.begin == child.end){
+                    continue;
+                }
+                const Vec2<T> d = child.com.sub(node.com);
+                xPow[0] = static_cast<T>(1);
+                yPow[0] = static_cast<T>(1);
+                for(int a = 1; a <= p; ++a){
+                    xPow[a] = xPow[a - 1] * d.x;
+                    yPow[a] = yPow[a - 1] * d.y;
+                }
+                for(int a = 0; a <= p; ++a){
+                    xPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+                    yPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+                }
+
+                T *Lc = &m_locals[childIndex * m_coeffs];
+                for(int kOrd = 0; kOrd <= p; ++kOrd){
+                    for(int kb = 0; kb <= kOrd; ++kb){
+                        const int ka = kOrd - kb;
+                        T sum = static_cast<T>(0);
+                        for(int mOrd = kOrd; mOrd <= p; ++mOrd){
+                            for(int mb = kb; mb <= mOrd - ka; ++mb){
+                                const int ma = mOrd - mb;
+                                sum += L[coeffIndex(ma, mb)] * xPow[ma - ka] * yPow[mb - kb];
+                            }
+                        }
+                        Lc[coeffIndex(ka, kb)] += sum;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // L2P, evaluate expansion and its gradient at each body in the leaf
+        for(std::size_t k = node.begin; k < node.end; ++k){
+            const std::size_t i = m_order[k];
+            const Vec2<T> e(bodies.x[i] - node.com.x, bodies.y[i] - node.com.y);
+            xPow[0] = static_cast<T>(1);
+            yPow[0] = static_cast<T>(1);
+            for(int a = 1; a <= p; ++a){
+                xPow[a] = xPow[a - 1] * e.x;
+                yPow[a] = yPow[a - 1] * e.y;
+            }
+            for(int a = 0; a <= p; ++a){
+                xPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+                yPow[a] *= m_invFactorial[static_cast<std::size_t>(a)];
+            }
+
+            T psi = static_cast<T>(0);
+            T gx = static_cast<T>(0);
+            T gy = static_cast<T>(0);
+            for(int kOrd = 0; kOrd <= p; ++kOrd){
+                for(int kb = 0; kb <= kOrd; ++kb){
+                    const int ka = kOrd - kb;
+                    const T w = xPow[ka] * yPow[kb];
+                    psi += L[coeffIndex(ka, kb)] * w;
+                    if(kOrd < p){
+                        gx += L[coeffIndex(ka + 1, kb)] * w;
+                        gy += L[coeffIndex(ka, kb + 1)] * w;
+                    }
+                }
+            }
+            m_psi[i] += psi;
+            m_grad[i].x += gx;
+            m_grad[i].y += gy;
+        }
+    }
+}
+
+/**
+ * @brief derivatives D_(a,b) = d^a/dx^a d^b/dy^b of g(R) for a + b <= order
+ *
+ * @param R separation vector
+ * @param D output, m_coeffs entries in coefficient order
+ */
+template<typename T>
+void FmmSolver2D<T>::kernelDerivatives(const Vec2<T> &R, T *D) const{
+    const int p = m_expansionOrder;
+    const std::size_t stride = static_cast<std::size_t>(p + 1);
+
+    // g = h(u), u = |R|^2 / 2, h(u) = (2u + eps2)^(-1/2)
+    // h^(m) = -(2m - 1) * s * h^(m - 1), s = 1 / (|R|^2 + eps2)
+    const T s = static_cast<T>(1) / (R.x * R.x + R.y * R.y + m_eps2);
+    T h[MAX_ORDER + 1];
+    h[0] = static_cast<T>(std::sqrt(s));
+    for(int m = 1; m <= p; ++m){
+        h[m] = -static_cast<T>(2 * m - 1) * s * h[m - 1];
+    }
+
+    T xPow[MAX_ORDER + 1];
+    T yPow[MAX_ORDER + 1];
+    xPow[0] = static_cast<T>(1);
+    yPow[0] = static_cast<T>(1);
+    for(int a = 1; a <= p; ++a){
+        xPow[a] = xPow[a - 1] * R.x;
+        yPow[a] = yPow[a - 1] * R.y;
+    }
+
+    // d^a/dx^a d^b/dy^b h = sum_k sum_l c(a, k) c(b, l) x^(a - 2k) y^(b - 2l) h^(a + b - k - l)
+    for(int nOrd = 0; nOrd <= p; ++nOrd){
+        for(int b = 0; b <= nOrd; ++b){
+            const int a = nOrd - b;
+            T sum = static_cast<T>(0);
+            for(int k = 0; 2 * k <= a; ++k){
+                const T cx = m_hermite[static_cast<std::size_t>(a) * stride + static_cast<std::size_t>(k)] * xPow[a - 2 * k];
+                for(int l = 0; 2 * l <= b; ++l){
+                    sum += cx * m_hermite[static_cast<std::size_t>(b) * stride + static_cast<std::size_t>(l)] * yPow[b - 2 * l] * h[nOrd - k - l];
+                }
+            }
+            D[coeffIndex(a, b)] = sum;
+        }
+    }
+}
+
+/**
+ * @brief add acceleration from the last evaluate() to each body's accumulator
+ *        a_i = G * grad(psi)(r_i)
+ *
+ * @param bodies same bodies that were evaluated
+ * @param G gravitational constant
+ */
+template<typename T>
+void FmmSolver2D<T>::accumulateAccelerations(BodyArrays2D<T> &bodies, T G) const{
+    const std::size_t n = std::min(bodies.size(), m_grad.size());
+    for(std::size_t i = 0; i < n; ++i){
+        bodies.ax[i] += G * m_grad[i].x;
+        bodies.ay[i] += G * m_grad[i].y;
+    }
+}
+
+/**
+ * @brief potential energy from the last evaluate()
+ *        U = -0.5 * G * sum(m_i * psi(r_i))
+ *
+ * @param bodies same bodies that were evaluated
+ * @param G gravitational constant
+ * @return T potential energy
+ */
+template<typename T>
+T FmmSolver2D<T>::potentialEnergy(const BodyArrays2D<T> &bodies, T G) const{
+    const std::size_t n = std::min(bodies.size(), m_psi.size());
+    EnergySum<T> sum = 0;
+    for(std::size_t i = 0; i < n; ++i){
+        sum += static_cast<EnergySum<T>>(bodies.m[i] * m_psi[i]);
+    }
+    return static_cast<T>(static_cast<EnergySum<T>>(-0.5) * static_cast<EnergySum<T>>(G) * sum);
+}
+
+// precisions selectable through the precision config key
+template class FmmSolver2D<float>;
+template class FmmSolver2D<double>;
+template class FmmSolver2D<long double>;
@@ -0,0 +1,574 @@
+// insituanalysis class, reductions of the running state written as a small csv time series
+
+#include "insitu_analysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+#include "nbody_system2d.h"
+#include "phase_profiler.h"
+
+namespace{
+
+constexpr double PI = 3.14159265358979323846;
+
+/**
+ * @brief sum width values over the bodies [0, n), body(begin, end, sums) adds a chunk into sums
+ *        chunks are fixed by n alone and added in order, so the result does not depend on the thread count
+ *
+ * @param pool worker threads, may be null
+ * @param n number of bodies
+ * @param grain bodies per chunk
+ * @param width values per sum
+ * @param sums receives the width totals
+ * @param body function adding the values of a chunk
+ */
+void sumRanges(ThreadPool *pool, std::size_t n, std::size_t grain, std::size_t width, std::vector<double> &sums, const std::function<void(std::size_t, std::size_t, double *)> &body){
+    const std::size_t chunks = std::max<std::size_t>(1, (n + grain - 1) / grain);
+    std::vector<double> partial(chunks * width, 0.0);
+    const auto chunk = [&](std::size_t c){
+        body(n * c / chunks, n * (c + 1) / chunks, partial.data() + c * width);
+    };
+    if(pool && chunks > 1){
+        pool->run(chunks, chunk);
+    }
+    else{
+        for(std::size_t c = 0; c < chunks; ++c){
+            chunk(c);
+        }
+    }
+    sums.assign(width, 0.0);
+    for(std::size_t c = 0; c < chunks; ++c){
+        for(std::size_t w = 0; w < width; ++w){
+            sums[w] += partial[c * width + w];
+        }
+    }
+}
+
+/**
+ * @brief E_total and its drift from the first row
+ *
+ */
+template<typename T>
+void measureEnergy(const AnalysisFrame<T> &frame, const AnalysisSettings &, const double *reference, double *out){
+    out[0] = frame.energy;
+    const double E0 = reference ? reference[0] : frame.energy;
+    out[1] = (E0 != 0.0) ? (frame.energy - E0) / std::fabs(E0) : 0.0;
+}
+
+/**
+ * @brief centre of mass and its velocity, already in the frame
+ *
+ */
+template<typename T>
+void measureCenterOfMass(const AnalysisFrame<T> &frame, const AnalysisSettings &, const double *, double *out){
+    out[0] = frame.comX;
+    out[1] = frame.comY;
+    out[2] = frame.comVx;
+    out[3] = frame.comVy;
+}
+
+/**
+ * @brief angular momentum about the origin and its change since the first row
+ *
+ */
+template<typename T>
+void measureAngularMomentum(const AnalysisFrame<T> &frame, const AnalysisSettings &, const double *reference, double *out){
+    const std::vector<Body2D<T>> &bodies = *frame.bodies;
+    std::vector<double> sums;
+    sumRanges(frame.pool, bodies.size(), InSituAnalysis2D<T>::SUM_GRAIN, 1, sums, [&](std::size_t begin, std::size_t end, double *chunk){
+        double L = 0.0;
+        for(std::size_t i = begin; i < end; ++i){
+            const Body2D<T> &b = bodies[i];
+            L += static_cast<double>(b.m) * (static_cast<double>(b.r.x) * static_cast<double>(b.v.y) - static_cast<double>(b.r.y) * static_cast<double>(b.v.x));
+        }
+        chunk[0] = L;
+    });
+    out[0] = sums[0];
+    out[1] = reference ? sums[0] - reference[0] : 0.0;
+}
+
+/**
+ * @brief half-mass radius and surface density annuli about the centre of mass
+ *        the bodies are sorted by radius, r_half is where the enclosed mass first reaches half the total
+ *
+ */
+template<typename T>
+void measureRadialProfile(const AnalysisFrame<T> &frame, const AnalysisSettings &settings, const double *reference, double *out){
+    const std::vector<Body2D<T>> &bodies = *frame.bodies;
+    const std::size_t n = bodies.size();
+    std::vector<std::pair<double, double>> radii(n);
+    const auto radius = [&](std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; ++i){
+            const double dx = static_cast<double>(bodies[i].r.x) - frame.comX;
+            const double dy = static_cast<double>(bodies[i].r.y) - frame.comY;
+            radii[i] = std::make_pair(std::sqrt(dx * dx + dy * dy), static_cast<double>(bodies[i].m));
+        }
+    };
+    if(frame.pool){
+        frame.pool->parallelFor(0, n, InSituAnalysis2D<T>::SUM_GRAIN, radius);
+    }
+    else{
+        radius(0, n);
+    }
+    std::sort(radii.begin(), radii.end());
+
+    // the outer radius is fixed by the first row, so every row bins the same annuli
+    double rMax = settings.radialMax;
+    if(!(rMax > 0.0)){
+        rMax = reference ? reference[1] : (n > 0 ? radii[n - 1].first : 0.0);
+    }
+    double enclosed = 0.0;
+    double rHalf = 0.0;
+    const std::size_t B = settings.radialBins;
+    double *sigma = out + 2;
+    std::fill(sigma, sigma + B, 0.0);
+    for(std::size_t i = 0; i < n; ++i){
+        const double r = radii[i].first;
+        const double m = radii[i].second;
+        if(enclosed < 0.5 * frame.mass && enclosed + m >= 0.5 * frame.mass){
+            rHalf = r;
+        }
+        enclosed += m;
+        if(rMax > 0.0 && r <= rMax){
+            sigma[std::min(B - 1, static_cast<std::size_t>(r / rMax * static_cast<double>(B)))] += m;
+        }
+    }
+    for(std::size_t k = 0; k < B && rMax > 0.0; ++k){
+        const double inner = rMax * static_cast<double>(k) / static_cast<double>(B);
+        const double outer = rMax * static_cast<double>(k + 1) / static_cast<double>(B);
+        sigma[k] /= PI * (outer * outer - inner * inner);
+    }
+    out[0] = rHalf;
+    out[1] = rMax;
+}
+
+/**
+ * @brief bodies on escape orbits, kinetic energy about the centre of mass above the
+ *        point-mass potential of the total mass
+ *
+ */
+template<typename T>
+void measureEscapers(const AnalysisFrame<T> &frame, const AnalysisSettings &settings, const double *, double *out){
+    const std::vector<Body2D<T>> &bodies = *frame.bodies;
+    const double GM = settings.G * frame.mass;
+    std::vector<double> sums;
+    sumRanges(frame.pool, bodies.size(), InSituAnalysis2D<T>::SUM_GRAIN, 2, sums, [&](std::size_t begin, std::size_t end, double *chunk){
+        for(std::size_t i = begin; i < end; ++i){
+            const Body2D<T> &b = bodies[i];
+            const double dx = static_cast<double>(b.r.x) - frame.comX;
+            const double dy = static_cast<double>(b.r.y) - frame.comY;
+            const double r = std::sqrt(dx * dx + dy * dy);
+            if(!(r > settings.escapeRadius) || !(r > 0.0)){
+                continue;
+            }
+            const double dvx = static_cast<double>(b.v.x) - frame.comVx;
+            const double dvy = static_cast<double>(b.v.y) - frame.comVy;
+            if(0.5 * (dvx * dvx + dvy * dvy) > GM / r){
+                chunk[0] += 1.0;
+                chunk[1] += static_cast<double>(b.m);
+            }
+        }
+    });
+    out[0] = sums[0];
+    out[1] = sums[1];
+}
+
+}
+
+/**
+ * @brief names of the built-in probes, in the order they are documented
+ *
+ * @return const std::vector<std::string>&
+ */
+const std::vector<std::string> &analysisProbeNames(){
+    static const std::vector<std::string> names = {"energy", "com", "angmom", "radial", "escapers"};
+    return names;
+}
+
+/**
+ * @brief split a comma separated probe list, spaces around names are dropped
+ *
+ * @param list value of the analysis config key, empty or "off" = no probes
+ * @param names receives the names in list order
+ * @param err stream for an unknown or repeated name
+ * @return true if every name is a built-in probe
+ * @return false otherwise
+ */
+bool parseAnalysisProbes(const std::string &list, std::vector<std::string> &names, std::ostream &err){
+    names.clear();
+    if(list.empty() || list == "off"){
+        return true;
+    }
+    const std::vector<std::string> &known = analysisProbeNames();
+    std::stringstream ss(list);
+    std::string name;
+    bool ok = true;
+    while(std::getline(ss, name, ',')){
+        const std::size_t first = name.find_first_not_of(" \t");
+        const std::size_t last = name.find_last_not_of(" \t");
+        name = (first == std::string::npos) ? std::string() : name.substr(first, last - first + 1);
+        if(std::find(known.begin(), known.end(), name) == known.end()){
+            err << "Unknown analysis probe '" << name << "', expected energy, com, angmom, radial or escapers.\n";
+            ok = false;
+        }
+        else if(std::find(names.begin(), names.end(), name) != names.end()){
+            err << "Analysis probe '" << name << "' is listed twice.\n";
+            ok = false;
+        }
+        else{
+            names.push_back(name);
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief build a built-in probe
+ *
+ * @param name one of analysisProbeNames()
+ * @param settings bin count, sizes the radial columns
+ * @param probe receives the probe
+ * @return true if the name is known
+ * @return false otherwise
+ */
+template<typename T>
+bool makeAnalysisProbe(const std::string &name, const AnalysisSettings &settings, AnalysisProbe2D<T> &probe){
+    probe = AnalysisProbe2D<T>();
+    probe.name = name;
+    if(name == "energy"){
+        probe.columns = {"E_total", "dE_rel"};
+        probe.needsEnergy = true;
+        probe.measure = measureEnergy<T>;
+    }
+    else if(name == "com"){
+        probe.columns = {"com_x", "com_y", "com_vx", "com_vy"};
+        probe.measure = measureCenterOfMass<T>;
+    }
+    else if(name == "angmom"){
+        probe.columns = {"L_z", "dL_z"};
+        probe.measure = measureAngularMomentum<T>;
+    }
+    else if(name == "radial"){
+        probe.columns = {"r_half", "r_max"};
+        for(std::size_t k = 1; k <= settings.radialBins; ++k){
+            probe.columns.push_back("sigma_" + std::to_string(k));
+        }
+        probe.measure = measureRadialProfile<T>;
+    }
+    else if(name == "escapers"){
+        probe.columns = {"escapers", "escaped_mass"};
+        probe.measure = measureEscapers<T>;
+    }
+    else{
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief construct a stage with no probes and no file
+ *
+ */
+template<typename T>
+InSituAnalysis2D<T>::InSituAnalysis2D() : m_settings(), m_probes(), m_offsets(), m_values(0), m_row(), m_reference(), m_threads(1), m_pool(), m_out(), m_wroteHeader(false), m_rows(0){}
+
+/**
+ * @brief set the parameters of built-in probes added afterwards
+ *
+ * @param settings probe parameters
+ */
+template<typename T>
+void InSituAnalysis2D<T>::setSettings(const AnalysisSettings &settings){
+    m_settings = settings;
+    if(m_settings.radialBins == 0){
+        m_settings.radialBins = 1;
+    }
+}
+
+/**
+ * @brief set the worker threads of the reductions, the pool starts with the first analyze()
+ *
+ * @param threads total threads, 0 = all hardware threads
+ */
+template<typename T>
+void InSituAnalysis2D<T>::setThreadCount(std::size_t threads){
+    m_threads = (threads == 0) ? ThreadPool::hardwareThreads() : threads;
+    m_pool.reset();
+}
+
+/**
+ * @brief add a built-in probe by name
+ *
+ * @param name one of analysisProbeNames()
+ * @return true if the name is known
+ * @return false otherwise
+ */
+template<typename T>
+bool InSituAnalysis2D<T>::addProbe(const std::string &name){
+    AnalysisProbe2D<T> probe;
+    if(!makeAnalysisProbe(name, m_settings, probe)){
+        return false;
+    }
+    addProbe(probe);
+    return true;
+}
+
+/**
+ * @brief add a probe, built-in or custom, before the header is written
+ *
+ * @param probe probe to add
+ */
+template<typename T>
+void InSituAnalysis2D<T>::addProbe(const AnalysisProbe2D<T> &probe){
+    m_probes.push_back(probe);
+    m_offsets.push_back(m_values);
+    m_values += probe.columns.size();
+    m_row.assign(m_values, 0.0);
+    m_reference.clear();
+}
+
+/**
+ * @brief whether any probe was added
+ *
+ * @return true if analyze() writes rows
+ */
+template<typename T>
+bool InSituAnalysis2D<T>::active() const{
+    return !m_probes.empty();
+}
+
+/**
+ * @brief whether a probe needs totalEnergy()
+ *
+ * @return true if steps ending on a row should track the potential
+ */
+template<typename T>
+bool InSituAnalysis2D<T>::needsEnergy() const{
+    for(std::size_t p = 0; p < m_probes.size(); ++p){
+        if(m_probes[p].needsEnergy){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief open the csv file for writing
+ *
+ * @param path file path
+ * @return true if the file is open
+ * @return false otherwise
+ */
+template<typename T>
+bool InSituAnalysis2D<T>::open(const std::string &path){
+    m_out.open(path, std::ios::out);
+    m_out.precision(std::numeric_limits<double>::max_digits10);
+    m_wroteHeader = false;
+    m_rows = 0;
+    m_reference.clear();
+    return static_cast<bool>(m_out);
+}
+
+/**
+ * @brief reopen an existing series to continue it, e.g. after resuming from a checkpoint
+ *        keeps the header and the first rowsKept rows, cuts anything after them and appends from there,
+ *        the first kept row becomes the drift reference again, writeHeader() then does nothing
+ *        a missing file is opened like open()
+ *
+ * @param path file path
+ * @param rowsKept rows up to the checkpoint
+ * @param rowsFound receives rows actually kept, fewer if the file was shorter
+ * @return true if the file is open
+ * @return false otherwise
+ */
+template<typename T>
+bool InSituAnalysis2D<T>::openAppend(const std::string &path, unsigned long long rowsKept, unsigned long long &rowsFound){
+    rowsFound = 0;
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if(ec || size == 0){
+        return open(path);
+    }
+    m_reference.clear();
+
+    // header line, then one line per row, a line without its newline is dropped
+    std::uintmax_t keep = 0;
+    {
+        std::ifstream in(path, std::ios::in);
+        if(!in){
+            return false;
+        }
+        std::string line;
+        if(std::getline(in, line) && !in.eof()){
+            keep = static_cast<std::uintmax_t>(in.tellg());
+            while(rowsFound < rowsKept && std::getline(in, line) && !in.eof()){
+                keep = static_cast<std::uintmax_t>(in.tellg());
+                if(rowsFound == 0){
+                    // skip t and N, the probe values follow
+                    std::stringstream ss(line);
+                    std::string value;
+                    std::vector<double> values;
+                    while(std::getline(ss, value, ',')){
+                        values.push_back(std::strtod(value.c_str(), nullptr));
+                    }
+                    if(values.size() == 2U + m_values){
+                        m_reference.assign(values.begin() + 2, values.end());
+                    }
+                }
+                ++rowsFound;
+            }
+        }
+    }
+    if(keep < size){
+        std::filesystem::resize_file(path, keep, ec);
+        if(ec){
+            return false;
+        }
+    }
+
+    m_out.open(path, std::ios::out | std::ios::app);
+    m_out.precision(std::numeric_limits<double>::max_digits10);
+    m_wroteHeader = keep > 0;
+    m_rows = 0;
+    return static_cast<bool>(m_out);
+}
+
+/**
+ * @brief write the column names, once
+ *
+ */
+template<typename T>
+void InSituAnalysis2D<T>::writeHeader(){
+    if(!m_out || m_wroteHeader){
+        return;
+    }
+    m_out << "t,N";
+    for(std::size_t p = 0; p < m_probes.size(); ++p){
+        for(std::size_t c = 0; c < m_probes[p].columns.size(); ++c){
+            m_out << "," << m_probes[p].columns[c];
+        }
+    }
+    m_out << "\n";
+    m_wroteHeader = true;
+}
+
+/**
+ * @brief reduce the current state to one row and write it
+ *
+ * @param t simulation time
+ * @param system system to reduce, read only
+ */
+template<typename T>
+void InSituAnalysis2D<T>::analyze(T t, const NBodySystem2D<T> &system){
+    if(!m_out || m_probes.empty()){
+        return;
+    }
+    ScopedPhase timer(Phase::Analysis);
+    if(!m_pool && m_threads > 1){
+        m_pool = std::make_unique<ThreadPool>(m_threads);
+    }
+
+    // total mass, centre of mass and its velocity, shared by the probes
+    AnalysisFrame<T> frame;
+    frame.t = static_cast<double>(t);
+    frame.bodies = &system.bodies();
+    frame.pool = m_pool.get();
+    const std::vector<Body2D<T>> &bodies = system.bodies();
+    std::vector<double> sums;
+    sumRanges(frame.pool, bodies.size(), SUM_GRAIN, 5, sums, [&](std::size_t begin, std::size_t end, double *chunk){
+        for(std::size_t i = begin; i < end; ++i){
+            const double m = static_cast<double>(bodies[i].m);
+            chunk[0] += m;
+            chunk[1] += m * static_cast<double>(bodies[i].r.x);
+            chunk[2] += m * static_cast<double>(bodies[i].r.y);
+            chunk[3] += m * static_cast<double>(bodies[i].v.x);
+            chunk[4] += m * static_cast<double>(bodies[i].v.y);
+        }
+    });
+    frame.mass = sums[0];
+    if(sums[0] != 0.0){
+        frame.comX = sums[1] / sums[0];
+        frame.comY = sums[2] / sums[0];
+        frame.comVx = sums[3] / sums[0];
+        frame.comVy = sums[4] / sums[0];
+    }
+    if(needsEnergy()){
+        frame.energy = static_cast<double>(system.totalEnergy());
+    }
+
+    const double *reference = m_reference.empty() ? nullptr : m_reference.data();
+    for(std::size_t p = 0; p < m_probes.size(); ++p){
+        m_probes[p].measure(frame, m_settings, reference ? reference + m_offsets[p] : nullptr, m_row.data() + m_offsets[p]);
+    }
+    if(m_reference.empty()){
+        m_reference = m_row;
+    }
+
+    m_out << frame.t << "," << bodies.size();
+    for(std::size_t v = 0; v < m_values; ++v){
+        m_out << "," << m_row[v];
+    }
+    m_out << "\n";
+    ++m_rows;
+}
+
+/**
+ * @brief push written rows to the file
+ *
+ */
+template<typename T>
+void InSituAnalysis2D<T>::flush(){
+    if(m_out.is_open()){
+        m_out.flush();
+    }
+}
+
+/**
+ * @brief close the file
+ *
+ */
+template<typename T>
+void InSituAnalysis2D<T>::close(){
+    if(m_out.is_open()){
+        m_out.close();
+    }
+}
+
+/**
+ * @brief returns rows written since open, kept rows of openAppend() not included
+ *
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long InSituAnalysis2D<T>::rowsWritten() const{
+    return m_rows;
+}
+
+/**
+ * @brief returns the names of the added probes, comma separated
+ *
+ * @return std::string
+ */
+template<typename T>
+std::string InSituAnalysis2D<T>::probeList() const{
+    std::string list;
+    for(std::size_t p = 0; p < m_probes.size(); ++p){
+        list += (p > 0 ? "," : "") + m_probes[p].name;
+    }
+    return list;
+}
+
+// precisions selectable through the precision config key
+template bool makeAnalysisProbe<float>(const std::string &, const AnalysisSettings &, AnalysisProbe2D<float> &);
+template bool makeAnalysisProbe<double>(const std::string &, const AnalysisSettings &, AnalysisProbe2D<double> &);
+template bool makeAnalysisProbe<long double>(const std::string &, const AnalysisSettings &, AnalysisProbe2D<long double> &);
+template class InSituAnalysis2D<float>;
+template class InSituAnalysis2D<double>;
+template class InSituAnalysis2D<long double>;
@@ -14,9 +14,12 @@
 #include <iostream>
 #include <string>
 #include <cctype>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#ifndef NBODY_HEADLESS
 #include <SFML/Graphics.hpp>
-#include <random>
-#include <cstdint>
+#endif
 
 #include "real_type.hpp"
 #include "vec2.hpp"
@@ -24,30 +27,162 @@
 #include "nbody_system2d.h"
 #include "simulation_config.h"
 #include "body_io.h"
+#include "async_run_logger.h"
+#include "checkpoint.h"
+#include "compressed_trajectory.h"
+#include "insitu_analysis.h"
+#include "phase_profiler.h"
 #include "run_logger.h"
+#ifndef NBODY_HEADLESS
+#include "body_renderer.hpp"
+#endif
 
-int main(int argc, char *argv[]){   
-    // determine config file path
-    // allowed to override by passing a filename as the first command line argument
-    std::string configPath = "config.txt";
-    if(argc > 1){
-        configPath = argv[1];
+#ifndef NBODY_HEADLESS
+/**
+ * @brief open the SFML window and draw the bodies after every step
+ *        runs until all steps are done or the window is closed
+ * 
+ * @tparam T scalar type used for all simulation state
+ * @tparam StepFn callable that advances the system by one step and logs
+ * @param view read-only system to draw
+ * @param cfg validated simulation config, for the heatmap settings
+ * @param steps number of steps to run
+ * @param advance one integration step
+ */
+template<typename T, typename StepFn>
+void runWindowed(const NBodySystem2D<T> &view, const SimulationConfig &cfg, long long steps, const StepFn &advance){
+    // SFML
+    // window dimension in pixels
+    const unsigned int windowWidth = 800U;
+    const unsigned int windowHeight = 800U;
+
+    // create VideoMode and RenderWindow
+    sf::Vector2u size(windowWidth, windowHeight);
+    sf::VideoMode mode(size);
+    sf::RenderWindow window(mode, "N-Body Simulator");
+    window.setFramerateLimit(60U);
+
+    // scale factor from simulation units to screen pixels
+    const float viewScale = 200.0f;
+
+    // one vertex array for all bodies, colored by id
+    // so a body keeps its color when others are merged away
+    BodyRenderer2D<T> renderer(view.idCount(), windowWidth, windowHeight, viewScale);
+    // past heatmapAbove bodies a density heatmap, one pixel per bin, replaces the sprites
+    renderer.setHeatmap(static_cast<std::size_t>(cfg.heatmapAbove), cfg.heatmapMass, static_cast<std::size_t>(cfg.threads));
+
+    // step counter for simulation loop
+    long long step = 0;
+
+    // while the window is open, simulator:
+        // handle window events
+        // advanced n-body system by one time step
+        // log state every outputEvery steps
+        // draw all bodies as colored discs in one batch
+            
+    while(window.isOpen() && step < steps){
+        // pollEvent() returns pointer-like object which gets dereferenced
+        {
+            ScopedPhase timer(Phase::Events);
+            while(auto event = window.pollEvent()){
+                // check for window close event
+                if(event->is<sf::Event::Closed>()){
+                    window.close();
+                }
+            }
+        }
+        // time integration and logging
+        advance();
+        ++step;
+
+        // rendering, display() also waits out the frame limit
+        ScopedPhase timer(Phase::Render);
+        window.clear(sf::Color::Black);
+        // every body in one draw call, sprites or the heatmap
+        renderer.update(view.bodies(), view.bodyIds());
+        renderer.draw(window);
+        // draw frame on screen
+        window.display();
     }
-    // load and validate simulation config
-    SimulationConfig cfg;
-    if(!cfg.loadFromFile(configPath)){
-        std::cerr << "Unable to read config file " << configPath << ".\n";
-        return 1;
+}
+#endif
+
+/**
+ * @brief build the system, run the time-stepping loop with SFML visualization or headless, and log output
+ * 
+ * @tparam T scalar type used for all simulation state, float, double or long double
+ * @param cfg validated simulation config
+ * @return int process exit code
+ */
+template<typename T>
+int runSimulation(const SimulationConfig &cfg){
+    // builds without SFML can only run headless
+#ifdef NBODY_HEADLESS
+    const bool headless = true;
+#else
+    const bool headless = cfg.headless;
+#endif
+
+    // construct n-body system with G and softening
+    NBodySystem2D<T> system(static_cast<T>(cfg.G), static_cast<T>(cfg.eps2));
+    if(cfg.storage == "soa"){
+        system.setStorageMode(StorageMode::SoA);
     }
-    if(!cfg.validate(std::cerr)){
-        return 1;
+
+    // pick force engine, integrators call computeForces() either way
+    if(cfg.forceEngine == "barneshut"){
+        system.setForceEngine(ForceEngine::BarnesHut);
+    }
+    else if(cfg.forceEngine == "fmm"){
+        system.setForceEngine(ForceEngine::Fmm);
+    }
+    else if(cfg.forceEngine == "pm"){
+        system.setForceEngine(ForceEngine::Pm);
     }
+    system.setTheta(static_cast<T>(cfg.theta));
+    system.setFmmOrder(cfg.fmmOrder);
+    system.setPmGrid(static_cast<std::size_t>(cfg.pmGrid), cfg.pmAssign == "tsc" ? PmAssignment::Tsc : PmAssignment::Cic);
+    system.setPmBoundary(cfg.pmBoundary == "periodic" ? PmBoundary::Periodic : PmBoundary::Isolated, static_cast<T>(cfg.pmBoxSize));
 
-    // construct n-body system with G and softening
-    NBodySystem2D system(cfg.G, cfg.eps2);
+    // individual timesteps, only read by the block method
+    system.setBlockLevels(cfg.blockLevels);
+    system.setBlockEta(static_cast<T>(cfg.blockEta));
+
+    // direct-sum instruction set, clamped to the running CPU
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    parseSimdLevel(cfg.simd, simdLevel);
+    system.setSimdLevel(simdLevel);
+    system.setFastRsqrt(cfg.fastRsqrt);
+    system.setFloatPairs(cfg.forcePrecision == "float");
+
+    // worker pool is started once and reused by every step
+    system.setThreadCount(static_cast<std::size_t>(cfg.threads));
+
+    // normalize method string
+    std::string method = cfg.method;
+    for(std::size_t i = 0; i < method.size(); ++i){
+        method[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(method[i])));
+    }
 
-    // load body initial conditions from csv
-    if(!loadBodiesFromCsv(cfg.bodiesFile, system)){
+    // continue a checkpointed run, or load body initial conditions from csv or the binary format written by tools/csv2bodies
+    const bool resuming = !cfg.resumeFrom.empty();
+    CheckpointData<T> resume;
+    if(resuming){
+        if(!readCheckpoint(cfg.resumeFrom, resume)){
+            return 1;
+        }
+        // G and eps2 belong to the saved state, their setters drop carried forces so they go first
+        if(resume.G != static_cast<T>(cfg.G) || resume.eps2 != static_cast<T>(cfg.eps2)){
+            std::cerr << "Note: using G and eps2 of the checkpoint, the config values differ.\n";
+        }
+        system.setG(resume.G);
+        system.setEps2(resume.eps2);
+        system.restoreState(resume.state);
+        if(resume.method != method || resume.dt != static_cast<T>(cfg.dt)){
+            std::cerr << "Note: the checkpoint was taken with method " << resume.method << " and dt " << static_cast<double>(resume.dt) << ", continuing with the config's.\n";
+        }
+    }
+    else if(!loadBodies(cfg.bodiesFile, system, static_cast<std::size_t>(cfg.threads))){
         return 1;
     }
     if(system.bodyCount() == 0){
@@ -55,152 +190,386 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
-    // set up run logger to write trajectories to CSV
-    RunLogger logger;
-    if(!logger.open(cfg.outTrajFile)){
+    // collision radii from the radii file or one radius for all, a checkpoint brings its own
+    CollisionMode collisionMode = CollisionMode::Off;
+    if(cfg.collisions == "detect"){
+        collisionMode = CollisionMode::Detect;
+    }
+    else if(cfg.collisions == "merge"){
+        collisionMode = CollisionMode::Merge;
+    }
+    if(collisionMode != CollisionMode::Off && system.radii().empty()){
+        std::vector<T> radii;
+        if(!cfg.radiiFile.empty()){
+            if(!loadRadii(cfg.radiiFile, radii)){
+                return 1;
+            }
+            if(radii.size() != system.bodyCount()){
+                std::cerr << cfg.radiiFile << " has " << radii.size() << " radii for " << system.bodyCount() << " bodies.\n";
+                return 1;
+            }
+        }
+        else{
+            radii.assign(system.bodyCount(), static_cast<T>(cfg.collisionRadius));
+        }
+        system.setRadii(radii);
+    }
+    // event log, a resumed run appends to it
+    std::ofstream collisionOut;
+    if(collisionMode != CollisionMode::Off && !cfg.collisionLog.empty()){
+        collisionOut.open(cfg.collisionLog, resuming ? std::ios::out | std::ios::app : std::ios::out);
+        if(!collisionOut){
+            std::cerr << "Could not open collision log " << cfg.collisionLog << ".\n";
+        }
+        else if(!resuming){
+            collisionOut << "t,body_a,body_b\n";
+        }
+    }
+
+    // set up run logger to write trajectories to CSV, binary frames or compressed blocks
+    // with asyncLog a writer thread formats, computes energy and writes while the loop keeps stepping
+    // a resumed run cuts the trajectory back to the checkpoint and appends to it
+    AsyncRunLogger<T> logger(cfg.asyncLog ? static_cast<std::size_t>(cfg.logBuffer) : 0);
+    const LogFormat format = cfg.outFormat == "binary" ? LogFormat::Binary : (cfg.outFormat == "compressed" ? LogFormat::Compressed : LogFormat::Csv);
+    logger.setCompression(static_cast<double>(cfg.compressPosError), static_cast<double>(cfg.compressVelError), static_cast<unsigned int>(cfg.keyframeEvery));
+    unsigned long long framesFound = 0;
+    if(!(resuming ? logger.openAppend(cfg.outTrajFile, format, resume.framesLogged, framesFound) : logger.open(cfg.outTrajFile, format))){
         std::cerr << "Could not open output file " << cfg.outTrajFile << ".\n";
     }
 
+    // full frames every dumpEvery steps when set, the in-situ series keeps the outputEvery cadence
+    const long long dumpEvery = cfg.dumpEvery > 0 ? cfg.dumpEvery : cfg.outputEvery;
+
     // write header line with time, positions, velocities, and energy if flagged
-    logger.writeHeader(system, cfg.includeEnergy);
+    logger.writeHeader(system, cfg.includeEnergy, dumpEvery, static_cast<double>(cfg.dt));
 
-    // normalize method string
-    std::string method = cfg.method;
-    for(std::size_t i = 0; i < method.size(); ++i){
-        method[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(method[i])));
+    // in-situ analysis writes one small row of reductions every outputEvery steps,
+    // a resumed run cuts the series back to the checkpoint like the trajectory
+    InSituAnalysis2D<T> analysis;
+    std::vector<std::string> probes;
+    parseAnalysisProbes(cfg.analysis, probes, std::cerr);
+    unsigned long long rowsFound = 0;
+    const unsigned long long rowsKept = resuming ? static_cast<unsigned long long>(resume.step / cfg.outputEvery) + 1ULL : 0ULL;
+    if(!probes.empty()){
+        AnalysisSettings settings;
+        settings.radialBins = static_cast<std::size_t>(cfg.radialBins);
+        settings.radialMax = static_cast<double>(cfg.radialMax);
+        settings.escapeRadius = static_cast<double>(cfg.escapeRadius);
+        settings.G = static_cast<double>(system.getG());
+        analysis.setSettings(settings);
+        analysis.setThreadCount(static_cast<std::size_t>(cfg.threads));
+        for(std::size_t p = 0; p < probes.size(); ++p){
+            analysis.addProbe(probes[p]);
+        }
+        if(!(resuming ? analysis.openAppend(cfg.analysisFile, rowsKept, rowsFound) : analysis.open(cfg.analysisFile))){
+            std::cerr << "Could not open analysis file " << cfg.analysisFile << ".\n";
+        }
+        analysis.writeHeader();
     }
 
-    // initial time and first log
-    Real t = static_cast<Real>(0);
-    logger.logState(t, system, cfg.includeEnergy);
+    // initial time and first log, a resumed run already has its rows up to the checkpoint
+    T t = resuming ? resume.t : static_cast<T>(0);
+    const T dt = static_cast<T>(cfg.dt);
+    const long long startStep = resuming ? resume.step : 0;
+    if(!resuming){
+        logger.logState(t, system, cfg.includeEnergy);
+        analysis.analyze(t, system);
+    }
+    else{
+        if(framesFound < resume.framesLogged){
+            std::cerr << "Note: " << cfg.outTrajFile << " held " << framesFound << " of the " << resume.framesLogged << " frames up to the checkpoint, continuing after them.\n";
+        }
+        if(analysis.active() && rowsFound < rowsKept){
+            std::cerr << "Note: " << cfg.analysisFile << " held " << rowsFound << " of the " << rowsKept << " rows up to the checkpoint, continuing after them.\n";
+        }
+    }
 
     // print config summary
     std::cout << "Configuration loaded.\n";
     std::cout << "precision = " << cfg.precision << "\n";
     std::cout << "method = " << cfg.method << "\n";
+    if(method == "block"){
+        std::cout << "blockLevels = " << cfg.blockLevels << " (smallest step dt / " << (1LL << (cfg.blockLevels - 1)) << "), blockEta = " << static_cast<double>(cfg.blockEta) << "\n";
+    }
+    std::cout << "storage = " << cfg.storage << "\n";
+    std::cout << "threads = " << system.getThreadCount() << "\n";
+    std::cout << "forceEngine = " << cfg.forceEngine << "\n";
+    if(cfg.forceEngine == "direct"){
+        std::cout << "simd = " << simdLevelName(system.getSimdLevel()) << (system.getFastRsqrt() && system.getSimdLevel() != SimdLevel::Scalar ? " (fast rsqrt)" : "") << "\n";
+    }
+    if(cfg.forcePrecision == "float"){
+        std::cout << "forcePrecision = float (pair terms in float, row sums in double)\n";
+        // mixed precision reports its error against the long double sum once, as the approximate engines do
+        if(cfg.accuracySamples > 0){
+            const ForceErrorReport report = system.measureForceError(static_cast<std::size_t>(cfg.accuracySamples));
+            std::cout << "force error vs long double (" << report.samples << " bodies): rms = " << static_cast<double>(report.rmsRelError) << ", max = " << static_cast<double>(report.maxRelError) << "\n";
+        }
+    }
+    if(cfg.forceEngine != "direct"){
+        if(cfg.forceEngine == "pm"){
+            std::cout << "pmGrid = " << cfg.pmGrid << " (" << cfg.pmAssign << ", " << cfg.pmBoundary;
+            if(cfg.pmBoundary == "periodic"){
+                std::cout << ", box " << static_cast<double>(cfg.pmBoxSize);
+            }
+            std::cout << ")\n";
+        }
+        else{
+            std::cout << "theta = " << static_cast<double>(cfg.theta) << "\n";
+        }
+        if(cfg.forceEngine == "fmm"){
+            std::cout << "fmmOrder = " << cfg.fmmOrder << "\n";
+        }
+        // approximate engines report their error against the direct sum once
+        if(cfg.accuracySamples > 0){
+            const ForceErrorReport report = system.measureForceError(static_cast<std::size_t>(cfg.accuracySamples));
+            std::cout << "force error vs direct (" << report.samples << " bodies): rms = " << static_cast<double>(report.rmsRelError) << ", max = " << static_cast<double>(report.maxRelError) << "\n";
+            if(cfg.forceEngine == "pm"){
+                // the mesh smooths below a cell, part of the error is that smoothing against eps2
+                std::cout << "pm cell = " << static_cast<double>(system.pmSolver().cellSize()) << ", smoothing length = " << static_cast<double>(system.pmSolver().smoothingLength()) << "\n";
+            }
+        }
+    }
     std::cout << "dt = " << static_cast<double>(cfg.dt) << "\n";
     std::cout << "steps = " << cfg.steps << "\n";
     std::cout << "bodiesFile = " << cfg.bodiesFile << "\n";
     std::cout << "outTrajFile = " << cfg.outTrajFile << "\n";
-    std::cout << "includeEnergy = " << (cfg.includeEnergy ? "true" : "false");
+    std::cout << "outFormat = " << cfg.outFormat;
+    if(format == LogFormat::Compressed){
+        std::cout << " (compressPosError = " << static_cast<double>(cfg.compressPosError) << ", compressVelError = " << static_cast<double>(cfg.compressVelError) << ", keyframeEvery = " << cfg.keyframeEvery << ", " << trajectoryCodecName(defaultTrajectoryCodec()) << " codec)";
+    }
+    std::cout << "\n";
+    std::cout << "asyncLog = " << (cfg.asyncLog ? "true" : "false");
+    if(cfg.asyncLog){
+        std::cout << " (logBuffer = " << cfg.logBuffer << ")";
+    }
+    std::cout << "\n";
+    std::cout << "includeEnergy = " << (cfg.includeEnergy ? "true" : "false") << "\n";
+    if(analysis.active()){
+        std::cout << "analysis = " << analysis.probeList() << " (" << cfg.analysisFile << ")\n";
+    }
+    if(cfg.dumpEvery > 0){
+        std::cout << "dumpEvery = " << cfg.dumpEvery << "\n";
+    }
     
-    // SFML
-    // window dimension in pixels
-    const unsigned int windowWidth = 800U;
-    const unsigned int windowHeight = 800U;
-
-    // create VideoMode and RenderWindow
-    sf::Vector2u size(windowWidth, windowHeight);
-    sf::VideoMode mode(size);
-    sf::RenderWindow window(mode, "N-Body Simulator");
-    window.setFramerateLimit(60U);
-
-    // scale factor from simulation units to screen pixels
-    const float viewScale = 200.0f;
-
-    // convert simulation coordinates (x, y) to screen coordinates
-    // simulation origin = (0, 0) put to center of window
-    // y-axis inverted so y points up
-    const auto toScreen = [&](Real x, Real y) -> sf::Vector2f{
-        const float sx = static_cast<float>(x) * viewScale + static_cast<float>(windowWidth) / 2.0f;
-        const float sy = -static_cast<float>(y) * viewScale + static_cast<float>(windowHeight) / 2.0f;
-        return sf::Vector2f(sx, sy);
-    };
+    std::cout << "headless = " << (headless ? "true" : "false") << "\n";
+    std::cout << "profile = " << (cfg.profile ? "true" : "false") << "\n";
+    if(collisionMode != CollisionMode::Off){
+        std::cout << "collisions = " << cfg.collisions << " (" << (cfg.radiiFile.empty() ? "collisionRadius = " + std::to_string(static_cast<double>(cfg.collisionRadius)) : "radiiFile = " + cfg.radiiFile) << ")\n";
+    }
+    if(cfg.checkpointEvery > 0){
+        std::cout << "checkpointEvery = " << cfg.checkpointEvery << " (" << cfg.checkpointFile << ")\n";
+    }
+    if(resuming){
+        std::cout << "resumeFrom = " << cfg.resumeFrom << " (step " << startStep << ", t = " << static_cast<double>(t) << ")\n";
+    }
 
-    // pre-create circle shapes for each body
-    // colored by index
-    const std::size_t bodyCount = system.bodyCount();
-    std::vector<sf::CircleShape> bodyShapes;
-    bodyShapes.reserve(bodyCount);
-
-    // random color gen
-    std::random_device rd;
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> colorDist(50, 255);
-
-    for(std::size_t i = 0; i < bodyCount; ++i){
-        sf::CircleShape circle;
-        const float radius = 16.0f;
-        circle.setRadius(radius);
-        // set origin to center
-        circle.setOrigin(sf::Vector2f(radius, radius));
-        // color setting
-        if(i == 0U){
-            circle.setFillColor(sf::Color::Red);
-        }
-        else if(i == 1U){
-            circle.setFillColor(sf::Color::Green);
-        }
-        else if(i==2U){
-            circle.setFillColor(sf::Color::Blue);
-        }
-        else{
-            // outside of the three main bodies, set to random color
-            const std::uint8_t r = static_cast<std::uint8_t>(colorDist(rng));
-            const std::uint8_t g = static_cast<std::uint8_t>(colorDist(rng));
-            const std::uint8_t b = static_cast<std::uint8_t>(colorDist(rng));
-            circle.setFillColor(sf::Color(r, g, b));
-        }
-        bodyShapes.push_back(circle);
+    // checkpoints are copied here and written by a background thread, which commits the file
+    // only once the trajectory holds every frame up to the checkpoint
+    CheckpointWriter<T> checkpoints;
+    if(cfg.checkpointEvery > 0){
+        checkpoints.open(cfg.checkpointFile);
     }
+    long long step = startStep;
+    std::vector<CollisionEvent> collisionEvents;
+    unsigned long long collisionCount = 0;
+    const auto checkpoint = [&](){
+        const unsigned long long frames = logger.framesLogged();
+        logger.flush();
+        analysis.flush();
+        checkpoints.submit(system, t, dt, step, frames, method, [&logger, frames](){
+            logger.waitFlushed(frames);
+        });
+    };
 
-    // step counter for simulation loop
-    long long step = 0;
+    // one integration step plus periodic logging, shared by the windowed and headless loops
+    const auto advance = [&](){
+        // a step that ends on a logged or analysed energy sums the potential inside its force pass
+        system.setTrackPotential((cfg.includeEnergy && (step + 1) % dumpEvery == 0) || (analysis.needsEnergy() && (step + 1) % cfg.outputEvery == 0));
 
-    // while the window is open, simulator:
-        // handle window events
-        // advanced n-body system by one time step
-        // log state every outputEvery steps
-        // draw each body as a colored circle to its position
-            
-    while(window.isOpen() && step < cfg.steps){
-        // pollEvent() returns pointer-like object which gets dereferenced
-        while(auto event = window.pollEvent()){
-            // check for window close event
-            if(event->is<sf::Event::Closed>()){
-                window.close();
-                }
-            }
         // time integration
         if(method == "euler"){
-            system.stepEuler(cfg.dt);
+            system.stepEuler(dt);
         }
         else if(method == "semieuler"){
-            system.stepSemiEuler(cfg.dt);
+            system.stepSemiEuler(dt);
+        }
+        else if(method == "leapfrog"){
+            system.stepLeapfrog(dt);
+        }
+        else if(method == "block"){
+            system.stepBlock(dt);
+        }
+        else if(method == "yoshida"){
+            system.stepYoshida(dt);
+        }
+        else if(method == "hermite"){
+            system.stepHermite(dt);
         }
         else{
-            system.stepVerlet(cfg.dt);
+            system.stepVerlet(dt);
         }
 
-        t += cfg.dt;
+        t += dt;
         ++step;
 
-        // log the state to CSV every outputEvery steps
-        if(step % cfg.outputEvery == 0){
+        // every body is synchronized between steps, merged bodies are gone before the state is logged
+        if(collisionMode != CollisionMode::Off){
+            system.resolveCollisions(collisionMode, collisionEvents);
+            collisionCount += collisionEvents.size();
+            if(collisionOut.is_open()){
+                // body numbers as in the trajectory columns
+                for(std::size_t k = 0; k < collisionEvents.size(); ++k){
+                    collisionOut << t << "," << collisionEvents[k].idA + 1 << "," << collisionEvents[k].idB + 1 << "\n";
+                }
+            }
+        }
+
+        // log the full state every dumpEvery steps, the in-situ reductions every outputEvery steps
+        if(step % dumpEvery == 0){
             logger.logState(t, system, cfg.includeEnergy);
         }
+        if(step % cfg.outputEvery == 0){
+            analysis.analyze(t, system);
+        }
+        if(cfg.checkpointEvery > 0 && step % cfg.checkpointEvery == 0){
+            checkpoint();
+        }
+    };
 
-        // rendering
-        window.clear(sf::Color::Black);
-        // get const reference to the bodies for drawing
-        const std::vector<Body2D> &bodies = system.bodies();
-        for(std::size_t i = 0; i < bodyCount; ++i){
-            const Body2D &b = bodies[i];
-            const sf::Vector2f screenPos = toScreen(b.r.x, b.r.y);
-            bodyShapes[i].setPosition(screenPos);
-            window.draw(bodyShapes[i]);
+    // phase timers cover the stepping loop, the same span as the wall time
+    const unsigned long long pairsStart = system.pairInteractions();
+    if(cfg.profile){
+        phaseProfiler().start(!cfg.profileTrace.empty());
+    }
+    const std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    if(headless){
+        // no window and no frame limit, integrate as fast as the physics allows
+        while(step < cfg.steps){
+            advance();
         }
-        // draw frame on screen
-        window.display();
+    }
+#ifndef NBODY_HEADLESS
+    else{
+        // read-only view for drawing, in SoA mode the non-const bodies() would force an array reload
+        const NBodySystem2D<T> &view = system;
+        runWindowed(view, cfg, cfg.steps - step, advance);
+    }
+#endif
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    if(cfg.profile){
+        phaseProfiler().stop();
     }
 
-    // close + summary
+    // a run that stopped between checkpoints, or whose window was closed, can still be continued
+    if(cfg.checkpointEvery > 0 && step > startStep && step % cfg.checkpointEvery != 0){
+        checkpoint();
+    }
 
+    // close + summary, close() waits for the writer to finish the queue
+    // the checkpoint writer may be waiting for the trajectory, so it is closed first
+    checkpoints.close();
     logger.close();
+    analysis.close();
 
     std::cout << "Simulation finished.\n";
     std::cout << "Steps: " << cfg.steps << ", dt: " << static_cast<double>(cfg.dt) << ", method: " << cfg.method << "\n";
     std::cout << "Output written to " << cfg.outTrajFile << ".\n";
+    if(analysis.active()){
+        std::cout << "Analysis rows written to " << cfg.analysisFile << ": " << analysis.rowsWritten() << "\n";
+    }
+    std::cout << "Wall time: " << wallSeconds << " s\n";
+    if(cfg.asyncLog){
+        std::cout << "Log buffer full: " << logger.fullWaits() << " times\n";
+    }
+    if(cfg.checkpointEvery > 0){
+        std::cout << "Checkpoints written: " << checkpoints.written();
+        if(checkpoints.lastStep() >= 0){
+            std::cout << " (last at step " << checkpoints.lastStep() << ")";
+        }
+        std::cout << ", waits: " << checkpoints.waits() << "\n";
+        if(checkpoints.failures() > 0){
+            std::cerr << "Checkpoints that failed to write: " << checkpoints.failures() << "\n";
+        }
+    }
+    if(collisionMode != CollisionMode::Off){
+        std::cout << "Collisions: " << collisionCount << (collisionMode == CollisionMode::Merge ? " merges" : " overlapping pairs") << ", bodies left: " << system.bodyCount() << " of " << system.idCount() << "\n";
+        if(collisionOut.is_open()){
+            std::cout << "Collision events written to " << cfg.collisionLog << ".\n";
+        }
+    }
+    if(method == "block"){
+        // bins the bodies would start the next step in
+        const std::vector<std::size_t> bins = system.blockBinCounts();
+        std::cout << "Block bins (dt / 2^k: bodies):";
+        for(std::size_t k = 0; k < bins.size(); ++k){
+            if(bins[k] > 0){
+                std::cout << " " << k << ": " << bins[k];
+            }
+        }
+        std::cout << "\n";
+    }
+    if(cfg.profile){
+        // direct-sum pair count, for barneshut, fmm and pm an equivalent rate
+        RunCounters counters;
+        counters.steps = step - startStep;
+        counters.interactions = static_cast<double>(system.pairInteractions() - pairsStart);
+        counters.bytesWritten = logger.bytesWritten();
+        phaseProfiler().printReport(std::cout, counters);
+        if(!cfg.profileJson.empty()){
+            if(phaseProfiler().writeJson(cfg.profileJson, counters)){
+                std::cout << "Profile written to " << cfg.profileJson << ".\n";
+            }
+            else{
+                std::cerr << "Could not open profile file " << cfg.profileJson << ".\n";
+            }
+        }
+        if(!cfg.profileTrace.empty()){
+            if(phaseProfiler().writeTrace(cfg.profileTrace)){
+                std::cout << "Trace written to " << cfg.profileTrace << ".\n";
+            }
+            else{
+                std::cerr << "Could not open trace file " << cfg.profileTrace << ".\n";
+            }
+        }
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]){   
+    // determine config file path
+    // allowed to override by passing a filename on the command line
+    // --headless skips the window, same as headless = true in the config
+    std::string configPath = "config.txt";
+    bool headlessFlag = false;
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        if(arg == "--headless"){
+            headlessFlag = true;
+        }
+        else{
+            configPath = arg;
+        }
+    }
+    // load and validate simulation config
+    SimulationConfig cfg;
+    if(!cfg.loadFromFile(configPath)){
+        std::cerr << "Unable to read config file " << configPath << ".\n";
+        return 1;
+    }
+    if(headlessFlag){
+        cfg.headless = true;
+    }
+    if(!cfg.validate(std::cerr)){
+        return 1;
+    }
+
+    // dispatch on precision, each scalar type gets its own compiled kernels
+    if(cfg.precision == "float"){
+        return runSimulation<float>(cfg);
+    }
+    if(cfg.precision == "double"){
+        return runSimulation<double>(cfg);
+    }
+    return runSimulation<long double>(cfg);
+}
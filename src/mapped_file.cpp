@@ -0,0 +1,110 @@
+// mappedfile class, read-only view of a whole file
+
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(_WIN32)
+#define NBODY_HAS_MMAP 0
+#else
+#define NBODY_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief construct a closed file
+ *
+ */
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_mapped(false), m_buffer(){}
+
+/**
+ * @brief unmap and close
+ *
+ */
+MappedFile::~MappedFile(){
+    close();
+}
+
+/**
+ * @brief map a file
+ *
+ * @param path file to open
+ * @return true if the file could be opened, an empty file has size() 0
+ * @return false otherwise
+ */
+bool MappedFile::open(const std::string &path){
+    close();
+#if NBODY_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+    struct stat info;
+    if(::fstat(fd, &info) != 0){
+        ::close(fd);
+        return false;
+    }
+    // mmap rejects a zero length, an empty file is simply an empty view
+    if(info.st_size <= 0){
+        ::close(fd);
+        return true;
+    }
+    const std::size_t length = static_cast<std::size_t>(info.st_size);
+    void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive, the descriptor is no longer needed
+    ::close(fd);
+    if(mapped == MAP_FAILED){
+        return false;
+    }
+    m_data = static_cast<const char *>(mapped);
+    m_size = length;
+    m_mapped = true;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if(!in){
+        return false;
+    }
+    m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    m_data = m_buffer.empty() ? nullptr : m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+    return true;
+}
+
+/**
+ * @brief unmap and release the file
+ *
+ */
+void MappedFile::close(){
+#if NBODY_HAS_MMAP
+    if(m_mapped && m_data != nullptr){
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_buffer.clear();
+}
+
+/**
+ * @brief first byte of the file, nullptr when closed or empty
+ *
+ * @return const char*
+ */
+const char *MappedFile::data() const{
+    return m_data;
+}
+
+/**
+ * @brief file size in bytes
+ *
+ * @return std::size_t
+ */
+std::size_t MappedFile::size() const{
+    return m_size;
+}
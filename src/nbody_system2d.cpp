@@ -1,20 +1,31 @@
 // nbodysystem2d class, vector+G+eps2, physics
 
 #include "nbody_system2d.h"
+#include "phase_profiler.h"
 
+#include <algorithm>
 #include <cmath>
+#include <type_traits>
 
 /**
- * @brief 2d newtonian n-body system
+ * @brief 2d newtonian n-body system, using scalar type T for all state and arithmetic
+ *        T = float, double or long double, picked at startup by the precision config key
  * Stores:
- *      list of Body2D objects with masses, positions, velocities, and forces
+ *      list of Body2D<T> objects with masses, positions, velocities, and forces
+ *          or, in SoA mode, one array per field plus a Body2D<T> copy refreshed on demand
  *      graviational constant G
  *      softening parameter eps2 for when bodies get close
  * Responsbile for:
  *      managing list of bodies: add, query
- *      computing pairwise gravitational forces O(n^2)
+ *      computing gravitational forces, pairwise O(n^2), Barnes-Hut O(n log n), FMM O(n) or particle mesh
  *      computing total energy = kinetic + potential
- *      advancing the system with either euler, semieuler, or verlet
+ *      advancing the system with either euler, semieuler, verlet, kick-drift-kick leapfrog, block timesteps,
+ *      4th-order yoshida or 4th-order hermite
+ *      keeping the last forces while positions and parameters are unchanged, so leapfrog reuses them
+ *      optionally summing the potential energy in the force pass, so totalEnergy() only adds kinetic energy
+ *      spreading force, energy and update loops over an owned persistent thread pool
+ *      giving every body a stable id that survives bodies being merged away
+ *      finding overlapping bodies with a uniform spatial hash grid and merging or reporting them
  */
 /**
  * @brief default constructor
@@ -24,21 +35,25 @@
  *      bodies list empty
  * 
  */
-NBodySystem2D::NBodySystem2D() : m_bodies(), m_G(static_cast<Real>(1)), m_eps2(static_cast<Real>(0)){}
+template<typename T>
+NBodySystem2D<T>::NBodySystem2D() : m_bodies(), m_soa(), m_scratch(), m_storage(StorageMode::AoS), m_mirrorStale(false), m_arraysStale(false), m_G(static_cast<T>(1)), m_eps2(static_cast<T>(0)), m_engine(ForceEngine::Direct), m_theta(static_cast<T>(0.5)), m_simd(detectSimdLevel()), m_fastRsqrt(false), m_floatPairs(false), m_pairX(), m_pairY(), m_pairM(), m_pairAx(), m_pairAy(), m_pairPhi(), m_tree(), m_fmm(), m_pm(), m_pool(), m_bandForces(), m_bandRows(), m_forcesValid(false), m_trackPotential(false), m_potentialValid(false), m_potential(static_cast<T>(0)), m_rowPotential(), m_bandPotential(), m_forceEvaluations(0), m_pairInteractions(0), m_blockLevels(8), m_blockEta(static_cast<T>(0.025)), m_blockBin(), m_blockActive(), m_jerkX(), m_jerkY(), m_jerkStartX(), m_jerkStartY(), m_hermiteStart(), m_hermiteEvaluation(0), m_ids(), m_idCount(0), m_radius(), m_grid(), m_collisionPairs(), m_collisionRoot(), m_collisionMembers(), m_collisionDead(){}
 /**
  * @brief Construct with specified G and softening parameter
  * 
  * @param GValue gravitational constant
  * @param eps2Value softening value added to r^2
  */
-NBodySystem2D::NBodySystem2D(Real GValue, Real eps2Value) : m_bodies(), m_G(GValue), m_eps2(eps2Value){}
+template<typename T>
+NBodySystem2D<T>::NBodySystem2D(T GValue, T eps2Value) : m_bodies(), m_soa(), m_scratch(), m_storage(StorageMode::AoS), m_mirrorStale(false), m_arraysStale(false), m_G(GValue), m_eps2(eps2Value), m_engine(ForceEngine::Direct), m_theta(static_cast<T>(0.5)), m_simd(detectSimdLevel()), m_fastRsqrt(false), m_floatPairs(false), m_pairX(), m_pairY(), m_pairM(), m_pairAx(), m_pairAy(), m_pairPhi(), m_tree(), m_fmm(), m_pm(), m_pool(), m_bandForces(), m_bandRows(), m_forcesValid(false), m_trackPotential(false), m_potentialValid(false), m_potential(static_cast<T>(0)), m_rowPotential(), m_bandPotential(), m_forceEvaluations(0), m_pairInteractions(0), m_blockLevels(8), m_blockEta(static_cast<T>(0.025)), m_blockBin(), m_blockActive(), m_jerkX(), m_jerkY(), m_jerkStartX(), m_jerkStartY(), m_hermiteStart(), m_hermiteEvaluation(0), m_ids(), m_idCount(0), m_radius(), m_grid(), m_collisionPairs(), m_collisionRoot(), m_collisionMembers(), m_collisionDead(){}
 
 /**
  * @brief set gravitational constant
  * 
  * @param GValue gravitational constant
  */
-void NBodySystem2D::setG(Real GValue){
+template<typename T>
+void NBodySystem2D<T>::setG(T GValue){
+    m_forcesValid = false;
     m_G = GValue;
 }
 
@@ -48,103 +63,1677 @@ void NBodySystem2D::setG(Real GValue){
  * 
  * @param eps2Value softening parameter
  */
-void NBodySystem2D::setEps2(Real eps2Value){
+template<typename T>
+void NBodySystem2D<T>::setEps2(T eps2Value){
+    m_forcesValid = false;
     m_eps2 = eps2Value;
 }
 
 /**
  * @brief Get gravitational constant
  * 
- * @return Real 
+ * @return T 
  */
-Real NBodySystem2D::getG() const{
+template<typename T>
+T NBodySystem2D<T>::getG() const{
     return m_G;
 }
 
 /**
  * @brief Get softening parameter
  * 
- * @return Real 
+ * @return T 
  */
-Real NBodySystem2D::getEps2() const{
+template<typename T>
+T NBodySystem2D<T>::getEps2() const{
     return m_eps2;
 }
 
+/**
+ * @brief select memory layout of the bodies
+ *        existing bodies are converted, forces/accelerations are kept
+ * 
+ * @param mode AoS or SoA
+ */
+template<typename T>
+void NBodySystem2D<T>::setStorageMode(StorageMode mode){
+    if(mode == m_storage){
+        return;
+    }
+    if(mode == StorageMode::SoA){
+        m_soa.load(m_bodies);
+        m_mirrorStale = false;
+        m_arraysStale = false;
+    }
+    else{
+        // bring the Body2D<T> list up to date, it becomes the only copy
+        syncMirror();
+        m_soa = BodyArrays2D<T>();
+    }
+    m_storage = mode;
+}
+
+/**
+ * @brief Get memory layout of the bodies
+ * 
+ * @return StorageMode 
+ */
+template<typename T>
+StorageMode NBodySystem2D<T>::getStorageMode() const{
+    return m_storage;
+}
+
+/**
+ * @brief select the force evaluation engine used by computeForces()
+ * 
+ * @param engine Direct, BarnesHut, Fmm or Pm
+ */
+template<typename T>
+void NBodySystem2D<T>::setForceEngine(ForceEngine engine){
+    m_forcesValid = false;
+    m_engine = engine;
+}
+
+/**
+ * @brief Get force evaluation engine
+ * 
+ * @return ForceEngine 
+ */
+template<typename T>
+ForceEngine NBodySystem2D<T>::getForceEngine() const{
+    return m_engine;
+}
+
+/**
+ * @brief set Barnes-Hut opening angle
+ *        smaller is more accurate and slower, 0 reproduces the direct sum
+ * 
+ * @param thetaValue opening angle, cell size / distance threshold
+ */
+template<typename T>
+void NBodySystem2D<T>::setTheta(T thetaValue){
+    m_forcesValid = false;
+    m_theta = thetaValue;
+}
+
+/**
+ * @brief Get Barnes-Hut opening angle
+ * 
+ * @return T 
+ */
+template<typename T>
+T NBodySystem2D<T>::getTheta() const{
+    return m_theta;
+}
+
+/**
+ * @brief set FMM expansion order
+ *        higher is more accurate and slower
+ * 
+ * @param order highest derivative kept, clamped to [1, FmmSolver2D<T>::MAX_ORDER]
+ */
+template<typename T>
+void NBodySystem2D<T>::setFmmOrder(int order){
+    m_forcesValid = false;
+    m_fmm.setOrder(order);
+}
+
+/**
+ * @brief Get FMM expansion order
+ * 
+ * @return int 
+ */
+template<typename T>
+int NBodySystem2D<T>::getFmmOrder() const{
+    return m_fmm.getOrder();
+}
+
+/**
+ * @brief set particle-mesh grid
+ *        structure below the cell size is smoothed away, the error drops fast once sqrt(eps2) spans a few cells
+ * 
+ * @param cells cells per side, rounded up to a power of two in [PmSolver2D<T>::MIN_GRID, PmSolver2D<T>::MAX_GRID]
+ * @param assignment Cic or Tsc
+ */
+template<typename T>
+void NBodySystem2D<T>::setPmGrid(std::size_t cells, PmAssignment assignment){
+    m_forcesValid = false;
+    m_pm.setGridSize(cells);
+    m_pm.setAssignment(assignment);
+}
+
+/**
+ * @brief set particle-mesh boundary condition
+ * 
+ * @param boundary Isolated or Periodic
+ * @param boxSize side of the periodic box centred on the origin, ignored for Isolated
+ */
+template<typename T>
+void NBodySystem2D<T>::setPmBoundary(PmBoundary boundary, T boxSize){
+    m_forcesValid = false;
+    m_pm.setBoundary(boundary, boxSize);
+}
+
+/**
+ * @brief Get particle-mesh solver, for its settings and the cell size and smoothing length of the last pass
+ * 
+ * @return const PmSolver2D<T>& 
+ */
+template<typename T>
+const PmSolver2D<T> &NBodySystem2D<T>::pmSolver() const{
+    return m_pm;
+}
+
+/**
+ * @brief copy G, eps2 and every setting that changes forces or energies from another system
+ *        engine, theta, FMM order, particle-mesh grid and boundary, SIMD level, fast rsqrt and float pairs
+ *        bodies, storage, threads and block timestep settings are left as they are
+ * 
+ * @param other system whose forces and energies this one should reproduce
+ */
+template<typename T>
+void NBodySystem2D<T>::copyForceSettings(const NBodySystem2D<T> &other){
+    m_forcesValid = false;
+    m_potentialValid = false;
+    m_G = other.m_G;
+    m_eps2 = other.m_eps2;
+    m_engine = other.m_engine;
+    m_theta = other.m_theta;
+    m_fmm.setOrder(other.m_fmm.getOrder());
+    m_pm.setGridSize(other.m_pm.getGridSize());
+    m_pm.setAssignment(other.m_pm.getAssignment());
+    m_pm.setBoundary(other.m_pm.getBoundary(), other.m_pm.getBoxSize());
+    // the level as set, getSimdLevel() reports Scalar wherever this T runs the scalar loop
+    m_simd = other.m_simd;
+    m_fastRsqrt = other.m_fastRsqrt;
+    m_floatPairs = other.m_floatPairs;
+}
+
+/**
+ * @brief select instruction set for the direct-sum kernel
+ *        clamped to what the running CPU supports, long double always runs the scalar loop
+ * 
+ * @param level Scalar, Avx2 or Avx512
+ */
+template<typename T>
+void NBodySystem2D<T>::setSimdLevel(SimdLevel level){
+    m_forcesValid = false;
+    m_simd = resolveSimdLevel(level);
+}
+
+/**
+ * @brief Get instruction set used by the direct-sum kernel, after clamping
+ * 
+ * @return SimdLevel 
+ */
+template<typename T>
+SimdLevel NBodySystem2D<T>::getSimdLevel() const{
+    return simdDirectActive() || floatPairsActive() ? m_simd : SimdLevel::Scalar;
+}
+
+/**
+ * @brief use reciprocal square root estimate + Newton refinement in the SIMD kernel
+ *        slightly less accurate than 1 / sqrt, no effect on the scalar loop
+ * 
+ * @param enabled true to use the fast path
+ */
+template<typename T>
+void NBodySystem2D<T>::setFastRsqrt(bool enabled){
+    m_forcesValid = false;
+    m_fastRsqrt = enabled;
+}
+
+/**
+ * @brief Get whether the SIMD kernel uses the fast reciprocal square root
+ * 
+ * @return true 
+ * @return false 
+ */
+template<typename T>
+bool NBodySystem2D<T>::getFastRsqrt() const{
+    return m_fastRsqrt;
+}
+
+/**
+ * @brief mixed precision for the direct sum: float pair terms, double row sums, state and integration stay in T
+ *        each pass subtracts a local origin, the centre of the bodies' bounding box, before rounding positions
+ *        to float, so the float bits go to the separations instead of the absolute position
+ *        only useful for T = double or long double, float runs ignore it; the tree engines and the
+ *        Hermite jerk sum are not affected, direct rows of block substeps are
+ * 
+ * @param enabled true for float pair terms
+ */
+template<typename T>
+void NBodySystem2D<T>::setFloatPairs(bool enabled){
+    m_forcesValid = false;
+    m_floatPairs = enabled;
+}
+
+/**
+ * @brief Get whether the direct sum evaluates pair terms in float
+ * 
+ * @return true 
+ * @return false 
+ */
+template<typename T>
+bool NBodySystem2D<T>::getFloatPairs() const{
+    return m_floatPairs;
+}
+
+/**
+ * @brief set number of power-of-two time bins used by stepBlock()
+ *        bin k steps with dt / 2^k, so the smallest step is dt / 2^(levels - 1)
+ * 
+ * @param levels number of bins, clamped to [1, MAX_BLOCK_LEVELS]
+ */
+template<typename T>
+void NBodySystem2D<T>::setBlockLevels(int levels){
+    m_blockLevels = std::min(std::max(levels, 1), MAX_BLOCK_LEVELS);
+}
+
+/**
+ * @brief Get number of time bins used by stepBlock()
+ * 
+ * @return int 
+ */
+template<typename T>
+int NBodySystem2D<T>::getBlockLevels() const{
+    return m_blockLevels;
+}
+
+/**
+ * @brief set accuracy parameter of the block timestep criterion
+ *        a body wants the step sqrt(2 * eta * sqrt(eps2) / |a|), smaller eta = smaller steps
+ * 
+ * @param eta accuracy parameter, > 0
+ */
+template<typename T>
+void NBodySystem2D<T>::setBlockEta(T eta){
+    m_blockEta = eta;
+}
+
+/**
+ * @brief Get accuracy parameter of the block timestep criterion
+ * 
+ * @return T 
+ */
+template<typename T>
+T NBodySystem2D<T>::getBlockEta() const{
+    return m_blockEta;
+}
+
+/**
+ * @brief number of bodies in each time bin after the last stepBlock()
+ * 
+ * @return std::vector<std::size_t> index = bin, empty before the first block step
+ */
+template<typename T>
+std::vector<std::size_t> NBodySystem2D<T>::blockBinCounts() const{
+    std::vector<std::size_t> counts;
+    if(m_blockBin.empty()){
+        return counts;
+    }
+    counts.assign(static_cast<std::size_t>(m_blockLevels), 0);
+    for(std::size_t i = 0; i < m_blockBin.size(); ++i){
+        ++counts[static_cast<std::size_t>(m_blockBin[i])];
+    }
+    return counts;
+}
+
+/**
+ * @brief set number of threads used by force, energy and update loops
+ *        workers are started once here and reused by every step, 1 runs everything on the caller
+ * 
+ * @param count total threads, 0 = all hardware threads
+ */
+template<typename T>
+void NBodySystem2D<T>::setThreadCount(std::size_t count){
+    if(count == 0){
+        count = ThreadPool::hardwareThreads();
+    }
+    if(count == getThreadCount()){
+        return;
+    }
+    m_pool.reset();
+    if(count > 1){
+        m_pool = std::make_unique<ThreadPool>(count);
+    }
+}
+
+/**
+ * @brief Get number of threads used by force, energy and update loops
+ * 
+ * @return std::size_t 
+ */
+template<typename T>
+std::size_t NBodySystem2D<T>::getThreadCount() const{
+    return m_pool ? m_pool->threadCount() : 1;
+}
+
+/**
+ * @brief let force passes also sum the potential energy from the 1 / r they already compute
+ *        totalEnergy() then adds the kinetic energy to it while positions are unchanged
+ *        Direct, Fmm and Pm engines, with Barnes-Hut totalEnergy() keeps the exact pair sum
+ * 
+ * @param enabled true to fuse the potential into the following force passes
+ */
+template<typename T>
+void NBodySystem2D<T>::setTrackPotential(bool enabled){
+    // forces stay valid, only the next pass changes
+    m_trackPotential = enabled;
+}
+
+/**
+ * @brief Get whether force passes also sum the potential energy
+ * 
+ * @return true 
+ * @return false 
+ */
+template<typename T>
+bool NBodySystem2D<T>::getTrackPotential() const{
+    return m_trackPotential;
+}
+
+/**
+ * @brief true if the last force pass summed the potential and positions have not changed since
+ * 
+ * @return true totalEnergy() is O(n)
+ * @return false totalEnergy() runs the full potential sum
+ */
+template<typename T>
+bool NBodySystem2D<T>::potentialCached() const{
+    return m_forcesValid && m_potentialValid;
+}
+
+/**
+ * @brief number of force passes since construction, block steps count only the ticks where some step ends
+ * 
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long NBodySystem2D<T>::forceEvaluations() const{
+    return m_forceEvaluations;
+}
+
+/**
+ * @brief pair interactions of all force passes so far, direct-sum equivalent
+ *        a full pass counts n(n-1)/2, a block substep counts n-1 per active body
+ * 
+ * @return unsigned long long
+ */
+template<typename T>
+unsigned long long NBodySystem2D<T>::pairInteractions() const{
+    return m_pairInteractions;
+}
+
 /**
  * @brief add new body to system
  * 
- * @param body instance of Body2D to append to vector
+ * @param body instance of Body2D<T> to append to vector
+ */
+template<typename T>
+void NBodySystem2D<T>::addBody(const Body2D<T> &body){
+    m_forcesValid = false;
+    if(m_storage == StorageMode::SoA){
+        syncArrays();
+        m_soa.pushBack(body);
+        m_mirrorStale = true;
+        return;
+    }
+    m_bodies.push_back(body);
+}
+
+/**
+ * @brief reserve room for count bodies in total, so following addBody()/addBodies() calls do not reallocate
+ * 
+ * @param count total number of bodies expected
+ */
+template<typename T>
+void NBodySystem2D<T>::reserveBodies(std::size_t count){
+    if(m_storage == StorageMode::SoA){
+        syncArrays();
+        m_soa.reserve(count);
+    }
+    m_bodies.reserve(count);
+}
+
+/**
+ * @brief append count bodies at once, same result as count addBody() calls
+ * 
+ * @param first pointer to the first body to append
+ * @param count number of bodies
+ */
+template<typename T>
+void NBodySystem2D<T>::addBodies(const Body2D<T> *first, std::size_t count){
+    if(count == 0){
+        return;
+    }
+    m_forcesValid = false;
+    if(m_storage == StorageMode::SoA){
+        syncArrays();
+        for(std::size_t i = 0; i < count; ++i){
+            m_soa.pushBack(first[i]);
+        }
+        m_mirrorStale = true;
+        return;
+    }
+    m_bodies.insert(m_bodies.end(), first, first + count);
+}
+
+/**
+ * @brief returns number of bodies in system
+ * 
+ * @return std::size_t number of bodies in system
+ */
+template<typename T>
+std::size_t NBodySystem2D<T>::bodyCount() const{
+    if(m_storage == StorageMode::SoA && !m_arraysStale){
+        return m_soa.size();
+    }
+    return m_bodies.size();
+}
+
+/**
+ * @brief non-const access to body list
+ *        in SoA mode edits to the list are copied back into the arrays before the next step
+ * 
+ * @return std::vector<Body2D<T>>& 
+ */
+template<typename T>
+std::vector<Body2D<T>> &NBodySystem2D<T>::bodies(){
+    syncMirror();
+    // caller may move bodies or change masses
+    m_forcesValid = false;
+    if(m_storage == StorageMode::SoA){
+        // caller may edit the list, arrays get reloaded before they are used
+        m_arraysStale = true;
+    }
+    return m_bodies;
+}
+
+/**
+ * @brief const access to body list
+ *        in SoA mode the list is refreshed from the arrays first
+ * 
+ * @return const std::vector<Body2D<T>>& 
+ */
+template<typename T>
+const std::vector<Body2D<T>> &NBodySystem2D<T>::bodies() const{
+    syncMirror();
+    return m_bodies;
+}
+
+/**
+ * @brief SoA mode: refresh the Body2D<T> copy if the arrays changed since the last refresh
+ * 
+ */
+template<typename T>
+void NBodySystem2D<T>::syncMirror() const{
+    if(m_storage == StorageMode::SoA && m_mirrorStale && !m_arraysStale){
+        m_soa.store(m_bodies);
+        m_mirrorStale = false;
+    }
+}
+
+/**
+ * @brief SoA mode: reload the arrays if the Body2D<T> copy was handed out for editing
+ * 
+ */
+template<typename T>
+void NBodySystem2D<T>::syncArrays(){
+    if(m_storage == StorageMode::SoA && m_arraysStale){
+        m_soa.load(m_bodies);
+        m_arraysStale = false;
+        m_mirrorStale = false;
+    }
+}
+
+/**
+ * @brief fit ids and radii to the body count after the list was edited through bodies()
+ *        new bodies get fresh ids and radius 0
+ * 
+ */
+template<typename T>
+void NBodySystem2D<T>::syncPerBody() const{
+    const std::size_t n = bodyCount();
+    if(m_ids.size() > n){
+        m_ids.resize(n);
+    }
+    while(m_ids.size() < n){
+        m_ids.push_back(m_idCount++);
+    }
+    if(!m_radius.empty()){
+        m_radius.resize(n, static_cast<T>(0));
+    }
+}
+
+/**
+ * @brief set the collision radius of every body, in body order
+ *        missing entries are 0, a body with radius 0 only collides with bodies that have a radius
+ * 
+ * @param radii radius per body, >= 0
+ */
+template<typename T>
+void NBodySystem2D<T>::setRadii(const std::vector<T> &radii){
+    m_radius = radii;
+    syncPerBody();
+}
+
+/**
+ * @brief collision radius of every body
+ * 
+ * @return const std::vector<T>& one per body, empty if setRadii() was never called
+ */
+template<typename T>
+const std::vector<T> &NBodySystem2D<T>::radii() const{
+    syncPerBody();
+    return m_radius;
+}
+
+/**
+ * @brief stable id of every body, in body order
+ *        bodies get ids 0, 1, 2, ... as they are added, an id is never reused,
+ *        so ids stay ascending when merged bodies are compacted out
+ * 
+ * @return const std::vector<std::size_t>& one per body
+ */
+template<typename T>
+const std::vector<std::size_t> &NBodySystem2D<T>::bodyIds() const{
+    syncPerBody();
+    return m_ids;
+}
+
+/**
+ * @brief number of ids handed out so far, every id is below it
+ *        equals bodyCount() until bodies are merged
+ * 
+ * @return std::size_t
+ */
+template<typename T>
+std::size_t NBodySystem2D<T>::idCount() const{
+    syncPerBody();
+    return m_idCount;
+}
+
+/**
+ * @brief replace the ids, e.g. for a copy of another system's bodies
+ * 
+ * @param ids one per body, ascending, all below idCount
+ * @param idCount ids handed out so far
+ */
+template<typename T>
+void NBodySystem2D<T>::setBodyIds(const std::vector<std::size_t> &ids, std::size_t idCount){
+    m_ids = ids;
+    m_idCount = idCount;
+}
+
+/**
+ * @brief find bodies closer than the sum of their radii and report or merge them
+ *        candidates come from a uniform spatial hash grid rebuilt from the current positions, O(n)
+ *        Merge: a group of touching bodies keeps the id and index of its most massive member,
+ *        lowest id on ties, with the total mass, the centre of mass, the total momentum and
+ *        the radius sqrt(sum r^2) of a body of the same surface density;
+ *        the others are compacted out keeping the order
+ *        carried forces are patched for the merged bodies instead of a new pass while the groups
+ *        are small, O(n) per member, exact for the direct sum, Pm always recomputes; call between steps, when every body is synchronized
+ * 
+ * @param mode Off, Detect or Merge
+ * @param events overwritten with the collisions found, by ascending id
+ * @return std::size_t number of bodies merged away
+ */
+template<typename T>
+std::size_t NBodySystem2D<T>::resolveCollisions(CollisionMode mode, std::vector<CollisionEvent> &events){
+    events.clear();
+    if(mode == CollisionMode::Off){
+        return 0;
+    }
+    ScopedPhase timer(Phase::Collisions);
+    syncArrays();
+    syncPerBody();
+    const std::size_t n = bodyCount();
+    if(m_radius.empty() || n < 2){
+        return 0;
+    }
+
+    // the grid reads arrays, AoS mode gathers positions like the tree engines
+    const bool soa = m_storage == StorageMode::SoA;
+    if(!soa){
+        m_scratch.load(m_bodies);
+    }
+    BodyArrays2D<T> &arrays = soa ? m_soa : m_scratch;
+    m_grid.findOverlaps(arrays, m_radius, m_collisionPairs);
+    if(m_collisionPairs.empty()){
+        return 0;
+    }
+    if(mode == CollisionMode::Detect){
+        for(std::size_t k = 0; k < m_collisionPairs.size(); ++k){
+            events.push_back(CollisionEvent{m_ids[m_collisionPairs[k].first], m_ids[m_collisionPairs[k].second]});
+        }
+        return 0;
+    }
+
+    // union-find with the lowest index as root, chains of touching bodies end up in one group
+    m_collisionRoot.resize(n);
+    m_collisionMembers.clear();
+    for(std::size_t k = 0; k < m_collisionPairs.size(); ++k){
+        m_collisionMembers.push_back(m_collisionPairs[k].first);
+        m_collisionMembers.push_back(m_collisionPairs[k].second);
+    }
+    std::sort(m_collisionMembers.begin(), m_collisionMembers.end());
+    m_collisionMembers.erase(std::unique(m_collisionMembers.begin(), m_collisionMembers.end()), m_collisionMembers.end());
+    for(std::size_t k = 0; k < m_collisionMembers.size(); ++k){
+        m_collisionRoot[m_collisionMembers[k]] = m_collisionMembers[k];
+    }
+    const auto find = [this](std::size_t i){
+        while(m_collisionRoot[i] != i){
+            m_collisionRoot[i] = m_collisionRoot[m_collisionRoot[i]];
+            i = m_collisionRoot[i];
+        }
+        return i;
+    };
+    for(std::size_t k = 0; k < m_collisionPairs.size(); ++k){
+        const std::size_t a = find(m_collisionPairs[k].first);
+        const std::size_t b = find(m_collisionPairs[k].second);
+        if(a != b){
+            m_collisionRoot[std::max(a, b)] = std::min(a, b);
+        }
+    }
+    for(std::size_t k = 0; k < m_collisionMembers.size(); ++k){
+        m_collisionRoot[m_collisionMembers[k]] = find(m_collisionMembers[k]);
+    }
+    // groups contiguous, members of a group by index
+    std::stable_sort(m_collisionMembers.begin(), m_collisionMembers.end(), [this](std::size_t a, std::size_t b){
+        return m_collisionRoot[a] < m_collisionRoot[b];
+    });
+
+    // survivor of every group: most massive member, lowest index on ties
+    struct Group{
+        std::size_t survivor; // index that keeps the merged body
+        std::size_t first; // first member in m_collisionMembers
+        std::size_t last; // one past the last member
+    };
+    const std::size_t members = m_collisionMembers.size();
+    std::vector<Group> groups;
+    for(std::size_t first = 0; first < members;){
+        const std::size_t root = m_collisionRoot[m_collisionMembers[first]];
+        std::size_t last = first;
+        std::size_t s = m_collisionMembers[first];
+        while(last < members && m_collisionRoot[m_collisionMembers[last]] == root){
+            if(arrays.m[m_collisionMembers[last]] > arrays.m[s]){
+                s = m_collisionMembers[last];
+            }
+            ++last;
+        }
+        groups.push_back(Group{s, first, last});
+        first = last;
+    }
+
+    // members before the merge, the force patch below takes their pull back out
+    std::vector<T> oldM(members);
+    std::vector<T> oldX(members);
+    std::vector<T> oldY(members);
+    for(std::size_t k = 0; k < members; ++k){
+        oldM[k] = arrays.m[m_collisionMembers[k]];
+        oldX[k] = arrays.x[m_collisionMembers[k]];
+        oldY[k] = arrays.y[m_collisionMembers[k]];
+    }
+
+    m_collisionDead.assign(n, COLLISION_ALIVE);
+    const bool bins = m_blockBin.size() == n;
+    std::size_t removed = 0;
+    for(std::size_t g = 0; g < groups.size(); ++g){
+        const std::size_t s = groups[g].survivor;
+        // sums relative to the survivor, so the centre of mass keeps the precision of the positions
+        T mass = static_cast<T>(0);
+        T offsetX = static_cast<T>(0);
+        T offsetY = static_cast<T>(0);
+        T momentumX = static_cast<T>(0);
+        T momentumY = static_cast<T>(0);
+        T area = static_cast<T>(0);
+        int bin = 0;
+        for(std::size_t k = groups[g].first; k < groups[g].last; ++k){
+            const std::size_t i = m_collisionMembers[k];
+            mass += arrays.m[i];
+            offsetX += arrays.m[i] * (arrays.x[i] - arrays.x[s]);
+            offsetY += arrays.m[i] * (arrays.y[i] - arrays.y[s]);
+            momentumX += arrays.m[i] * arrays.vx[i];
+            momentumY += arrays.m[i] * arrays.vy[i];
+            area += m_radius[i] * m_radius[i];
+            if(bins){
+                bin = std::max(bin, m_blockBin[i]);
+            }
+            if(i != s){
+                m_collisionDead[i] = COLLISION_DEAD;
+                events.push_back(CollisionEvent{m_ids[s], m_ids[i]});
+                ++removed;
+            }
+        }
+        m_collisionDead[s] = COLLISION_SURVIVOR;
+        // massless groups keep the survivor's position and velocity
+        if(mass != static_cast<T>(0)){
+            arrays.x[s] += offsetX / mass;
+            arrays.y[s] += offsetY / mass;
+            arrays.vx[s] = momentumX / mass;
+            arrays.vy[s] = momentumY / mass;
+        }
+        arrays.m[s] = mass;
+        if(!soa){
+            Body2D<T> &b = m_bodies[s];
+            b.m = mass;
+            b.r = Vec2<T>(arrays.x[s], arrays.y[s]);
+            b.v = Vec2<T>(arrays.vx[s], arrays.vy[s]);
+        }
+        m_radius[s] = std::sqrt(area);
+        if(bins){
+            m_blockBin[s] = bin;
+        }
+    }
+
+    // carried forces: instead of a new force pass, every other body swaps the pull of the members
+    // for the pull of the merged bodies and each merged body gets a fresh row, O(n) per member;
+    // exact for the direct sum, for the tree engines the members' part keeps its approximation
+    const std::size_t patchRows = members + groups.size();
+    // exact rows would not match the mesh forces of a Pm pass
+    const bool patch = m_forcesValid && m_engine != ForceEngine::Pm && (m_engine == ForceEngine::Direct ? 4 * patchRows < n : patchRows <= FMM_ACTIVE_DIRECT_LIMIT);
+    if(patch){
+        m_pairInteractions += static_cast<unsigned long long>(n) * patchRows;
+        const T eps2 = m_eps2;
+        const auto pull = [eps2](T xi, T yi, T mj, T xj, T yj, T &ax, T &ay){
+            const T dx = xj - xi;
+            const T dy = yj - yi;
+            const T s2 = dx * dx + dy * dy + eps2;
+            if(s2 > static_cast<T>(0)){
+                const T inv = static_cast<T>(1) / std::sqrt(s2);
+                const T w = mj * inv * inv * inv;
+                ax += w * dx;
+                ay += w * dy;
+            }
+        };
+        parallelRanges(n, std::max<std::size_t>(1, PARALLEL_GRAIN / patchRows), [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                if(m_collisionDead[i] != COLLISION_ALIVE){
+                    continue;
+                }
+                T mergedX = static_cast<T>(0);
+                T mergedY = static_cast<T>(0);
+                T membersX = static_cast<T>(0);
+                T membersY = static_cast<T>(0);
+                for(std::size_t g = 0; g < groups.size(); ++g){
+                    const std::size_t s = groups[g].survivor;
+                    pull(arrays.x[i], arrays.y[i], arrays.m[s], arrays.x[s], arrays.y[s], mergedX, mergedY);
+                }
+                for(std::size_t k = 0; k < members; ++k){
+                    pull(arrays.x[i], arrays.y[i], oldM[k], oldX[k], oldY[k], membersX, membersY);
+                }
+                const T dax = m_G * (mergedX - membersX);
+                const T day = m_G * (mergedY - membersY);
+                if(soa){
+                    arrays.ax[i] += dax;
+                    arrays.ay[i] += day;
+                }
+                else{
+                    m_bodies[i].addForce(Vec2<T>(m_bodies[i].m * dax, m_bodies[i].m * day));
+                }
+            }
+        });
+        parallelRanges(groups.size(), std::max<std::size_t>(1, PARALLEL_GRAIN / n), [&](std::size_t begin, std::size_t end){
+            for(std::size_t g = begin; g < end; ++g){
+                const std::size_t s = groups[g].survivor;
+                T ax = static_cast<T>(0);
+                T ay = static_cast<T>(0);
+                for(std::size_t j = 0; j < n; ++j){
+                    if(j != s && m_collisionDead[j] != COLLISION_DEAD){
+                        pull(arrays.x[s], arrays.y[s], arrays.m[j], arrays.x[j], arrays.y[j], ax, ay);
+                    }
+                }
+                if(soa){
+                    arrays.ax[s] = m_G * ax;
+                    arrays.ay[s] = m_G * ay;
+                }
+                else{
+                    m_bodies[s].f = Vec2<T>(arrays.m[s] * m_G * ax, arrays.m[s] * m_G * ay);
+                }
+            }
+        });
+    }
+    else{
+        m_forcesValid = false;
+    }
+
+    std::sort(events.begin(), events.end(), [](const CollisionEvent &x, const CollisionEvent &y){
+        return x.idA != y.idA ? x.idA < y.idA : x.idB < y.idB;
+    });
+    compactBodies();
+    return removed;
+}
+
+/**
+ * @brief drop the bodies marked COLLISION_DEAD in m_collisionDead, keeping the order of the rest
+ *        forces of the remaining bodies move along, the cached potential is dropped
+ * 
+ */
+template<typename T>
+void NBodySystem2D<T>::compactBodies(){
+    const std::size_t n = m_collisionDead.size();
+    const bool soa = m_storage == StorageMode::SoA;
+    const bool bins = m_blockBin.size() == n;
+    std::size_t kept = 0;
+    for(std::size_t i = 0; i < n; ++i){
+        if(m_collisionDead[i] == COLLISION_DEAD){
+            continue;
+        }
+        if(kept != i){
+            if(soa){
+                m_soa.x[kept] = m_soa.x[i];
+                m_soa.y[kept] = m_soa.y[i];
+                m_soa.vx[kept] = m_soa.vx[i];
+                m_soa.vy[kept] = m_soa.vy[i];
+                m_soa.m[kept] = m_soa.m[i];
+                m_soa.ax[kept] = m_soa.ax[i];
+                m_soa.ay[kept] = m_soa.ay[i];
+            }
+            else{
+                m_bodies[kept] = m_bodies[i];
+            }
+            m_ids[kept] = m_ids[i];
+            m_radius[kept] = m_radius[i];
+            if(bins){
+                m_blockBin[kept] = m_blockBin[i];
+            }
+        }
+        ++kept;
+    }
+    if(soa){
+        m_soa.x.resize(kept);
+        m_soa.y.resize(kept);
+        m_soa.vx.resize(kept);
+        m_soa.vy.resize(kept);
+        m_soa.m.resize(kept);
+        m_soa.ax.resize(kept);
+        m_soa.ay.resize(kept);
+        m_mirrorStale = true;
+    }
+    else{
+        m_bodies.resize(kept);
+    }
+    m_ids.resize(kept);
+    m_radius.resize(kept);
+    if(bins){
+        m_blockBin.resize(kept);
+    }
+    // the potential of the last force pass still counts the merged bodies
+    m_potentialValid = false;
+}
+
+/**
+ * @brief copy bodies and integrator state, the O(n) part of a checkpoint
+ *        G, eps2 and the engine settings are not included, they have their own getters
+ *        AoS mode copies the forces as they are, SoA mode the accelerations, so nothing is rounded
+ * 
+ * @param state overwritten, its buffers are reused
+ */
+template<typename T>
+void NBodySystem2D<T>::captureState(SystemState2D<T> &state) const{
+    ScopedPhase timer(Phase::Checkpoint);
+    const std::size_t n = bodyCount();
+    if(m_storage == StorageMode::SoA && !m_arraysStale){
+        state.arrays = m_soa;
+        state.forcesInArrays = false;
+    }
+    else{
+        BodyArrays2D<T> &a = state.arrays;
+        a.x.resize(n);
+        a.y.resize(n);
+        a.vx.resize(n);
+        a.vy.resize(n);
+        a.m.resize(n);
+        a.ax.resize(n);
+        a.ay.resize(n);
+        for(std::size_t i = 0; i < n; ++i){
+            const Body2D<T> &b = m_bodies[i];
+            a.x[i] = b.r.x;
+            a.y[i] = b.r.y;
+            a.vx[i] = b.v.x;
+            a.vy[i] = b.v.y;
+            a.m[i] = b.m;
+            a.ax[i] = b.f.x;
+            a.ay[i] = b.f.y;
+        }
+        state.forcesInArrays = true;
+    }
+    state.forcesValid = m_forcesValid;
+    state.hermiteValid = m_forcesValid && m_hermiteEvaluation == m_forceEvaluations && m_jerkX.size() == n;
+    if(state.hermiteValid){
+        state.jerkX = m_jerkX;
+        state.jerkY = m_jerkY;
+    }
+    else{
+        state.jerkX.clear();
+        state.jerkY.clear();
+    }
+    state.forceEvaluations = m_forceEvaluations;
+    state.pairInteractions = m_pairInteractions;
+    syncPerBody();
+    state.ids = m_ids;
+    state.idCount = m_idCount;
+    state.radii = m_radius;
+}
+
+/**
+ * @brief replace bodies and integrator state with a captured state
+ *        set G and eps2 first, their setters discard the carried forces
+ *        a state from the other storage mode is converted with F = m * a or a = F / m
+ * 
+ * @param state state from captureState(), possibly of a system in the other storage mode
+ */
+template<typename T>
+void NBodySystem2D<T>::restoreState(const SystemState2D<T> &state){
+    const BodyArrays2D<T> &a = state.arrays;
+    const std::size_t n = a.size();
+    m_bodies.resize(n);
+    for(std::size_t i = 0; i < n; ++i){
+        Body2D<T> &b = m_bodies[i];
+        b.m = a.m[i];
+        b.r = Vec2<T>(a.x[i], a.y[i]);
+        b.v = Vec2<T>(a.vx[i], a.vy[i]);
+        b.f = state.forcesInArrays ? Vec2<T>(a.ax[i], a.ay[i]) : Vec2<T>(a.m[i] * a.ax[i], a.m[i] * a.ay[i]);
+    }
+    if(m_storage == StorageMode::SoA){
+        if(state.forcesInArrays){
+            m_soa.load(m_bodies);
+        }
+        else{
+            m_soa = a;
+        }
+        m_mirrorStale = false;
+        m_arraysStale = false;
+    }
+
+    m_forcesValid = state.forcesValid;
+    m_potentialValid = false;
+    m_forceEvaluations = state.forceEvaluations;
+    m_pairInteractions = state.pairInteractions;
+    if(state.hermiteValid){
+        m_jerkX = state.jerkX;
+        m_jerkY = state.jerkY;
+        m_hermiteEvaluation = m_forceEvaluations;
+    }
+    else{
+        // a size mismatch is what makes stepHermite() start with a fresh pass
+        m_jerkX.clear();
+        m_jerkY.clear();
+    }
+    m_blockBin.clear();
+    // a state without ids gets 0 .. n-1 from syncPerBody()
+    m_ids = state.ids;
+    m_idCount = state.idCount;
+    m_radius = state.radii;
+}
+
+/**
+ * @brief compute gravitational forces on all bodies
+ * 
+ * Steps:
+ *      clear all force accumulators
+ *      in SoA mode engines fill accelerations ax, ay instead of forces
+ *      Direct: for each pair (i, j) compute gravitational force
+ *          F = G * m_i * m_j * r_hat / (|r|^2 + eps2)^(3/2) and add +F to body i and -F to body j
+ *          in SoA mode every row i sums all j instead, no writes to body j
+ *          with threads, rows are split into bands of equal pair count,
+ *          each band adds into its own force accumulator and the accumulators are summed after
+ *          float/double with a SIMD level: rows of the SoA arrays go through the
+ *          AVX2/AVX-512 kernel, AoS mode gathers into arrays first
+ *          Complexity = O(n^2) for n bodies
+ *      BarnesHut: build quadtree, then walk it once per body, walks are spread over threads
+ *          Complexity = O(n log n) for n bodies
+ *      Fmm: build quadtree with expansions, dual tree walk
+ *          Complexity = O(n) for n bodies
+ *      Pm: assign masses to the grid, FFT convolution, interpolate back, interpolation is spread over threads
+ *          Complexity = O(n + M^2 log M) for n bodies and an M x M transform
+ * 
+ */
+template<typename T>
+void NBodySystem2D<T>::computeForces(){
+    ScopedPhase timer(Phase::Forces);
+    // set again by the engines that sum it
+    m_potentialValid = false;
+    ++m_forceEvaluations;
+    const unsigned long long bodies = bodyCount();
+    m_pairInteractions += bodies * (bodies - 1) / 2;
+    if(m_storage == StorageMode::SoA){
+        syncArrays();
+        m_soa.clearAccelerations();
+        computeAccelerations(m_soa);
+        m_mirrorStale = true;
+        m_forcesValid = true;
+        return;
+    }
+
+    const std::size_t n = m_bodies.size();
+    // clear existing forces
+    for(std::size_t i = 0; i < n; ++i){
+        m_bodies[i].clearForce();
+    }
+
+    if(m_engine != ForceEngine::Direct || simdDirectActive() || floatPairsActive()){
+        // tree engines, the SIMD kernel and float pairs read arrays, gather positions and scatter F = m * a back
+        m_scratch.load(m_bodies);
+        m_scratch.clearAccelerations();
+        computeAccelerations(m_scratch);
+        m_scratch.addForcesTo(m_bodies);
+    }
+    else{
+        computeForcesDirect();
+    }
+    m_forcesValid = true;
+}
+/**
+ * @brief run the current engine on arrays, accumulators must already be cleared
+ * 
+ * @param arrays bodies to receive accelerations
  */
-void NBodySystem2D::addBody(const Body2D &body){
-    m_bodies.push_back(body);
+template<typename T>
+void NBodySystem2D<T>::computeAccelerations(BodyArrays2D<T> &arrays){
+    if(m_engine == ForceEngine::BarnesHut){
+        m_tree.build(arrays);
+        // one walk costs roughly a hundred interactions
+        parallelRanges(arrays.size(), PARALLEL_GRAIN / 64, [&](std::size_t begin, std::size_t end){
+            m_tree.accumulateAccelerations(arrays, m_G, m_eps2, m_theta, begin, end);
+        });
+    }
+    else if(m_engine == ForceEngine::Fmm){
+        m_fmm.evaluate(arrays, m_eps2, m_theta);
+        m_fmm.accumulateAccelerations(arrays, m_G);
+        if(m_trackPotential){
+            // the expansions are already built, the potential is one more O(n) pass
+            m_potential = m_fmm.potentialEnergy(arrays, m_G);
+            m_potentialValid = true;
+        }
+    }
+    else if(m_engine == ForceEngine::Pm){
+        m_pm.evaluate(arrays, m_eps2, m_trackPotential, m_pool.get());
+        // interpolation reads 4 or 9 cells per body
+        parallelRanges(arrays.size(), PARALLEL_GRAIN / 16, [&](std::size_t begin, std::size_t end){
+            m_pm.accumulateAccelerations(arrays, m_G, begin, end);
+        });
+        if(m_trackPotential){
+            m_potential = m_pm.potentialEnergy(arrays, m_G);
+            m_potentialValid = true;
+        }
+    }
+    else{
+        computeAccelerationsDirect(arrays);
+    }
 }
-
 /**
- * @brief returns number of bodies in system
+ * @brief compare forces of the current engine against the direct sum
+ *        calls computeForces(), then sums exact forces in long double for up to maxSamples evenly spaced bodies
+ *        with a periodic Pm boundary the exact sum takes the nearest image of every body
+ *        Complexity = O(n * maxSamples)
  * 
- * @return std::size_t number of bodies in system
+ * @param maxSamples number of bodies to check
+ * @return ForceErrorReport rms and max relative error
  */
-std::size_t NBodySystem2D::bodyCount() const{
-    return m_bodies.size();
+template<typename T>
+ForceErrorReport NBodySystem2D<T>::measureForceError(std::size_t maxSamples){
+    ForceErrorReport report;
+    report.samples = 0;
+    report.rmsRelError = 0.0;
+    report.maxRelError = 0.0;
+
+    const std::size_t n = bodyCount();
+    if(n == 0 || maxSamples == 0){
+        return report;
+    }
+    computeForces();
+    syncMirror();
+
+    // a periodic mesh sees the nearest image, the reference has to as well
+    const bool periodic = m_engine == ForceEngine::Pm && m_pm.getBoundary() == PmBoundary::Periodic;
+    const long double box = static_cast<long double>(m_pm.getBoxSize());
+
+    // spread the samples over the whole body list
+    const std::size_t stride = n > maxSamples ? n / maxSamples : 1;
+    double sumSq = 0.0;
+    for(std::size_t i = 0; i < n && report.samples < maxSamples; i += stride){
+        const Body2D<T> &bi = m_bodies[i];
+        // reference in long double, so the report also covers the rounding of T and of float pair terms
+        Vec2<long double> exact;
+        for(std::size_t j = 0; j < n; ++j){
+            if(j == i){
+                continue;
+            }
+            Vec2<long double> dr(static_cast<long double>(m_bodies[j].r.x) - static_cast<long double>(bi.r.x), static_cast<long double>(m_bodies[j].r.y) - static_cast<long double>(bi.r.y));
+            if(periodic){
+                dr.x -= box * std::round(dr.x / box);
+                dr.y -= box * std::round(dr.y / box);
+            }
+            const long double invDist = 1.0L / std::sqrt(dr.x * dr.x + dr.y * dr.y + static_cast<long double>(m_eps2));
+            exact = exact.add(dr.scale(static_cast<long double>(m_G) * static_cast<long double>(bi.m) * static_cast<long double>(m_bodies[j].m) * invDist * invDist * invDist));
+        }
+        const long double exactMag = exact.norm();
+        if(exactMag > 0.0L){
+            const Vec2<long double> f(static_cast<long double>(bi.f.x), static_cast<long double>(bi.f.y));
+            const double rel = static_cast<double>(f.sub(exact).norm() / exactMag);
+            sumSq += rel * rel;
+            if(rel > report.maxRelError){
+                report.maxRelError = rel;
+            }
+        }
+        ++report.samples;
+    }
+    report.rmsRelError = std::sqrt(sumSq / static_cast<double>(report.samples));
+    return report;
 }
 
 /**
- * @brief non-const access to body list
+ * @brief accelerations of the listed bodies from all bodies, other rows are left as they are
+ *        Fmm evaluates every body, or sums the active rows directly when there are at most FMM_ACTIVE_DIRECT_LIMIT
+ *        Pm always evaluates every body, exact rows would not match the mesh forces of the others
  * 
- * @return std::vector<Body2D>& 
+ * @param arrays bodies with current positions
+ * @param active indices whose accelerations are recomputed
  */
-std::vector<Body2D> &NBodySystem2D::bodies(){
-    return m_bodies;
+template<typename T>
+void NBodySystem2D<T>::computeAccelerationsActive(BodyArrays2D<T> &arrays, const std::vector<std::size_t> &active){
+    if(active.empty()){
+        return;
+    }
+    ScopedPhase timer(Phase::Forces);
+    ++m_forceEvaluations;
+    m_potentialValid = false;
+    const std::size_t n = arrays.size();
+
+    if((m_engine == ForceEngine::Fmm && active.size() > FMM_ACTIVE_DIRECT_LIMIT) || m_engine == ForceEngine::Pm){
+        // the expansions and the mesh need every body anyway, rows of inactive bodies are not read before their next pass
+        const bool track = m_trackPotential;
+        m_trackPotential = false;
+        arrays.clearAccelerations();
+        computeAccelerations(arrays);
+        m_trackPotential = track;
+        m_pairInteractions += static_cast<unsigned long long>(n) * (n - 1) / 2;
+        return;
+    }
+
+    m_pairInteractions += static_cast<unsigned long long>(active.size()) * (n - 1);
+    for(std::size_t k = 0; k < active.size(); ++k){
+        arrays.ax[active[k]] = static_cast<T>(0);
+        arrays.ay[active[k]] = static_cast<T>(0);
+    }
+    if(m_engine == ForceEngine::BarnesHut){
+        // every body moved since the last substep, so the tree is rebuilt, only active bodies walk it
+        m_tree.build(arrays);
+        parallelRanges(active.size(), PARALLEL_GRAIN / 64, [&](std::size_t begin, std::size_t end){
+            for(std::size_t k = begin; k < end; ++k){
+                m_tree.accumulateAccelerations(arrays, m_G, m_eps2, m_theta, active[k], active[k] + 1);
+            }
+        });
+    }
+    else{
+        // Direct, or Fmm with so few active bodies that their exact rows cost less than one expansion pass
+        computeAccelerationsDirect(arrays, &active);
+    }
 }
 
 /**
- * @brief const access to body list
+ * @brief direct-sum accelerations and jerks of every body, overwrites arrays.ax, ay and m_jerkX, m_jerkY
+ *        jerk_i = G * sum_j m_j * (v_ij / s^3 - 3 * (r_ij . v_ij) * r_ij / s^5), s^2 = |r_ij|^2 + eps2
+ *        rows are independent and split over the thread pool
+ *        Complexity = O(n^2) for n bodies
  * 
- * @return const std::vector<Body2D>& 
+ * @param arrays bodies with current positions and velocities
  */
-const std::vector<Body2D> &NBodySystem2D::bodies() const{
-    return m_bodies;
+template<typename T>
+void NBodySystem2D<T>::computeAccelerationsJerk(BodyArrays2D<T> &arrays){
+    ScopedPhase timer(Phase::Forces);
+    ++m_forceEvaluations;
+    m_potentialValid = false;
+    const std::size_t n = arrays.size();
+    m_pairInteractions += static_cast<unsigned long long>(n) * (n - 1) / 2;
+    m_jerkX.resize(n);
+    m_jerkY.resize(n);
+
+    const T *x = arrays.x.data();
+    const T *y = arrays.y.data();
+    const T *vx = arrays.vx.data();
+    const T *vy = arrays.vy.data();
+    const T *m = arrays.m.data();
+    const T eps2 = m_eps2;
+    parallelRanges(n, std::max<std::size_t>(1, PARALLEL_GRAIN / std::max<std::size_t>(n, 1)), [&](std::size_t rowBegin, std::size_t rowEnd){
+        for(std::size_t i = rowBegin; i < rowEnd; ++i){
+            const T xi = x[i];
+            const T yi = y[i];
+            const T vxi = vx[i];
+            const T vyi = vy[i];
+            T sx = static_cast<T>(0);
+            T sy = static_cast<T>(0);
+            T jx = static_cast<T>(0);
+            T jy = static_cast<T>(0);
+
+            // j = i is skipped by splitting the row, same as the direct sum
+            const auto accumulate = [&](std::size_t jBegin, std::size_t jEnd){
+                for(std::size_t j = jBegin; j < jEnd; ++j){
+                    const T dx = x[j] - xi;
+                    const T dy = y[j] - yi;
+                    const T dvx = vx[j] - vxi;
+                    const T dvy = vy[j] - vyi;
+                    const T invDist2 = static_cast<T>(1) / (dx * dx + dy * dy + eps2);
+                    const T invDist = static_cast<T>(std::sqrt(invDist2));
+                    const T accMag = m[j] * invDist * invDist2;
+                    // radial part of the relative velocity, 3 (r . v) / s^2
+                    const T radial = static_cast<T>(3) * (dx * dvx + dy * dvy) * invDist2;
+                    sx += dx * accMag;
+                    sy += dy * accMag;
+                    jx += (dvx - radial * dx) * accMag;
+                    jy += (dvy - radial * dy) * accMag;
+                }
+            };
+            accumulate(0, i);
+            accumulate(i + 1, n);
+
+            arrays.ax[i] = m_G * sx;
+            arrays.ay[i] = m_G * sy;
+            m_jerkX[i] = m_G * jx;
+            m_jerkY[i] = m_G * jy;
+        }
+    });
 }
 
 /**
- * @brief compute gravitational forces on all bodies
+ * @brief bin a body wants for its acceleration, 0 = dt, levels - 1 = smallest step
+ *        criterion dt_i = sqrt(2 * eta * eps / |a_i|) with eps = sqrt(eps2) the softening length,
+ *        the largest power-of-two fraction of dt not above dt_i is picked
  * 
- * Steps:
- *      clear all force accumulators
- *      for each pair (i, j) compute gravitational force
- *          F = G * m_i * m_j * r_hat / (|r|^2 + eps2)^(3/2) and add +F to body i and -F to body j
- *          Complexity = O(n^2) for n bodies
+ * @param ax x acceleration
+ * @param ay y acceleration
+ * @param dt step of bin 0
+ * @return int bin index
+ */
+template<typename T>
+int NBodySystem2D<T>::blockBinFor(T ax, T ay, T dt) const{
+    const T accel = static_cast<T>(std::sqrt(ax * ax + ay * ay));
+    const T length = static_cast<T>(std::sqrt(m_eps2));
+    if(accel <= static_cast<T>(0) || length <= static_cast<T>(0)){
+        return 0;
+    }
+    const T wanted = static_cast<T>(std::sqrt(static_cast<T>(2) * m_blockEta * length / accel));
+    int bin = 0;
+    T step = dt;
+    while(step > wanted && bin < m_blockLevels - 1){
+        step *= static_cast<T>(0.5);
+        ++bin;
+    }
+    return bin;
+}
+
+/**
+ * @brief exact pairwise force sum, accumulators must already be cleared
+ *        with threads each band of rows writes into its own accumulator, no data races on body j
  * 
  */
-void NBodySystem2D::computeForces(){
+template<typename T>
+void NBodySystem2D<T>::computeForcesDirect(){
     const std::size_t n = m_bodies.size();
-    // clear existing forces
-    for(std::size_t i = 0; i < n; ++i){
-        m_bodies[i].clearForce();
+    if(m_pool && n * n >= 4 * PARALLEL_GRAIN){
+        // bands of rows with equal pair count, one per thread
+        const std::size_t bands = m_pool->threadCount();
+        m_bandForces.resize(bands);
+        m_bandPotential.assign(bands, 0);
+        m_bandRows.resize(bands + 1);
+        for(std::size_t k = 0; k <= bands; ++k){
+            m_bandRows[k] = triangularRowSplit(n, bands, k);
+        }
+
+        m_pool->run(bands, [&](std::size_t k){
+            // a band only touches bodies from its first row on
+            std::vector<Vec2<T>> &acc = m_bandForces[k];
+            acc.resize(n);
+            std::fill(acc.begin() + static_cast<std::ptrdiff_t>(m_bandRows[k]), acc.end(), Vec2<T>());
+            EnergySum<T> potential = 0;
+            for(std::size_t i = m_bandRows[k]; i < m_bandRows[k + 1]; ++i){
+                for(std::size_t j = i + 1; j < n; ++j){
+                    Vec2<T> dr = m_bodies[j].r.sub(m_bodies[i].r);
+                    T dist2 = dr.x * dr.x + dr.y * dr.y + m_eps2;
+                    T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dist2));
+                    T invDist3 = invDist * invDist * invDist;
+                    T gmm = m_G * m_bodies[i].m * m_bodies[j].m;
+                    Vec2<T> F = dr.scale(gmm * invDist3);
+                    acc[i] = acc[i].add(F);
+                    acc[j] = acc[j].sub(F);
+                    if(m_trackPotential){
+                        potential -= static_cast<EnergySum<T>>(gmm * invDist);
+                    }
+                }
+            }
+            m_bandPotential[k] = potential;
+        });
+
+        // sum the bands in a fixed order so results do not depend on scheduling
+        parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                for(std::size_t k = 0; k < bands && m_bandRows[k] <= i; ++k){
+                    m_bodies[i].addForce(m_bandForces[k][i]);
+                }
+            }
+        });
+        if(m_trackPotential){
+            EnergySum<T> potential = 0;
+            for(std::size_t k = 0; k < bands; ++k){
+                potential += m_bandPotential[k];
+            }
+            m_potential = static_cast<T>(potential);
+            m_potentialValid = true;
+        }
+        return;
     }
+
     // pairwise interaction loop, and i < j to avoid duplicates
+    // the potential is summed in EnergySum<T> like totalEnergy(), so cached and summed energies agree
+    EnergySum<T> potential = 0;
     for(std::size_t i = 0; i < n; ++i){
         for(std::size_t j = i + 1; j < n; ++j){
             // displacement from i to j
-            Vec2 dr = m_bodies[j].r.sub(m_bodies[i].r);
+            Vec2<T> dr = m_bodies[j].r.sub(m_bodies[i].r);
 
             // squared distance with softening
-            Real dist2 = dr.x * dr.x + dr.y * dr.y + m_eps2;
+            T dist2 = dr.x * dr.x + dr.y * dr.y + m_eps2;
             // 1 / |r| and 1 / |r|^3
-            Real invDist = static_cast<Real>(1) / static_cast<Real>(std::sqrt(dist2));
-            Real invDist3 = invDist * invDist * invDist;
+            T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dist2));
+            T invDist3 = invDist * invDist * invDist;
 
-            // Magnitude of gravitational force
-            Real forceMag = m_G * m_bodies[i].m * m_bodies[j].m * invDist3;
+            // Magnitude of gravitational force, G * m_i * m_j also gives the pair potential
+            T gmm = m_G * m_bodies[i].m * m_bodies[j].m;
+            T forceMag = gmm * invDist3;
             
             // force vector in direction of dr
-            Vec2 F = dr.scale(forceMag);
+            Vec2<T> F = dr.scale(forceMag);
 
             // apply equal and opposite forces
             m_bodies[i].addForce(F);
-            m_bodies[j].addForce(F.scale(static_cast<Real>(-1)));
+            m_bodies[j].addForce(F.scale(static_cast<T>(-1)));
+
+            // pair potential -G * m_i * m_j / |r| from the same 1 / |r|
+            if(m_trackPotential){
+                potential -= static_cast<EnergySum<T>>(gmm * invDist);
+            }
+        }
+    }
+    if(m_trackPotential){
+        m_potential = static_cast<T>(potential);
+        m_potentialValid = true;
+    }
+}
+/**
+ * @brief true if the direct engine runs through the SIMD kernel for this T
+ * 
+ * @return true 
+ * @return false 
+ */
+template<typename T>
+bool NBodySystem2D<T>::simdDirectActive() const{
+    return m_simd != SimdLevel::Scalar && !std::is_same<T, long double>::value;
+}
+/**
+ * @brief true if the direct sum runs with float pair terms for this T
+ * 
+ * @return true 
+ * @return false 
+ */
+template<typename T>
+bool NBodySystem2D<T>::floatPairsActive() const{
+    return m_floatPairs && !std::is_same<T, float>::value;
+}
+/**
+ * @brief exact acceleration sum over arrays, accumulators must already be cleared
+ *        each row i reads every j and writes only ax[i], ay[i]
+ *        uses the SIMD kernel when one is available for T
+ * 
+ * @param arrays bodies to receive accelerations
+ * @param rows rows to sum, nullptr = every row; a row list never sums the potential
+ */
+template<typename T>
+void NBodySystem2D<T>::computeAccelerationsDirect(BodyArrays2D<T> &arrays, const std::vector<std::size_t> *rows){
+    if(floatPairsActive()){
+        computeAccelerationsMixed(arrays, rows);
+        return;
+    }
+    const std::size_t n = arrays.size();
+    const T *x = arrays.x.data();
+    const T *y = arrays.y.data();
+    const T *m = arrays.m.data();
+    const T eps2 = m_eps2;
+    const bool simd = simdDirectActive();
+    const bool potential = m_trackPotential && rows == nullptr;
+
+    // each row writes only its own potential, so rows stay independent
+    T *phi = nullptr;
+    if(potential){
+        m_rowPotential.assign(n, static_cast<T>(0));
+        phi = m_rowPotential.data();
+    }
+
+    // scalar loop for one row, used where the SIMD kernel is not
+    const auto sumRow = [&](std::size_t i){
+        const T xi = x[i];
+        const T yi = y[i];
+        T sx = static_cast<T>(0);
+        T sy = static_cast<T>(0);
+        EnergySum<T> sp = 0;
+
+        // j = i is skipped by splitting the row, keeps both loops branch free
+        const auto accumulate = [&](std::size_t jBegin, std::size_t jEnd){
+            for(std::size_t j = jBegin; j < jEnd; ++j){
+                const T dx = x[j] - xi;
+                const T dy = y[j] - yi;
+                const T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dx * dx + dy * dy + eps2));
+                const T accMag = m[j] * invDist * invDist * invDist;
+                sx += dx * accMag;
+                sy += dy * accMag;
+                if(potential){
+                    sp += static_cast<EnergySum<T>>(m[j] * invDist);
+                }
+            }
+        };
+        accumulate(0, i);
+        accumulate(i + 1, n);
+
+        arrays.ax[i] += m_G * sx;
+        arrays.ay[i] += m_G * sy;
+        if(potential){
+            phi[i] -= m_G * static_cast<T>(sp);
+        }
+    };
+
+    if(rows != nullptr){
+        // listed rows only, each still reads all n bodies
+        parallelRanges(rows->size(), std::max<std::size_t>(1, PARALLEL_GRAIN / std::max<std::size_t>(n, 1)), [&](std::size_t begin, std::size_t end){
+            for(std::size_t k = begin; k < end; ++k){
+                const std::size_t i = (*rows)[k];
+                if(!(simd && simdDirectAccelerations(x, y, m, arrays.ax.data(), arrays.ay.data(), nullptr, n, i, i + 1, m_G, eps2, m_simd, m_fastRsqrt))){
+                    sumRow(i);
+                }
+            }
+        });
+        return;
+    }
+
+    // rows are independent, every row costs n pair evaluations
+    parallelRanges(n, std::max<std::size_t>(1, PARALLEL_GRAIN / std::max<std::size_t>(n, 1)), [&](std::size_t rowBegin, std::size_t rowEnd){
+        if(simd && simdDirectAccelerations(x, y, m, arrays.ax.data(), arrays.ay.data(), phi, n, rowBegin, rowEnd, m_G, eps2, m_simd, m_fastRsqrt)){
+            return;
+        }
+        for(std::size_t i = rowBegin; i < rowEnd; ++i){
+            sumRow(i);
         }
+    });
+
+    if(potential){
+        // every pair appears in two rows, hence the half
+        // rows are added in EnergySum<T>, a float run would otherwise lose digits over n rows
+        EnergySum<T> sum = 0;
+        for(std::size_t i = 0; i < n; ++i){
+            sum += static_cast<EnergySum<T>>(m[i] * m_rowPotential[i]);
+        }
+        m_potential = static_cast<T>(static_cast<EnergySum<T>>(0.5) * sum);
+        m_potentialValid = true;
+    }
+}
+/**
+ * @brief mixed-precision acceleration sum over arrays, float pair terms and double row sums
+ *        rows are independent as in computeAccelerationsDirect()
+ * 
+ * @param arrays bodies to receive accelerations
+ * @param rows rows to sum, nullptr = every row; a row list never sums the potential
+ */
+template<typename T>
+void NBodySystem2D<T>::computeAccelerationsMixed(BodyArrays2D<T> &arrays, const std::vector<std::size_t> *rows){
+    const std::size_t n = arrays.size();
+    if(n == 0){
+        return;
+    }
+    const bool potential = m_trackPotential && rows == nullptr;
+
+    // local origin at the centre of the bounding box, float offsets from it are at most half the extent
+    T minX = arrays.x[0];
+    T maxX = arrays.x[0];
+    T minY = arrays.y[0];
+    T maxY = arrays.y[0];
+    for(std::size_t i = 1; i < n; ++i){
+        minX = std::min(minX, arrays.x[i]);
+        maxX = std::max(maxX, arrays.x[i]);
+        minY = std::min(minY, arrays.y[i]);
+        maxY = std::max(maxY, arrays.y[i]);
+    }
+    const T originX = static_cast<T>(0.5) * (minX + maxX);
+    const T originY = static_cast<T>(0.5) * (minY + maxY);
+    m_pairX.resize(n);
+    m_pairY.resize(n);
+    m_pairM.resize(n);
+    m_pairAx.resize(n);
+    m_pairAy.resize(n);
+    parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; ++i){
+            m_pairX[i] = static_cast<float>(arrays.x[i] - originX);
+            m_pairY[i] = static_cast<float>(arrays.y[i] - originY);
+            m_pairM[i] = static_cast<float>(arrays.m[i]);
+        }
+    });
+    if(potential){
+        m_pairPhi.resize(n);
+    }
+
+    const float *x = m_pairX.data();
+    const float *y = m_pairY.data();
+    const float *m = m_pairM.data();
+    double *phi = potential ? m_pairPhi.data() : nullptr;
+    const float eps2 = static_cast<float>(m_eps2);
+
+    // scalar loop for one row, float pair terms each added to double sums
+    const auto sumRow = [&](std::size_t i){
+        const float xi = x[i];
+        const float yi = y[i];
+        double sx = 0.0;
+        double sy = 0.0;
+        double sp = 0.0;
+        for(std::size_t j = 0; j < n; ++j){
+            const float dx = x[j] - xi;
+            const float dy = y[j] - yi;
+            const float r2 = dx * dx + dy * dy + eps2;
+            // the i = j term, and bodies that meet in float with eps2 = 0, add nothing
+            if(j == i || !(r2 > 0.0f)){
+                continue;
+            }
+            const float invDist = 1.0f / std::sqrt(r2);
+            const float accMag = m[j] * invDist * invDist * invDist;
+            sx += static_cast<double>(dx * accMag);
+            sy += static_cast<double>(dy * accMag);
+            if(potential){
+                sp += static_cast<double>(m[j] * invDist);
+            }
+        }
+        m_pairAx[i] = sx;
+        m_pairAy[i] = sy;
+        if(potential){
+            phi[i] = sp;
+        }
+    };
+    const auto sumRows = [&](std::size_t begin, std::size_t end){
+        if(!simdMixedAccelerations(x, y, m, m_pairAx.data(), m_pairAy.data(), phi, n, begin, end, eps2, m_simd, m_fastRsqrt)){
+            for(std::size_t i = begin; i < end; ++i){
+                sumRow(i);
+            }
+        }
+    };
+    const auto addRow = [&](std::size_t i){
+        arrays.ax[i] += m_G * static_cast<T>(m_pairAx[i]);
+        arrays.ay[i] += m_G * static_cast<T>(m_pairAy[i]);
+    };
+
+    if(rows != nullptr){
+        parallelRanges(rows->size(), std::max<std::size_t>(1, PARALLEL_GRAIN / n), [&](std::size_t begin, std::size_t end){
+            for(std::size_t k = begin; k < end; ++k){
+                sumRows((*rows)[k], (*rows)[k] + 1);
+                addRow((*rows)[k]);
+            }
+        });
+        return;
+    }
+
+    parallelRanges(n, std::max<std::size_t>(1, PARALLEL_GRAIN / n), [&](std::size_t rowBegin, std::size_t rowEnd){
+        sumRows(rowBegin, rowEnd);
+        for(std::size_t i = rowBegin; i < rowEnd; ++i){
+            addRow(i);
+        }
+    });
+
+    if(potential){
+        // every pair appears in two rows, hence the half
+        EnergySum<T> sum = 0;
+        for(std::size_t i = 0; i < n; ++i){
+            sum += static_cast<EnergySum<T>>(arrays.m[i]) * static_cast<EnergySum<T>>(m_pairPhi[i]);
+        }
+        m_potential = static_cast<T>(static_cast<EnergySum<T>>(-0.5) * static_cast<EnergySum<T>>(m_G) * sum);
+        m_potentialValid = true;
+    }
+}
+/**
+ * @brief call body(begin, end) on chunks of [0, n), spread over the pool if there is one
+ * 
+ * @param n number of indices
+ * @param grain minimum chunk length
+ * @param body function taking a chunk [begin, end)
+ */
+template<typename T>
+void NBodySystem2D<T>::parallelRanges(std::size_t n, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body) const{
+    if(m_pool){
+        m_pool->parallelFor(0, n, grain, body);
+    }
+    else if(n > 0){
+        body(0, n);
+    }
+}
+/**
+ * @brief first row of band k when rows of the i<j pair triangle are split into bands of equal pair count
+ * 
+ * @param n number of bodies
+ * @param bands number of bands
+ * @param k band index, k = bands returns n
+ * @return std::size_t row index
+ */
+template<typename T>
+std::size_t NBodySystem2D<T>::triangularRowSplit(std::size_t n, std::size_t bands, std::size_t k){
+    if(k == 0){
+        return 0;
     }
+    if(k >= bands){
+        return n;
+    }
+    // rows [b, n) hold (n - b)(n - b - 1) / 2 pairs, solve for the b leaving the right share after it
+    const double total = 0.5 * static_cast<double>(n) * static_cast<double>(n - 1);
+    const double tail = total * static_cast<double>(bands - k) / static_cast<double>(bands);
+    const double rows = 0.5 * (1.0 + std::sqrt(1.0 + 8.0 * tail));
+    const std::size_t tailRows = std::min(n, static_cast<std::size_t>(rows + 0.5));
+    return n - tailRows;
 }
 /**
  * @brief compute total energy of the system
@@ -153,89 +1742,193 @@ void NBodySystem2D::computeForces(){
  *      kinetic = sum(0.5 * m * v^2) over all bodies
  *      potential = sum over i<j of (-G * m_i * m_j / |r_ij|)
  *      uses eps2 for softening
+ *      with the Fmm engine the potential comes from the multipole expansions, O(n), with Pm from the mesh
+ *      otherwise the pair sum is split over the thread pool in bands of equal pair count
+ *      kinetic and potential are summed in EnergySum<T>, at least double, and rounded to T once
  * 
- * @return Real Total Energy
+ * @return T Total Energy
  */
-Real NBodySystem2D::totalEnergy() const{
-    const std::size_t n = m_bodies.size();
+template<typename T>
+T NBodySystem2D<T>::totalEnergy() const{
+    ScopedPhase timer(Phase::Energy);
+    if(potentialCached()){
+        // the last force pass summed the potential at these positions, only kinetic is left
+        EnergySum<T> kinetic = 0;
+        if(m_storage == StorageMode::SoA){
+            for(std::size_t i = 0; i < m_soa.size(); ++i){
+                T v2 = m_soa.vx[i] * m_soa.vx[i] + m_soa.vy[i] * m_soa.vy[i];
+                kinetic += static_cast<EnergySum<T>>(static_cast<T>(0.5) * m_soa.m[i] * v2);
+            }
+        }
+        else{
+            for(std::size_t i = 0; i < m_bodies.size(); ++i){
+                const Body2D<T> &b = m_bodies[i];
+                T v2 = b.v.x * b.v.x + b.v.y * b.v.y;
+                kinetic += static_cast<EnergySum<T>>(static_cast<T>(0.5) * b.m * v2);
+            }
+        }
+        return static_cast<T>(kinetic + static_cast<EnergySum<T>>(m_potential));
+    }
+
+    // read the arrays directly in SoA mode, otherwise gather a copy
+    BodyArrays2D<T> gathered;
+    const BodyArrays2D<T> *arrays = &m_soa;
+    if(m_storage != StorageMode::SoA || m_arraysStale){
+        gathered.load(m_bodies);
+        arrays = &gathered;
+    }
+    const BodyArrays2D<T> &b = *arrays;
+    const std::size_t n = b.size();
 
-    Real kinetic = static_cast<Real>(0);
-    Real potential = static_cast<Real>(0);
+    // sums are at least double whatever T is, see EnergySum
+    EnergySum<T> kinetic = 0;
+    EnergySum<T> potential = 0;
 
     // kinetic energy = 0.5 * m * |v|^2
     for(std::size_t i = 0; i < n; ++i){
-        const Body2D &b = m_bodies[i];
-        Real v2 = b.v.x * b.v.x + b.v.y * b.v.y;
-        kinetic += static_cast<Real>(0.5) * b.m * v2;
+        T v2 = b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i];
+        kinetic += static_cast<EnergySum<T>>(static_cast<T>(0.5) * b.m[i] * v2);
+    }
+
+    if(m_engine == ForceEngine::Fmm){
+        // separate solver so the const system is left untouched
+        FmmSolver2D<T> solver;
+        solver.setOrder(m_fmm.getOrder());
+        solver.evaluate(b, m_eps2, m_theta);
+        return static_cast<T>(kinetic + static_cast<EnergySum<T>>(solver.potentialEnergy(b, m_G)));
+    }
+    if(m_engine == ForceEngine::Pm){
+        PmSolver2D<T> solver;
+        solver.setGridSize(m_pm.getGridSize());
+        solver.setAssignment(m_pm.getAssignment());
+        solver.setBoundary(m_pm.getBoundary(), m_pm.getBoxSize());
+        solver.evaluate(b, m_eps2, true, m_pool.get());
+        return static_cast<T>(kinetic + static_cast<EnergySum<T>>(solver.potentialEnergy(b, m_G)));
     }
 
     // potential energy = -G * m_i * m_j / |r_ij|
-    for(std::size_t i = 0; i < n; ++i){
-        for(std::size_t j = i + 1; j < n; ++j){
-            Vec2 dr = m_bodies[j].r.sub(m_bodies[i].r);
-            Real dist2 = dr.x * dr.x + dr.y * dr.y + m_eps2;
-            Real dist = static_cast<Real>(std::sqrt(dist2));
+    // bands of rows with equal pair count, partial sums added in band order
+    const std::size_t bands = m_pool && n * n >= 4 * PARALLEL_GRAIN ? m_pool->threadCount() : 1;
+    std::vector<EnergySum<T>> partial(bands, 0);
+    const auto band = [&](std::size_t k){
+        const std::size_t rowEnd = triangularRowSplit(n, bands, k + 1);
+        EnergySum<T> sum = 0;
+        for(std::size_t i = triangularRowSplit(n, bands, k); i < rowEnd; ++i){
+            for(std::size_t j = i + 1; j < n; ++j){
+                T dx = b.x[j] - b.x[i];
+                T dy = b.y[j] - b.y[i];
+                T dist2 = dx * dx + dy * dy + m_eps2;
+                T dist = static_cast<T>(std::sqrt(dist2));
 
-            if(dist > static_cast<Real>(0)){
-                potential -= m_G * m_bodies[i].m * m_bodies[j].m / dist;
+                if(dist > static_cast<T>(0)){
+                    sum -= static_cast<EnergySum<T>>(m_G * b.m[i] * b.m[j] / dist);
+                }
+            }
+        }
+        partial[k] = sum;
+    };
+    if(bands > 1){
+        m_pool->run(bands, band);
+    }
+    else{
+        band(0);
+    }
+    for(std::size_t k = 0; k < bands; ++k){
+        potential += partial[k];
+    }
+    return static_cast<T>(kinetic + potential);
+}
+/**
+ * @brief v += a * dt for every body
+ * 
+ * @param dt time step
+ */
+template<typename T>
+void NBodySystem2D<T>::kick(T dt){
+    ScopedPhase timer(Phase::Integrate);
+    if(m_storage == StorageMode::SoA){
+        parallelRanges(m_soa.size(), PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                m_soa.vx[i] += m_soa.ax[i] * dt;
+                m_soa.vy[i] += m_soa.ay[i] * dt;
             }
+        });
+        m_mirrorStale = true;
+        return;
+    }
+    parallelRanges(m_bodies.size(), PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; ++i){
+            Body2D<T> &b = m_bodies[i];
+
+            T ax = b.f.x / b.m;
+            T ay = b.f.y / b.m;
+
+            b.v.x += ax * dt;
+            b.v.y += ay * dt;
         }
+    });
+}
+/**
+ * @brief r += v * dt for every body
+ * 
+ * @param dt time step
+ */
+template<typename T>
+void NBodySystem2D<T>::drift(T dt){
+    ScopedPhase timer(Phase::Integrate);
+    // forces belong to the old positions from here on
+    m_forcesValid = false;
+    if(m_storage == StorageMode::SoA){
+        parallelRanges(m_soa.size(), PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                m_soa.x[i] += m_soa.vx[i] * dt;
+                m_soa.y[i] += m_soa.vy[i] * dt;
+            }
+        });
+        m_mirrorStale = true;
+        return;
     }
-    return kinetic + potential;
+    parallelRanges(m_bodies.size(), PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+        for(std::size_t i = begin; i < end; ++i){
+            Body2D<T> &b = m_bodies[i];
+            b.r.x += b.v.x * dt;
+            b.r.y += b.v.y * dt;
+        }
+    });
 }
 /**
  * @brief advance system by one time step using euler
  * Algo:
  *      computeForces()
  *      a = F / m
- *      r_{n+1} = r_n + v_n * dt
- *      v_{n+1} = v_n + a * dt
+ *      r_{n+1} = r_n + v_n * dt    (drift)
+ *      v_{n+1} = v_n + a * dt      (kick)
  */
-void NBodySystem2D::stepEuler(Real dt){
+template<typename T>
+void NBodySystem2D<T>::stepEuler(T dt){
     computeForces();
 
-    const std::size_t n = m_bodies.size();
-    for(std::size_t i = 0; i < n; ++i){
-        Body2D &b = m_bodies[i];
-
-        Real ax = b.f.x / b.m;
-        Real ay = b.f.y / b.m;
-
-        // update positions using current velocity
-        b.r.x += b.v.x * dt;
-        b.r.y += b.v.y * dt;
-
-        // update velocity using current acceleration
-        b.v.x += ax * dt;
-        b.v.y += ay * dt;
-    }
+    // update positions using current velocity
+    drift(dt);
+    // update velocity using current acceleration
+    kick(dt);
 }
 /**
  * @brief advance system by one time step using semieuler
  *      * Algo:
  *      computeForces()
  *      a = F / m
- *      v_{n+1} = v_n + a * dt
- *      r_{n+1} = r_n + v_{n+1} * dt
+ *      v_{n+1} = v_n + a * dt          (kick)
+ *      r_{n+1} = r_n + v_{n+1} * dt    (drift)
  */
-void NBodySystem2D::stepSemiEuler(Real dt){
+template<typename T>
+void NBodySystem2D<T>::stepSemiEuler(T dt){
     computeForces();
 
-    const std::size_t n = m_bodies.size();
-    for(std::size_t i = 0; i < n; ++i){
-        Body2D &b = m_bodies[i];
-
-        Real ax = b.f.x / b.m;
-        Real ay = b.f.y / b.m;
-
-        // update velocity
-        b.v.x += ax * dt;
-        b.v.y += ay * dt;
-
-        // update position using new velocity
-        b.r.x += b.v.x * dt;
-        b.r.y += b.v.y * dt;
-    }
+    // update velocity
+    kick(dt);
+    // update position using new velocity
+    drift(dt);
 }
 /**
  * @brief advance system by one time step using verlet
@@ -246,39 +1939,306 @@ void NBodySystem2D::stepSemiEuler(Real dt){
  *      computeForces() again to get acceleration a_new
  *      update velocities: 
  *          v_{n+1} = v_n + 0.5 * (a_old + a_new) * dt
+ *      done as half kick with a_old, drift, computeForces(), half kick with a_new
  */
-void NBodySystem2D::stepVerlet(Real dt){
-    const std::size_t n = m_bodies.size();
-    if(n==0){
+template<typename T>
+void NBodySystem2D<T>::stepVerlet(T dt){
+    if(bodyCount() == 0){
         return;
     }
+    const T halfDt = static_cast<T>(0.5) * dt;
+
     // first force evaluation to get old accelerations
     computeForces();
+    // v_{n+1/2} = v_n + 0.5 * a_old * dt
+    kick(halfDt);
+    // r_{n+1} = r_n + v_{n+1/2} * dt = r_n + v_n * dt + 0.5 * a_old * dt^2
+    drift(dt);
+    // compute forces at new positions to get new accelerations
+    computeForces();
+    // v_{n+1} = v_{n+1/2} + 0.5 * a_new * dt
+    kick(halfDt);
+}
+/**
+ * @brief advance system by one time step using kick-drift-kick leapfrog
+ * Algo:
+ *      v_{n+1/2} = v_n + 0.5 * a_n * dt            (kick)
+ *      r_{n+1} = r_n + v_{n+1/2} * dt              (drift)
+ *      computeForces() to get a_{n+1}
+ *      v_{n+1} = v_{n+1/2} + 0.5 * a_{n+1} * dt    (kick)
+ *      same trajectory as stepVerlet, but a_n is the a_{n+1} kept from the previous step,
+ *      so only one force evaluation per step
+ *      a_n is recomputed first if bodies or parameters changed since the last computeForces()
+ */
+template<typename T>
+void NBodySystem2D<T>::stepLeapfrog(T dt){
+    if(bodyCount() == 0){
+        return;
+    }
+    const T halfDt = static_cast<T>(0.5) * dt;
+
+    // only the first step, or one after an edit, pays for a_n
+    if(!m_forcesValid){
+        computeForces();
+    }
+    kick(halfDt);
+    drift(dt);
+    // a_{n+1} stays valid for the next step
+    computeForces();
+    kick(halfDt);
+}
+/**
+ * @brief advance system by one time step with the 4th-order Yoshida / Forest-Ruth composition
+ * Algo:
+ *      w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 * w1 (negative)
+ *      stepLeapfrog(w1 * dt), stepLeapfrog(w0 * dt), stepLeapfrog(w1 * dt)
+ *      symmetric and symplectic like leapfrog, the middle backwards substep cancels the dt^3 error
+ *      three force evaluations per step, the last one is kept for the next step
+ */
+template<typename T>
+void NBodySystem2D<T>::stepYoshida(T dt){
+    if(bodyCount() == 0){
+        return;
+    }
+    // weights in long double so float runs still get the exact composition
+    const long double cubeRootTwo = std::cbrt(2.0L);
+    const T w1 = static_cast<T>(1.0L / (2.0L - cubeRootTwo));
+    const T w0 = static_cast<T>(-cubeRootTwo / (2.0L - cubeRootTwo));
 
-    // store old accelerations
-    std::vector<Vec2> aOld(n);
-    for(std::size_t i = 0; i < n; ++i){
-        const Body2D &b = m_bodies[i];
-        aOld[i].x = b.f.x / b.m;
-        aOld[i].y = b.f.y / b.m;
+    stepLeapfrog(w1 * dt);
+    stepLeapfrog(w0 * dt);
+    stepLeapfrog(w1 * dt);
+}
+/**
+ * @brief advance system by one time step with the 4th-order Hermite predictor-corrector
+ * Algo:
+ *      a_0 and jerk j_0 = da/dt at the start of the step, kept from the previous step
+ *      predict:
+ *          r_p = r_0 + v_0 * dt + a_0 * dt^2 / 2 + j_0 * dt^3 / 6
+ *          v_p = v_0 + a_0 * dt + j_0 * dt^2 / 2
+ *      a_1, j_1 from the predicted positions and velocities
+ *      correct:
+ *          v_1 = v_0 + (a_0 + a_1) * dt / 2 + (j_0 - j_1) * dt^2 / 12
+ *          r_1 = r_0 + (v_0 + v_1) * dt / 2 + (a_0 - a_1) * dt^2 / 12
+ *      a_1, j_1 are used as a_0, j_0 of the next step, so one force evaluation per step
+ *      always uses the direct sum, the tree engines have no jerk
+ */
+template<typename T>
+void NBodySystem2D<T>::stepHermite(T dt){
+    const std::size_t n = bodyCount();
+    if(n == 0){
+        return;
     }
 
-    // update positions with current velocities and aOld
-    for(std::size_t i = 0; i < n; ++i){
-        Body2D &b = m_bodies[i];
+    // the step runs on arrays, AoS mode gathers positions, velocities and F / m once per step
+    const bool soa = m_storage == StorageMode::SoA;
+    if(soa){
+        syncArrays();
+    }
+    else{
+        m_scratch.load(m_bodies);
+    }
+    BodyArrays2D<T> &arrays = soa ? m_soa : m_scratch;
 
-        b.r.x += b.v.x * dt + static_cast<Real>(0.5) * aOld[i].x * dt * dt;
-        b.r.y += b.v.y * dt + static_cast<Real>(0.5) * aOld[i].y * dt * dt;
+    // a_0, j_0 of the last step only hold if nothing moved, changed or recomputed forces since
+    if(!m_forcesValid || m_hermiteEvaluation != m_forceEvaluations || m_jerkX.size() != n){
+        computeAccelerationsJerk(arrays);
     }
-    // compute forces at new positions to get new accelerations
-    computeForces();
-    // update velocities with average of old and new accelerations
-    for(std::size_t i = 0; i < n; ++i){
-        Body2D &b = m_bodies[i];
-        Vec2 aNew;
-        aNew.x = b.f.x / b.m;
-        aNew.y = b.f.y / b.m;
-        b.v.x += static_cast<Real>(0.5) * (aOld[i].x + aNew.x) * dt;
-        b.v.y += static_cast<Real>(0.5) * (aOld[i].y + aNew.y) * dt;
-    }
-}
\ No newline at end of file
+    m_hermiteStart = arrays;
+    m_jerkStartX = m_jerkX;
+    m_jerkStartY = m_jerkY;
+    const BodyArrays2D<T> &start = m_hermiteStart;
+
+    const T halfDt = static_cast<T>(0.5) * dt;
+    const T halfDt2 = halfDt * dt;
+    const T sixthDt3 = halfDt2 * dt / static_cast<T>(3);
+    const T twelfthDt2 = halfDt2 / static_cast<T>(6);
+    {
+        ScopedPhase timer(Phase::Integrate);
+        parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                arrays.x[i] = start.x[i] + start.vx[i] * dt + start.ax[i] * halfDt2 + m_jerkStartX[i] * sixthDt3;
+                arrays.y[i] = start.y[i] + start.vy[i] * dt + start.ay[i] * halfDt2 + m_jerkStartY[i] * sixthDt3;
+                arrays.vx[i] = start.vx[i] + start.ax[i] * dt + m_jerkStartX[i] * halfDt2;
+                arrays.vy[i] = start.vy[i] + start.ay[i] * dt + m_jerkStartY[i] * halfDt2;
+            }
+        });
+    }
+    m_forcesValid = false;
+
+    computeAccelerationsJerk(arrays);
+
+    {
+        ScopedPhase timer(Phase::Integrate);
+        parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                arrays.vx[i] = start.vx[i] + (start.ax[i] + arrays.ax[i]) * halfDt + (m_jerkStartX[i] - m_jerkX[i]) * twelfthDt2;
+                arrays.vy[i] = start.vy[i] + (start.ay[i] + arrays.ay[i]) * halfDt + (m_jerkStartY[i] - m_jerkY[i]) * twelfthDt2;
+                arrays.x[i] = start.x[i] + (start.vx[i] + arrays.vx[i]) * halfDt + (start.ax[i] - arrays.ax[i]) * twelfthDt2;
+                arrays.y[i] = start.y[i] + (start.vy[i] + arrays.vy[i]) * halfDt + (start.ay[i] - arrays.ay[i]) * twelfthDt2;
+            }
+        });
+    }
+
+    // a_1, j_1 belong to the predicted state, Hermite carries them into the next step as they are
+    if(soa){
+        m_mirrorStale = true;
+    }
+    else{
+        m_scratch.store(m_bodies);
+    }
+    m_forcesValid = true;
+    m_hermiteEvaluation = m_forceEvaluations;
+}
+/**
+ * @brief advance system by dt with individual power-of-two timesteps (hierarchical block steps)
+ * Algo:
+ *      every body sits in a bin k and steps with dt_k = dt / 2^k, the step is split into
+ *      2^(levels - 1) ticks h of the smallest bin
+ *      at the start of the step every body is synchronized and gets its opening half kick
+ *          v += 0.5 * a * dt_k
+ *      each tick where a step ends, the next multiple of the finest occupied bin's length:
+ *          drift every body by the ticks since the last one, r += v * h * ticks
+ *          bodies whose step ends now are active: accelerations for active bodies only,
+ *          from all bodies at the current positions, then their closing half kick
+ *          active bodies pick a new bin from the criterion, a larger step only where the
+ *          time is aligned to it, and open their next step with a half kick
+ *      the last tick ends every bin, so all bodies are synchronized and the final
+ *      accelerations are kept for the next step, like stepLeapfrog
+ *      with one bin, or every body in bin 0, this is exactly stepLeapfrog, one force pass per step
+ *      Direct and Barnes-Hut sum active rows only, Fmm evaluates every body and uses the active ones,
+ *      or sums few active rows directly, Pm always evaluates every body
+ */
+template<typename T>
+void NBodySystem2D<T>::stepBlock(T dt){
+    const std::size_t n = bodyCount();
+    if(n == 0){
+        return;
+    }
+
+    // the step runs on arrays, AoS mode gathers positions, velocities and F / m once per step
+    const bool soa = m_storage == StorageMode::SoA;
+    if(soa){
+        syncArrays();
+    }
+    else{
+        m_scratch.load(m_bodies);
+    }
+    BodyArrays2D<T> &arrays = soa ? m_soa : m_scratch;
+
+    // a full pass over arrays, same work as computeForces()
+    const auto fullPass = [&](){
+        ScopedPhase timer(Phase::Forces);
+        ++m_forceEvaluations;
+        m_pairInteractions += static_cast<unsigned long long>(n) * (n - 1) / 2;
+        m_potentialValid = false;
+        arrays.clearAccelerations();
+        computeAccelerations(arrays);
+    };
+    if(!m_forcesValid){
+        fullPass();
+    }
+
+    const int levels = m_blockLevels;
+    const long long substeps = 1LL << (levels - 1);
+    std::vector<T> halfStep(static_cast<std::size_t>(levels));
+    for(int k = 0; k < levels; ++k){
+        halfStep[static_cast<std::size_t>(k)] = static_cast<T>(0.5) * dt / static_cast<T>(1LL << k);
+    }
+    const T h = dt / static_cast<T>(substeps);
+
+    // everyone is synchronized here, so every bin is allowed
+    m_blockBin.assign(n, 0);
+    {
+        ScopedPhase timer(Phase::Integrate);
+        parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t i = begin; i < end; ++i){
+                const int bin = blockBinFor(arrays.ax[i], arrays.ay[i], dt);
+                m_blockBin[i] = bin;
+                const T half = halfStep[static_cast<std::size_t>(bin)];
+                arrays.vx[i] += arrays.ax[i] * half;
+                arrays.vy[i] += arrays.ay[i] * half;
+            }
+        });
+    }
+
+    long long tick = 0;
+    while(tick < substeps){
+        // every step ends on a multiple of its length in ticks, so the next tick where any step
+        // ends is the next multiple of the finest occupied bin's length, the ticks between are skipped
+        int finest = 0;
+        for(std::size_t i = 0; i < n; ++i){
+            finest = std::max(finest, m_blockBin[i]);
+        }
+        const long long stride = 1LL << (levels - 1 - finest);
+        const long long next = (tick / stride + 1) * stride;
+        const T interval = h * static_cast<T>(next - tick);
+        tick = next;
+        {
+            ScopedPhase timer(Phase::Integrate);
+            parallelRanges(n, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+                for(std::size_t i = begin; i < end; ++i){
+                    arrays.x[i] += arrays.vx[i] * interval;
+                    arrays.y[i] += arrays.vy[i] * interval;
+                }
+            });
+        }
+        m_forcesValid = false;
+
+        // bins whose step ends at this tick are the ones whose length in ticks divides it
+        int trailingZeros = 0;
+        while(((tick >> trailingZeros) & 1LL) == 0){
+            ++trailingZeros;
+        }
+        const int firstActiveBin = levels - 1 - trailingZeros;
+
+        // the last tick ends every bin, the full pass also sums the potential if asked
+        const bool last = tick == substeps;
+        if(last){
+            fullPass();
+        }
+        else{
+            m_blockActive.clear();
+            for(std::size_t i = 0; i < n; ++i){
+                if(m_blockBin[i] >= firstActiveBin){
+                    m_blockActive.push_back(i);
+                }
+            }
+            computeAccelerationsActive(arrays, m_blockActive);
+        }
+
+        // closing half kick, new bin, opening half kick
+        ScopedPhase timer(Phase::Integrate);
+        const std::size_t activeCount = last ? n : m_blockActive.size();
+        parallelRanges(activeCount, PARALLEL_GRAIN, [&](std::size_t begin, std::size_t end){
+            for(std::size_t k = begin; k < end; ++k){
+                const std::size_t i = last ? k : m_blockActive[k];
+                const T closing = halfStep[static_cast<std::size_t>(m_blockBin[i])];
+                arrays.vx[i] += arrays.ax[i] * closing;
+                arrays.vy[i] += arrays.ay[i] * closing;
+                // a larger step has to start at a time that is a multiple of it
+                const int bin = std::max(blockBinFor(arrays.ax[i], arrays.ay[i], dt), last ? 0 : firstActiveBin);
+                m_blockBin[i] = bin;
+                if(!last){
+                    const T opening = halfStep[static_cast<std::size_t>(bin)];
+                    arrays.vx[i] += arrays.ax[i] * opening;
+                    arrays.vy[i] += arrays.ay[i] * opening;
+                }
+            }
+        });
+    }
+
+    // accelerations of the last full pass belong to the final positions
+    if(soa){
+        m_mirrorStale = true;
+    }
+    else{
+        m_scratch.store(m_bodies);
+    }
+    m_forcesValid = true;
+}
+
+// precisions selectable through the precision config key
+template class NBodySystem2D<float>;
+template class NBodySystem2D<double>;
+template class NBodySystem2D<long double>;
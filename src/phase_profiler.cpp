@@ -0,0 +1,278 @@
+// phaseprofiler class, scoped wall-clock timers for the phases of a run
+
+#include "phase_profiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+/**
+ * @brief construct a disabled profiler with empty totals
+ *
+ */
+PhaseProfiler::PhaseProfiler() : m_enabled(false), m_keepTrace(false), m_mainThread(), m_begin(), m_end(), m_traceMutex(), m_events(), m_threads(), m_droppedEvents(0){
+    for(std::size_t p = 0; p < PHASE_COUNT; ++p){
+        for(std::size_t k = 0; k < 2; ++k){
+            m_nanos[p][k].store(0);
+            m_calls[p][k].store(0);
+        }
+    }
+}
+
+/**
+ * @brief clear totals and events, start the wall clock and enable timing
+ *        the calling thread is reported as the main thread
+ *
+ * @param keepTrace true to also record every scope for writeTrace()
+ */
+void PhaseProfiler::start(bool keepTrace){
+    for(std::size_t p = 0; p < PHASE_COUNT; ++p){
+        for(std::size_t k = 0; k < 2; ++k){
+            m_nanos[p][k].store(0, std::memory_order_relaxed);
+            m_calls[p][k].store(0, std::memory_order_relaxed);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        m_events.clear();
+        m_threads.clear();
+        m_droppedEvents = 0;
+        // the main thread is trace thread 0
+        m_threads.push_back(std::this_thread::get_id());
+    }
+    m_keepTrace = keepTrace;
+    m_mainThread = std::this_thread::get_id();
+    m_begin = std::chrono::steady_clock::now();
+    m_end = m_begin;
+    m_enabled.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief disable timing and stop the wall clock, scopes already running are still added
+ *
+ */
+void PhaseProfiler::stop(){
+    m_enabled.store(false, std::memory_order_release);
+    m_end = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief add one finished scope
+ *
+ * @param phase phase the scope belongs to
+ * @param begin scope start
+ * @param end scope end
+ */
+void PhaseProfiler::record(Phase phase, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+    const std::size_t p = static_cast<std::size_t>(phase);
+    const std::thread::id id = std::this_thread::get_id();
+    const std::size_t slot = id == m_mainThread ? 0U : 1U;
+    const long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    if(slot == 0){
+        // only the main thread writes slot 0, a plain load and store is enough
+        m_nanos[p][0].store(m_nanos[p][0].load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+        m_calls[p][0].store(m_calls[p][0].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    else{
+        m_nanos[p][1].fetch_add(nanos, std::memory_order_relaxed);
+        m_calls[p][1].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if(!m_keepTrace){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    if(m_events.size() >= MAX_TRACE_EVENTS){
+        ++m_droppedEvents;
+        return;
+    }
+    TraceEvent event;
+    event.phase = phase;
+    event.thread = threadNumber(id);
+    event.beginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - m_begin).count();
+    event.durationNs = nanos;
+    m_events.push_back(event);
+}
+
+/**
+ * @brief seconds between start() and stop()
+ *
+ * @return double
+ */
+double PhaseProfiler::wallSeconds() const{
+    return std::chrono::duration<double>(m_end - m_begin).count();
+}
+
+/**
+ * @brief print the per-phase table and the run rates
+ *        main-thread phases are shown as a share of the wall time, the rest of the wall time is "other",
+ *        time spent on other threads (the asyncLog writer) overlaps the main thread and is listed apart
+ *
+ * @param out stream to print to
+ * @param counters steps, interactions and bytes of the run
+ */
+void PhaseProfiler::printReport(std::ostream &out, const RunCounters &counters) const{
+    const double wall = wallSeconds();
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+
+    out << "Performance report (" << std::fixed << std::setprecision(3) << wall << " s wall):\n";
+    out << "  " << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "seconds" << std::setw(9) << "share" << std::setw(12) << "calls" << std::setw(14) << "us/call" << "\n";
+    double accounted = 0.0;
+    for(std::size_t k = 0; k < 2; ++k){
+        for(std::size_t p = 0; p < PHASE_COUNT; ++p){
+            const long long calls = m_calls[p][k].load(std::memory_order_relaxed);
+            if(calls == 0){
+                continue;
+            }
+            const double seconds = 1e-9 * static_cast<double>(m_nanos[p][k].load(std::memory_order_relaxed));
+            if(k == 0){
+                accounted += seconds;
+            }
+            const std::string name = std::string(phaseName(static_cast<Phase>(p))) + (k == 0 ? "" : " (bg)");
+            out << "  " << std::left << std::setw(10) << name << std::right << std::setw(12) << std::setprecision(4) << seconds;
+            if(k == 0 && wall > 0.0){
+                out << std::setw(8) << std::setprecision(1) << 100.0 * seconds / wall << "%";
+            }
+            else{
+                out << std::setw(9) << "-";
+            }
+            out << std::setw(12) << calls << std::setw(14) << std::setprecision(2) << 1e6 * seconds / static_cast<double>(calls) << "\n";
+        }
+    }
+    if(wall > 0.0){
+        const double other = wall > accounted ? wall - accounted : 0.0;
+        out << "  " << std::left << std::setw(10) << "other" << std::right << std::setw(12) << std::setprecision(4) << other << std::setw(8) << std::setprecision(1) << 100.0 * other / wall << "%\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+    if(wall > 0.0){
+        out << "Steps per second: " << static_cast<double>(counters.steps) / wall << "\n";
+        out << "Interactions per second: " << counters.interactions / wall << "\n";
+    }
+    out << "Bytes written: " << counters.bytesWritten << "\n";
+    if(m_droppedEvents > 0){
+        out << "Trace events dropped past " << MAX_TRACE_EVENTS << ": " << m_droppedEvents << "\n";
+    }
+}
+
+/**
+ * @brief write the report as a JSON object
+ *
+ * @param path output file
+ * @param counters steps, interactions and bytes of the run
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool PhaseProfiler::writeJson(const std::string &path, const RunCounters &counters) const{
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    const double wall = wallSeconds();
+    out << std::setprecision(9);
+    out << "{\n  \"wallSeconds\": " << wall << ",\n";
+    out << "  \"steps\": " << counters.steps << ",\n";
+    out << "  \"stepsPerSecond\": " << (wall > 0.0 ? static_cast<double>(counters.steps) / wall : 0.0) << ",\n";
+    out << "  \"interactions\": " << counters.interactions << ",\n";
+    out << "  \"interactionsPerSecond\": " << (wall > 0.0 ? counters.interactions / wall : 0.0) << ",\n";
+    out << "  \"bytesWritten\": " << counters.bytesWritten << ",\n";
+    out << "  \"phases\": [\n";
+    for(std::size_t p = 0; p < PHASE_COUNT; ++p){
+        out << "    {\"name\": \"" << phaseName(static_cast<Phase>(p)) << "\"";
+        out << ", \"seconds\": " << 1e-9 * static_cast<double>(m_nanos[p][0].load(std::memory_order_relaxed));
+        out << ", \"calls\": " << m_calls[p][0].load(std::memory_order_relaxed);
+        out << ", \"backgroundSeconds\": " << 1e-9 * static_cast<double>(m_nanos[p][1].load(std::memory_order_relaxed));
+        out << ", \"backgroundCalls\": " << m_calls[p][1].load(std::memory_order_relaxed) << "}";
+        out << (p + 1 < PHASE_COUNT ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief write the recorded scopes as Chrome trace events, one complete ("X") event per scope
+ *
+ * @param path output file
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool PhaseProfiler::writeTrace(const std::string &path) const{
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    // trace timestamps and durations are microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for(std::size_t t = 0; t < m_threads.size(); ++t){
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t << ", \"args\": {\"name\": \"" << (t == 0 ? "main" : "background") << "\"}},\n";
+    }
+    for(std::size_t k = 0; k < m_events.size(); ++k){
+        const TraceEvent &e = m_events[k];
+        out << "{\"name\": \"" << phaseName(e.phase) << "\", \"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread;
+        out << ", \"ts\": " << 1e-3 * static_cast<double>(e.beginNs) << ", \"dur\": " << 1e-3 * static_cast<double>(e.durationNs) << "}";
+        out << (k + 1 < m_events.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief short lowercase name of a phase, used in the report and the trace
+ *
+ * @param phase phase to name
+ * @return const char*
+ */
+const char *PhaseProfiler::phaseName(Phase phase){
+    switch(phase){
+        case Phase::Forces:
+            return "forces";
+        case Phase::Integrate:
+            return "integrate";
+        case Phase::Energy:
+            return "energy";
+        case Phase::Logging:
+            return "logging";
+        case Phase::Events:
+            return "events";
+        case Phase::Render:
+            return "render";
+        case Phase::Checkpoint:
+            return "checkpoint";
+        case Phase::Collisions:
+            return "collisions";
+        case Phase::Analysis:
+            return "analysis";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief small stable number for the calling thread, 0 for the thread that called start()
+ *        caller must hold m_traceMutex
+ *
+ * @param id thread to number
+ * @return std::size_t
+ */
+std::size_t PhaseProfiler::threadNumber(std::thread::id id){
+    for(std::size_t t = 0; t < m_threads.size(); ++t){
+        if(m_threads[t] == id){
+            return t;
+        }
+    }
+    m_threads.push_back(id);
+    return m_threads.size() - 1;
+}
+
+/**
+ * @brief the profiler every ScopedPhase reports to
+ *
+ * @return PhaseProfiler&
+ */
+PhaseProfiler &phaseProfiler(){
+    static PhaseProfiler profiler;
+    return profiler;
+}
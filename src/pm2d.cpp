@@ -0,0 +1,632 @@
+// pmsolver2d class, particle-mesh gravity through FFT convolution on a square grid
+
+#include "pm2d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace{
+
+// the isolated grid keeps bodies this many cells away from its edges, room for the Tsc stencil
+constexpr std::size_t EDGE_CELLS = 2;
+// isolated cell sizes are 2^(k / CELL_STEPS) for integer k
+constexpr double CELL_STEPS = 8.0;
+
+/**
+ * @brief run body(begin, end) over [0, n) on the pool, or on the calling thread without one
+ *
+ * @param pool worker threads, may be null
+ * @param n range size
+ * @param grain smallest chunk
+ * @param body function taking a chunk
+ */
+void forRanges(ThreadPool *pool, std::size_t n, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body){
+    if(pool){
+        pool->parallelFor(0, n, grain, body);
+    }
+    else if(n > 0){
+        body(0, n);
+    }
+}
+
+/**
+ * @brief complex product written out, std::complex multiplication checks for inf/nan on every call
+ *
+ * @param a first factor
+ * @param b second factor
+ * @return std::complex<T> a * b
+ */
+template<typename T>
+std::complex<T> multiply(const std::complex<T> &a, const std::complex<T> &b){
+    return std::complex<T>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+/**
+ * @brief signed grid offset of a transform index, indices past half the size are negative offsets
+ *
+ * @param index index in [0, size)
+ * @param size transform size
+ * @return double offset in cells
+ */
+double wrappedOffset(std::size_t index, std::size_t size){
+    return index <= size / 2 ? static_cast<double>(index) : static_cast<double>(index) - static_cast<double>(size);
+}
+
+}
+
+/**
+ * @brief construct a solver with a 256 x 256 cloud in cell grid and isolated boundaries
+ *
+ */
+template<typename T>
+PmSolver2D<T>::PmSolver2D() : m_grid(256), m_size(512), m_assignment(PmAssignment::Cic), m_boundary(PmBoundary::Isolated), m_boxSize(static_cast<T>(0)), m_cell(static_cast<T>(1)), m_originX(static_cast<T>(0)), m_originY(static_cast<T>(0)), m_smoothing(static_cast<T>(0)), m_kernelCell(static_cast<T>(0)), m_kernelSmoothing(static_cast<T>(0)), m_potentialKernelValid(false), m_hasPotential(false), m_nearPotential(), m_twiddle(), m_bitReverse(), m_forceKernel(), m_potentialKernel(), m_density(), m_forceField(), m_potentialField(), m_massGrids(){}
+
+/**
+ * @brief set cells per side, rounded up to a power of two and clamped to [MIN_GRID, MAX_GRID]
+ *        structure below the cell size is smoothed away, the error drops fast once sqrt(eps2) spans a few cells
+ *
+ * @param cells cells per side
+ */
+template<typename T>
+void PmSolver2D<T>::setGridSize(std::size_t cells){
+    std::size_t grid = MIN_GRID;
+    while(grid < cells && grid < MAX_GRID){
+        grid <<= 1;
+    }
+    m_grid = grid;
+    m_size = m_boundary == PmBoundary::Isolated ? 2 * m_grid : m_grid;
+    m_kernelCell = static_cast<T>(0);
+}
+
+/**
+ * @brief Get cells per side
+ *
+ * @return std::size_t
+ */
+template<typename T>
+std::size_t PmSolver2D<T>::getGridSize() const{
+    return m_grid;
+}
+
+/**
+ * @brief set mass assignment scheme
+ *
+ * @param assignment Cic or Tsc
+ */
+template<typename T>
+void PmSolver2D<T>::setAssignment(PmAssignment assignment){
+    m_assignment = assignment;
+    m_kernelCell = static_cast<T>(0);
+}
+
+/**
+ * @brief Get mass assignment scheme
+ *
+ * @return PmAssignment
+ */
+template<typename T>
+PmAssignment PmSolver2D<T>::getAssignment() const{
+    return m_assignment;
+}
+
+/**
+ * @brief set boundary condition
+ *
+ * @param boundary Isolated or Periodic
+ * @param boxSize side of the periodic box centred on the origin, ignored for Isolated
+ */
+template<typename T>
+void PmSolver2D<T>::setBoundary(PmBoundary boundary, T boxSize){
+    m_boundary = boundary;
+    m_boxSize = boxSize;
+    m_size = m_boundary == PmBoundary::Isolated ? 2 * m_grid : m_grid;
+    m_kernelCell = static_cast<T>(0);
+}
+
+/**
+ * @brief Get boundary condition
+ *
+ * @return PmBoundary
+ */
+template<typename T>
+PmBoundary PmSolver2D<T>::getBoundary() const{
+    return m_boundary;
+}
+
+/**
+ * @brief Get side of the periodic box
+ *
+ * @return T
+ */
+template<typename T>
+T PmSolver2D<T>::getBoxSize() const{
+    return m_boxSize;
+}
+
+/**
+ * @brief assign masses, convolve with the kernels and keep the fields until the next evaluate()
+ *
+ * @param bodies bodies acting as sources, non-finite positions are left out
+ * @param eps2 softening value added to r^2
+ * @param withPotential also compute the potential field for potentialEnergy()
+ * @param pool worker threads for assignment and FFTs, null = calling thread only
+ */
+template<typename T>
+void PmSolver2D<T>::evaluate(const BodyArrays2D<T> &bodies, T eps2, bool withPotential, ThreadPool *pool){
+    const std::size_t n = bodies.size();
+    const std::size_t N = m_grid;
+    const std::size_t M = m_size;
+    m_hasPotential = false;
+    placeGrid(bodies, eps2, withPotential, pool);
+
+    // scatter writes collide between threads, each band gets its own grid once there are
+    // enough bodies per cell to pay for adding the grids up
+    std::size_t bands = 1;
+    if(pool && pool->threadCount() > 1){
+        bands = std::max<std::size_t>(1, std::min(pool->threadCount(), n / std::max<std::size_t>(1, N * N / 4)));
+    }
+    m_massGrids.assign(bands * N * N, static_cast<T>(0));
+    const auto assign = [&](std::size_t k){
+        T *grid = m_massGrids.data() + k * N * N;
+        std::size_t cellX[3];
+        std::size_t cellY[3];
+        T weightX[3];
+        T weightY[3];
+        const std::size_t end = n * (k + 1) / bands;
+        for(std::size_t i = n * k / bands; i < end; ++i){
+            const std::size_t count = stencil(bodies.x[i], bodies.y[i], cellX, cellY, weightX, weightY);
+            for(std::size_t b = 0; b < count; ++b){
+                const T rowMass = bodies.m[i] * weightY[b];
+                T *row = grid + cellY[b] * N;
+                for(std::size_t a = 0; a < count; ++a){
+                    row[cellX[a]] += rowMass * weightX[a];
+                }
+            }
+        }
+    };
+    if(bands > 1){
+        pool->run(bands, assign);
+    }
+    else{
+        assign(0);
+    }
+
+    // add the band grids into the corner of the padded transform array
+    m_density.assign(M * M, std::complex<T>());
+    forRanges(pool, N, 1, [&](std::size_t rowBegin, std::size_t rowEnd){
+        for(std::size_t r = rowBegin; r < rowEnd; ++r){
+            for(std::size_t c = 0; c < N; ++c){
+                T mass = static_cast<T>(0);
+                for(std::size_t k = 0; k < bands; ++k){
+                    mass += m_massGrids[k * N * N + r * N + c];
+                }
+                m_density[r * M + c] = std::complex<T>(mass, static_cast<T>(0));
+            }
+        }
+    });
+
+    // convolution = product of transforms, only the rows holding mass need the inverse
+    transform2D(m_density, N, false, pool);
+    m_forceField.resize(M * M);
+    if(withPotential){
+        m_potentialField.resize(M * M);
+    }
+    forRanges(pool, M, 1, [&](std::size_t rowBegin, std::size_t rowEnd){
+        for(std::size_t k = rowBegin * M; k < rowEnd * M; ++k){
+            m_forceField[k] = multiply(m_density[k], m_forceKernel[k]);
+            if(withPotential){
+                m_potentialField[k] = multiply(m_density[k], m_potentialKernel[k]);
+            }
+        }
+    });
+    transform2D(m_forceField, N, true, pool);
+    if(withPotential){
+        transform2D(m_potentialField, N, true, pool);
+        m_hasPotential = true;
+    }
+}
+
+/**
+ * @brief add acceleration from the last evaluate() to the accumulators of bodies [begin, end)
+ *        ranges do not share writes, so they can run on different threads
+ *
+ * @param bodies same bodies that were evaluated
+ * @param G gravitational constant
+ * @param begin first body
+ * @param end one past the last body
+ */
+template<typename T>
+void PmSolver2D<T>::accumulateAccelerations(BodyArrays2D<T> &bodies, T G, std::size_t begin, std::size_t end) const{
+    const std::size_t M = m_size;
+    // the inverse transform was not scaled
+    const T scale = G / (static_cast<T>(M) * static_cast<T>(M));
+    std::size_t cellX[3];
+    std::size_t cellY[3];
+    T weightX[3];
+    T weightY[3];
+    for(std::size_t i = begin; i < end; ++i){
+        const std::size_t count = stencil(bodies.x[i], bodies.y[i], cellX, cellY, weightX, weightY);
+        T sx = static_cast<T>(0);
+        T sy = static_cast<T>(0);
+        for(std::size_t b = 0; b < count; ++b){
+            const std::complex<T> *row = m_forceField.data() + cellY[b] * M;
+            T rowX = static_cast<T>(0);
+            T rowY = static_cast<T>(0);
+            for(std::size_t a = 0; a < count; ++a){
+                rowX += weightX[a] * row[cellX[a]].real();
+                rowY += weightX[a] * row[cellX[a]].imag();
+            }
+            sx += weightY[b] * rowX;
+            sy += weightY[b] * rowY;
+        }
+        bodies.ax[i] += scale * sx;
+        bodies.ay[i] += scale * sy;
+    }
+}
+
+/**
+ * @brief potential energy from the last evaluate(), which must have been asked for the potential
+ *        U = -0.5 * G * sum(m_i * psi(r_i)), each body's own mass removed from its psi
+ *
+ * @param bodies same bodies that were evaluated
+ * @param G gravitational constant
+ * @return T potential energy
+ */
+template<typename T>
+T PmSolver2D<T>::potentialEnergy(const BodyArrays2D<T> &bodies, T G) const{
+    if(!m_hasPotential){
+        return static_cast<T>(0);
+    }
+    const std::size_t M = m_size;
+    const T scale = static_cast<T>(1) / (static_cast<T>(M) * static_cast<T>(M));
+    std::size_t cellX[3];
+    std::size_t cellY[3];
+    T weightX[3];
+    T weightY[3];
+    EnergySum<T> sum = 0;
+    for(std::size_t i = 0; i < bodies.size(); ++i){
+        const std::size_t count = stencil(bodies.x[i], bodies.y[i], cellX, cellY, weightX, weightY);
+        T psi = static_cast<T>(0);
+        T self = static_cast<T>(0);
+        for(std::size_t b = 0; b < count; ++b){
+            for(std::size_t a = 0; a < count; ++a){
+                const T w = weightX[a] * weightY[b];
+                psi += w * m_potentialField[cellY[b] * M + cellX[a]].real();
+                // the body's own mass seen through its own stencil, offsets between stencil slots
+                for(std::size_t bb = 0; bb < count; ++bb){
+                    for(std::size_t aa = 0; aa < count; ++aa){
+                        self += w * weightX[aa] * weightY[bb] * m_nearPotential[(b + 2 - bb) * 5 + (a + 2 - aa)];
+                    }
+                }
+            }
+        }
+        sum += static_cast<EnergySum<T>>(bodies.m[i] * (scale * psi - bodies.m[i] * self));
+    }
+    return static_cast<T>(static_cast<EnergySum<T>>(-0.5) * static_cast<EnergySum<T>>(G) * sum);
+}
+
+/**
+ * @brief returns cell size of the last evaluate()
+ *
+ * @return T cell side length
+ */
+template<typename T>
+T PmSolver2D<T>::cellSize() const{
+    return m_cell;
+}
+
+/**
+ * @brief returns smoothing length s of the last evaluate()
+ *
+ * @return T max(sqrt(eps2), SMOOTHING_CELLS * cell size)
+ */
+template<typename T>
+T PmSolver2D<T>::smoothingLength() const{
+    return m_smoothing;
+}
+
+/**
+ * @brief cells and weights a position is spread over, the same for assignment and interpolation
+ *
+ * @param x x position
+ * @param y y position
+ * @param cellX set to the grid columns, periodic indices already wrapped
+ * @param cellY set to the grid rows
+ * @param weightX set to the weight of each column
+ * @param weightY set to the weight of each row
+ * @return std::size_t cells per axis, 2 for Cic, 3 for Tsc, 0 for a non-finite position
+ */
+template<typename T>
+std::size_t PmSolver2D<T>::stencil(T x, T y, std::size_t *cellX, std::size_t *cellY, T *weightX, T *weightY) const{
+    const T grid = static_cast<T>(m_grid);
+    T u[2] = {(x - m_originX) / m_cell, (y - m_originY) / m_cell};
+    if(!std::isfinite(u[0]) || !std::isfinite(u[1])){
+        return 0;
+    }
+    std::size_t *cells[2] = {cellX, cellY};
+    T *weights[2] = {weightX, weightY};
+    const std::size_t count = m_assignment == PmAssignment::Cic ? 2 : 3;
+    for(int axis = 0; axis < 2; ++axis){
+        if(m_boundary == PmBoundary::Periodic){
+            u[axis] -= grid * std::floor(u[axis] / grid);
+            if(u[axis] >= grid){
+                u[axis] = static_cast<T>(0);
+            }
+        }
+        else{
+            // the grid covers every body, the clamp only guards against rounding at the edges
+            u[axis] = std::max(static_cast<T>(EDGE_CELLS - 1), std::min(grid - static_cast<T>(EDGE_CELLS), u[axis]));
+        }
+        T *w = weights[axis];
+        long long first = 0;
+        if(count == 2){
+            const T c = std::floor(u[axis]);
+            const T f = u[axis] - c;
+            first = static_cast<long long>(c);
+            w[0] = static_cast<T>(1) - f;
+            w[1] = f;
+        }
+        else{
+            const T c = std::floor(u[axis] + static_cast<T>(0.5));
+            const T d = u[axis] - c;
+            first = static_cast<long long>(c) - 1;
+            w[0] = static_cast<T>(0.5) * (static_cast<T>(0.5) - d) * (static_cast<T>(0.5) - d);
+            w[1] = static_cast<T>(0.75) - d * d;
+            w[2] = static_cast<T>(0.5) * (static_cast<T>(0.5) + d) * (static_cast<T>(0.5) + d);
+        }
+        // periodic stencils wrap around the box, isolated ones stay inside by the edge margin
+        const long long N = static_cast<long long>(m_grid);
+        for(std::size_t k = 0; k < count; ++k){
+            const long long index = first + static_cast<long long>(k);
+            cells[axis][k] = static_cast<std::size_t>(((index % N) + N) % N);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief place the grid for this evaluation: cell size, origin and smoothing length
+ *        rebuilds the kernel transforms if the cell size or smoothing changed
+ *
+ * @param bodies bodies to cover
+ * @param eps2 softening value
+ * @param withPotential potential kernel is needed too
+ * @param pool worker threads
+ */
+template<typename T>
+void PmSolver2D<T>::placeGrid(const BodyArrays2D<T> &bodies, T eps2, bool withPotential, ThreadPool *pool){
+    const std::size_t M = m_size;
+    if(m_bitReverse.size() != M){
+        m_bitReverse.resize(M);
+        std::size_t bits = 0;
+        while((static_cast<std::size_t>(1) << bits) < M){
+            ++bits;
+        }
+        for(std::size_t k = 0; k < M; ++k){
+            std::size_t reversed = 0;
+            for(std::size_t b = 0; b < bits; ++b){
+                reversed |= ((k >> b) & 1U) << (bits - 1 - b);
+            }
+            m_bitReverse[k] = reversed;
+        }
+        // long double angles, the twiddles are the only place rounding enters the transform setup
+        const long double pi = 3.141592653589793238462643383279502884L;
+        m_twiddle.resize(M / 2);
+        for(std::size_t k = 0; k < M / 2; ++k){
+            const long double angle = -2.0L * pi * static_cast<long double>(k) / static_cast<long double>(M);
+            m_twiddle[k] = std::complex<T>(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)));
+        }
+        m_kernelCell = static_cast<T>(0);
+    }
+
+    if(m_boundary == PmBoundary::Periodic){
+        m_cell = m_boxSize / static_cast<T>(m_grid);
+        m_originX = static_cast<T>(-0.5) * m_boxSize + static_cast<T>(0.5) * m_cell;
+        m_originY = m_originX;
+    }
+    else{
+        // bounding box of the finite positions
+        double minX = 0.0;
+        double maxX = 0.0;
+        double minY = 0.0;
+        double maxY = 0.0;
+        bool any = false;
+        for(std::size_t i = 0; i < bodies.size(); ++i){
+            const double x = static_cast<double>(bodies.x[i]);
+            const double y = static_cast<double>(bodies.y[i]);
+            if(!std::isfinite(x) || !std::isfinite(y)){
+                continue;
+            }
+            if(!any){
+                minX = maxX = x;
+                minY = maxY = y;
+                any = true;
+            }
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+        const double extent = std::max(maxX - minX, maxY - minY);
+        const double needed = extent / static_cast<double>(m_grid - 2 * EDGE_CELLS - 1);
+        // a cell size from a fixed ladder, so small changes of the extent keep the kernels
+        double cell = 1.0;
+        if(needed > 0.0 && std::isfinite(needed)){
+            cell = std::exp2(std::ceil(CELL_STEPS * std::log2(needed)) / CELL_STEPS);
+        }
+        m_cell = static_cast<T>(cell);
+        const double half = 0.5 * static_cast<double>(m_grid - 1) * static_cast<double>(m_cell);
+        m_originX = static_cast<T>(0.5 * (minX + maxX) - half);
+        m_originY = static_cast<T>(0.5 * (minY + maxY) - half);
+    }
+    m_smoothing = std::max(static_cast<T>(std::sqrt(eps2)), static_cast<T>(SMOOTHING_CELLS) * m_cell);
+
+    if(m_kernelCell != m_cell || m_kernelSmoothing != m_smoothing || m_forceKernel.size() != M * M){
+        buildKernel(false, m_forceKernel, pool);
+        m_potentialKernelValid = false;
+        m_kernelCell = m_cell;
+        m_kernelSmoothing = m_smoothing;
+    }
+    if(withPotential && !m_potentialKernelValid){
+        buildKernel(true, m_potentialKernel, pool);
+        m_potentialKernelValid = true;
+    }
+}
+
+/**
+ * @brief sample a kernel at every grid offset, transform it and divide out the assignment window
+ *        offsets past half the transform size wrap to negative, the offset of exactly half is
+ *        ambiguous and gets 0 in the odd acceleration kernels
+ *        the potential kernel also refreshes m_nearPotential
+ *
+ * @param potential true for psi, false for the acceleration pair ax + i ay
+ * @param out transformed kernel, M x M
+ * @param pool worker threads
+ */
+template<typename T>
+void PmSolver2D<T>::buildKernel(bool potential, std::vector<std::complex<T>> &out, ThreadPool *pool){
+    const std::size_t M = m_size;
+    const T s2 = m_smoothing * m_smoothing;
+    out.resize(M * M);
+    forRanges(pool, M, 1, [&](std::size_t rowBegin, std::size_t rowEnd){
+        for(std::size_t r = rowBegin; r < rowEnd; ++r){
+            const T dy = static_cast<T>(wrappedOffset(r, M)) * m_cell;
+            for(std::size_t c = 0; c < M; ++c){
+                const T dx = static_cast<T>(wrappedOffset(c, M)) * m_cell;
+                const T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dx * dx + dy * dy + s2));
+                if(potential){
+                    out[r * M + c] = std::complex<T>(invDist, static_cast<T>(0));
+                }
+                else{
+                    // a(d) for d = target - source points back at the source
+                    const T invDist3 = invDist * invDist * invDist;
+                    const T kx = 2 * c == M ? static_cast<T>(0) : -dx * invDist3;
+                    const T ky = 2 * r == M ? static_cast<T>(0) : -dy * invDist3;
+                    out[r * M + c] = std::complex<T>(kx, ky);
+                }
+            }
+        }
+    });
+    transform2D(out, M, false, pool);
+
+    // assigning and interpolating with the same window smooths the field twice, divide the window
+    // transform out twice, sinc^2 per axis for Cic, sinc^3 for Tsc
+    const double power = m_assignment == PmAssignment::Cic ? 4.0 : 6.0;
+    std::vector<T> window(M);
+    for(std::size_t k = 0; k < M; ++k){
+        const double f = 3.141592653589793 * wrappedOffset(k, M) / static_cast<double>(M);
+        const double sinc = k == 0 ? 1.0 : std::sin(f) / f;
+        window[k] = static_cast<T>(1.0 / std::pow(sinc, power));
+    }
+    forRanges(pool, M, 1, [&](std::size_t rowBegin, std::size_t rowEnd){
+        for(std::size_t r = rowBegin; r < rowEnd; ++r){
+            for(std::size_t c = 0; c < M; ++c){
+                out[r * M + c] *= window[r] * window[c];
+            }
+        }
+    });
+
+    if(potential){
+        // the self terms need the kernel the mesh actually applies, transform a copy back
+        std::vector<std::complex<T>> applied(out);
+        transform2D(applied, M, true, pool);
+        const T scale = static_cast<T>(1) / (static_cast<T>(M) * static_cast<T>(M));
+        for(std::size_t oy = 0; oy < 5; ++oy){
+            for(std::size_t ox = 0; ox < 5; ++ox){
+                m_nearPotential[oy * 5 + ox] = scale * applied[((oy + M - 2) % M) * M + (ox + M - 2) % M].real();
+            }
+        }
+    }
+}
+
+/**
+ * @brief in-place 2D FFT of an M x M row-major array
+ *        forward transforms rows [0, rows) then every column, inverse every column then rows [0, rows),
+ *        rows past that are zero going in (forward) or not needed coming out (inverse)
+ *        the inverse is not scaled by 1 / M^2
+ *
+ * @param data array to transform
+ * @param rows rows that matter
+ * @param inverse true for the inverse transform
+ * @param pool worker threads
+ */
+template<typename T>
+void PmSolver2D<T>::transform2D(std::vector<std::complex<T>> &data, std::size_t rows, bool inverse, ThreadPool *pool) const{
+    const std::size_t M = m_size;
+    const auto rowPass = [&](){
+        forRanges(pool, rows, 1, [&](std::size_t rowBegin, std::size_t rowEnd){
+            for(std::size_t r = rowBegin; r < rowEnd; ++r){
+                transform1D(data.data() + r * M, inverse);
+            }
+        });
+    };
+    const auto columnPass = [&](){
+        forRanges(pool, M, COLUMN_BLOCK, [&](std::size_t columnBegin, std::size_t columnEnd){
+            // a few neighbouring columns at a time, every row read then fills whole cache lines
+            std::vector<std::complex<T>> buffer(COLUMN_BLOCK * M);
+            for(std::size_t c0 = columnBegin; c0 < columnEnd; c0 += COLUMN_BLOCK){
+                const std::size_t width = std::min(COLUMN_BLOCK, columnEnd - c0);
+                for(std::size_t r = 0; r < M; ++r){
+                    const std::complex<T> *row = data.data() + r * M + c0;
+                    for(std::size_t k = 0; k < width; ++k){
+                        buffer[k * M + r] = row[k];
+                    }
+                }
+                for(std::size_t k = 0; k < width; ++k){
+                    transform1D(buffer.data() + k * M, inverse);
+                }
+                for(std::size_t r = 0; r < M; ++r){
+                    std::complex<T> *row = data.data() + r * M + c0;
+                    for(std::size_t k = 0; k < width; ++k){
+                        row[k] = buffer[k * M + r];
+                    }
+                }
+            }
+        });
+    };
+    if(inverse){
+        columnPass();
+        rowPass();
+    }
+    else{
+        rowPass();
+        columnPass();
+    }
+}
+
+/**
+ * @brief in-place radix-2 FFT of M contiguous values
+ *
+ * @param data first value
+ * @param inverse true for the inverse transform, not scaled
+ */
+template<typename T>
+void PmSolver2D<T>::transform1D(std::complex<T> *data, bool inverse) const{
+    const std::size_t M = m_size;
+    for(std::size_t k = 0; k < M; ++k){
+        const std::size_t j = m_bitReverse[k];
+        if(k < j){
+            std::swap(data[k], data[j]);
+        }
+    }
+    for(std::size_t length = 2; length <= M; length <<= 1){
+        const std::size_t half = length / 2;
+        const std::size_t step = M / length;
+        for(std::size_t start = 0; start < M; start += length){
+            for(std::size_t k = 0; k < half; ++k){
+                const std::complex<T> &t = m_twiddle[k * step];
+                const std::complex<T> w = inverse ? std::conj(t) : t;
+                const std::complex<T> u = data[start + k];
+                const std::complex<T> v = multiply(data[start + k + half], w);
+                data[start + k] = std::complex<T>(u.real() + v.real(), u.imag() + v.imag());
+                data[start + k + half] = std::complex<T>(u.real() - v.real(), u.imag() - v.imag());
+            }
+        }
+    }
+}
+
+// precisions selectable through the precision config key
+template class PmSolver2D<float>;
+template class PmSolver2D<double>;
+template class PmSolver2D<long double>;
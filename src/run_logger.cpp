@@ -1,28 +1,146 @@
 // runlogger class, writes to csv
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <limits>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "body2d.hpp"
 #include "nbody_system2d.h"
+#include "phase_profiler.h"
 #include "run_logger.h"
 
-RunLogger::RunLogger() : m_trajOfs(), m_wroteHeader(false){}
+RunLogger::RunLogger() : m_trajOfs(), m_wroteHeader(false), m_format(LogFormat::Csv), m_binaryHeader(), m_frame(), m_compressedHeader(), m_compressor(), m_block(), m_values(), m_positionError(1e-6), m_velocityError(1e-6), m_keyframeEvery(64), m_bytesWritten(0){}
 
-bool RunLogger::open(const std::string &path){
-    m_trajOfs.open(path);
+void RunLogger::setCompression(double positionError, double velocityError, unsigned int keyframeEvery){
+    m_positionError = positionError;
+    m_velocityError = velocityError;
+    m_keyframeEvery = keyframeEvery;
+}
+
+bool RunLogger::open(const std::string &path, LogFormat format){
+    m_format = format;
+    m_trajOfs.open(path, format != LogFormat::Csv ? std::ios::out | std::ios::binary : std::ios::out);
+    m_wroteHeader = false;
+    m_bytesWritten = 0;
+    return static_cast<bool>(m_trajOfs);
+}
+
+bool RunLogger::openAppend(const std::string &path, LogFormat format, unsigned long long framesKept, unsigned long long &framesFound){
+    framesFound = 0;
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    if(ec || size == 0){
+        return open(path, format);
+    }
+    m_format = format;
     m_wroteHeader = false;
+    m_bytesWritten = 0;
+
+    std::uintmax_t keep = 0;
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if(!in){
+            return false;
+        }
+        if(format == LogFormat::Binary){
+            TrajectoryHeader header;
+            if(!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, "NBODYTRJ", 8) != 0 || header.frameBytes == 0){
+                return false;
+            }
+            // whole frames only, a torn last frame is dropped
+            const std::uintmax_t frames = size >= header.headerBytes ? (size - header.headerBytes) / header.frameBytes : 0;
+            framesFound = std::min<unsigned long long>(framesKept, frames);
+            keep = header.headerBytes + framesFound * header.frameBytes;
+            m_binaryHeader = header;
+            m_frame.resize(static_cast<std::size_t>(header.frameBytes));
+        }
+        else if(format == LogFormat::Compressed){
+            in.close();
+            CompressedTrajectoryReader reader;
+            if(!reader.open(path, std::cerr)){
+                return false;
+            }
+            // whole blocks are kept as they are, the frames kept of a cut block go back into
+            // the compressor and are written again with the next block
+            m_compressedHeader = reader.header();
+            m_compressor.begin(m_compressedHeader);
+            framesFound = std::min<unsigned long long>(framesKept, reader.frameCount());
+            std::size_t b = 0;
+            while(b < reader.blockCount() && reader.blockFirstFrame(b + 1) <= framesFound){
+                ++b;
+            }
+            keep = reader.blockOffset(b);
+            for(std::size_t k = reader.blockFirstFrame(b); k < framesFound; ++k){
+                const double *values = reader.frame(k, std::cerr);
+                if(values == nullptr){
+                    framesFound = k;
+                    break;
+                }
+                m_compressor.addFrame(values);
+            }
+            m_frame.resize(reader.valuesPerFrame() * sizeof(double));
+            m_values.resize(reader.valuesPerFrame());
+        }
+        else{
+            // header line, then one line per frame, a line without its newline is dropped
+            std::string line;
+            if(std::getline(in, line) && !in.eof()){
+                keep = static_cast<std::uintmax_t>(in.tellg());
+                while(framesFound < framesKept && std::getline(in, line) && !in.eof()){
+                    keep = static_cast<std::uintmax_t>(in.tellg());
+                    ++framesFound;
+                }
+            }
+        }
+    }
+    if(keep < size){
+        std::filesystem::resize_file(path, keep, ec);
+        if(ec){
+            return false;
+        }
+    }
+
+    m_trajOfs.open(path, format != LogFormat::Csv ? std::ios::out | std::ios::binary | std::ios::app : std::ios::out | std::ios::app);
+    // an empty csv still needs its header line
+    m_wroteHeader = keep > 0;
     return static_cast<bool>(m_trajOfs);
 }
 
-void RunLogger::writeHeader(const NBodySystem2D &system, bool includeEnergy){
+template<typename T>
+void RunLogger::writeHeader(const NBodySystem2D<T> &system, bool includeEnergy, long long outputEvery, double dt){
     // if file is not open or header is written, do nothing
     if(!m_trajOfs || m_wroteHeader){
         return;
     }
 
-    const std::size_t nBodies = system.bodyCount();
+    // one column group per id, bodies merged away later keep their columns
+    const std::size_t nBodies = system.idCount();
+
+    // float runs store float, double and long double runs store double
+    const std::uint32_t precisionCode = std::is_same<T, float>::value ? 0U : (std::is_same<T, double>::value ? 1U : 2U);
+    if(m_format == LogFormat::Compressed){
+        m_compressedHeader = makeCompressedTrajectoryHeader(precisionCode, nBodies, includeEnergy, static_cast<std::uint64_t>(outputEvery), dt, m_positionError, m_velocityError, m_keyframeEvery);
+        m_compressor.begin(m_compressedHeader);
+        const std::size_t values = 1U + 4U * nBodies + (includeEnergy ? 1U : 0U);
+        m_frame.resize(values * sizeof(double));
+        m_values.resize(values);
+        m_trajOfs.write(reinterpret_cast<const char *>(&m_compressedHeader), sizeof(m_compressedHeader));
+        m_wroteHeader = true;
+        return;
+    }
+    if(m_format == LogFormat::Binary){
+        m_binaryHeader = makeTrajectoryHeader(precisionCode, nBodies, includeEnergy, static_cast<std::uint64_t>(outputEvery), dt);
+        m_frame.resize(static_cast<std::size_t>(m_binaryHeader.frameBytes));
+        m_trajOfs.write(reinterpret_cast<const char *>(&m_binaryHeader), sizeof(m_binaryHeader));
+        m_wroteHeader = true;
+        return;
+    }
 
     // first column is time
     m_trajOfs << "t";
@@ -40,34 +158,172 @@ void RunLogger::writeHeader(const NBodySystem2D &system, bool includeEnergy){
     m_wroteHeader = true;
 }
 
-void RunLogger::logState(Real t, const NBodySystem2D &system, bool includeEnergy){
+template<typename T>
+void RunLogger::logState(T t, const NBodySystem2D<T> &system, bool includeEnergy){
     // if file not open, do nothing
     if(!m_trajOfs){
         return;
     }
+    // binary and compressed frames follow the header's choice, csv rows the caller's
+    bool energy = includeEnergy;
+    if(m_format == LogFormat::Binary){
+        energy = (m_binaryHeader.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+    }
+    else if(m_format == LogFormat::Compressed){
+        energy = (m_compressedHeader.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+    }
+    writeState(t, system, includeEnergy, energy ? system.totalEnergy() : static_cast<T>(0));
+}
+
+template<typename T>
+void RunLogger::logStateWithEnergy(T t, const NBodySystem2D<T> &system, T energy){
+    if(!m_trajOfs){
+        return;
+    }
+    writeState(t, system, true, energy);
+}
+
+template<typename T>
+void RunLogger::writeState(T t, const NBodySystem2D<T> &system, bool includeEnergy, T energy){
+    ScopedPhase timer(Phase::Logging);
+    if(m_format == LogFormat::Binary){
+        // frames have a fixed size, new ids would break the stride
+        if(!m_wroteHeader || system.idCount() != m_binaryHeader.bodyCount){
+            return;
+        }
+        const std::size_t slots = static_cast<std::size_t>(m_binaryHeader.bodyCount);
+        const bool withEnergy = (m_binaryHeader.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+        if(m_binaryHeader.valueBytes == 4U){
+            packFrame<float>(t, system, energy, slots, withEnergy);
+        }
+        else{
+            packFrame<double>(t, system, energy, slots, withEnergy);
+        }
+        m_trajOfs.write(reinterpret_cast<const char *>(m_frame.data()), static_cast<std::streamsize>(m_frame.size()));
+        return;
+    }
+    if(m_format == LogFormat::Compressed){
+        if(!m_wroteHeader || system.idCount() != m_compressedHeader.bodyCount){
+            return;
+        }
+        const bool withEnergy = (m_compressedHeader.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+        packFrame<double>(t, system, energy, static_cast<std::size_t>(m_compressedHeader.bodyCount), withEnergy);
+        std::memcpy(m_values.data(), m_frame.data(), m_frame.size());
+        m_compressor.addFrame(m_values.data());
+        if(m_compressor.blockFull()){
+            writeBlock();
+        }
+        return;
+    }
     // write time
     m_trajOfs << t;
 
-    // wrute each body's position and velocity
-    const std::vector<Body2D> &bodies = system.bodies();
+    // wrute each body's position and velocity into the columns of its id, ids are ascending
+    const std::vector<Body2D<T>> &bodies = system.bodies();
+    const std::vector<std::size_t> &ids = system.bodyIds();
     const std::size_t n = bodies.size();
+    const std::size_t slots = system.idCount();
 
-    for(std::size_t i = 0; i < n; ++i){
-        const Body2D &b = bodies[i];
-        m_trajOfs << "," << b.r.x << "," << b.r.y << "," << b.v.x << "," << b.v.y;;
+    std::size_t i = 0;
+    for(std::size_t slot = 0; slot < slots; ++slot){
+        if(i < n && ids[i] == slot){
+            const Body2D<T> &b = bodies[i];
+            m_trajOfs << "," << b.r.x << "," << b.r.y << "," << b.v.x << "," << b.v.y;
+            ++i;
+        }
+        else{
+            // merged away
+            m_trajOfs << ",nan,nan,nan,nan";
+        }
     }
 
     // optional totalEnergy
     if(includeEnergy){
-        const Real energy = system.totalEnergy();
         m_trajOfs << "," << energy;
     }
     m_trajOfs << "\n";
 }
 
+template<typename V, typename T>
+void RunLogger::packFrame(T t, const NBodySystem2D<T> &system, T energy, std::size_t slots, bool withEnergy){
+    unsigned char *out = m_frame.data();
+    const auto put = [&out](T value){
+        const V stored = static_cast<V>(value);
+        std::memcpy(out, &stored, sizeof(V));
+        out += sizeof(V);
+    };
+
+    put(t);
+    const std::vector<Body2D<T>> &bodies = system.bodies();
+    const std::vector<std::size_t> &ids = system.bodyIds();
+    const std::size_t n = bodies.size();
+    const T missing = std::numeric_limits<T>::quiet_NaN();
+    std::size_t i = 0;
+    for(std::size_t slot = 0; slot < slots; ++slot){
+        if(i < n && ids[i] == slot){
+            const Body2D<T> &b = bodies[i];
+            put(b.r.x);
+            put(b.r.y);
+            put(b.v.x);
+            put(b.v.y);
+            ++i;
+        }
+        else{
+            // merged away
+            put(missing);
+            put(missing);
+            put(missing);
+            put(missing);
+        }
+    }
+    if(withEnergy){
+        put(energy);
+    }
+}
+
+void RunLogger::writeBlock(){
+    m_block.clear();
+    m_compressor.finishBlock(m_block);
+    if(!m_block.empty()){
+        m_trajOfs.write(reinterpret_cast<const char *>(m_block.data()), static_cast<std::streamsize>(m_block.size()));
+    }
+}
+
+void RunLogger::flush(){
+    if(m_trajOfs.is_open()){
+        if(m_format == LogFormat::Compressed && m_wroteHeader){
+            writeBlock();
+        }
+        m_trajOfs.flush();
+    }
+}
+
 void RunLogger::close(){
     if(m_trajOfs.is_open()){
+        if(m_format == LogFormat::Compressed && m_wroteHeader){
+            writeBlock();
+        }
+        // the put position after the last write is the file size
+        const std::streamoff end = m_trajOfs.tellp();
+        if(end > 0){
+            m_bytesWritten = static_cast<unsigned long long>(end);
+        }
         m_trajOfs.close();
     }
     m_wroteHeader = false;
 }
+
+unsigned long long RunLogger::bytesWritten() const{
+    return m_bytesWritten;
+}
+
+// precisions selectable through the precision config key
+template void RunLogger::writeHeader<float>(const NBodySystem2D<float> &system, bool includeEnergy, long long outputEvery, double dt);
+template void RunLogger::writeHeader<double>(const NBodySystem2D<double> &system, bool includeEnergy, long long outputEvery, double dt);
+template void RunLogger::writeHeader<long double>(const NBodySystem2D<long double> &system, bool includeEnergy, long long outputEvery, double dt);
+template void RunLogger::logState<float>(float t, const NBodySystem2D<float> &system, bool includeEnergy);
+template void RunLogger::logState<double>(double t, const NBodySystem2D<double> &system, bool includeEnergy);
+template void RunLogger::logState<long double>(long double t, const NBodySystem2D<long double> &system, bool includeEnergy);
+template void RunLogger::logStateWithEnergy<float>(float t, const NBodySystem2D<float> &system, float energy);
+template void RunLogger::logStateWithEnergy<double>(double t, const NBodySystem2D<double> &system, double energy);
+template void RunLogger::logStateWithEnergy<long double>(long double t, const NBodySystem2D<long double> &system, long double energy);
@@ -0,0 +1,720 @@
+// simd direct-sum kernels, avx2/avx-512 with runtime cpu dispatch
+
+#include "simd_kernels.h"
+
+#include <cmath>
+
+// kernels are compiled per function with target attributes, no -mavx2 needed for the whole build
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NBODY_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define NBODY_SIMD_X86 0
+#endif
+
+/**
+ * @brief best SIMD level the running CPU supports
+ *        checked once through cpuid, x86 with GCC/Clang only, Scalar elsewhere
+ *
+ * @return SimdLevel
+ */
+SimdLevel detectSimdLevel(){
+#if NBODY_SIMD_X86
+    static const SimdLevel detected = [](){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")){
+            return SimdLevel::Avx512;
+        }
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+            return SimdLevel::Avx2;
+        }
+        return SimdLevel::Scalar;
+    }();
+    return detected;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+/**
+ * @brief clamp a requested level to what the CPU supports
+ *
+ * @param requested wanted level
+ * @return SimdLevel the lower of requested and detectSimdLevel()
+ */
+SimdLevel resolveSimdLevel(SimdLevel requested){
+    const SimdLevel detected = detectSimdLevel();
+    return static_cast<int>(requested) < static_cast<int>(detected) ? requested : detected;
+}
+
+/**
+ * @brief parse a config value, auto|off|avx2|avx512
+ *        auto means the best level of the running CPU
+ *
+ * @param value config string
+ * @param out parsed level
+ * @return true if value was recognized
+ * @return false otherwise
+ */
+bool parseSimdLevel(const std::string &value, SimdLevel &out){
+    if(value == "auto" || value == "avx512"){
+        out = SimdLevel::Avx512;
+    }
+    else if(value == "avx2"){
+        out = SimdLevel::Avx2;
+    }
+    else if(value == "off" || value == "scalar"){
+        out = SimdLevel::Scalar;
+    }
+    else{
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief printable name of a level
+ *
+ * @param level SIMD level
+ * @return const char* scalar, avx2 or avx512
+ */
+const char *simdLevelName(SimdLevel level){
+    switch(level){
+        case SimdLevel::Avx512:
+            return "avx512";
+        case SimdLevel::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+#if NBODY_SIMD_X86
+
+/**
+ * @brief scalar tail of one row, j in [jBegin, n), i = j skipped
+ *        Potential also sums m_j / r into sp
+ */
+template<bool Potential, typename T>
+static void directRowTail(const T *x, const T *y, const T *m, std::size_t n, std::size_t i, std::size_t jBegin, T eps2, T &sx, T &sy, T &sp){
+    for(std::size_t j = jBegin; j < n; ++j){
+        if(j == i){
+            continue;
+        }
+        const T dx = x[j] - x[i];
+        const T dy = y[j] - y[i];
+        const T invDist = static_cast<T>(1) / static_cast<T>(std::sqrt(dx * dx + dy * dy + eps2));
+        const T accMag = m[j] * invDist * invDist * invDist;
+        sx += dx * accMag;
+        sy += dy * accMag;
+        if(Potential){
+            sp += m[j] * invDist;
+        }
+    }
+}
+
+/**
+ * @brief sum of the 4 lanes of a 256-bit double vector
+ */
+__attribute__((target("avx2,fma")))
+static double horizontalSum(__m256d v){
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+/**
+ * @brief sum of the 8 lanes of a 256-bit float vector
+ */
+__attribute__((target("avx2,fma")))
+static float horizontalSum(__m256 v){
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    return _mm_cvtss_f32(_mm_add_ss(quad, _mm_movehdup_ps(quad)));
+}
+
+/**
+ * @brief AVX2 rows, 4 doubles per instruction
+ *        fast path: float rsqrt estimate (12 bits), two Newton steps in double
+ */
+template<bool Potential>
+__attribute__((target("avx2,fma")))
+static void directRowsAvx2(const double *x, const double *y, const double *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, double G, double eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 4;
+    const __m256d vEps2 = _mm256_set1_pd(eps2);
+    const __m256d vZero = _mm256_setzero_pd();
+    const __m256d vOne = _mm256_set1_pd(1.0);
+    const __m256d vHalf = _mm256_set1_pd(0.5);
+    const __m256d vThreeHalves = _mm256_set1_pd(1.5);
+    const __m256i laneIndex = _mm256_set_epi64x(3, 2, 1, 0);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        // block of the i = j lane, r^2 = eps2 there, no force but m_i / sqrt(eps2) of potential
+        const std::size_t selfBlock = i - i % 4;
+        const __m256d xi = _mm256_set1_pd(x[i]);
+        const __m256d yi = _mm256_set1_pd(y[i]);
+        __m256d sx = vZero;
+        __m256d sy = vZero;
+        __m256d sp = vZero;
+
+        for(std::size_t j = 0; j < nVec; j += 4){
+            const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+            const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+            const __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, vEps2));
+
+            __m256d invDist;
+            if(fastRsqrt){
+                invDist = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+                const __m256d halfR2 = _mm256_mul_pd(vHalf, r2);
+                for(int k = 0; k < 2; ++k){
+                    // y = y * (1.5 - 0.5 * r^2 * y^2)
+                    invDist = _mm256_mul_pd(invDist, _mm256_fnmadd_pd(halfR2, _mm256_mul_pd(invDist, invDist), vThreeHalves));
+                }
+            }
+            else{
+                invDist = _mm256_div_pd(vOne, _mm256_sqrt_pd(r2));
+            }
+            // zero separation contributes nothing, also drops the i = j lane when eps2 = 0
+            invDist = _mm256_and_pd(invDist, _mm256_cmp_pd(r2, vZero, _CMP_GT_OQ));
+            if(Potential && j == selfBlock){
+                invDist = _mm256_andnot_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(laneIndex, _mm256_set1_epi64x(static_cast<long long>(i - j)))), invDist);
+            }
+
+            const __m256d invDist3 = _mm256_mul_pd(invDist, _mm256_mul_pd(invDist, invDist));
+            const __m256d mj = _mm256_loadu_pd(m + j);
+            const __m256d accMag = _mm256_mul_pd(mj, invDist3);
+            sx = _mm256_fmadd_pd(dx, accMag, sx);
+            sy = _mm256_fmadd_pd(dy, accMag, sy);
+            if(Potential){
+                // m_j / r from the invDist the force already needed
+                sp = _mm256_fmadd_pd(mj, invDist, sp);
+            }
+        }
+
+        double tx = horizontalSum(sx);
+        double ty = horizontalSum(sy);
+        double tp = Potential ? horizontalSum(sp) : 0.0;
+        directRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] += G * tx;
+        ay[i] += G * ty;
+        if(Potential){
+            phi[i] -= G * tp;
+        }
+    }
+}
+
+/**
+ * @brief AVX2 rows, 8 floats per instruction
+ *        fast path: rsqrt estimate (12 bits), one Newton step
+ */
+template<bool Potential>
+__attribute__((target("avx2,fma")))
+static void directRowsAvx2(const float *x, const float *y, const float *m, float *ax, float *ay, float *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float G, float eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 8;
+    const __m256 vEps2 = _mm256_set1_ps(eps2);
+    const __m256 vZero = _mm256_setzero_ps();
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vHalf = _mm256_set1_ps(0.5f);
+    const __m256 vThreeHalves = _mm256_set1_ps(1.5f);
+    const __m256i laneIndex = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        // block of the i = j lane, r^2 = eps2 there, no force but m_i / sqrt(eps2) of potential
+        const std::size_t selfBlock = i - i % 8;
+        const __m256 xi = _mm256_set1_ps(x[i]);
+        const __m256 yi = _mm256_set1_ps(y[i]);
+        __m256 sx = vZero;
+        __m256 sy = vZero;
+        __m256 sp = vZero;
+
+        for(std::size_t j = 0; j < nVec; j += 8){
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+            const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, vEps2));
+
+            __m256 invDist;
+            if(fastRsqrt){
+                invDist = _mm256_rsqrt_ps(r2);
+                invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(vHalf, r2), _mm256_mul_ps(invDist, invDist), vThreeHalves));
+            }
+            else{
+                invDist = _mm256_div_ps(vOne, _mm256_sqrt_ps(r2));
+            }
+            invDist = _mm256_and_ps(invDist, _mm256_cmp_ps(r2, vZero, _CMP_GT_OQ));
+            if(Potential && j == selfBlock){
+                invDist = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(laneIndex, _mm256_set1_epi32(static_cast<int>(i - j)))), invDist);
+            }
+
+            const __m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+            const __m256 mj = _mm256_loadu_ps(m + j);
+            const __m256 accMag = _mm256_mul_ps(mj, invDist3);
+            sx = _mm256_fmadd_ps(dx, accMag, sx);
+            sy = _mm256_fmadd_ps(dy, accMag, sy);
+            if(Potential){
+                // m_j / r from the invDist the force already needed
+                sp = _mm256_fmadd_ps(mj, invDist, sp);
+            }
+        }
+
+        float tx = horizontalSum(sx);
+        float ty = horizontalSum(sy);
+        float tp = Potential ? horizontalSum(sp) : 0.0f;
+        directRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] += G * tx;
+        ay[i] += G * ty;
+        if(Potential){
+            phi[i] -= G * tp;
+        }
+    }
+}
+
+/**
+ * @brief scalar tail of one mixed-precision row, j in [jBegin, n), i = j skipped
+ *        float pair terms, each added to the double sums on its own
+ */
+template<bool Potential>
+static void mixedRowTail(const float *x, const float *y, const float *m, std::size_t n, std::size_t i, std::size_t jBegin, float eps2, double &sx, double &sy, double &sp){
+    for(std::size_t j = jBegin; j < n; ++j){
+        if(j == i){
+            continue;
+        }
+        const float dx = x[j] - x[i];
+        const float dy = y[j] - y[i];
+        const float r2 = dx * dx + dy * dy + eps2;
+        if(!(r2 > 0.0f)){
+            continue;
+        }
+        const float invDist = 1.0f / std::sqrt(r2);
+        const float accMag = m[j] * invDist * invDist * invDist;
+        sx += static_cast<double>(dx * accMag);
+        sy += static_cast<double>(dy * accMag);
+        if(Potential){
+            sp += static_cast<double>(m[j] * invDist);
+        }
+    }
+}
+
+/**
+ * @brief AVX2 mixed-precision rows, 8 float pair terms per instruction
+ *        the float lane sums are widened into double sums every MIXED_FLUSH_PAIRS pairs
+ */
+template<bool Potential>
+__attribute__((target("avx2,fma")))
+static void mixedRowsAvx2(const float *x, const float *y, const float *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 8;
+    const __m256 vEps2 = _mm256_set1_ps(eps2);
+    const __m256 vZero = _mm256_setzero_ps();
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vHalf = _mm256_set1_ps(0.5f);
+    const __m256 vThreeHalves = _mm256_set1_ps(1.5f);
+    const __m256i laneIndex = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        const std::size_t selfBlock = i - i % 8;
+        const __m256 xi = _mm256_set1_ps(x[i]);
+        const __m256 yi = _mm256_set1_ps(y[i]);
+        __m256d wx = _mm256_setzero_pd();
+        __m256d wy = _mm256_setzero_pd();
+        __m256d wp = _mm256_setzero_pd();
+
+        for(std::size_t tile = 0; tile < nVec; tile += MIXED_FLUSH_PAIRS){
+            const std::size_t tileEnd = tile + MIXED_FLUSH_PAIRS < nVec ? tile + MIXED_FLUSH_PAIRS : nVec;
+            __m256 sx = vZero;
+            __m256 sy = vZero;
+            __m256 sp = vZero;
+            for(std::size_t j = tile; j < tileEnd; j += 8){
+                const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+                const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+                const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, vEps2));
+
+                __m256 invDist;
+                if(fastRsqrt){
+                    invDist = _mm256_rsqrt_ps(r2);
+                    invDist = _mm256_mul_ps(invDist, _mm256_fnmadd_ps(_mm256_mul_ps(vHalf, r2), _mm256_mul_ps(invDist, invDist), vThreeHalves));
+                }
+                else{
+                    invDist = _mm256_div_ps(vOne, _mm256_sqrt_ps(r2));
+                }
+                invDist = _mm256_and_ps(invDist, _mm256_cmp_ps(r2, vZero, _CMP_GT_OQ));
+                if(Potential && j == selfBlock){
+                    invDist = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(laneIndex, _mm256_set1_epi32(static_cast<int>(i - j)))), invDist);
+                }
+
+                const __m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+                const __m256 mj = _mm256_loadu_ps(m + j);
+                const __m256 accMag = _mm256_mul_ps(mj, invDist3);
+                sx = _mm256_fmadd_ps(dx, accMag, sx);
+                sy = _mm256_fmadd_ps(dy, accMag, sy);
+                if(Potential){
+                    sp = _mm256_fmadd_ps(mj, invDist, sp);
+                }
+            }
+            // widen both halves of the tile sums
+            wx = _mm256_add_pd(wx, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sx)), _mm256_cvtps_pd(_mm256_extractf128_ps(sx, 1))));
+            wy = _mm256_add_pd(wy, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sy)), _mm256_cvtps_pd(_mm256_extractf128_ps(sy, 1))));
+            if(Potential){
+                wp = _mm256_add_pd(wp, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sp)), _mm256_cvtps_pd(_mm256_extractf128_ps(sp, 1))));
+            }
+        }
+
+        double tx = horizontalSum(wx);
+        double ty = horizontalSum(wy);
+        double tp = Potential ? horizontalSum(wp) : 0.0;
+        mixedRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] = tx;
+        ay[i] = ty;
+        if(Potential){
+            phi[i] = tp;
+        }
+    }
+}
+
+/**
+ * @brief sum of the 8 lanes of a 512-bit double vector
+ *        maskz extracts avoid the undefined-vector intrinsics GCC warns about
+ */
+__attribute__((target("avx512f")))
+static double horizontalSum(__m512d v){
+    const __m512d half = _mm512_add_pd(v, _mm512_maskz_shuffle_f64x2(0xFF, v, v, 0x4E));
+    const __m512d quarter = _mm512_add_pd(half, _mm512_maskz_shuffle_f64x2(0xFF, half, half, 0xB1));
+    const __m512d eighth = _mm512_add_pd(quarter, _mm512_maskz_permute_pd(0xFF, quarter, 0x55));
+    return _mm512_cvtsd_f64(eighth);
+}
+
+/**
+ * @brief sum of the 16 lanes of a 512-bit float vector
+ */
+__attribute__((target("avx512f")))
+static float horizontalSum(__m512 v){
+    const __m512 half = _mm512_add_ps(v, _mm512_maskz_shuffle_f32x4(0xFFFF, v, v, 0x4E));
+    const __m512 quarter = _mm512_add_ps(half, _mm512_maskz_shuffle_f32x4(0xFFFF, half, half, 0xB1));
+    const __m512 eighth = _mm512_add_ps(quarter, _mm512_maskz_permute_ps(0xFFFF, quarter, 0x4E));
+    const __m512 sixteenth = _mm512_add_ps(eighth, _mm512_maskz_permute_ps(0xFFFF, eighth, 0xB1));
+    return _mm512_cvtss_f32(sixteenth);
+}
+
+/**
+ * @brief AVX-512 rows, 8 doubles per instruction
+ *        fast path: rsqrt14 estimate (14 bits), two Newton steps
+ */
+template<bool Potential>
+__attribute__((target("avx512f")))
+static void directRowsAvx512(const double *x, const double *y, const double *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, double G, double eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 8;
+    const __m512d vEps2 = _mm512_set1_pd(eps2);
+    const __m512d vZero = _mm512_setzero_pd();
+    const __m512d vOne = _mm512_set1_pd(1.0);
+    const __m512d vHalf = _mm512_set1_pd(0.5);
+    const __m512d vThreeHalves = _mm512_set1_pd(1.5);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        // block of the i = j lane, r^2 = eps2 there, no force but m_i / sqrt(eps2) of potential
+        const std::size_t selfBlock = i - i % 8;
+        const __m512d xi = _mm512_set1_pd(x[i]);
+        const __m512d yi = _mm512_set1_pd(y[i]);
+        __m512d sx = vZero;
+        __m512d sy = vZero;
+        __m512d sp = vZero;
+
+        for(std::size_t j = 0; j < nVec; j += 8){
+            const __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+            const __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+            const __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, vEps2));
+            const __mmask8 nonZero = _mm512_cmp_pd_mask(r2, vZero, _CMP_GT_OQ);
+
+            __m512d invDist;
+            if(fastRsqrt){
+                invDist = _mm512_maskz_rsqrt14_pd(nonZero, r2);
+                const __m512d halfR2 = _mm512_mul_pd(vHalf, r2);
+                for(int k = 0; k < 2; ++k){
+                    invDist = _mm512_mul_pd(invDist, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invDist, invDist), vThreeHalves));
+                }
+            }
+            else{
+                invDist = _mm512_maskz_div_pd(nonZero, vOne, _mm512_maskz_sqrt_pd(nonZero, r2));
+            }
+            invDist = _mm512_maskz_mov_pd(nonZero, invDist);
+            if(Potential && j == selfBlock){
+                invDist = _mm512_maskz_mov_pd(static_cast<__mmask8>(~(1U << (i - j))), invDist);
+            }
+
+            const __m512d invDist3 = _mm512_mul_pd(invDist, _mm512_mul_pd(invDist, invDist));
+            const __m512d mj = _mm512_loadu_pd(m + j);
+            const __m512d accMag = _mm512_mul_pd(mj, invDist3);
+            sx = _mm512_fmadd_pd(dx, accMag, sx);
+            sy = _mm512_fmadd_pd(dy, accMag, sy);
+            if(Potential){
+                // m_j / r from the invDist the force already needed
+                sp = _mm512_fmadd_pd(mj, invDist, sp);
+            }
+        }
+
+        double tx = horizontalSum(sx);
+        double ty = horizontalSum(sy);
+        double tp = Potential ? horizontalSum(sp) : 0.0;
+        directRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] += G * tx;
+        ay[i] += G * ty;
+        if(Potential){
+            phi[i] -= G * tp;
+        }
+    }
+}
+
+/**
+ * @brief AVX-512 rows, 16 floats per instruction
+ *        fast path: rsqrt14 estimate (14 bits), one Newton step
+ */
+template<bool Potential>
+__attribute__((target("avx512f")))
+static void directRowsAvx512(const float *x, const float *y, const float *m, float *ax, float *ay, float *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float G, float eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 16;
+    const __m512 vEps2 = _mm512_set1_ps(eps2);
+    const __m512 vZero = _mm512_setzero_ps();
+    const __m512 vOne = _mm512_set1_ps(1.0f);
+    const __m512 vHalf = _mm512_set1_ps(0.5f);
+    const __m512 vThreeHalves = _mm512_set1_ps(1.5f);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        // block of the i = j lane, r^2 = eps2 there, no force but m_i / sqrt(eps2) of potential
+        const std::size_t selfBlock = i - i % 16;
+        const __m512 xi = _mm512_set1_ps(x[i]);
+        const __m512 yi = _mm512_set1_ps(y[i]);
+        __m512 sx = vZero;
+        __m512 sy = vZero;
+        __m512 sp = vZero;
+
+        for(std::size_t j = 0; j < nVec; j += 16){
+            const __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), xi);
+            const __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), yi);
+            const __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, vEps2));
+            const __mmask16 nonZero = _mm512_cmp_ps_mask(r2, vZero, _CMP_GT_OQ);
+
+            __m512 invDist;
+            if(fastRsqrt){
+                invDist = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+                invDist = _mm512_mul_ps(invDist, _mm512_fnmadd_ps(_mm512_mul_ps(vHalf, r2), _mm512_mul_ps(invDist, invDist), vThreeHalves));
+            }
+            else{
+                invDist = _mm512_maskz_div_ps(nonZero, vOne, _mm512_maskz_sqrt_ps(nonZero, r2));
+            }
+            invDist = _mm512_maskz_mov_ps(nonZero, invDist);
+            if(Potential && j == selfBlock){
+                invDist = _mm512_maskz_mov_ps(static_cast<__mmask16>(~(1U << (i - j))), invDist);
+            }
+
+            const __m512 invDist3 = _mm512_mul_ps(invDist, _mm512_mul_ps(invDist, invDist));
+            const __m512 mj = _mm512_loadu_ps(m + j);
+            const __m512 accMag = _mm512_mul_ps(mj, invDist3);
+            sx = _mm512_fmadd_ps(dx, accMag, sx);
+            sy = _mm512_fmadd_ps(dy, accMag, sy);
+            if(Potential){
+                // m_j / r from the invDist the force already needed
+                sp = _mm512_fmadd_ps(mj, invDist, sp);
+            }
+        }
+
+        float tx = horizontalSum(sx);
+        float ty = horizontalSum(sy);
+        float tp = Potential ? horizontalSum(sp) : 0.0f;
+        directRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] += G * tx;
+        ay[i] += G * ty;
+        if(Potential){
+            phi[i] -= G * tp;
+        }
+    }
+}
+
+
+/**
+ * @brief the 16 float lanes widened to double and added pairwise, lane k + lane k + 8
+ *        double-typed maskz extracts need only avx512f and avoid the undefined-vector intrinsics GCC warns about
+ */
+__attribute__((target("avx512f")))
+static __m512d widenHalves(__m512 v){
+    const __m512d bits = _mm512_castps_pd(v);
+    const __m256 low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 0));
+    const __m256 high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 1));
+    return _mm512_add_pd(_mm512_maskz_cvtps_pd(0xFF, low), _mm512_maskz_cvtps_pd(0xFF, high));
+}
+
+/**
+ * @brief AVX-512 mixed-precision rows, 16 float pair terms per instruction
+ *        the float lane sums are widened into double sums every MIXED_FLUSH_PAIRS pairs
+ */
+template<bool Potential>
+__attribute__((target("avx512f")))
+static void mixedRowsAvx512(const float *x, const float *y, const float *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float eps2, bool fastRsqrt){
+    const std::size_t nVec = n - n % 16;
+    const __m512 vEps2 = _mm512_set1_ps(eps2);
+    const __m512 vZero = _mm512_setzero_ps();
+    const __m512 vOne = _mm512_set1_ps(1.0f);
+    const __m512 vHalf = _mm512_set1_ps(0.5f);
+    const __m512 vThreeHalves = _mm512_set1_ps(1.5f);
+
+    for(std::size_t i = iBegin; i < iEnd; ++i){
+        const std::size_t selfBlock = i - i % 16;
+        const __m512 xi = _mm512_set1_ps(x[i]);
+        const __m512 yi = _mm512_set1_ps(y[i]);
+        __m512d wx = _mm512_setzero_pd();
+        __m512d wy = _mm512_setzero_pd();
+        __m512d wp = _mm512_setzero_pd();
+
+        for(std::size_t tile = 0; tile < nVec; tile += MIXED_FLUSH_PAIRS){
+            const std::size_t tileEnd = tile + MIXED_FLUSH_PAIRS < nVec ? tile + MIXED_FLUSH_PAIRS : nVec;
+            __m512 sx = vZero;
+            __m512 sy = vZero;
+            __m512 sp = vZero;
+            for(std::size_t j = tile; j < tileEnd; j += 16){
+                const __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), xi);
+                const __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), yi);
+                const __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, vEps2));
+                const __mmask16 nonZero = _mm512_cmp_ps_mask(r2, vZero, _CMP_GT_OQ);
+
+                __m512 invDist;
+                if(fastRsqrt){
+                    invDist = _mm512_maskz_rsqrt14_ps(nonZero, r2);
+                    invDist = _mm512_mul_ps(invDist, _mm512_fnmadd_ps(_mm512_mul_ps(vHalf, r2), _mm512_mul_ps(invDist, invDist), vThreeHalves));
+                }
+                else{
+                    invDist = _mm512_maskz_div_ps(nonZero, vOne, _mm512_maskz_sqrt_ps(nonZero, r2));
+                }
+                invDist = _mm512_maskz_mov_ps(nonZero, invDist);
+                if(Potential && j == selfBlock){
+                    invDist = _mm512_maskz_mov_ps(static_cast<__mmask16>(~(1U << (i - j))), invDist);
+                }
+
+                const __m512 invDist3 = _mm512_mul_ps(invDist, _mm512_mul_ps(invDist, invDist));
+                const __m512 mj = _mm512_loadu_ps(m + j);
+                const __m512 accMag = _mm512_mul_ps(mj, invDist3);
+                sx = _mm512_fmadd_ps(dx, accMag, sx);
+                sy = _mm512_fmadd_ps(dy, accMag, sy);
+                if(Potential){
+                    sp = _mm512_fmadd_ps(mj, invDist, sp);
+                }
+            }
+            wx = _mm512_add_pd(wx, widenHalves(sx));
+            wy = _mm512_add_pd(wy, widenHalves(sy));
+            if(Potential){
+                wp = _mm512_add_pd(wp, widenHalves(sp));
+            }
+        }
+
+        double tx = horizontalSum(wx);
+        double ty = horizontalSum(wy);
+        double tp = Potential ? horizontalSum(wp) : 0.0;
+        mixedRowTail<Potential>(x, y, m, n, i, nVec, eps2, tx, ty, tp);
+        ax[i] = tx;
+        ay[i] = ty;
+        if(Potential){
+            phi[i] = tp;
+        }
+    }
+}
+
+#endif
+
+/**
+ * @brief add exact-sum gravitational accelerations for rows [iBegin, iEnd)
+ *        every row i reads all j, only ax[i], ay[i] and phi[i] are written,
+ *        so disjoint row ranges can run on different threads
+ *        pairs at zero separation (the i = j term, or coincident bodies with eps2 = 0) add nothing
+ *        with phi, the same pass subtracts G * sum_j m_j / r_ij into phi[i], reusing 1 / r
+ *
+ * @return true if a SIMD kernel ran
+ * @return false if level is Scalar, nothing was written and the caller must use its own loop
+ */
+bool simdDirectAccelerations(const float *x, const float *y, const float *m, float *ax, float *ay, float *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float G, float eps2, SimdLevel level, bool fastRsqrt){
+#if NBODY_SIMD_X86
+    if(level == SimdLevel::Avx512){
+        if(phi != nullptr){
+            directRowsAvx512<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        else{
+            directRowsAvx512<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        return true;
+    }
+    if(level == SimdLevel::Avx2){
+        if(phi != nullptr){
+            directRowsAvx2<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        else{
+            directRowsAvx2<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        return true;
+    }
+#else
+    (void)x; (void)y; (void)m; (void)ax; (void)ay; (void)phi; (void)n; (void)iBegin; (void)iEnd; (void)G; (void)eps2; (void)level; (void)fastRsqrt;
+#endif
+    return false;
+}
+
+bool simdDirectAccelerations(const double *x, const double *y, const double *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, double G, double eps2, SimdLevel level, bool fastRsqrt){
+#if NBODY_SIMD_X86
+    if(level == SimdLevel::Avx512){
+        if(phi != nullptr){
+            directRowsAvx512<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        else{
+            directRowsAvx512<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        return true;
+    }
+    if(level == SimdLevel::Avx2){
+        if(phi != nullptr){
+            directRowsAvx2<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        else{
+            directRowsAvx2<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, G, eps2, fastRsqrt);
+        }
+        return true;
+    }
+#else
+    (void)x; (void)y; (void)m; (void)ax; (void)ay; (void)phi; (void)n; (void)iBegin; (void)iEnd; (void)G; (void)eps2; (void)level; (void)fastRsqrt;
+#endif
+    return false;
+}
+
+/**
+ * @brief long double has no SIMD form, always returns false
+ */
+bool simdDirectAccelerations(const long double *, const long double *, const long double *, long double *, long double *, long double *, std::size_t, std::size_t, std::size_t, long double, long double, SimdLevel, bool){
+    return false;
+}
+
+/**
+ * @brief mixed-precision rows [iBegin, iEnd): float pair terms, double sums
+ *        writes sum_j m_j * (r_j - r_i) / r_ij^3 into ax[i], ay[i], without G,
+ *        and with phi, sum_j m_j / r_ij into phi[i]
+ *        the float lanes are widened into double every MIXED_FLUSH_PAIRS pairs, so the float
+ *        rounding of a row sum does not grow with n
+ *
+ * @return true if a SIMD kernel ran
+ * @return false if level is Scalar, nothing was written and the caller must use its own loop
+ */
+bool simdMixedAccelerations(const float *x, const float *y, const float *m, double *ax, double *ay, double *phi, std::size_t n, std::size_t iBegin, std::size_t iEnd, float eps2, SimdLevel level, bool fastRsqrt){
+#if NBODY_SIMD_X86
+    if(level == SimdLevel::Avx512){
+        if(phi != nullptr){
+            mixedRowsAvx512<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, eps2, fastRsqrt);
+        }
+        else{
+            mixedRowsAvx512<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, eps2, fastRsqrt);
+        }
+        return true;
+    }
+    if(level == SimdLevel::Avx2){
+        if(phi != nullptr){
+            mixedRowsAvx2<true>(x, y, m, ax, ay, phi, n, iBegin, iEnd, eps2, fastRsqrt);
+        }
+        else{
+            mixedRowsAvx2<false>(x, y, m, ax, ay, phi, n, iBegin, iEnd, eps2, fastRsqrt);
+        }
+        return true;
+    }
+#else
+    (void)x; (void)y; (void)m; (void)ax; (void)ay; (void)phi; (void)n; (void)iBegin; (void)iEnd; (void)eps2; (void)level; (void)fastRsqrt;
+#endif
+    return false;
+}
@@ -5,14 +5,20 @@
 #include <fstream>
 #include <sstream>
 #include <cctype>
+#include <vector>
 
 #include "simulation_config.h"
+#include "fmm2d.h"
+#include "insitu_analysis.h"
+#include "nbody_system2d.h"
+#include "pm2d.h"
+#include "simd_kernels.h"
 
 /**
  * @brief Construct a config with defaults
  *        overwritten by loadFromFile() as necessary
  */
-SimulationConfig::SimulationConfig() : precision("long double"), method("verlet"), dt(static_cast<Real>(0)), steps(0), outputEvery(1), G(static_cast<Real>(1)), eps2(static_cast<Real>(0)), bodiesFile(), outTrajFile(), includeEnergy(false){}
+SimulationConfig::SimulationConfig() : precision("long double"), method("verlet"), dt(static_cast<Real>(0)), steps(0), outputEvery(1), G(static_cast<Real>(1)), eps2(static_cast<Real>(0)), bodiesFile(), outTrajFile(), outFormat("csv"), compressPosError(static_cast<Real>(1e-6)), compressVelError(static_cast<Real>(1e-6)), keyframeEvery(64), asyncLog(false), logBuffer(8), includeEnergy(false), analysis(), analysisFile("analysis.csv"), dumpEvery(0), radialBins(16), radialMax(static_cast<Real>(0)), escapeRadius(static_cast<Real>(0)), forceEngine("direct"), theta(static_cast<Real>(0.5)), fmmOrder(4), pmGrid(256), pmAssign("cic"), pmBoundary("isolated"), pmBoxSize(static_cast<Real>(0)), blockLevels(8), blockEta(static_cast<Real>(0.025)), accuracySamples(256), storage("aos"), simd("auto"), fastRsqrt(false), forcePrecision("native"), threads(1), headless(false), heatmapAbove(200000), heatmapMass(false), profile(false), profileJson(), profileTrace(), checkpointEvery(0), checkpointFile("checkpoint.bin"), resumeFrom(), collisions("off"), collisionRadius(static_cast<Real>(0)), radiiFile(), collisionLog(){}
 
 /**
  * @brief load configuration values from a key=value text file
@@ -45,54 +51,320 @@ bool SimulationConfig::loadFromFile(const std::string &path){
         const std::string key = trim(trimmed.substr(0, eqPos));
         const std::string value = trim(trimmed.substr(eqPos + 1));
 
-        if(key == "precision"){
-            precision = value;
-        }
-        else if(key == "method"){
-            method = value;
-        }
-        else if(key == "dt"){
-            dt = static_cast<Real>(std::stold(value));
-        }
-        else if(key == "steps"){
-            steps = std::stoll(value);
-        }
-        else if(key == "outputEvery"){
-            outputEvery = std::stoi(value);
+        // unknown keys ignored
+        setValue(key, value);
+    }
+    return true;
+}
+/**
+ * @brief set one configuration value from its key=value text
+ *        shared by loadFromFile() and tools that override keys, e.g. tools/ensemble
+ *
+ * @param key config key
+ * @param value value text, numbers throw std::invalid_argument or std::out_of_range if malformed
+ * @return true if the key is known
+ * @return false if it was ignored
+ */
+bool SimulationConfig::setValue(const std::string &key, const std::string &value){
+    if(key == "precision"){
+        precision = value;
+    }
+    else if(key == "method"){
+        method = value;
+    }
+    else if(key == "dt"){
+        dt = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "steps"){
+        steps = std::stoll(value);
+    }
+    else if(key == "outputEvery"){
+        outputEvery = std::stoi(value);
+    }
+    else if(key == "G"){
+        G = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "eps2"){
+        eps2 = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "bodiesFile"){
+        bodiesFile = value;
+    }
+    else if(key == "outTrajFile"){
+        outTrajFile = value;
+    }
+    else if(key == "outFormat"){
+        outFormat = value;
+    }
+    else if(key == "asyncLog"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            asyncLog = parsed;
         }
-        else if(key == "G"){
-            G = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "compressPosError"){
+        compressPosError = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "compressVelError"){
+        compressVelError = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "keyframeEvery"){
+        keyframeEvery = std::stoi(value);
+    }
+    else if(key == "logBuffer"){
+        logBuffer = std::stoi(value);
+    }
+    else if(key == "includeEnergy"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            includeEnergy = parsed;
         }
-        else if(key == "eps2"){
-            eps2 = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "analysis"){
+        analysis = value;
+    }
+    else if(key == "analysisFile"){
+        analysisFile = value;
+    }
+    else if(key == "dumpEvery"){
+        dumpEvery = std::stoll(value);
+    }
+    else if(key == "radialBins"){
+        radialBins = std::stoi(value);
+    }
+    else if(key == "radialMax"){
+        radialMax = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "escapeRadius"){
+        escapeRadius = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "forceEngine"){
+        forceEngine = value;
+    }
+    else if(key == "theta"){
+        theta = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "fmmOrder"){
+        fmmOrder = std::stoi(value);
+    }
+    else if(key == "pmGrid"){
+        pmGrid = std::stoi(value);
+    }
+    else if(key == "pmAssign"){
+        pmAssign = value;
+    }
+    else if(key == "pmBoundary"){
+        pmBoundary = value;
+    }
+    else if(key == "pmBoxSize"){
+        pmBoxSize = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "blockLevels"){
+        blockLevels = std::stoi(value);
+    }
+    else if(key == "blockEta"){
+        blockEta = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "accuracySamples"){
+        accuracySamples = std::stoi(value);
+    }
+    else if(key == "storage"){
+        storage = value;
+    }
+    else if(key == "simd"){
+        simd = value;
+    }
+    else if(key == "fastRsqrt"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            fastRsqrt = parsed;
         }
-        else if(key == "bodiesFile"){
-            bodiesFile = value;
+    }
+    else if(key == "forcePrecision"){
+        forcePrecision = value;
+    }
+    else if(key == "threads"){
+        threads = std::stoi(value);
+    }
+    else if(key == "headless"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            headless = parsed;
         }
-        else if(key == "outTrajFile"){
-            outTrajFile = value;
+    }
+    else if(key == "heatmapAbove"){
+        heatmapAbove = std::stoll(value);
+    }
+    else if(key == "heatmapMass"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            heatmapMass = parsed;
         }
-        else if(key == "includeEnergy"){
-            bool parsed = false;
-            if(parseBool(value, parsed)){
-                includeEnergy = parsed;
-            }
+    }
+    else if(key == "profile"){
+        bool parsed = false;
+        if(parseBool(value, parsed)){
+            profile = parsed;
         }
-        // unknown keys ignored
+    }
+    else if(key == "profileJson"){
+        profileJson = value;
+    }
+    else if(key == "profileTrace"){
+        profileTrace = value;
+    }
+    else if(key == "checkpointEvery"){
+        checkpointEvery = std::stoll(value);
+    }
+    else if(key == "checkpointFile"){
+        checkpointFile = value;
+    }
+    else if(key == "resumeFrom"){
+        resumeFrom = value;
+    }
+    else if(key == "collisions"){
+        collisions = value;
+    }
+    else if(key == "collisionRadius"){
+        collisionRadius = static_cast<Real>(std::stold(value));
+    }
+    else if(key == "radiiFile"){
+        radiiFile = value;
+    }
+    else if(key == "collisionLog"){
+        collisionLog = value;
+    }
+    else{
+        return false;
     }
     return true;
 }
 /**
  * @brief validate configuration values are usable
  *        checks for positive dt, steps, and outputEvery
+ *        checks for known precision, method, force engine, storage, simd and outFormat, non-negative theta and threads, valid fmmOrder and blockLevels, positive logBuffer and blockEta,
+ *        positive compressPosError, compressVelError and keyframeEvery,
+ *        hermite only with the direct engine, float pair terms only for double or long double direct sums, non-negative checkpointEvery,
+ *        known collisions mode with a non-negative collisionRadius or a radiiFile,
+ *        power of two pmGrid, known pmAssign and pmBoundary, positive pmBoxSize for a periodic mesh, non-negative heatmapAbove,
+ *        known analysis probes with an analysisFile, non-negative dumpEvery, radialMax and escapeRadius, positive radialBins
  * @param err stream to print error messages into
  * @return true if all checks pass
  * @return false otherwise
  */
 bool SimulationConfig::validate(std::ostream &err) const{
     bool ok = true;
-    if(method != "euler" && method != "semieuler" && method != "verlet"){
-        err << "Method must be 'euler' or 'semieuler' or 'verlet'.\n";
+    if(precision != "float" && precision != "double" && precision != "long double"){
+        err << "precision must be 'float' or 'double' or 'long double'.\n";
+        ok = false;
+    }
+    if(method != "euler" && method != "semieuler" && method != "verlet" && method != "leapfrog" && method != "block" && method != "yoshida" && method != "hermite"){
+        err << "Method must be 'euler' or 'semieuler' or 'verlet' or 'leapfrog' or 'block' or 'yoshida' or 'hermite'.\n";
+        ok = false;
+    }
+    if(blockLevels < 1 || blockLevels > NBodySystem2D<Real>::MAX_BLOCK_LEVELS){
+        err << "blockLevels must be between 1 and " << NBodySystem2D<Real>::MAX_BLOCK_LEVELS << ".\n";
+        ok = false;
+    }
+    if(blockEta <= static_cast<Real>(0)){
+        err << "blockEta must be greater than 0.\n";
+        ok = false;
+    }
+    if(method == "block" && eps2 <= static_cast<Real>(0)){
+        err << "method 'block' needs eps2 > 0, its timestep criterion uses the softening length.\n";
+        ok = false;
+    }
+    if(method == "hermite" && forceEngine != "direct"){
+        err << "method 'hermite' needs forceEngine = direct, the other engines do not compute the jerk.\n";
+        ok = false;
+    }
+    if(forcePrecision != "native" && forcePrecision != "float"){
+        err << "forcePrecision must be 'native' or 'float'.\n";
+        ok = false;
+    }
+    if(forcePrecision == "float" && (precision == "float" || forceEngine != "direct" || method == "hermite")){
+        err << "forcePrecision = float needs precision double or long double and forceEngine = direct, and does not apply to hermite.\n";
+        ok = false;
+    }
+    if(forceEngine != "direct" && forceEngine != "barneshut" && forceEngine != "fmm" && forceEngine != "pm"){
+        err << "forceEngine must be 'direct' or 'barneshut' or 'fmm' or 'pm'.\n";
+        ok = false;
+    }
+    if(pmGrid < static_cast<int>(PmSolver2D<Real>::MIN_GRID) || pmGrid > static_cast<int>(PmSolver2D<Real>::MAX_GRID) || (pmGrid & (pmGrid - 1)) != 0){
+        err << "pmGrid must be a power of two between " << PmSolver2D<Real>::MIN_GRID << " and " << PmSolver2D<Real>::MAX_GRID << ".\n";
+        ok = false;
+    }
+    if(pmAssign != "cic" && pmAssign != "tsc"){
+        err << "pmAssign must be 'cic' or 'tsc'.\n";
+        ok = false;
+    }
+    if(pmBoundary != "isolated" && pmBoundary != "periodic"){
+        err << "pmBoundary must be 'isolated' or 'periodic'.\n";
+        ok = false;
+    }
+    if(forceEngine == "pm" && pmBoundary == "periodic" && !(pmBoxSize > static_cast<Real>(0))){
+        err << "pmBoundary = periodic needs a pmBoxSize greater than 0.\n";
+        ok = false;
+    }
+    if(outFormat != "csv" && outFormat != "binary" && outFormat != "compressed"){
+        err << "outFormat must be 'csv' or 'binary' or 'compressed'.\n";
+        ok = false;
+    }
+    if(!(compressPosError > static_cast<Real>(0)) || !(compressVelError > static_cast<Real>(0))){
+        err << "compressPosError and compressVelError must be greater than 0.\n";
+        ok = false;
+    }
+    if(keyframeEvery <= 0){
+        err << "keyframeEvery must be positive.\n";
+        ok = false;
+    }
+    std::vector<std::string> probes;
+    if(!parseAnalysisProbes(analysis, probes, err)){
+        ok = false;
+    }
+    if(!probes.empty() && analysisFile.empty()){
+        err << "analysisFile is empty.\n";
+        ok = false;
+    }
+    if(dumpEvery < 0){
+        err << "dumpEvery must not be negative.\n";
+        ok = false;
+    }
+    if(radialBins <= 0){
+        err << "radialBins must be positive.\n";
+        ok = false;
+    }
+    if(!(radialMax >= static_cast<Real>(0)) || !(escapeRadius >= static_cast<Real>(0))){
+        err << "radialMax and escapeRadius must not be negative.\n";
+        ok = false;
+    }
+    if(logBuffer <= 0){
+        err << "logBuffer must be positive.\n";
+        ok = false;
+    }
+    if(storage != "aos" && storage != "soa"){
+        err << "storage must be 'aos' or 'soa'.\n";
+        ok = false;
+    }
+    SimdLevel level = SimdLevel::Scalar;
+    if(!parseSimdLevel(simd, level)){
+        err << "simd must be 'auto' or 'avx2' or 'avx512' or 'off'.\n";
+        ok = false;
+    }
+    if(fmmOrder < 1 || fmmOrder > FmmSolver2D<Real>::MAX_ORDER){
+        err << "fmmOrder must be between 1 and " << FmmSolver2D<Real>::MAX_ORDER << ".\n";
+        ok = false;
+    }
+    if(accuracySamples < 0){
+        err << "accuracySamples must not be negative.\n";
+        ok = false;
+    }
+    if(threads < 0){
+        err << "threads must not be negative.\n";
+        ok = false;
+    }
+    if(theta < static_cast<Real>(0)){
+        err << "theta must not be negative.\n";
         ok = false;
     }
     if(dt <= static_cast<Real>(0)){
@@ -107,10 +379,35 @@ bool SimulationConfig::validate(std::ostream &err) const{
         err << "outputEvery must be greater than 0.\n";
         ok = false;
     }
-    if(bodiesFile.empty()){
+    // a resumed run takes its bodies from the checkpoint
+    if(bodiesFile.empty() && resumeFrom.empty()){
         err << "bodiesFile is empty.\n";
         ok = false;
     }
+    if(checkpointEvery < 0){
+        err << "checkpointEvery must not be negative.\n";
+        ok = false;
+    }
+    if(checkpointEvery > 0 && checkpointFile.empty()){
+        err << "checkpointFile is empty.\n";
+        ok = false;
+    }
+    if(collisions != "off" && collisions != "detect" && collisions != "merge"){
+        err << "collisions must be 'off' or 'detect' or 'merge'.\n";
+        ok = false;
+    }
+    if(!(collisionRadius >= static_cast<Real>(0))){
+        err << "collisionRadius must not be negative.\n";
+        ok = false;
+    }
+    if(collisions != "off" && collisionRadius == static_cast<Real>(0) && radiiFile.empty()){
+        err << "collisions need a collisionRadius greater than 0 or a radiiFile.\n";
+        ok = false;
+    }
+    if(heatmapAbove < 0){
+        err << "heatmapAbove must not be negative.\n";
+        ok = false;
+    }
     if(outTrajFile.empty()){
         err << "outTrajFile is empty.\n";
         ok = false;
@@ -0,0 +1,219 @@
+// spatialhashgrid2d class, uniform hash grid for O(n) collision candidates
+
+#include "spatial_hash2d.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace{
+
+// cell coordinates are clamped here, far beyond any position a cell size can resolve
+constexpr long double CELL_LIMIT = 1.0e15L;
+
+/**
+ * @brief true if a body takes part in collisions at all
+ *
+ * @param x x position
+ * @param y y position
+ * @param radius radius
+ * @return true for finite values and a radius >= 0
+ */
+template<typename T>
+bool collidable(T x, T y, T radius){
+    return std::isfinite(x) && std::isfinite(y) && std::isfinite(radius) && radius >= static_cast<T>(0);
+}
+
+/**
+ * @brief integer cell coordinate of a position
+ *
+ * @param position x or y
+ * @param cellSize side of a cell, > 0
+ * @return long long floor(position / cellSize), clamped
+ */
+template<typename T>
+long long cellCoordinate(T position, T cellSize){
+    const long double q = std::floor(static_cast<long double>(position) / static_cast<long double>(cellSize));
+    return static_cast<long long>(std::max(-CELL_LIMIT, std::min(CELL_LIMIT, q)));
+}
+
+/**
+ * @brief true if two bodies are closer than the sum of their radii
+ *
+ * @param bodies positions
+ * @param radii radii
+ * @param i first body
+ * @param j second body
+ * @return true if they overlap
+ */
+template<typename T>
+bool overlaps(const BodyArrays2D<T> &bodies, const std::vector<T> &radii, std::size_t i, std::size_t j){
+    const T dx = bodies.x[j] - bodies.x[i];
+    const T dy = bodies.y[j] - bodies.y[i];
+    const T reach = radii[i] + radii[j];
+    return dx * dx + dy * dy < reach * reach;
+}
+
+}
+
+/**
+ * @brief construct an empty grid
+ *
+ */
+template<typename T>
+SpatialHashGrid2D<T>::SpatialHashGrid2D() : m_cellX(), m_cellY(), m_role(), m_bucketStart(), m_order(), m_large(), m_mask(0){}
+
+/**
+ * @brief rebuild the grid and collect every overlapping pair
+ *        storage from previous calls is reused
+ *        bodies with a non-finite position or radius never overlap
+ *
+ * @param bodies current positions, only x and y are read
+ * @param radii radius of every body, same order, 0 = point
+ * @param pairs overwritten with (i, j), i < j, |r_i - r_j| < radius_i + radius_j, sorted
+ */
+template<typename T>
+void SpatialHashGrid2D<T>::findOverlaps(const BodyArrays2D<T> &bodies, const std::vector<T> &radii, std::vector<std::pair<std::size_t, std::size_t>> &pairs){
+    const std::size_t n = bodies.size();
+    pairs.clear();
+    m_large.clear();
+    m_order.clear();
+    m_bucketStart.clear();
+    m_role.assign(n, SKIPPED);
+    if(n < 2){
+        return;
+    }
+
+    // mean of the positive radii sets what counts as a large body
+    T radiusSum = static_cast<T>(0);
+    std::size_t positive = 0;
+    for(std::size_t i = 0; i < n; ++i){
+        if(collidable(bodies.x[i], bodies.y[i], radii[i]) && radii[i] > static_cast<T>(0)){
+            radiusSum += radii[i];
+            ++positive;
+        }
+    }
+    if(positive == 0){
+        return;
+    }
+    const T largeRadius = static_cast<T>(LARGE_RADIUS_FACTOR) * radiusSum / static_cast<T>(positive);
+    T maxRadius = static_cast<T>(0);
+    for(std::size_t i = 0; i < n; ++i){
+        if(!collidable(bodies.x[i], bodies.y[i], radii[i])){
+            continue;
+        }
+        if(radii[i] > largeRadius){
+            m_role[i] = LARGE;
+            m_large.push_back(i);
+            continue;
+        }
+        m_role[i] = GRID;
+        maxRadius = std::max(maxRadius, radii[i]);
+    }
+
+    // the grid only matters if two ordinary bodies can touch
+    if(maxRadius > static_cast<T>(0)){
+        const T cellSize = static_cast<T>(2) * maxRadius;
+        std::size_t buckets = 1;
+        while(buckets < n){
+            buckets <<= 1;
+        }
+        m_mask = buckets - 1;
+        m_cellX.resize(n);
+        m_cellY.resize(n);
+
+        // counting sort of the grid bodies by bucket, counts become bucket ends,
+        // placing back to front leaves every entry at the start of its bucket
+        m_bucketStart.assign(buckets + 1, 0);
+        for(std::size_t i = 0; i < n; ++i){
+            if(m_role[i] == GRID){
+                m_cellX[i] = cellCoordinate(bodies.x[i], cellSize);
+                m_cellY[i] = cellCoordinate(bodies.y[i], cellSize);
+                ++m_bucketStart[bucketOf(m_cellX[i], m_cellY[i])];
+            }
+        }
+        for(std::size_t b = 1; b < buckets; ++b){
+            m_bucketStart[b] += m_bucketStart[b - 1];
+        }
+        m_bucketStart[buckets] = m_bucketStart[buckets - 1];
+        m_order.resize(m_bucketStart[buckets]);
+        for(std::size_t i = n; i-- > 0;){
+            if(m_role[i] == GRID){
+                m_order[--m_bucketStart[bucketOf(m_cellX[i], m_cellY[i])]] = i;
+            }
+        }
+
+        // an overlapping pair is at most one cell apart, the exact cell check skips
+        // bodies of other cells that share a bucket, so each pair is found once, from its lower index
+        for(std::size_t i = 0; i < n; ++i){
+            if(m_role[i] != GRID){
+                continue;
+            }
+            for(long long dy = -1; dy <= 1; ++dy){
+                for(long long dx = -1; dx <= 1; ++dx){
+                    const long long cx = m_cellX[i] + dx;
+                    const long long cy = m_cellY[i] + dy;
+                    const std::size_t b = bucketOf(cx, cy);
+                    for(std::size_t k = m_bucketStart[b]; k < m_bucketStart[b + 1]; ++k){
+                        const std::size_t j = m_order[k];
+                        if(j > i && m_cellX[j] == cx && m_cellY[j] == cy && overlaps(bodies, radii, i, j)){
+                            pairs.emplace_back(i, j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // large bodies against everyone, a pair of two large bodies only from the lower one
+    for(std::size_t k = 0; k < m_large.size(); ++k){
+        const std::size_t i = m_large[k];
+        for(std::size_t j = 0; j < n; ++j){
+            const bool candidate = m_role[j] == GRID || (m_role[j] == LARGE && j > i);
+            if(candidate && overlaps(bodies, radii, i, j)){
+                pairs.emplace_back(std::min(i, j), std::max(i, j));
+            }
+        }
+    }
+    // the scan order depends on the hash, sorted pairs make the result independent of it
+    std::sort(pairs.begin(), pairs.end());
+}
+
+/**
+ * @brief returns number of hash buckets of the last build
+ *
+ * @return std::size_t bucket count
+ */
+template<typename T>
+std::size_t SpatialHashGrid2D<T>::bucketCount() const{
+    return m_bucketStart.empty() ? 0 : m_bucketStart.size() - 1;
+}
+
+/**
+ * @brief returns number of bodies compared directly in the last build
+ *
+ * @return std::size_t large body count
+ */
+template<typename T>
+std::size_t SpatialHashGrid2D<T>::largeCount() const{
+    return m_large.size();
+}
+
+/**
+ * @brief bucket of a cell
+ *
+ * @param cx cell x coordinate
+ * @param cy cell y coordinate
+ * @return std::size_t bucket index
+ */
+template<typename T>
+std::size_t SpatialHashGrid2D<T>::bucketOf(long long cx, long long cy) const{
+    // multiply by large odd constants, fold the high bits down so neighbouring cells spread out
+    unsigned long long h = static_cast<unsigned long long>(cx) * 0x9E3779B97F4A7C15ULL + static_cast<unsigned long long>(cy) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 32;
+    return static_cast<std::size_t>(h) & m_mask;
+}
+
+// precisions selectable through the precision config key
+template class SpatialHashGrid2D<float>;
+template class SpatialHashGrid2D<double>;
+template class SpatialHashGrid2D<long double>;
@@ -0,0 +1,158 @@
+// threadpool class, persistent workers for parallel loops
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+/**
+ * @brief start threadCount - 1 workers
+ *
+ * @param threadCount total threads including the caller, 0 = hardwareThreads()
+ */
+ThreadPool::ThreadPool(std::size_t threadCount) : m_workers(), m_mutex(), m_wake(), m_done(), m_task(nullptr), m_taskCount(0), m_nextTask(0), m_busyWorkers(0), m_generation(0), m_stopping(false){
+    if(threadCount == 0){
+        threadCount = hardwareThreads();
+    }
+    m_workers.reserve(threadCount - 1);
+    for(std::size_t i = 1; i < threadCount; ++i){
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+/**
+ * @brief stop and join all workers
+ *
+ */
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for(std::size_t i = 0; i < m_workers.size(); ++i){
+        m_workers[i].join();
+    }
+}
+
+/**
+ * @brief returns number of threads working on a run(), including the caller
+ *
+ * @return std::size_t thread count
+ */
+std::size_t ThreadPool::threadCount() const{
+    return m_workers.size() + 1;
+}
+
+/**
+ * @brief call task(k) once for every k in [0, taskCount), blocks until all calls returned
+ *
+ * @param taskCount number of tasks
+ * @param task function taking the task index
+ */
+void ThreadPool::run(std::size_t taskCount, const std::function<void(std::size_t)> &task){
+    if(taskCount == 0){
+        return;
+    }
+    if(m_workers.empty() || taskCount == 1){
+        for(std::size_t k = 0; k < taskCount; ++k){
+            task(k);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskCount = taskCount;
+        m_nextTask.store(0);
+        m_busyWorkers = m_workers.size();
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    // caller works too instead of just waiting
+    drainTasks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this](){ return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
+
+/**
+ * @brief split [begin, end) into chunks of at least grain indices and call body(chunkBegin, chunkEnd) on each
+ *        ranges shorter than two grains run on the calling thread only
+ *
+ * @param begin first index
+ * @param end one past last index
+ * @param grain minimum chunk length
+ * @param body function taking a chunk [chunkBegin, chunkEnd)
+ */
+void ThreadPool::parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &body){
+    if(end <= begin){
+        return;
+    }
+    const std::size_t length = end - begin;
+    grain = std::max<std::size_t>(grain, 1);
+    if(m_workers.empty() || length < 2 * grain){
+        body(begin, end);
+        return;
+    }
+
+    // a few chunks per thread so a slow thread does not hold up the rest
+    const std::size_t chunks = std::min(length / grain, 4 * threadCount());
+    run(chunks, [&](std::size_t k){
+        body(begin + length * k / chunks, begin + length * (k + 1) / chunks);
+    });
+}
+
+/**
+ * @brief number of hardware threads, at least 1
+ *
+ * @return std::size_t
+ */
+std::size_t ThreadPool::hardwareThreads(){
+    const unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<std::size_t>(count) : 1;
+}
+
+/**
+ * @brief worker thread body, sleeps until a run() starts or the pool stops
+ *
+ */
+void ThreadPool::workerLoop(){
+    std::uint64_t seen = 0;
+    for(;;){
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&](){ return m_stopping || m_generation != seen; });
+            if(m_stopping){
+                return;
+            }
+            seen = m_generation;
+        }
+
+        drainTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busyWorkers;
+            if(m_busyWorkers == 0){
+                m_done.notify_one();
+            }
+        }
+    }
+}
+
+/**
+ * @brief take and run tasks of the current run() until none are left
+ *
+ */
+void ThreadPool::drainTasks(){
+    for(;;){
+        const std::size_t k = m_nextTask.fetch_add(1);
+        if(k >= m_taskCount){
+            return;
+        }
+        (*m_task)(k);
+    }
+}
@@ -0,0 +1,148 @@
+// trajectory file format, fixed header + fixed-stride binary frames
+
+#include "trajectory_file.h"
+
+#include <cstring>
+#include <ostream>
+
+/**
+ * @brief fill a header for a run
+ *        long double runs are stored as double, long double has no portable binary layout
+ *
+ * @param precisionCode 0 = float, 1 = double, 2 = long double
+ * @param bodyCount number of bodies
+ * @param includeEnergy frames carry E_total
+ * @param outputEvery steps between frames
+ * @param dt time step
+ * @return TrajectoryHeader
+ */
+TrajectoryHeader makeTrajectoryHeader(std::uint32_t precisionCode, std::uint64_t bodyCount, bool includeEnergy, std::uint64_t outputEvery, double dt){
+    TrajectoryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "NBODYTRJ", 8);
+    header.version = TRAJECTORY_VERSION;
+    header.headerBytes = static_cast<std::uint32_t>(sizeof(TrajectoryHeader));
+    header.precision = precisionCode;
+    header.valueBytes = precisionCode == 0U ? 4U : 8U;
+    header.fields = static_cast<std::uint32_t>(TrajectoryField::Time) | static_cast<std::uint32_t>(TrajectoryField::Position) | static_cast<std::uint32_t>(TrajectoryField::Velocity);
+    if(includeEnergy){
+        header.fields |= static_cast<std::uint32_t>(TrajectoryField::Energy);
+    }
+    header.bodyCount = bodyCount;
+    header.outputEvery = outputEvery;
+    header.dt = dt;
+    header.frameBytes = header.valueBytes * (1U + 4U * bodyCount + (includeEnergy ? 1U : 0U));
+    return header;
+}
+
+/**
+ * @brief construct a closed reader
+ *
+ */
+TrajectoryReader::TrajectoryReader() : m_file(), m_header(){
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+/**
+ * @brief unmap and close
+ *
+ */
+TrajectoryReader::~TrajectoryReader(){
+    close();
+}
+
+/**
+ * @brief map a file and check its header
+ *
+ * @param path binary trajectory file
+ * @param err stream for error messages
+ * @return true if the file is a valid trajectory
+ * @return false otherwise
+ */
+bool TrajectoryReader::open(const std::string &path, std::ostream &err){
+    close();
+    if(!m_file.open(path)){
+        err << "Could not open trajectory file " << path << ".\n";
+        return false;
+    }
+    if(m_file.size() < sizeof(TrajectoryHeader)){
+        err << "Trajectory file " << path << " is too short for a header.\n";
+        close();
+        return false;
+    }
+    std::memcpy(&m_header, m_file.data(), sizeof(TrajectoryHeader));
+    if(std::memcmp(m_header.magic, "NBODYTRJ", 8) != 0){
+        err << path << " is not a binary trajectory file.\n";
+        close();
+        return false;
+    }
+    if(m_header.version != TRAJECTORY_VERSION){
+        err << path << " has unsupported format version " << m_header.version << ".\n";
+        close();
+        return false;
+    }
+    if((m_header.valueBytes != 4U && m_header.valueBytes != 8U) || m_header.headerBytes < sizeof(TrajectoryHeader) || m_header.frameBytes != m_header.valueBytes * valuesPerFrame()){
+        err << path << " has an inconsistent header.\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief unmap and release the file
+ *
+ */
+void TrajectoryReader::close(){
+    m_file.close();
+}
+
+/**
+ * @brief header of the open file
+ *
+ * @return const TrajectoryHeader&
+ */
+const TrajectoryHeader &TrajectoryReader::header() const{
+    return m_header;
+}
+
+/**
+ * @brief number of complete frames in the file
+ *
+ * @return std::size_t
+ */
+std::size_t TrajectoryReader::frameCount() const{
+    if(m_file.data() == nullptr || m_header.frameBytes == 0){
+        return 0;
+    }
+    return static_cast<std::size_t>((m_file.size() - m_header.headerBytes) / m_header.frameBytes);
+}
+
+/**
+ * @brief number of values in one frame, 1 + 4 * N [+ 1]
+ *
+ * @return std::size_t
+ */
+std::size_t TrajectoryReader::valuesPerFrame() const{
+    const bool energy = (m_header.fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U;
+    return static_cast<std::size_t>(1U + 4U * m_header.bodyCount + (energy ? 1U : 0U));
+}
+
+/**
+ * @brief value v of frame k, widened to double
+ *
+ * @param k frame index, less than frameCount()
+ * @param v value index, less than valuesPerFrame()
+ * @return double
+ */
+double TrajectoryReader::value(std::size_t k, std::size_t v) const{
+    const char *at = m_file.data() + m_header.headerBytes + k * m_header.frameBytes + v * m_header.valueBytes;
+    if(m_header.valueBytes == 4U){
+        float f;
+        std::memcpy(&f, at, sizeof(f));
+        return static_cast<double>(f);
+    }
+    double d;
+    std::memcpy(&d, at, sizeof(d));
+    return d;
+}
@@ -0,0 +1,190 @@
+// workstealingscheduler class, runs independent tasks of uneven length on per-thread queues with stealing
+
+#include "work_stealing_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+#include "thread_pool.h"
+
+/**
+ * @brief set the thread count, no threads are started until run()
+ *
+ * @param threadCount total threads including the caller, 0 = ThreadPool::hardwareThreads()
+ */
+WorkStealingScheduler::WorkStealingScheduler(std::size_t threadCount) : m_threadCount(threadCount == 0 ? ThreadPool::hardwareThreads() : threadCount), m_queues(), m_stats(){
+    for(std::size_t i = 0; i < m_threadCount; ++i){
+        m_queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+}
+
+/**
+ * @brief returns number of threads a run() uses, including the caller
+ *
+ * @return std::size_t thread count
+ */
+std::size_t WorkStealingScheduler::threadCount() const{
+    return m_threadCount;
+}
+
+/**
+ * @brief call task(k, thread) once for every k in [0, costs.size()), blocks until all calls returned
+ *        task must not throw
+ *
+ * @param costs estimated cost of every task, any unit, larger runs first
+ * @param task function taking the task index and the number of the thread running it
+ */
+void WorkStealingScheduler::run(const std::vector<double> &costs, const std::function<void(std::size_t, std::size_t)> &task){
+    m_stats.assign(m_threadCount, WorkerStats{0, 0, 0.0});
+    if(costs.empty()){
+        return;
+    }
+
+    // largest first, each to the queue with the least cost so far
+    std::vector<std::size_t> order(costs.size());
+    std::iota(order.begin(), order.end(), static_cast<std::size_t>(0));
+    std::stable_sort(order.begin(), order.end(), [&costs](std::size_t a, std::size_t b){
+        return costs[a] > costs[b];
+    });
+    for(std::size_t i = 0; i < m_threadCount; ++i){
+        m_queues[i]->tasks.clear();
+        m_queues[i]->cost = 0.0;
+    }
+    for(std::size_t k = 0; k < order.size(); ++k){
+        std::size_t lightest = 0;
+        for(std::size_t i = 1; i < m_threadCount; ++i){
+            if(m_queues[i]->cost < m_queues[lightest]->cost){
+                lightest = i;
+            }
+        }
+        m_queues[lightest]->tasks.push_back(order[k]);
+        m_queues[lightest]->cost += costs[order[k]];
+    }
+
+    // no spare threads for fewer tasks than threads
+    const std::size_t threads = std::min(m_threadCount, costs.size());
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for(std::size_t i = 1; i < threads; ++i){
+        workers.emplace_back(&WorkStealingScheduler::workerLoop, this, i, std::cref(costs), std::cref(task));
+    }
+    workerLoop(0, costs, task);
+    for(std::size_t i = 0; i < workers.size(); ++i){
+        workers[i].join();
+    }
+}
+
+/**
+ * @brief per-thread counts and busy time of the last run()
+ *
+ * @return const std::vector<WorkerStats>& one entry per thread
+ */
+const std::vector<WorkerStats> &WorkStealingScheduler::workerStats() const{
+    return m_stats;
+}
+
+/**
+ * @brief tasks stolen during the last run()
+ *
+ * @return unsigned long long
+ */
+unsigned long long WorkStealingScheduler::steals() const{
+    unsigned long long total = 0;
+    for(std::size_t i = 0; i < m_stats.size(); ++i){
+        total += m_stats[i].stolen;
+    }
+    return total;
+}
+
+/**
+ * @brief thread body, own queue first, then steal until every queue is empty
+ *        tasks never add tasks, so once every queue is empty the thread is done
+ *
+ * @param thread thread number
+ * @param costs estimates of the current run()
+ * @param task task function of the current run()
+ */
+void WorkStealingScheduler::workerLoop(std::size_t thread, const std::vector<double> &costs, const std::function<void(std::size_t, std::size_t)> &task){
+    WorkerStats &stats = m_stats[thread];
+    std::size_t taskIndex = 0;
+    while(true){
+        if(!takeOwn(thread, costs, taskIndex)){
+            if(!steal(thread, costs, taskIndex)){
+                return;
+            }
+            ++stats.stolen;
+        }
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        task(taskIndex, thread);
+        stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ++stats.tasks;
+    }
+}
+
+/**
+ * @brief pop the front of the thread's own queue
+ *
+ * @param thread thread number
+ * @param costs estimates of the current run()
+ * @param taskIndex set to the task taken
+ * @return true if a task was taken
+ * @return false if the queue is empty
+ */
+bool WorkStealingScheduler::takeOwn(std::size_t thread, const std::vector<double> &costs, std::size_t &taskIndex){
+    TaskQueue &queue = *m_queues[thread];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.tasks.empty()){
+        return false;
+    }
+    taskIndex = queue.tasks.front();
+    queue.tasks.pop_front();
+    queue.cost -= costs[taskIndex];
+    return true;
+}
+
+/**
+ * @brief pop the back of the other queue with the most estimated cost left
+ *        the owner keeps its largest tasks, the thief takes the small tail end
+ *        and another owner may have emptied the victim meanwhile, so the search repeats
+ *
+ * @param thread thread number of the thief
+ * @param costs estimates of the current run()
+ * @param taskIndex set to the task taken
+ * @return true if a task was stolen
+ * @return false if every other queue is empty
+ */
+bool WorkStealingScheduler::steal(std::size_t thread, const std::vector<double> &costs, std::size_t &taskIndex){
+    while(true){
+        std::size_t victim = m_threadCount;
+        double most = 0.0;
+        bool anyLeft = false;
+        for(std::size_t i = 0; i < m_threadCount; ++i){
+            if(i == thread){
+                continue;
+            }
+            TaskQueue &queue = *m_queues[i];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(queue.tasks.empty()){
+                continue;
+            }
+            if(!anyLeft || queue.cost > most){
+                victim = i;
+                most = queue.cost;
+            }
+            anyLeft = true;
+        }
+        if(!anyLeft){
+            return false;
+        }
+        TaskQueue &queue = *m_queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            taskIndex = queue.tasks.back();
+            queue.tasks.pop_back();
+            queue.cost -= costs[taskIndex];
+            return true;
+        }
+    }
+}
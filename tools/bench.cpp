@@ -0,0 +1,667 @@
+// bench, timed sweep over N, integrator, precision and force engine, writes results/bench.csv
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "body2d.hpp"
+#include "nbody_system2d.h"
+#include "simd_kernels.h"
+#include "vec2.hpp"
+
+/**
+ * @brief command line settings of one bench run
+ *
+ */
+struct BenchOptions{
+    std::vector<std::size_t> sizes; // body counts N
+    std::vector<std::string> methods; // integrators, same names as the method config key
+    std::vector<std::string> precisions; // float, double, long double
+    std::vector<std::string> engines; // direct, barneshut, fmm, pm
+    long long steps; // steps per trial, 0 = calibrate to trialSeconds
+    double trialSeconds; // target length of one trial when calibrating
+    int trials; // timed trials per case
+    int warmup; // untimed trials per case before the timed ones
+    int threads; // worker threads, same meaning as the threads config key
+    std::string storage; // aos or soa
+    std::string simd; // auto, avx2, avx512 or off
+    std::string outPath; // csv output, - for stdout
+    std::string baselinePath; // compare against this file after the run, empty = no comparison
+    double tolerance; // throughput drop below which a case is not flagged
+};
+
+/**
+ * @brief timing of one case, one row of the csv
+ *
+ */
+struct BenchResult{
+    std::size_t n; // body count
+    long long steps; // steps per trial
+    std::string method; // integrator
+    std::string precision; // scalar type
+    std::string engine; // force engine
+    std::string storage; // memory layout
+    int threads; // worker threads
+    int trials; // timed trials
+    double seconds; // median trial time
+    double minSeconds; // fastest trial
+    double madSeconds; // median absolute deviation of the trial times
+    unsigned long long forceEvals; // force passes per trial
+    double pairsPerSecond; // direct-sum equivalent pair interactions per second, N(N-1)/2 per full force pass
+};
+
+/**
+ * @brief split a comma separated list, empty entries are dropped
+ *
+ * @param value list text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &value){
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        if(!item.empty()){
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief median of a list of values, the list is reordered
+ *
+ * @param values trial times
+ * @return double
+ */
+double median(std::vector<double> values){
+    std::sort(values.begin(), values.end());
+    const std::size_t mid = values.size() / 2;
+    return values.size() % 2 == 1 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+}
+
+/**
+ * @brief deterministic rotating disk, same bodies for every precision and engine
+ *        uniform surface density of total mass 1 inside radius 1, circular speed from the enclosed mass
+ *
+ * @param n body count
+ * @return std::vector<Body2D<double>>
+ */
+std::vector<Body2D<double>> makeDisk(std::size_t n){
+    std::mt19937_64 rng(20240101ULL + n);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double twoPi = 6.283185307179586;
+    std::vector<Body2D<double>> bodies;
+    bodies.reserve(n);
+    for(std::size_t i = 0; i < n; ++i){
+        // sqrt keeps the surface density uniform
+        const double radius = std::sqrt(unit(rng)) + 1e-3;
+        const double angle = twoPi * unit(rng);
+        // enclosed mass of a uniform disk grows as radius^2
+        const double speed = std::sqrt(std::min(radius * radius, 1.0) / radius);
+        const Vec2<double> position(radius * std::cos(angle), radius * std::sin(angle));
+        const Vec2<double> velocity(-speed * std::sin(angle), speed * std::cos(angle));
+        bodies.push_back(Body2D<double>(1.0 / static_cast<double>(n), position, velocity));
+    }
+    return bodies;
+}
+
+/**
+ * @brief set up a fresh system with the bench's softening, engine and threads and fill it with the disk
+ *
+ * @tparam T scalar type of the run
+ * @param options storage, simd and thread settings
+ * @param disk initial conditions in double
+ * @param engine force engine name
+ * @param system empty system, G = 1 and eps2 = 1e-4 are set here
+ */
+template<typename T>
+void setupSystem(const BenchOptions &options, const std::vector<Body2D<double>> &disk, const std::string &engine, NBodySystem2D<T> &system){
+    system.setG(static_cast<T>(1));
+    system.setEps2(static_cast<T>(1e-4));
+    if(options.storage == "soa"){
+        system.setStorageMode(StorageMode::SoA);
+    }
+    if(engine == "barneshut"){
+        system.setForceEngine(ForceEngine::BarnesHut);
+    }
+    else if(engine == "fmm"){
+        system.setForceEngine(ForceEngine::Fmm);
+    }
+    else if(engine == "pm"){
+        // default 256 cell cloud in cell mesh
+        system.setForceEngine(ForceEngine::Pm);
+    }
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    parseSimdLevel(options.simd, simdLevel);
+    system.setSimdLevel(simdLevel);
+    system.setThreadCount(static_cast<std::size_t>(options.threads));
+    system.reserveBodies(disk.size());
+    for(std::size_t i = 0; i < disk.size(); ++i){
+        const Body2D<double> &b = disk[i];
+        system.addBody(Body2D<T>(static_cast<T>(b.m), Vec2<T>(static_cast<T>(b.r.x), static_cast<T>(b.r.y)), Vec2<T>(static_cast<T>(b.v.x), static_cast<T>(b.v.y))));
+    }
+}
+
+/**
+ * @brief build a fresh system from the disk and run steps steps of method
+ *
+ * @tparam T scalar type of the run
+ * @param options storage, simd and thread settings
+ * @param disk initial conditions in double
+ * @param method integrator name
+ * @param engine force engine name
+ * @param steps steps to run
+ * @param forceEvals set to the number of force passes the steps took
+ * @param pairs set to the pair interactions the steps took
+ * @return double seconds spent stepping, system construction excluded
+ */
+template<typename T>
+double timeTrial(const BenchOptions &options, const std::vector<Body2D<double>> &disk, const std::string &method, const std::string &engine, long long steps, unsigned long long &forceEvals, unsigned long long &pairs){
+    NBodySystem2D<T> system;
+    setupSystem<T>(options, disk, engine, system);
+
+    const T dt = static_cast<T>(1e-3);
+    const unsigned long long evalsBefore = system.forceEvaluations();
+    const unsigned long long pairsBefore = system.pairInteractions();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(long long step = 0; step < steps; ++step){
+        if(method == "euler"){
+            system.stepEuler(dt);
+        }
+        else if(method == "semieuler"){
+            system.stepSemiEuler(dt);
+        }
+        else if(method == "leapfrog"){
+            system.stepLeapfrog(dt);
+        }
+        else if(method == "block"){
+            system.stepBlock(dt);
+        }
+        else if(method == "yoshida"){
+            system.stepYoshida(dt);
+        }
+        else if(method == "hermite"){
+            system.stepHermite(dt);
+        }
+        else{
+            system.stepVerlet(dt);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    forceEvals = system.forceEvaluations() - evalsBefore;
+    pairs = system.pairInteractions() - pairsBefore;
+    return seconds;
+}
+
+/**
+ * @brief block steps with every body in bin 0 must cost what leapfrog costs, one force pass per step
+ *        a huge blockEta keeps every body in bin 0, both methods then add the first step's opening pass
+ *
+ * @tparam T scalar type of the run
+ * @param options storage, simd and thread settings
+ * @param disk initial conditions in double
+ * @param engine force engine name
+ * @return true if block and leapfrog took the same number of force passes
+ * @return false otherwise, the counts are printed
+ */
+template<typename T>
+bool checkBlockCost(const BenchOptions &options, const std::vector<Body2D<double>> &disk, const std::string &engine){
+    const long long steps = 4;
+    const T dt = static_cast<T>(1e-3);
+    NBodySystem2D<T> block;
+    setupSystem<T>(options, disk, engine, block);
+    block.setBlockEta(static_cast<T>(1e30));
+    NBodySystem2D<T> leapfrog;
+    setupSystem<T>(options, disk, engine, leapfrog);
+    for(long long step = 0; step < steps; ++step){
+        block.stepBlock(dt);
+        leapfrog.stepLeapfrog(dt);
+    }
+    const std::vector<std::size_t> bins = block.blockBinCounts();
+    if(bins.empty() || bins[0] != disk.size() || block.forceEvaluations() != leapfrog.forceEvaluations()){
+        std::cerr << "block cost check failed for " << engine << ": " << block.forceEvaluations() << " force passes in bin 0, leapfrog took " << leapfrog.forceEvaluations() << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief calibrate, warm up and time one case
+ *
+ * @tparam T scalar type of the run
+ * @param options sweep settings
+ * @param disk initial conditions in double
+ * @param method integrator name
+ * @param precision precision name, copied to the result
+ * @param engine force engine name
+ * @return BenchResult
+ */
+template<typename T>
+BenchResult runCase(const BenchOptions &options, const std::vector<Body2D<double>> &disk, const std::string &method, const std::string &precision, const std::string &engine){
+    unsigned long long forceEvals = 0;
+    unsigned long long pairs = 0;
+    long long steps = options.steps;
+    if(steps <= 0){
+        // double the step count until a trial is long enough that one-off costs like the
+        // first leapfrog force pass do not skew the estimate, these runs also warm up
+        const long long maxSteps = 100000;
+        long long probe = 1;
+        double probeSeconds = timeTrial<T>(options, disk, method, engine, probe, forceEvals, pairs);
+        while(probeSeconds < 0.25 * options.trialSeconds && probe < maxSteps){
+            probe *= 2;
+            probeSeconds = timeTrial<T>(options, disk, method, engine, probe, forceEvals, pairs);
+        }
+        const double perStep = std::max(probeSeconds, 1e-9) / static_cast<double>(probe);
+        steps = std::max(1LL, std::min(maxSteps, static_cast<long long>(std::ceil(options.trialSeconds / perStep))));
+    }
+    for(int k = 0; k < options.warmup; ++k){
+        timeTrial<T>(options, disk, method, engine, steps, forceEvals, pairs);
+    }
+
+    std::vector<double> times;
+    for(int k = 0; k < options.trials; ++k){
+        times.push_back(timeTrial<T>(options, disk, method, engine, steps, forceEvals, pairs));
+    }
+
+    BenchResult result;
+    result.n = disk.size();
+    result.steps = steps;
+    result.method = method;
+    result.precision = precision;
+    result.engine = engine;
+    result.storage = options.storage;
+    result.threads = options.threads;
+    result.trials = options.trials;
+    result.seconds = median(times);
+    result.minSeconds = *std::min_element(times.begin(), times.end());
+    std::vector<double> deviations;
+    for(std::size_t k = 0; k < times.size(); ++k){
+        deviations.push_back(std::fabs(times[k] - result.seconds));
+    }
+    result.madSeconds = median(deviations);
+    result.forceEvals = forceEvals;
+    result.pairsPerSecond = static_cast<double>(pairs) / std::max(result.seconds, 1e-12);
+    return result;
+}
+
+/**
+ * @brief the csv header, the first four columns are the original N,steps,method,seconds
+ *
+ * @return const char*
+ */
+const char *csvHeader(){
+    return "N,steps,method,seconds,precision,engine,storage,threads,trials,min_seconds,mad_seconds,force_evals,pairs_per_second";
+}
+
+/**
+ * @brief write results as csv
+ *
+ * @param out output stream
+ * @param results one row per case
+ */
+void writeCsv(std::ostream &out, const std::vector<BenchResult> &results){
+    out << csvHeader() << "\n";
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const BenchResult &r = results[k];
+        out << r.n << "," << r.steps << "," << r.method << "," << r.seconds << "," << r.precision << "," << r.engine << "," << r.storage << "," << r.threads << "," << r.trials << "," << r.minSeconds << "," << r.madSeconds << "," << r.forceEvals << "," << r.pairsPerSecond << "\n";
+    }
+}
+
+/**
+ * @brief read a csv written by writeCsv
+ *        columns are found by name, rows without pairs_per_second cannot be compared and are skipped
+ *
+ * @param path csv path
+ * @param results filled with the rows
+ * @return true if the file was read
+ * @return false if it could not be opened or lacks the needed columns
+ */
+bool readCsv(const std::string &path, std::vector<BenchResult> &results){
+    std::ifstream in(path);
+    if(!in){
+        std::cerr << "Could not open " << path << ".\n";
+        return false;
+    }
+    std::string line;
+    if(!std::getline(in, line)){
+        std::cerr << path << " is empty.\n";
+        return false;
+    }
+    std::map<std::string, std::size_t> column;
+    std::vector<std::string> names = splitList(line);
+    for(std::size_t k = 0; k < names.size(); ++k){
+        column[names[k]] = k;
+    }
+    if(column.count("N") == 0 || column.count("method") == 0 || column.count("seconds") == 0 || column.count("pairs_per_second") == 0){
+        std::cerr << path << " has no pairs_per_second column, regenerate it with make bench.\n";
+        return false;
+    }
+
+    // missing columns take the values the original hand-entered table was measured with
+    const auto field = [&column](const std::vector<std::string> &row, const std::string &name, const std::string &fallback){
+        const std::map<std::string, std::size_t>::const_iterator it = column.find(name);
+        return it != column.end() && it->second < row.size() ? row[it->second] : fallback;
+    };
+    while(std::getline(in, line)){
+        const std::vector<std::string> row = splitList(line);
+        if(row.size() < names.size()){
+            continue;
+        }
+        BenchResult r;
+        r.n = static_cast<std::size_t>(std::strtoull(field(row, "N", "0").c_str(), nullptr, 10));
+        r.steps = std::strtoll(field(row, "steps", "0").c_str(), nullptr, 10);
+        r.method = field(row, "method", "verlet");
+        r.seconds = std::strtod(field(row, "seconds", "0").c_str(), nullptr);
+        r.precision = field(row, "precision", "long double");
+        r.engine = field(row, "engine", "direct");
+        r.storage = field(row, "storage", "aos");
+        r.threads = std::atoi(field(row, "threads", "1").c_str());
+        r.trials = std::atoi(field(row, "trials", "1").c_str());
+        r.minSeconds = std::strtod(field(row, "min_seconds", "0").c_str(), nullptr);
+        r.madSeconds = std::strtod(field(row, "mad_seconds", "0").c_str(), nullptr);
+        r.forceEvals = std::strtoull(field(row, "force_evals", "0").c_str(), nullptr, 10);
+        r.pairsPerSecond = std::strtod(field(row, "pairs_per_second", "0").c_str(), nullptr);
+        results.push_back(r);
+    }
+    return true;
+}
+
+/**
+ * @brief key that matches a case between two runs
+ *
+ * @param r result row
+ * @return std::string
+ */
+std::string caseKey(const BenchResult &r){
+    std::ostringstream key;
+    key << "N=" << r.n << " " << r.method << " " << r.precision << " " << r.engine << " " << r.storage << " threads=" << r.threads;
+    return key.str();
+}
+
+/**
+ * @brief compare throughput case by case and flag drops
+ *        a case regresses when pairs/s fell by more than the tolerance and by more than
+ *        three times the combined relative spread of the two runs, so noisy cases need a larger drop
+ *
+ * @param baseline rows of the saved run
+ * @param current rows of the new run
+ * @param tolerance relative drop that is always accepted
+ * @return int number of regressed cases
+ */
+int compareRuns(const std::vector<BenchResult> &baseline, const std::vector<BenchResult> &current, double tolerance){
+    std::map<std::string, BenchResult> base;
+    for(std::size_t k = 0; k < baseline.size(); ++k){
+        base[caseKey(baseline[k])] = baseline[k];
+    }
+
+    int regressions = 0;
+    int matched = 0;
+    for(std::size_t k = 0; k < current.size(); ++k){
+        const BenchResult &now = current[k];
+        const std::map<std::string, BenchResult>::const_iterator it = base.find(caseKey(now));
+        if(it == base.end()){
+            std::cout << caseKey(now) << ": no baseline\n";
+            continue;
+        }
+        const BenchResult &old = it->second;
+        if(old.pairsPerSecond <= 0.0 || old.seconds <= 0.0 || now.seconds <= 0.0){
+            continue;
+        }
+        ++matched;
+        const double change = now.pairsPerSecond / old.pairsPerSecond - 1.0;
+        const double noise = 3.0 * (old.madSeconds / old.seconds + now.madSeconds / now.seconds);
+        const bool regressed = -change > std::max(tolerance, noise);
+        if(regressed){
+            ++regressions;
+        }
+        std::cout << caseKey(now) << ": " << old.pairsPerSecond << " -> " << now.pairsPerSecond << " pairs/s (" << (change >= 0.0 ? "+" : "") << 100.0 * change << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+    }
+    std::cout << matched << " cases compared, " << regressions << " regressions (tolerance " << 100.0 * tolerance << "%)\n";
+    return regressions;
+}
+
+/**
+ * @brief print usage
+ *
+ */
+void printUsage(){
+    std::cerr << "usage: bench [options]\n"
+              << "       bench --compare <baseline.csv> <current.csv> [--tolerance f]\n"
+              << "  --n LIST            body counts (default 256,1024,4096)\n"
+              << "  --methods LIST      euler,semieuler,verlet,leapfrog,block,yoshida,\n"
+              << "                      hermite (default verlet,leapfrog)\n"
+              << "  --precisions LIST   float,double,long double (default all three)\n"
+              << "  --engines LIST      direct,barneshut,fmm,pm (default the first three)\n"
+              << "  --steps S           steps per trial, 0 calibrates to --trial-seconds (default 0)\n"
+              << "  --trial-seconds X   target trial length when calibrating (default 0.1)\n"
+              << "  --trials K          timed trials per case (default 5)\n"
+              << "  --warmup W          untimed trials per case (default 1)\n"
+              << "  --threads T         worker threads, 0 = all (default 1)\n"
+              << "  --storage aos|soa   body layout (default aos)\n"
+              << "  --simd LEVEL        auto, avx2, avx512 or off (default auto)\n"
+              << "  --out PATH          csv output, - for stdout (default results/bench.csv)\n"
+              << "  --baseline PATH     compare the new run against PATH, exit code 2 on a regression\n"
+              << "  --tolerance F       accepted relative throughput drop (default 0.1)\n"
+              << "  a block case first checks that block steps with every body in bin 0 cost one force pass\n"
+              << "  per step like leapfrog, exit code 3 if not\n";
+}
+
+/**
+ * @brief usage: see printUsage()
+ *        sweeps every combination of the lists, one csv row per combination
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int 0, 1 on bad arguments or files, 2 if the comparison found a regression,
+ *         3 if block steps with every body in bin 0 took more force passes than leapfrog
+ */
+int main(int argc, char *argv[]){
+    BenchOptions options;
+    options.sizes = {256, 1024, 4096};
+    options.methods = {"verlet", "leapfrog"};
+    options.precisions = {"float", "double", "long double"};
+    options.engines = {"direct", "barneshut", "fmm"};
+    options.steps = 0;
+    options.trialSeconds = 0.1;
+    options.trials = 5;
+    options.warmup = 1;
+    options.threads = 1;
+    options.storage = "aos";
+    options.simd = "auto";
+    options.outPath = "results/bench.csv";
+    options.tolerance = 0.1;
+    std::string compareBase;
+    std::string compareCurrent;
+
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        if(arg == "--help"){
+            printUsage();
+            return 0;
+        }
+        if(arg == "--compare" && i + 2 < argc){
+            compareBase = argv[++i];
+            compareCurrent = argv[++i];
+            continue;
+        }
+        if(i + 1 >= argc){
+            printUsage();
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--n"){
+            options.sizes.clear();
+            const std::vector<std::string> items = splitList(value);
+            for(std::size_t k = 0; k < items.size(); ++k){
+                options.sizes.push_back(static_cast<std::size_t>(std::strtoull(items[k].c_str(), nullptr, 10)));
+            }
+        }
+        else if(arg == "--methods"){
+            options.methods = splitList(value);
+        }
+        else if(arg == "--precisions"){
+            options.precisions = splitList(value);
+        }
+        else if(arg == "--engines"){
+            options.engines = splitList(value);
+        }
+        else if(arg == "--steps"){
+            options.steps = std::strtoll(value.c_str(), nullptr, 10);
+        }
+        else if(arg == "--trial-seconds"){
+            options.trialSeconds = std::strtod(value.c_str(), nullptr);
+        }
+        else if(arg == "--trials"){
+            options.trials = std::atoi(value.c_str());
+        }
+        else if(arg == "--warmup"){
+            options.warmup = std::atoi(value.c_str());
+        }
+        else if(arg == "--threads"){
+            options.threads = std::atoi(value.c_str());
+        }
+        else if(arg == "--storage"){
+            options.storage = value;
+        }
+        else if(arg == "--simd"){
+            options.simd = value;
+        }
+        else if(arg == "--out"){
+            options.outPath = value;
+        }
+        else if(arg == "--baseline"){
+            options.baselinePath = value;
+        }
+        else if(arg == "--tolerance"){
+            options.tolerance = std::strtod(value.c_str(), nullptr);
+        }
+        else{
+            printUsage();
+            return 1;
+        }
+    }
+
+    // compare two saved runs without timing anything
+    if(!compareBase.empty()){
+        std::vector<BenchResult> baseline;
+        std::vector<BenchResult> current;
+        if(!readCsv(compareBase, baseline) || !readCsv(compareCurrent, current)){
+            return 1;
+        }
+        return compareRuns(baseline, current, options.tolerance) > 0 ? 2 : 0;
+    }
+
+    // same checks as SimulationConfig::validate for the values the sweep passes on
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    if(options.trials < 1 || options.warmup < 0 || options.threads < 0 || (options.storage != "aos" && options.storage != "soa") || !parseSimdLevel(options.simd, simdLevel)){
+        printUsage();
+        return 1;
+    }
+    for(std::size_t k = 0; k < options.sizes.size(); ++k){
+        if(options.sizes[k] < 2){
+            std::cerr << "N must be at least 2.\n";
+            return 1;
+        }
+    }
+    for(std::size_t k = 0; k < options.methods.size(); ++k){
+        const std::string &m = options.methods[k];
+        if(m != "euler" && m != "semieuler" && m != "verlet" && m != "leapfrog" && m != "block" && m != "yoshida" && m != "hermite"){
+            std::cerr << "Method must be 'euler' or 'semieuler' or 'verlet' or 'leapfrog' or 'block' or 'yoshida' or 'hermite'.\n";
+            return 1;
+        }
+    }
+    for(std::size_t k = 0; k < options.precisions.size(); ++k){
+        const std::string &p = options.precisions[k];
+        if(p != "float" && p != "double" && p != "long double"){
+            std::cerr << "precision must be 'float' or 'double' or 'long double'.\n";
+            return 1;
+        }
+    }
+    for(std::size_t k = 0; k < options.engines.size(); ++k){
+        const std::string &e = options.engines[k];
+        if(e != "direct" && e != "barneshut" && e != "fmm" && e != "pm"){
+            std::cerr << "engine must be 'direct' or 'barneshut' or 'fmm' or 'pm'.\n";
+            return 1;
+        }
+    }
+
+    std::cerr << "simd = " << simdLevelName(resolveSimdLevel(simdLevel)) << ", threads = " << options.threads << ", storage = " << options.storage << "\n";
+    std::vector<BenchResult> results;
+    bool blockCostOk = true;
+    for(std::size_t s = 0; s < options.sizes.size(); ++s){
+        const std::vector<Body2D<double>> disk = makeDisk(options.sizes[s]);
+        for(std::size_t m = 0; m < options.methods.size(); ++m){
+            for(std::size_t p = 0; p < options.precisions.size(); ++p){
+                for(std::size_t e = 0; e < options.engines.size(); ++e){
+                    const std::string &method = options.methods[m];
+                    const std::string &precision = options.precisions[p];
+                    const std::string &engine = options.engines[e];
+                    if(method == "hermite" && engine != "direct"){
+                        // hermite always runs the direct sum, a tree engine row would be mislabeled
+                        continue;
+                    }
+                    if(method == "block"){
+                        // a block case that pays for empty ticks would time the wrong thing
+                        bool costOk = true;
+                        if(precision == "float"){
+                            costOk = checkBlockCost<float>(options, disk, engine);
+                        }
+                        else if(precision == "double"){
+                            costOk = checkBlockCost<double>(options, disk, engine);
+                        }
+                        else{
+                            costOk = checkBlockCost<long double>(options, disk, engine);
+                        }
+                        blockCostOk = blockCostOk && costOk;
+                    }
+                    BenchResult r;
+                    if(precision == "float"){
+                        r = runCase<float>(options, disk, method, precision, engine);
+                    }
+                    else if(precision == "double"){
+                        r = runCase<double>(options, disk, method, precision, engine);
+                    }
+                    else{
+                        r = runCase<long double>(options, disk, method, precision, engine);
+                    }
+                    std::cerr << caseKey(r) << ": " << r.steps << " steps, median " << r.seconds << " s (mad " << r.madSeconds << " s), " << r.pairsPerSecond << " pairs/s\n";
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+
+    if(options.outPath == "-"){
+        writeCsv(std::cout, results);
+    }
+    else{
+        std::ofstream out(options.outPath);
+        if(!out){
+            std::cerr << "Could not open output file " << options.outPath << ".\n";
+            return 1;
+        }
+        writeCsv(out, results);
+        std::cerr << "wrote " << results.size() << " cases to " << options.outPath << "\n";
+    }
+
+    if(!options.baselinePath.empty()){
+        std::vector<BenchResult> baseline;
+        if(!readCsv(options.baselinePath, baseline)){
+            return 1;
+        }
+        if(compareRuns(baseline, results, options.tolerance) > 0){
+            return 2;
+        }
+    }
+    return blockCostOk ? 0 : 3;
+}
@@ -0,0 +1,55 @@
+// csv2bodies, converts an initial-conditions csv to the binary bodies format
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "body_io.h"
+#include "nbody_system2d.h"
+
+/**
+ * @brief load a csv with the simulator's own parser and write it back as a binary bodies file
+ *
+ * @tparam T scalar type the csv is parsed in, also picks the stored value size
+ * @param input csv path
+ * @param output binary path
+ * @return int process exit code
+ */
+template<typename T>
+int convert(const std::string &input, const std::string &output){
+    NBodySystem2D<T> system;
+    // every hardware thread, the converter has nothing else to do
+    if(!loadBodiesFromCsv(input, system, 0)){
+        return 1;
+    }
+    if(!saveBodiesToBinary(output, system)){
+        return 1;
+    }
+    std::cerr << "wrote " << system.bodyCount() << " bodies to " << output << "\n";
+    return 0;
+}
+
+/**
+ * @brief usage: csv2bodies <input.csv> <output.bin> [float|double]
+ *        double (default) keeps every digit a double or long double run would read from the csv,
+ *        float halves the file for float runs
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        std::cerr << "usage: csv2bodies <input.csv> <output.bin> [float|double]\n";
+        return 1;
+    }
+    const std::string precision = argc > 3 ? argv[3] : "double";
+    if(precision == "float"){
+        return convert<float>(argv[1], argv[2]);
+    }
+    if(precision != "double"){
+        std::cerr << "precision must be 'float' or 'double'.\n";
+        return 1;
+    }
+    return convert<double>(argv[1], argv[2]);
+}
@@ -0,0 +1,451 @@
+// drift_cost, force evaluations each integrator needs to hold a target energy drift over a run
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "body2d.hpp"
+#include "body_io.h"
+#include "nbody_system2d.h"
+#include "simd_kernels.h"
+#include "simulation_config.h"
+
+/**
+ * @brief command line settings of one drift_cost run
+ *
+ */
+struct CostOptions{
+    std::string configPath; // config with the initial condition, engine, precision and run length dt * steps
+    double target; // largest allowed relative energy drift |E(t) - E(0)| / |E(0)|
+    std::vector<std::string> methods; // integrators, same names as the method config key
+    int checks; // energy checks spread over the run, the drift is the largest one seen
+    double maxEvals; // a method is given up once a trial would need more pair interactions than this many full force passes
+    int refine; // bisection rounds between the last failing and the first passing step count
+    std::string outPath; // csv output, empty = none
+};
+
+/**
+ * @brief one run of a method at a fixed step count
+ *
+ */
+struct CostTrial{
+    long long steps; // steps over the run
+    double dt; // span / steps
+    unsigned long long forceEvals; // force passes the run took
+    unsigned long long pairs; // direct-sum equivalent pair interactions the run took
+    double drift; // largest relative energy drift at the checks
+    double seconds; // wall time of the stepping, energy checks included
+};
+
+/**
+ * @brief cheapest passing trial of a method, or the last failing one
+ *
+ */
+struct CostResult{
+    std::string method; // integrator
+    bool reached; // a step count within maxEvals met the target
+    CostTrial trial; // passing trial with the fewest steps, else the last one tried
+    int runs; // trials the search took
+};
+
+/**
+ * @brief split a comma separated list, empty entries are dropped
+ *
+ * @param value list text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &value){
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        if(!item.empty()){
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief run the config's initial condition for the whole span with one method
+ *
+ * @tparam T scalar type of the run
+ * @param cfg engine, softening and thread settings
+ * @param initial bodies loaded from the config's bodiesFile
+ * @param method integrator name
+ * @param span simulated time, dt * steps of the config
+ * @param steps steps to split the span into
+ * @param checks energy checks spread over the run
+ * @return CostTrial
+ */
+template<typename T>
+CostTrial runTrial(const SimulationConfig &cfg, const std::vector<Body2D<T>> &initial, const std::string &method, double span, long long steps, int checks){
+    NBodySystem2D<T> system(static_cast<T>(cfg.G), static_cast<T>(cfg.eps2));
+    if(cfg.storage == "soa"){
+        system.setStorageMode(StorageMode::SoA);
+    }
+    if(cfg.forceEngine == "barneshut"){
+        system.setForceEngine(ForceEngine::BarnesHut);
+    }
+    else if(cfg.forceEngine == "fmm"){
+        system.setForceEngine(ForceEngine::Fmm);
+    }
+    else if(cfg.forceEngine == "pm"){
+        system.setForceEngine(ForceEngine::Pm);
+    }
+    system.setTheta(static_cast<T>(cfg.theta));
+    system.setFmmOrder(cfg.fmmOrder);
+    system.setPmGrid(static_cast<std::size_t>(cfg.pmGrid), cfg.pmAssign == "tsc" ? PmAssignment::Tsc : PmAssignment::Cic);
+    system.setPmBoundary(cfg.pmBoundary == "periodic" ? PmBoundary::Periodic : PmBoundary::Isolated, static_cast<T>(cfg.pmBoxSize));
+    system.setBlockLevels(cfg.blockLevels);
+    system.setBlockEta(static_cast<T>(cfg.blockEta));
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    parseSimdLevel(cfg.simd, simdLevel);
+    system.setSimdLevel(simdLevel);
+    system.setFastRsqrt(cfg.fastRsqrt);
+    system.setThreadCount(static_cast<std::size_t>(cfg.threads));
+    system.addBodies(initial.data(), initial.size());
+
+    CostTrial trial;
+    trial.steps = steps;
+    trial.dt = span / static_cast<double>(steps);
+    trial.drift = 0.0;
+    const T dt = static_cast<T>(trial.dt);
+
+    // energies in long double, the drift of a float run should not drown in the sum's own rounding
+    const long double e0 = static_cast<long double>(system.totalEnergy());
+    const long double scale = std::fabs(e0) > 0.0L ? std::fabs(e0) : 1.0L;
+    const long long every = std::max(1LL, steps / std::max(1, checks));
+    const unsigned long long evalsBefore = system.forceEvaluations();
+    const unsigned long long pairsBefore = system.pairInteractions();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(long long step = 1; step <= steps; ++step){
+        if(method == "euler"){
+            system.stepEuler(dt);
+        }
+        else if(method == "semieuler"){
+            system.stepSemiEuler(dt);
+        }
+        else if(method == "leapfrog"){
+            system.stepLeapfrog(dt);
+        }
+        else if(method == "block"){
+            system.stepBlock(dt);
+        }
+        else if(method == "yoshida"){
+            system.stepYoshida(dt);
+        }
+        else if(method == "hermite"){
+            system.stepHermite(dt);
+        }
+        else{
+            system.stepVerlet(dt);
+        }
+        if(step % every == 0 || step == steps){
+            const long double e = static_cast<long double>(system.totalEnergy());
+            const double drift = static_cast<double>(std::fabs(e - e0) / scale);
+            // a blown-up run reports nan, which must count as failing
+            trial.drift = std::isfinite(drift) ? std::max(trial.drift, drift) : HUGE_VAL;
+        }
+    }
+    trial.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    trial.forceEvals = system.forceEvaluations() - evalsBefore;
+    trial.pairs = system.pairInteractions() - pairsBefore;
+    return trial;
+}
+
+/**
+ * @brief search the fewest steps over the span that keep the drift under the target
+ *        starts at the config's steps, halves while the target holds or doubles until it does,
+ *        then bisects between the last failing and the first passing step count
+ *        the drift of symplectic methods oscillates with dt, so the answer is the
+ *        cheapest passing count found, not a proven minimum
+ *
+ * @tparam T scalar type of the run
+ * @param options target, checks and limits
+ * @param cfg run settings
+ * @param initial initial condition
+ * @param method integrator name
+ * @return CostResult
+ */
+template<typename T>
+CostResult searchMethod(const CostOptions &options, const SimulationConfig &cfg, const std::vector<Body2D<T>> &initial, const std::string &method){
+    const double span = static_cast<double>(cfg.dt) * static_cast<double>(cfg.steps);
+    // the limit in pair interactions, so partial passes like block substeps cost only the rows they sum
+    const double n = static_cast<double>(initial.size());
+    const double maxPairs = options.maxEvals * 0.5 * n * (n - 1.0);
+    CostResult result;
+    result.method = method;
+    result.reached = false;
+    result.runs = 0;
+
+    const auto run = [&](long long steps){
+        ++result.runs;
+        const CostTrial trial = runTrial<T>(cfg, initial, method, span, steps, options.checks);
+        std::cerr << "  " << method << " steps=" << steps << " evals=" << trial.forceEvals << " drift=" << trial.drift << "\n";
+        return trial;
+    };
+
+    CostTrial trial = run(cfg.steps);
+    long long passSteps = 0;
+    long long failSteps = 0;
+    CostTrial best = trial;
+    if(trial.drift <= options.target){
+        passSteps = trial.steps;
+        while(passSteps > 1){
+            trial = run(passSteps / 2);
+            if(trial.drift > options.target){
+                failSteps = trial.steps;
+                break;
+            }
+            passSteps = trial.steps;
+            best = trial;
+        }
+    }
+    else{
+        failSteps = trial.steps;
+        while(true){
+            // pair interactions per step of the last trial predict the cost of the next one
+            const double pairsPerStep = static_cast<double>(trial.pairs) / static_cast<double>(trial.steps);
+            if(pairsPerStep * static_cast<double>(2 * failSteps) > maxPairs){
+                result.trial = trial;
+                return result;
+            }
+            trial = run(2 * failSteps);
+            if(trial.drift <= options.target){
+                passSteps = trial.steps;
+                best = trial;
+                break;
+            }
+            failSteps = trial.steps;
+        }
+    }
+
+    // geometric bisection, stops once the bracket is within about 5%
+    for(int round = 0; round < options.refine && failSteps > 0 && passSteps - failSteps > std::max(1LL, passSteps / 20); ++round){
+        const long long mid = std::max(failSteps + 1, std::min(passSteps - 1, std::llround(std::sqrt(static_cast<double>(failSteps) * static_cast<double>(passSteps)))));
+        trial = run(mid);
+        if(trial.drift <= options.target){
+            passSteps = mid;
+            best = trial;
+        }
+        else{
+            failSteps = mid;
+        }
+    }
+    result.reached = true;
+    result.trial = best;
+    return result;
+}
+
+/**
+ * @brief print the table, cheapest reached method first
+ *        ranked by pair interactions, which is what a force pass costs with every engine
+ *        and also counts the partial passes of block steps
+ *
+ * @param out output stream
+ * @param results one row per method
+ * @param target drift target
+ */
+void printTable(std::ostream &out, const std::vector<CostResult> &results, double target){
+    out << "Target relative energy drift: " << target << "\n";
+    out << std::left << std::setw(11) << "method" << std::right << std::setw(10) << "steps" << std::setw(13) << "dt" << std::setw(13) << "force_evals" << std::setw(13) << "pairs" << std::setw(13) << "drift" << std::setw(11) << "seconds" << "\n";
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const CostResult &r = results[k];
+        const CostTrial &t = r.trial;
+        out << std::left << std::setw(11) << r.method << std::right << std::setw(10) << t.steps << std::setw(13) << std::setprecision(4) << t.dt << std::setw(13) << t.forceEvals << std::setw(13) << static_cast<double>(t.pairs) << std::setw(13) << t.drift << std::setw(11) << t.seconds;
+        if(!r.reached){
+            out << "  not reached within --max-evals";
+        }
+        out << "\n";
+    }
+    if(!results.empty() && results[0].reached){
+        out << "Cheapest: " << results[0].method << "\n";
+    }
+}
+
+/**
+ * @brief write the table as csv
+ *
+ * @param path output file
+ * @param results one row per method
+ * @param target drift target
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool writeCsv(const std::string &path, const std::vector<CostResult> &results, double target){
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "method,target,reached,steps,dt,force_evals,pairs,drift,seconds,runs\n";
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const CostResult &r = results[k];
+        const CostTrial &t = r.trial;
+        out << r.method << "," << target << "," << (r.reached ? 1 : 0) << "," << t.steps << "," << t.dt << "," << t.forceEvals << "," << t.pairs << "," << t.drift << "," << t.seconds << "," << r.runs << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief load the initial condition, search every method and report
+ *
+ * @tparam T scalar type picked by the config's precision
+ * @param options command line settings
+ * @param cfg validated config
+ * @return int process exit code
+ */
+template<typename T>
+int runCost(const CostOptions &options, const SimulationConfig &cfg){
+    NBodySystem2D<T> loaded;
+    if(!loadBodies(cfg.bodiesFile, loaded, static_cast<std::size_t>(cfg.threads))){
+        return 1;
+    }
+    if(loaded.bodyCount() < 2){
+        std::cerr << "drift_cost needs at least two bodies.\n";
+        return 1;
+    }
+    const std::vector<Body2D<T>> initial = loaded.bodies();
+
+    std::vector<CostResult> results;
+    for(std::size_t k = 0; k < options.methods.size(); ++k){
+        const std::string &method = options.methods[k];
+        // same restrictions as validate() puts on the method key
+        if(method == "hermite" && cfg.forceEngine != "direct"){
+            std::cerr << "skipping hermite, it needs forceEngine = direct.\n";
+            continue;
+        }
+        if(method == "block" && cfg.eps2 <= static_cast<Real>(0)){
+            std::cerr << "skipping block, it needs eps2 > 0.\n";
+            continue;
+        }
+        results.push_back(searchMethod<T>(options, cfg, initial, method));
+    }
+
+    // reached first, then by cost
+    std::stable_sort(results.begin(), results.end(), [](const CostResult &a, const CostResult &b){
+        if(a.reached != b.reached){
+            return a.reached;
+        }
+        return a.trial.pairs < b.trial.pairs;
+    });
+    printTable(std::cout, results, options.target);
+    if(!options.outPath.empty()){
+        if(!writeCsv(options.outPath, results, options.target)){
+            std::cerr << "Could not open output file " << options.outPath << ".\n";
+            return 1;
+        }
+        std::cerr << "wrote " << results.size() << " methods to " << options.outPath << "\n";
+    }
+    return 0;
+}
+
+/**
+ * @brief print usage
+ *
+ */
+void printUsage(){
+    std::cerr << "usage: drift_cost <config.txt> [options]\n"
+              << "  bodiesFile, G, eps2, forceEngine, precision and the other run keys come from the config,\n"
+              << "  the span is dt * steps and steps is the first step count tried\n"
+              << "  --target X        largest relative energy drift (default 1e-6)\n"
+              << "  --methods LIST    euler,semieuler,verlet,leapfrog,block,yoshida,hermite\n"
+              << "                    (default verlet,leapfrog,yoshida,hermite)\n"
+              << "  --checks K        energy checks spread over the run (default 16)\n"
+              << "  --max-evals X     give a method up past the pair interactions of this many full force passes\n"
+              << "                    per trial (default 1e6)\n"
+              << "  --refine R        bisection rounds once the target is bracketed (default 6)\n"
+              << "  --out FILE        also write the table as csv\n";
+}
+
+/**
+ * @brief usage: drift_cost <config.txt> [--target X] [--methods LIST] [--checks K] [--max-evals X] [--refine R] [--out FILE]
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    CostOptions options;
+    options.target = 1e-6;
+    options.methods = splitList("verlet,leapfrog,yoshida,hermite");
+    options.checks = 16;
+    options.maxEvals = 1e6;
+    options.refine = 6;
+
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(arg == "--help" || arg == "-h"){
+            printUsage();
+            return 0;
+        }
+        else if(arg == "--target" && hasValue){
+            options.target = std::atof(argv[++i]);
+        }
+        else if(arg == "--methods" && hasValue){
+            options.methods = splitList(argv[++i]);
+        }
+        else if(arg == "--checks" && hasValue){
+            options.checks = std::atoi(argv[++i]);
+        }
+        else if(arg == "--max-evals" && hasValue){
+            options.maxEvals = std::atof(argv[++i]);
+        }
+        else if(arg == "--refine" && hasValue){
+            options.refine = std::atoi(argv[++i]);
+        }
+        else if(arg == "--out" && hasValue){
+            options.outPath = argv[++i];
+        }
+        else if(!arg.empty() && arg[0] != '-' && options.configPath.empty()){
+            options.configPath = arg;
+        }
+        else{
+            std::cerr << "unknown option " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if(options.configPath.empty()){
+        printUsage();
+        return 1;
+    }
+    if(options.target <= 0.0 || options.checks < 1 || options.maxEvals <= 0.0 || options.refine < 0){
+        std::cerr << "--target and --max-evals must be greater than 0, --checks at least 1, --refine not negative.\n";
+        return 1;
+    }
+    for(std::size_t k = 0; k < options.methods.size(); ++k){
+        const std::string &m = options.methods[k];
+        if(m != "euler" && m != "semieuler" && m != "verlet" && m != "leapfrog" && m != "block" && m != "yoshida" && m != "hermite"){
+            std::cerr << "Method must be 'euler' or 'semieuler' or 'verlet' or 'leapfrog' or 'block' or 'yoshida' or 'hermite'.\n";
+            return 1;
+        }
+    }
+
+    SimulationConfig cfg;
+    if(!cfg.loadFromFile(options.configPath)){
+        std::cerr << "Failed to load config file: " << options.configPath << "\n";
+        return 1;
+    }
+    if(!cfg.validate(std::cerr)){
+        return 1;
+    }
+
+    if(cfg.precision == "float"){
+        return runCost<float>(options, cfg);
+    }
+    if(cfg.precision == "double"){
+        return runCost<double>(options, cfg);
+    }
+    return runCost<long double>(options, cfg);
+}
@@ -0,0 +1,723 @@
+// ensemble, many variants of one run in a single process, spread over the cores with work stealing
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "body2d.hpp"
+#include "body_io.h"
+#include "nbody_system2d.h"
+#include "run_logger.h"
+#include "simd_kernels.h"
+#include "simulation_config.h"
+#include "work_stealing_scheduler.h"
+
+/**
+ * @brief command line settings of one ensemble run
+ *
+ */
+struct EnsembleOptions{
+    std::string configPath; // base config, every member starts from it
+    std::vector<std::pair<std::string, std::vector<std::string>>> axes; // swept config keys and their values, members are the full grid
+    int seeds; // copies of every grid point, copy 0 unperturbed, the others with perturbed initial conditions
+    double perturb; // perturbation size relative to the rms radius and rms speed of the bodies
+    std::size_t jobs; // worker threads, 0 = all hardware threads
+    std::string outDir; // per-member trajectories and the summary
+    std::string summaryPath; // summary csv, empty = outDir/summary.csv
+    bool writeTrajectories; // false = only the summary
+};
+
+/**
+ * @brief one variant, the base config with the axis values of its grid point applied
+ *
+ */
+struct EnsembleMember{
+    std::size_t id; // position in the grid, names the output file
+    std::vector<std::string> values; // one value per axis
+    int seed; // 0 = initial conditions as loaded
+    SimulationConfig cfg; // config of the member, outTrajFile and a set collisionLog already point into outDir
+    std::string method; // lower-case method name
+    std::size_t bodyCount; // N of the bodies file, for the cost estimate
+};
+
+/**
+ * @brief what a member run produced, filled by the thread that ran it
+ *
+ */
+struct MemberResult{
+    std::string status; // ok, invalid, nan, or the error
+    double finalDrift; // |E(end) - E(0)| / |E(0)|
+    double maxDrift; // largest drift at the logged frames, the final one included
+    double seconds; // wall time of the stepping, logging included
+    unsigned long long pairs; // direct-sum equivalent pair interactions
+    std::size_t collisions; // collision events, 0 with collisions = off
+    std::size_t thread; // scheduler thread that ran it
+};
+
+/**
+ * @brief split a comma separated list and trim the entries, empty entries are dropped
+ *
+ * @param value list text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &value){
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        const std::size_t first = item.find_first_not_of(" \t\r");
+        if(first == std::string::npos){
+            continue;
+        }
+        const std::size_t last = item.find_last_not_of(" \t\r");
+        out.push_back(item.substr(first, last - first + 1));
+    }
+    return out;
+}
+
+/**
+ * @brief parse KEY=V1,V2,... into a sweep axis
+ *
+ * @param text axis text, spaces around the key and values are allowed
+ * @param options receives the axis
+ * @return true if the text had a key and at least one value
+ * @return false otherwise
+ */
+bool addAxis(const std::string &text, EnsembleOptions &options){
+    const std::size_t eqPos = text.find('=');
+    if(eqPos == std::string::npos){
+        return false;
+    }
+    const std::vector<std::string> key = splitList(text.substr(0, eqPos));
+    const std::vector<std::string> values = splitList(text.substr(eqPos + 1));
+    if(key.size() != 1 || values.empty()){
+        return false;
+    }
+    options.axes.push_back(std::make_pair(key[0], values));
+    return true;
+}
+
+/**
+ * @brief read sweep axes from a file, one KEY = V1, V2, ... per line, '#' comments and blank lines ignored
+ *
+ * @param path spec file
+ * @param options receives the axes
+ * @return true if the file was read and every line parsed
+ * @return false otherwise
+ */
+bool loadSpec(const std::string &path, EnsembleOptions &options){
+    std::ifstream input(path);
+    if(!input){
+        std::cerr << "Could not open sweep spec " << path << ".\n";
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while(std::getline(input, line)){
+        ++lineNumber;
+        const std::size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos || line[first] == '#'){
+            continue;
+        }
+        if(!addAxis(line, options)){
+            std::cerr << path << ":" << lineNumber << ": expected KEY = V1, V2, ...\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief shift every position and velocity by a gaussian kick
+ *        sized relative to the rms radius and rms speed, so the same perturb works for any units
+ *
+ * @tparam T scalar type of the run
+ * @param bodies bodies to perturb
+ * @param seed random seed, the same seed perturbs every grid point alike
+ * @param perturb relative size of the kick
+ */
+template<typename T>
+void perturbBodies(std::vector<Body2D<T>> &bodies, int seed, double perturb){
+    long double r2 = 0.0L;
+    long double v2 = 0.0L;
+    for(std::size_t i = 0; i < bodies.size(); ++i){
+        r2 += static_cast<long double>(bodies[i].r.x * bodies[i].r.x + bodies[i].r.y * bodies[i].r.y);
+        v2 += static_cast<long double>(bodies[i].v.x * bodies[i].v.x + bodies[i].v.y * bodies[i].v.y);
+    }
+    const long double count = static_cast<long double>(std::max<std::size_t>(1, bodies.size()));
+    const double rScale = perturb * static_cast<double>(std::sqrt(r2 / count));
+    const double vScale = perturb * static_cast<double>(std::sqrt(v2 / count));
+    std::mt19937_64 rng(static_cast<std::mt19937_64::result_type>(seed));
+    std::normal_distribution<double> kick(0.0, 1.0);
+    for(std::size_t i = 0; i < bodies.size(); ++i){
+        bodies[i].r.x += static_cast<T>(rScale * kick(rng));
+        bodies[i].r.y += static_cast<T>(rScale * kick(rng));
+        bodies[i].v.x += static_cast<T>(vScale * kick(rng));
+        bodies[i].v.y += static_cast<T>(vScale * kick(rng));
+    }
+}
+
+/**
+ * @brief run one member to the end on the calling thread, same stepping and logging as a headless NBodySimulator run
+ *
+ * @tparam T scalar type picked by the member's precision
+ * @param member member to run
+ * @param options perturbation size and trajectory switch
+ * @param result filled with the status, drift, time and pair count
+ */
+template<typename T>
+void runMember(const EnsembleMember &member, const EnsembleOptions &options, MemberResult &result){
+    const SimulationConfig &cfg = member.cfg;
+    NBodySystem2D<T> system(static_cast<T>(cfg.G), static_cast<T>(cfg.eps2));
+    if(cfg.storage == "soa"){
+        system.setStorageMode(StorageMode::SoA);
+    }
+    if(cfg.forceEngine == "barneshut"){
+        system.setForceEngine(ForceEngine::BarnesHut);
+    }
+    else if(cfg.forceEngine == "fmm"){
+        system.setForceEngine(ForceEngine::Fmm);
+    }
+    else if(cfg.forceEngine == "pm"){
+        system.setForceEngine(ForceEngine::Pm);
+    }
+    system.setTheta(static_cast<T>(cfg.theta));
+    system.setFmmOrder(cfg.fmmOrder);
+    system.setPmGrid(static_cast<std::size_t>(cfg.pmGrid), cfg.pmAssign == "tsc" ? PmAssignment::Tsc : PmAssignment::Cic);
+    system.setPmBoundary(cfg.pmBoundary == "periodic" ? PmBoundary::Periodic : PmBoundary::Isolated, static_cast<T>(cfg.pmBoxSize));
+    system.setBlockLevels(cfg.blockLevels);
+    system.setBlockEta(static_cast<T>(cfg.blockEta));
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    parseSimdLevel(cfg.simd, simdLevel);
+    system.setSimdLevel(simdLevel);
+    system.setFastRsqrt(cfg.fastRsqrt);
+    system.setFloatPairs(cfg.forcePrecision == "float");
+    // the ensemble is parallel across members, each one steps on its own thread
+    system.setThreadCount(1);
+
+    // loaded in the member's own precision, so seed 0 matches a stand-alone run bit for bit
+    NBodySystem2D<T> loaded;
+    if(!loadBodies(cfg.bodiesFile, loaded)){
+        result.status = "load failed";
+        return;
+    }
+    std::vector<Body2D<T>> initial = loaded.bodies();
+    if(member.seed > 0){
+        perturbBodies(initial, member.seed, options.perturb);
+    }
+    system.addBodies(initial.data(), initial.size());
+
+    // collision radii from the radii file or one radius for all, as in a headless run
+    CollisionMode collisionMode = CollisionMode::Off;
+    if(cfg.collisions == "detect"){
+        collisionMode = CollisionMode::Detect;
+    }
+    else if(cfg.collisions == "merge"){
+        collisionMode = CollisionMode::Merge;
+    }
+    if(collisionMode != CollisionMode::Off){
+        std::vector<T> radii;
+        if(!cfg.radiiFile.empty()){
+            if(!loadRadii(cfg.radiiFile, radii)){
+                result.status = "could not load " + cfg.radiiFile;
+                return;
+            }
+            if(radii.size() != system.bodyCount()){
+                result.status = cfg.radiiFile + " does not match the bodies";
+                return;
+            }
+        }
+        else{
+            radii.assign(system.bodyCount(), static_cast<T>(cfg.collisionRadius));
+        }
+        system.setRadii(radii);
+    }
+    std::ofstream collisionOut;
+    if(collisionMode != CollisionMode::Off && options.writeTrajectories && !cfg.collisionLog.empty()){
+        collisionOut.open(cfg.collisionLog);
+        if(!collisionOut){
+            result.status = "could not open " + cfg.collisionLog;
+            return;
+        }
+        collisionOut << "t,body_a,body_b\n";
+    }
+    std::vector<CollisionEvent> collisionEvents;
+
+    RunLogger logger;
+    if(options.writeTrajectories){
+        logger.setCompression(static_cast<double>(cfg.compressPosError), static_cast<double>(cfg.compressVelError), static_cast<unsigned int>(cfg.keyframeEvery));
+        if(!logger.open(cfg.outTrajFile, cfg.outFormat == "binary" ? LogFormat::Binary : (cfg.outFormat == "compressed" ? LogFormat::Compressed : LogFormat::Csv))){
+            result.status = "could not open " + cfg.outTrajFile;
+            return;
+        }
+        logger.writeHeader(system, cfg.includeEnergy, cfg.outputEvery, static_cast<double>(cfg.dt));
+    }
+
+    // energies in long double, as in tools/drift_cost
+    T t = static_cast<T>(0);
+    const T dt = static_cast<T>(cfg.dt);
+    const T e0 = system.totalEnergy();
+    const long double scale = std::fabs(static_cast<long double>(e0)) > 0.0L ? std::fabs(static_cast<long double>(e0)) : 1.0L;
+    const auto drift = [&](T energy){
+        return static_cast<double>(std::fabs(static_cast<long double>(energy) - static_cast<long double>(e0)) / scale);
+    };
+    if(options.writeTrajectories){
+        if(cfg.includeEnergy){
+            logger.logStateWithEnergy(t, system, e0);
+        }
+        else{
+            logger.logState(t, system, false);
+        }
+    }
+
+    const unsigned long long pairsStart = system.pairInteractions();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result.maxDrift = 0.0;
+    result.collisions = 0;
+    for(long long step = 1; step <= cfg.steps; ++step){
+        // the energy is needed at logged frames and at the end
+        const bool energyStep = step == cfg.steps || (cfg.includeEnergy && step % cfg.outputEvery == 0);
+        system.setTrackPotential(energyStep);
+        if(member.method == "euler"){
+            system.stepEuler(dt);
+        }
+        else if(member.method == "semieuler"){
+            system.stepSemiEuler(dt);
+        }
+        else if(member.method == "leapfrog"){
+            system.stepLeapfrog(dt);
+        }
+        else if(member.method == "block"){
+            system.stepBlock(dt);
+        }
+        else if(member.method == "yoshida"){
+            system.stepYoshida(dt);
+        }
+        else if(member.method == "hermite"){
+            system.stepHermite(dt);
+        }
+        else{
+            system.stepVerlet(dt);
+        }
+        t += dt;
+
+        // every body is synchronized between steps, merged bodies are gone before the energy and the frame
+        if(collisionMode != CollisionMode::Off){
+            system.resolveCollisions(collisionMode, collisionEvents);
+            result.collisions += collisionEvents.size();
+            if(collisionOut.is_open()){
+                // body numbers as in the trajectory columns
+                for(std::size_t k = 0; k < collisionEvents.size(); ++k){
+                    collisionOut << t << "," << collisionEvents[k].idA + 1 << "," << collisionEvents[k].idB + 1 << "\n";
+                }
+            }
+        }
+
+        T energy = static_cast<T>(0);
+        if(energyStep){
+            energy = system.totalEnergy();
+            const double d = drift(energy);
+            // a blown-up run reports nan, which must count as the worst drift
+            result.maxDrift = std::isfinite(d) ? std::max(result.maxDrift, d) : HUGE_VAL;
+            if(step == cfg.steps){
+                result.finalDrift = std::isfinite(d) ? d : HUGE_VAL;
+            }
+        }
+        if(options.writeTrajectories && step % cfg.outputEvery == 0){
+            if(cfg.includeEnergy){
+                logger.logStateWithEnergy(t, system, energy);
+            }
+            else{
+                logger.logState(t, system, false);
+            }
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.pairs = system.pairInteractions() - pairsStart;
+    if(options.writeTrajectories){
+        logger.close();
+    }
+    result.status = std::isfinite(result.finalDrift) ? "ok" : "nan";
+}
+
+/**
+ * @brief relative cost of a member for the scheduler, force passes times the pair work of one pass
+ *
+ * @param member member to estimate
+ * @return double
+ */
+double estimateCost(const EnsembleMember &member){
+    const double n = static_cast<double>(std::max<std::size_t>(2, member.bodyCount));
+    double passCost = 0.5 * n * n;
+    if(member.cfg.forceEngine == "barneshut"){
+        passCost = std::min(passCost, 20.0 * n * std::log2(n));
+    }
+    else if(member.cfg.forceEngine == "fmm"){
+        passCost = std::min(passCost, 40.0 * n);
+    }
+    else if(member.cfg.forceEngine == "pm"){
+        // assignment and interpolation per body, plus the transforms of the padded grid
+        const double cells = member.cfg.pmBoundary == "periodic" ? static_cast<double>(member.cfg.pmGrid) : 2.0 * static_cast<double>(member.cfg.pmGrid);
+        passCost = std::min(passCost, 20.0 * n + 4.0 * cells * cells * std::log2(cells));
+    }
+    // force passes per step, yoshida takes three leapfrog steps, hermite two direct passes with the jerk
+    double passes = 1.0;
+    if(member.method == "yoshida"){
+        passes = 3.0;
+    }
+    else if(member.method == "hermite"){
+        passes = 2.0;
+    }
+    return passCost * passes * static_cast<double>(member.cfg.steps);
+}
+
+/**
+ * @brief build every member of the grid, invalid members are reported and marked
+ *
+ * @param options axes, seeds and output directory
+ * @param base base config
+ * @param members filled with one entry per grid point and seed
+ * @param results filled with one entry per member, invalid ones already marked
+ * @return true if every axis names a known config key
+ * @return false otherwise
+ */
+bool buildMembers(const EnsembleOptions &options, const SimulationConfig &base, std::vector<EnsembleMember> &members, std::vector<MemberResult> &results){
+    std::size_t gridSize = 1;
+    for(std::size_t a = 0; a < options.axes.size(); ++a){
+        gridSize *= options.axes[a].second.size();
+    }
+    const std::size_t total = gridSize * static_cast<std::size_t>(options.seeds);
+    std::map<std::string, std::size_t> bodyCounts;
+    for(std::size_t id = 0; id < total; ++id){
+        EnsembleMember member;
+        member.id = id;
+        member.seed = static_cast<int>(id % static_cast<std::size_t>(options.seeds));
+        member.cfg = base;
+        // last axis varies fastest
+        std::size_t point = id / static_cast<std::size_t>(options.seeds);
+        member.values.resize(options.axes.size());
+        for(std::size_t a = options.axes.size(); a-- > 0;){
+            const std::vector<std::string> &values = options.axes[a].second;
+            member.values[a] = values[point % values.size()];
+            point /= values.size();
+        }
+
+        MemberResult result;
+        result.status = "ok";
+        result.finalDrift = 0.0;
+        result.maxDrift = 0.0;
+        result.seconds = 0.0;
+        result.pairs = 0;
+        result.collisions = 0;
+        result.thread = 0;
+        std::ostringstream errors;
+        for(std::size_t a = 0; a < options.axes.size(); ++a){
+            try{
+                if(!member.cfg.setValue(options.axes[a].first, member.values[a])){
+                    std::cerr << "Unknown config key " << options.axes[a].first << " in the sweep.\n";
+                    return false;
+                }
+            }
+            catch(const std::exception &){
+                errors << options.axes[a].first << " = " << member.values[a] << " is not a number.\n";
+            }
+        }
+
+        std::ostringstream name;
+        name << "member_" << std::setw(4) << std::setfill('0') << id << (member.cfg.outFormat == "binary" ? ".bin" : (member.cfg.outFormat == "compressed" ? ".ctrj" : ".csv"));
+        member.cfg.outTrajFile = (std::filesystem::path(options.outDir) / name.str()).string();
+        if(!member.cfg.collisionLog.empty()){
+            std::ostringstream logName;
+            logName << "member_" << std::setw(4) << std::setfill('0') << id << "_collisions.csv";
+            member.cfg.collisionLog = (std::filesystem::path(options.outDir) / logName.str()).string();
+        }
+        member.method = member.cfg.method;
+        for(std::size_t i = 0; i < member.method.size(); ++i){
+            member.method[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(member.method[i])));
+        }
+        member.cfg.method = member.method;
+        member.bodyCount = 0;
+
+        if(errors.str().empty() && member.cfg.validate(errors)){
+            // bodies files are only opened here to learn N, members load them again in their own precision
+            const std::map<std::string, std::size_t>::const_iterator found = bodyCounts.find(member.cfg.bodiesFile);
+            if(found != bodyCounts.end()){
+                member.bodyCount = found->second;
+            }
+            else{
+                NBodySystem2D<double> probe;
+                member.bodyCount = loadBodies(member.cfg.bodiesFile, probe) ? probe.bodyCount() : 0;
+                bodyCounts[member.cfg.bodiesFile] = member.bodyCount;
+            }
+            if(member.bodyCount == 0){
+                errors << "no bodies loaded from " << member.cfg.bodiesFile << ".\n";
+            }
+        }
+        if(!errors.str().empty()){
+            std::cerr << "skipping member " << id << ":\n" << errors.str();
+            result.status = "invalid";
+        }
+        members.push_back(member);
+        results.push_back(result);
+    }
+    return true;
+}
+
+/**
+ * @brief print the summary, one row per member in grid order
+ *        every axis column is one wider than its key or its longest value, so long names stay apart
+ *
+ * @param out output stream
+ * @param options axes
+ * @param members members
+ * @param results results
+ */
+void printTable(std::ostream &out, const EnsembleOptions &options, const std::vector<EnsembleMember> &members, const std::vector<MemberResult> &results){
+    std::vector<int> widths(options.axes.size());
+    for(std::size_t a = 0; a < options.axes.size(); ++a){
+        std::size_t width = options.axes[a].first.size();
+        for(std::size_t k = 0; k < members.size(); ++k){
+            width = std::max(width, members[k].values[a].size());
+        }
+        widths[a] = static_cast<int>(width + 1);
+    }
+    out << std::left << std::setw(8) << "member";
+    for(std::size_t a = 0; a < options.axes.size(); ++a){
+        out << std::setw(widths[a]) << options.axes[a].first;
+    }
+    out << std::right << std::setw(6) << "seed" << std::setw(8) << "N" << std::setw(10) << "steps" << std::setw(13) << "final_drift" << std::setw(13) << "max_drift" << std::setw(11) << "seconds" << std::setw(8) << "thread" << "  status\n";
+    for(std::size_t k = 0; k < members.size(); ++k){
+        const EnsembleMember &m = members[k];
+        const MemberResult &r = results[k];
+        out << std::left << std::setw(8) << m.id;
+        for(std::size_t a = 0; a < m.values.size(); ++a){
+            out << std::setw(widths[a]) << m.values[a];
+        }
+        out << std::right << std::setw(6) << m.seed << std::setw(8) << m.bodyCount << std::setw(10) << m.cfg.steps << std::setprecision(4) << std::setw(13) << r.finalDrift << std::setw(13) << r.maxDrift << std::setw(11) << r.seconds << std::setw(8) << r.thread << "  " << r.status << "\n";
+    }
+}
+
+/**
+ * @brief write the summary as csv, one row per member
+ *
+ * @param path output file
+ * @param options axes
+ * @param members members
+ * @param results results
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool writeSummary(const std::string &path, const EnsembleOptions &options, const std::vector<EnsembleMember> &members, const std::vector<MemberResult> &results){
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "member";
+    for(std::size_t a = 0; a < options.axes.size(); ++a){
+        out << "," << options.axes[a].first;
+    }
+    out << ",seed,N,steps,final_drift,max_drift,seconds,steps_per_second,pairs,collisions,thread,status,trajectory\n";
+    for(std::size_t k = 0; k < members.size(); ++k){
+        const EnsembleMember &m = members[k];
+        const MemberResult &r = results[k];
+        out << m.id;
+        for(std::size_t a = 0; a < m.values.size(); ++a){
+            out << "," << m.values[a];
+        }
+        const double stepsPerSecond = r.seconds > 0.0 ? static_cast<double>(m.cfg.steps) / r.seconds : 0.0;
+        out << "," << m.seed << "," << m.bodyCount << "," << m.cfg.steps << "," << r.finalDrift << "," << r.maxDrift << "," << r.seconds << "," << stepsPerSecond << "," << r.pairs << "," << r.collisions << "," << r.thread << "," << r.status << "," << (options.writeTrajectories && r.status != "invalid" ? m.cfg.outTrajFile : "") << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief build the members, run them on the scheduler and report
+ *
+ * @param options command line settings
+ * @param base validated base config
+ * @return int process exit code, 1 if any member did not finish cleanly
+ */
+int runEnsemble(const EnsembleOptions &options, const SimulationConfig &base){
+    std::vector<EnsembleMember> members;
+    std::vector<MemberResult> results;
+    if(!buildMembers(options, base, members, results)){
+        return 1;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(options.outDir, ec);
+    if(ec){
+        std::cerr << "Could not create " << options.outDir << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    // only valid members are scheduled
+    std::vector<std::size_t> runnable;
+    std::vector<double> costs;
+    for(std::size_t k = 0; k < members.size(); ++k){
+        if(results[k].status != "invalid"){
+            runnable.push_back(k);
+            costs.push_back(estimateCost(members[k]));
+        }
+    }
+
+    WorkStealingScheduler scheduler(options.jobs);
+    std::cerr << "running " << runnable.size() << " of " << members.size() << " members on " << scheduler.threadCount() << " threads\n";
+    std::mutex printMutex;
+    std::size_t finished = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    scheduler.run(costs, [&](std::size_t task, std::size_t thread){
+        const EnsembleMember &member = members[runnable[task]];
+        MemberResult &result = results[runnable[task]];
+        result.thread = thread;
+        try{
+            if(member.cfg.precision == "float"){
+                runMember<float>(member, options, result);
+            }
+            else if(member.cfg.precision == "double"){
+                runMember<double>(member, options, result);
+            }
+            else{
+                runMember<long double>(member, options, result);
+            }
+        }
+        catch(const std::exception &e){
+            result.status = e.what();
+        }
+        std::lock_guard<std::mutex> lock(printMutex);
+        ++finished;
+        std::cerr << "  [" << finished << "/" << runnable.size() << "] member " << member.id << " " << result.status << " in " << result.seconds << " s, drift " << result.finalDrift << "\n";
+    });
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printTable(std::cout, options, members, results);
+    double busy = 0.0;
+    const std::vector<WorkerStats> &stats = scheduler.workerStats();
+    for(std::size_t i = 0; i < stats.size(); ++i){
+        busy += stats[i].busySeconds;
+    }
+    std::cout << "Wall time: " << wall << " s, member time: " << busy << " s (" << (wall > 0.0 ? busy / wall : 0.0) << "x), steals: " << scheduler.steals() << "\n";
+
+    const std::string summaryPath = options.summaryPath.empty() ? (std::filesystem::path(options.outDir) / "summary.csv").string() : options.summaryPath;
+    if(!writeSummary(summaryPath, options, members, results)){
+        std::cerr << "Could not open output file " << summaryPath << ".\n";
+        return 1;
+    }
+    std::cerr << "wrote " << members.size() << " members to " << summaryPath << "\n";
+    for(std::size_t k = 0; k < results.size(); ++k){
+        if(results[k].status != "ok"){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief print usage
+ *
+ */
+void printUsage(){
+    std::cerr << "usage: ensemble <config.txt> [options]\n"
+              << "  every member starts from the config, the sweep overrides keys of it\n"
+              << "  --sweep KEY=V1,V2,...  vary a config key, repeat for a grid over several keys\n"
+              << "  --spec FILE            sweep lines KEY = V1, V2, ... from a file\n"
+              << "  --seeds K              copies of every grid point, 1..K-1 with perturbed bodies (default 1)\n"
+              << "  --perturb X            kick size relative to the rms radius and speed (default 1e-6)\n"
+              << "  --jobs J               worker threads, 0 = all hardware threads (default 0)\n"
+              << "  --out-dir DIR          member trajectories and summary.csv (default ensemble)\n"
+              << "  --summary FILE         summary csv instead of DIR/summary.csv\n"
+              << "  --no-traj              only write the summary\n";
+}
+
+/**
+ * @brief usage: ensemble <config.txt> [--sweep KEY=LIST]... [--spec FILE] [--seeds K] [--perturb X] [--jobs J] [--out-dir DIR] [--summary FILE] [--no-traj]
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    EnsembleOptions options;
+    options.seeds = 1;
+    options.perturb = 1e-6;
+    options.jobs = 0;
+    options.outDir = "ensemble";
+    options.writeTrajectories = true;
+
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(arg == "--help" || arg == "-h"){
+            printUsage();
+            return 0;
+        }
+        else if(arg == "--sweep" && hasValue){
+            const std::string axis = argv[++i];
+            if(!addAxis(axis, options)){
+                std::cerr << "--sweep expects KEY=V1,V2,..., got " << axis << "\n";
+                return 1;
+            }
+        }
+        else if(arg == "--spec" && hasValue){
+            if(!loadSpec(argv[++i], options)){
+                return 1;
+            }
+        }
+        else if(arg == "--seeds" && hasValue){
+            options.seeds = std::atoi(argv[++i]);
+        }
+        else if(arg == "--perturb" && hasValue){
+            options.perturb = std::atof(argv[++i]);
+        }
+        else if(arg == "--jobs" && hasValue){
+            options.jobs = static_cast<std::size_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if(arg == "--out-dir" && hasValue){
+            options.outDir = argv[++i];
+        }
+        else if(arg == "--summary" && hasValue){
+            options.summaryPath = argv[++i];
+        }
+        else if(arg == "--no-traj"){
+            options.writeTrajectories = false;
+        }
+        else if(!arg.empty() && arg[0] != '-' && options.configPath.empty()){
+            options.configPath = arg;
+        }
+        else{
+            std::cerr << "unknown option " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if(options.configPath.empty()){
+        printUsage();
+        return 1;
+    }
+    if(options.seeds < 1 || options.perturb < 0.0){
+        std::cerr << "--seeds must be at least 1 and --perturb not negative.\n";
+        return 1;
+    }
+
+    SimulationConfig cfg;
+    if(!cfg.loadFromFile(options.configPath)){
+        std::cerr << "Failed to load config file: " << options.configPath << "\n";
+        return 1;
+    }
+    return runEnsemble(options, cfg);
+}
@@ -0,0 +1,301 @@
+// pm_accuracy, particle-mesh force error against the direct sum and time per pass for a sweep of grids
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "body2d.hpp"
+#include "body_io.h"
+#include "nbody_system2d.h"
+#include "pm2d.h"
+#include "simulation_config.h"
+
+/**
+ * @brief command line settings of one pm_accuracy run
+ *
+ */
+struct SweepOptions{
+    std::string configPath; // config with the bodies, G, eps2, pmBoundary, pmBoxSize, precision and threads
+    std::vector<std::size_t> grids; // cells per side to try
+    std::vector<std::string> assignments; // cic, tsc
+    int samples; // bodies checked against the direct sum
+    double target; // rms relative force error the recommendation has to meet
+    double minSeconds; // force passes are repeated until they took at least this long
+    std::string outPath; // csv output, empty = none
+};
+
+/**
+ * @brief error and cost of one grid
+ *
+ */
+struct GridResult{
+    std::size_t grid; // cells per side
+    std::string assignment; // cic or tsc
+    double cell; // cell size of the last pass
+    double smoothing; // smoothing length of the last pass
+    ForceErrorReport error; // error against the direct sum
+    double secondsPerPass; // wall time of one force pass
+};
+
+/**
+ * @brief split a comma separated list, empty entries are dropped
+ *
+ * @param value list text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &value){
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        if(!item.empty()){
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief measure one grid: error once, then time passes until minSeconds
+ *        the first pass builds the kernel transforms and is not timed
+ *
+ * @tparam T scalar type picked by the config's precision
+ * @param options command line settings
+ * @param cfg validated config
+ * @param initial bodies
+ * @param grid cells per side
+ * @param assignment cic or tsc
+ * @return GridResult
+ */
+template<typename T>
+GridResult measureGrid(const SweepOptions &options, const SimulationConfig &cfg, const std::vector<Body2D<T>> &initial, std::size_t grid, const std::string &assignment){
+    NBodySystem2D<T> system(static_cast<T>(cfg.G), static_cast<T>(cfg.eps2));
+    system.setStorageMode(StorageMode::SoA);
+    system.setForceEngine(ForceEngine::Pm);
+    system.setPmGrid(grid, assignment == "tsc" ? PmAssignment::Tsc : PmAssignment::Cic);
+    system.setPmBoundary(cfg.pmBoundary == "periodic" ? PmBoundary::Periodic : PmBoundary::Isolated, static_cast<T>(cfg.pmBoxSize));
+    system.setThreadCount(static_cast<std::size_t>(cfg.threads));
+    system.addBodies(initial.data(), initial.size());
+
+    GridResult result;
+    result.grid = system.pmSolver().getGridSize();
+    result.assignment = assignment;
+    result.error = system.measureForceError(static_cast<std::size_t>(options.samples));
+    result.cell = static_cast<double>(system.pmSolver().cellSize());
+    result.smoothing = static_cast<double>(system.pmSolver().smoothingLength());
+
+    // setEps2 drops the carried forces, so every computeForces() is a full pass
+    long long passes = 0;
+    double seconds = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    do{
+        system.setEps2(static_cast<T>(cfg.eps2));
+        system.computeForces();
+        ++passes;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while(seconds < options.minSeconds);
+    result.secondsPerPass = seconds / static_cast<double>(passes);
+    return result;
+}
+
+/**
+ * @brief print the table and the cheapest grid meeting the target
+ *
+ * @param out output stream
+ * @param results one row per grid and assignment
+ * @param target rms error target
+ */
+void printTable(std::ostream &out, const std::vector<GridResult> &results, double target){
+    out << std::left << std::setw(7) << "grid" << std::setw(8) << "assign" << std::right << std::setw(13) << "cell" << std::setw(13) << "smoothing" << std::setw(13) << "rms_error" << std::setw(13) << "max_error" << std::setw(13) << "s_per_pass" << "\n";
+    const GridResult *best = nullptr;
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const GridResult &r = results[k];
+        out << std::left << std::setw(7) << r.grid << std::setw(8) << r.assignment << std::right << std::setprecision(4) << std::setw(13) << r.cell << std::setw(13) << r.smoothing << std::setw(13) << r.error.rmsRelError << std::setw(13) << r.error.maxRelError << std::setw(13) << r.secondsPerPass << "\n";
+        if(r.error.rmsRelError <= target && (!best || r.secondsPerPass < best->secondsPerPass)){
+            best = &r;
+        }
+    }
+    if(best){
+        out << "Cheapest with rms error <= " << target << ": pmGrid = " << best->grid << ", pmAssign = " << best->assignment << "\n";
+    }
+    else{
+        out << "No grid reached rms error <= " << target << ", try larger grids or a larger eps2\n";
+    }
+}
+
+/**
+ * @brief write the table as csv
+ *
+ * @param path output file
+ * @param results one row per grid and assignment
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool writeCsv(const std::string &path, const std::vector<GridResult> &results){
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "grid,assign,cell,smoothing,samples,rms_error,max_error,seconds_per_pass\n";
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const GridResult &r = results[k];
+        out << r.grid << "," << r.assignment << "," << r.cell << "," << r.smoothing << "," << r.error.samples << "," << r.error.rmsRelError << "," << r.error.maxRelError << "," << r.secondsPerPass << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief load the bodies, measure every grid and assignment and report
+ *
+ * @tparam T scalar type picked by the config's precision
+ * @param options command line settings
+ * @param cfg validated config
+ * @return int process exit code
+ */
+template<typename T>
+int runSweep(const SweepOptions &options, const SimulationConfig &cfg){
+    NBodySystem2D<T> loaded;
+    if(!loadBodies(cfg.bodiesFile, loaded, static_cast<std::size_t>(cfg.threads))){
+        return 1;
+    }
+    if(loaded.bodyCount() < 2){
+        std::cerr << "pm_accuracy needs at least two bodies.\n";
+        return 1;
+    }
+    const std::vector<Body2D<T>> initial = loaded.bodies();
+    std::cout << loaded.bodyCount() << " bodies, eps2 = " << static_cast<double>(cfg.eps2) << ", " << cfg.pmBoundary << " boundary, error of " << options.samples << " bodies against the direct sum\n";
+
+    std::vector<GridResult> results;
+    for(std::size_t g = 0; g < options.grids.size(); ++g){
+        for(std::size_t a = 0; a < options.assignments.size(); ++a){
+            results.push_back(measureGrid<T>(options, cfg, initial, options.grids[g], options.assignments[a]));
+        }
+    }
+    printTable(std::cout, results, options.target);
+    if(!options.outPath.empty()){
+        if(!writeCsv(options.outPath, results)){
+            std::cerr << "Could not open output file " << options.outPath << ".\n";
+            return 1;
+        }
+        std::cerr << "wrote " << results.size() << " grids to " << options.outPath << "\n";
+    }
+    return 0;
+}
+
+/**
+ * @brief print usage
+ *
+ */
+void printUsage(){
+    std::cerr << "usage: pm_accuracy <config.txt> [options]\n"
+              << "  bodiesFile, G, eps2, pmBoundary, pmBoxSize, precision and threads come from the config\n"
+              << "  --grids LIST        cells per side, powers of two (default 64,128,256,512,1024)\n"
+              << "  --assign LIST       cic,tsc (default both)\n"
+              << "  --samples K         bodies checked against the direct sum (default 256)\n"
+              << "  --target X          rms relative force error to recommend a grid for (default 1e-2)\n"
+              << "  --min-seconds S     repeat force passes until they took this long (default 0.2)\n"
+              << "  --out FILE          also write the table as csv\n";
+}
+
+/**
+ * @brief usage: pm_accuracy <config.txt> [--grids LIST] [--assign LIST] [--samples K] [--target X] [--min-seconds S] [--out FILE]
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    SweepOptions options;
+    std::vector<std::string> grids = splitList("64,128,256,512,1024");
+    options.assignments = splitList("cic,tsc");
+    options.samples = 256;
+    options.target = 1e-2;
+    options.minSeconds = 0.2;
+
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(arg == "--help" || arg == "-h"){
+            printUsage();
+            return 0;
+        }
+        else if(arg == "--grids" && hasValue){
+            grids = splitList(argv[++i]);
+        }
+        else if(arg == "--assign" && hasValue){
+            options.assignments = splitList(argv[++i]);
+        }
+        else if(arg == "--samples" && hasValue){
+            options.samples = std::atoi(argv[++i]);
+        }
+        else if(arg == "--target" && hasValue){
+            options.target = std::atof(argv[++i]);
+        }
+        else if(arg == "--min-seconds" && hasValue){
+            options.minSeconds = std::atof(argv[++i]);
+        }
+        else if(arg == "--out" && hasValue){
+            options.outPath = argv[++i];
+        }
+        else if(!arg.empty() && arg[0] != '-' && options.configPath.empty()){
+            options.configPath = arg;
+        }
+        else{
+            std::cerr << "unknown option " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if(options.configPath.empty()){
+        printUsage();
+        return 1;
+    }
+    if(options.samples < 1 || options.target <= 0.0 || options.minSeconds < 0.0){
+        std::cerr << "--samples must be at least 1, --target greater than 0, --min-seconds not negative.\n";
+        return 1;
+    }
+    for(std::size_t k = 0; k < grids.size(); ++k){
+        const long grid = std::atol(grids[k].c_str());
+        if(grid < static_cast<long>(PmSolver2D<double>::MIN_GRID) || grid > static_cast<long>(PmSolver2D<double>::MAX_GRID) || (grid & (grid - 1)) != 0){
+            std::cerr << "Grids must be powers of two between " << PmSolver2D<double>::MIN_GRID << " and " << PmSolver2D<double>::MAX_GRID << ".\n";
+            return 1;
+        }
+        options.grids.push_back(static_cast<std::size_t>(grid));
+    }
+    for(std::size_t k = 0; k < options.assignments.size(); ++k){
+        if(options.assignments[k] != "cic" && options.assignments[k] != "tsc"){
+            std::cerr << "Assignment must be 'cic' or 'tsc'.\n";
+            return 1;
+        }
+    }
+
+    SimulationConfig cfg;
+    if(!cfg.loadFromFile(options.configPath)){
+        std::cerr << "Failed to load config file: " << options.configPath << "\n";
+        return 1;
+    }
+    if(!cfg.validate(std::cerr)){
+        return 1;
+    }
+    if(cfg.pmBoundary == "periodic" && !(cfg.pmBoxSize > static_cast<Real>(0))){
+        std::cerr << "pmBoundary = periodic needs a pmBoxSize greater than 0.\n";
+        return 1;
+    }
+
+    if(cfg.precision == "float"){
+        return runSweep<float>(options, cfg);
+    }
+    if(cfg.precision == "double"){
+        return runSweep<double>(options, cfg);
+    }
+    return runSweep<long double>(options, cfg);
+}
@@ -0,0 +1,477 @@
+// precision_report, force error, energy drift and force throughput of each precision mode against long double
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "body2d.hpp"
+#include "body_io.h"
+#include "nbody_system2d.h"
+#include "simd_kernels.h"
+#include "simulation_config.h"
+
+/**
+ * @brief command line settings of one precision_report run
+ *
+ */
+struct ReportOptions{
+    std::string configPath; // config with the bodies, G, eps2, method, dt and steps
+    std::vector<std::string> modes; // precision modes to compare, see runMode()
+    double budget; // largest acceptable relative energy drift over the run
+    int checks; // energy checks spread over the run
+    double minSeconds; // force passes are repeated until they took at least this long
+    std::string outPath; // csv output, empty = none
+};
+
+/**
+ * @brief bodies at the start and at the end of the long double reference run
+ *
+ */
+struct Reference{
+    std::vector<Body2D<long double>> initial; // loaded bodies
+    std::vector<Vec2<long double>> forces; // exact forces at the initial positions
+    std::vector<Vec2<long double>> finalPositions; // positions after the config's run
+    long double radius; // rms distance of the initial bodies from their centre of mass, scales the position error
+};
+
+/**
+ * @brief results of one precision mode
+ *
+ */
+struct ModeResult{
+    std::string mode; // mode name
+    double rmsForceError; // rms relative force error against the long double forces
+    double maxForceError; // worst relative force error
+    double drift; // largest relative energy drift at the checks
+    double positionError; // rms final position difference to the long double run, relative to the rms radius
+    double cacheError; // relative difference of totalEnergy() with and without the potential of a force pass
+    double cacheTolerance; // largest acceptable cacheError, 16 * sqrt(N) machine epsilons of the pair terms
+    double pairsPerSecond; // direct-sum pair interactions per second of a force pass
+    double runSeconds; // wall time of the run
+};
+
+/**
+ * @brief split a comma separated list, empty entries are dropped
+ *
+ * @param value list text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &value){
+    std::vector<std::string> out;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        if(!item.empty()){
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief exact forces in long double, the reference every mode is compared against
+ *
+ * @param bodies bodies
+ * @param G gravitational constant
+ * @param eps2 softening
+ * @return std::vector<Vec2<long double>>
+ */
+std::vector<Vec2<long double>> referenceForces(const std::vector<Body2D<long double>> &bodies, long double G, long double eps2){
+    const std::size_t n = bodies.size();
+    std::vector<Vec2<long double>> forces(n);
+    for(std::size_t i = 0; i < n; ++i){
+        for(std::size_t j = i + 1; j < n; ++j){
+            const Vec2<long double> dr = bodies[j].r.sub(bodies[i].r);
+            const long double invDist = 1.0L / std::sqrt(dr.x * dr.x + dr.y * dr.y + eps2);
+            const Vec2<long double> F = dr.scale(G * bodies[i].m * bodies[j].m * invDist * invDist * invDist);
+            forces[i] = forces[i].add(F);
+            forces[j] = forces[j].sub(F);
+        }
+    }
+    return forces;
+}
+
+/**
+ * @brief set up a system with the config's engine settings and the reference bodies rounded to T
+ *
+ * @tparam T scalar type of the mode
+ * @param cfg run settings
+ * @param initial reference bodies
+ * @param floatPairs evaluate pair terms in float
+ * @param system system to fill
+ */
+template<typename T>
+void setupSystem(const SimulationConfig &cfg, const std::vector<Body2D<long double>> &initial, bool floatPairs, NBodySystem2D<T> &system){
+    system.setG(static_cast<T>(cfg.G));
+    system.setEps2(static_cast<T>(cfg.eps2));
+    if(cfg.storage == "soa"){
+        system.setStorageMode(StorageMode::SoA);
+    }
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    parseSimdLevel(cfg.simd, simdLevel);
+    system.setSimdLevel(simdLevel);
+    system.setFastRsqrt(cfg.fastRsqrt);
+    system.setFloatPairs(floatPairs);
+    system.setThreadCount(static_cast<std::size_t>(cfg.threads));
+    system.reserveBodies(initial.size());
+    for(std::size_t i = 0; i < initial.size(); ++i){
+        const Body2D<long double> &b = initial[i];
+        system.addBody(Body2D<T>(static_cast<T>(b.m), Vec2<T>(static_cast<T>(b.r.x), static_cast<T>(b.r.y)), Vec2<T>(static_cast<T>(b.v.x), static_cast<T>(b.v.y))));
+    }
+}
+
+/**
+ * @brief advance a system one step with the named method
+ *
+ * @tparam T scalar type
+ * @param system system to step
+ * @param method integrator name
+ * @param dt time step
+ */
+template<typename T>
+void stepMethod(NBodySystem2D<T> &system, const std::string &method, T dt){
+    if(method == "euler"){
+        system.stepEuler(dt);
+    }
+    else if(method == "semieuler"){
+        system.stepSemiEuler(dt);
+    }
+    else if(method == "leapfrog"){
+        system.stepLeapfrog(dt);
+    }
+    else if(method == "block"){
+        system.stepBlock(dt);
+    }
+    else if(method == "yoshida"){
+        system.stepYoshida(dt);
+    }
+    else{
+        system.stepVerlet(dt);
+    }
+}
+
+/**
+ * @brief measure one precision mode: force error, force throughput, then the config's run
+ *
+ * @tparam T scalar type the bodies are stored and integrated in
+ * @param options checks and timing
+ * @param cfg run settings
+ * @param ref long double reference
+ * @param mode mode name for the table
+ * @param floatPairs evaluate pair terms in float
+ * @return ModeResult
+ */
+template<typename T>
+ModeResult runMode(const ReportOptions &options, const SimulationConfig &cfg, const Reference &ref, const std::string &mode, bool floatPairs){
+    ModeResult result;
+    result.mode = mode;
+    const std::size_t n = ref.initial.size();
+
+    // forces at the initial positions
+    NBodySystem2D<T> system;
+    setupSystem(cfg, ref.initial, floatPairs, system);
+    system.computeForces();
+    const std::vector<Body2D<T>> &bodies = system.bodies();
+    double sumSq = 0.0;
+    result.maxForceError = 0.0;
+    for(std::size_t i = 0; i < n; ++i){
+        const long double exactMag = ref.forces[i].norm();
+        if(exactMag > 0.0L){
+            const Vec2<long double> f(static_cast<long double>(bodies[i].f.x), static_cast<long double>(bodies[i].f.y));
+            const double rel = static_cast<double>(f.sub(ref.forces[i]).norm() / exactMag);
+            sumSq += rel * rel;
+            result.maxForceError = std::max(result.maxForceError, rel);
+        }
+    }
+    result.rmsForceError = std::sqrt(sumSq / static_cast<double>(n));
+
+    // force throughput, passes at fixed positions until minSeconds have passed
+    long long passes = 0;
+    const std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+    double passSeconds = 0.0;
+    do{
+        system.computeForces();
+        ++passes;
+        passSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - passStart).count();
+    } while(passSeconds < options.minSeconds);
+    result.pairsPerSecond = 0.5 * static_cast<double>(n) * static_cast<double>(n - 1) * static_cast<double>(passes) / passSeconds;
+
+    // energy from the pair sum against energy from the potential a force pass summed, in both layouts,
+    // they differ only by rounding, which grows like sqrt(N), unless one of the two sums loses digits
+    result.cacheError = 0.0;
+    const double pairEpsilon = (floatPairs || std::is_same<T, float>::value) ? static_cast<double>(std::numeric_limits<float>::epsilon()) : static_cast<double>(std::numeric_limits<T>::epsilon());
+    result.cacheTolerance = 16.0 * std::sqrt(static_cast<double>(n)) * pairEpsilon;
+    const StorageMode layouts[] = {StorageMode::AoS, StorageMode::SoA};
+    for(std::size_t l = 0; l < 2; ++l){
+        NBodySystem2D<T> check;
+        setupSystem(cfg, ref.initial, floatPairs, check);
+        check.setStorageMode(layouts[l]);
+        const double summed = static_cast<double>(check.totalEnergy());
+        check.setTrackPotential(true);
+        check.computeForces();
+        const double cached = static_cast<double>(check.totalEnergy());
+        const double error = std::fabs(cached - summed) / (std::fabs(summed) > 0.0 ? std::fabs(summed) : 1.0);
+        result.cacheError = std::isfinite(error) ? std::max(result.cacheError, error) : HUGE_VAL;
+    }
+
+    // the config's run, energies in long double as in tools/drift_cost
+    NBodySystem2D<T> run;
+    setupSystem(cfg, ref.initial, floatPairs, run);
+    const T dt = static_cast<T>(cfg.dt);
+    const long double e0 = static_cast<long double>(run.totalEnergy());
+    const long double scale = std::fabs(e0) > 0.0L ? std::fabs(e0) : 1.0L;
+    const long long every = std::max(1LL, cfg.steps / std::max(1, options.checks));
+    result.drift = 0.0;
+    const std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+    for(long long step = 1; step <= cfg.steps; ++step){
+        stepMethod(run, cfg.method, dt);
+        if(step % every == 0 || step == cfg.steps){
+            const double drift = static_cast<double>(std::fabs(static_cast<long double>(run.totalEnergy()) - e0) / scale);
+            result.drift = std::isfinite(drift) ? std::max(result.drift, drift) : HUGE_VAL;
+        }
+    }
+    result.runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+    const std::vector<Body2D<T>> &end = run.bodies();
+    long double posSq = 0.0L;
+    for(std::size_t i = 0; i < n; ++i){
+        const long double dx = static_cast<long double>(end[i].r.x) - ref.finalPositions[i].x;
+        const long double dy = static_cast<long double>(end[i].r.y) - ref.finalPositions[i].y;
+        posSq += dx * dx + dy * dy;
+    }
+    result.positionError = static_cast<double>(std::sqrt(posSq / static_cast<long double>(n)) / ref.radius);
+    return result;
+}
+
+/**
+ * @brief print the table, long double first, speedups relative to the first row
+ *
+ * @param out output stream
+ * @param results one row per mode
+ * @param budget drift budget
+ */
+void printTable(std::ostream &out, const std::vector<ModeResult> &results, double budget){
+    out << "Energy drift budget: " << budget << "\n";
+    out << std::left << std::setw(27) << "mode" << std::right << std::setw(12) << "rms_force" << std::setw(12) << "max_force" << std::setw(12) << "drift" << std::setw(12) << "pos_error" << std::setw(14) << "pairs/s" << std::setw(9) << "speedup" << std::setw(12) << "E_cache" << "  budget\n";
+    const double base = results.empty() ? 0.0 : results[0].pairsPerSecond;
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const ModeResult &r = results[k];
+        out << std::left << std::setw(27) << r.mode << std::right << std::setprecision(3) << std::setw(12) << r.rmsForceError << std::setw(12) << r.maxForceError << std::setw(12) << r.drift << std::setw(12) << r.positionError << std::setw(14) << r.pairsPerSecond << std::setw(9) << (base > 0.0 ? r.pairsPerSecond / base : 0.0) << std::setw(12) << r.cacheError << "  " << (r.drift <= budget ? "ok" : "over") << (r.cacheError <= r.cacheTolerance ? "" : ", cached energy differs") << "\n";
+    }
+}
+
+/**
+ * @brief write the table as csv
+ *
+ * @param path output file
+ * @param results one row per mode
+ * @param budget drift budget
+ * @return true if the file was written
+ * @return false otherwise
+ */
+bool writeCsv(const std::string &path, const std::vector<ModeResult> &results, double budget){
+    std::ofstream out(path);
+    if(!out){
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "mode,rms_force_error,max_force_error,drift,position_error,pairs_per_second,speedup,run_seconds,budget,within_budget,energy_cache_error\n";
+    const double base = results.empty() ? 0.0 : results[0].pairsPerSecond;
+    for(std::size_t k = 0; k < results.size(); ++k){
+        const ModeResult &r = results[k];
+        out << r.mode << "," << r.rmsForceError << "," << r.maxForceError << "," << r.drift << "," << r.positionError << "," << r.pairsPerSecond << "," << (base > 0.0 ? r.pairsPerSecond / base : 0.0) << "," << r.runSeconds << "," << budget << "," << (r.drift <= budget ? 1 : 0) << "," << r.cacheError << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief run the long double reference, then every mode, and report
+ *
+ * @param options command line settings
+ * @param cfg validated config
+ * @return int process exit code, 2 if a mode is over the drift budget, 3 if a cached energy differs
+ */
+int runReport(const ReportOptions &options, const SimulationConfig &cfg){
+    NBodySystem2D<long double> loaded;
+    if(!loadBodies(cfg.bodiesFile, loaded)){
+        return 1;
+    }
+    if(loaded.bodyCount() < 2){
+        std::cerr << "precision_report needs at least two bodies.\n";
+        return 1;
+    }
+    Reference ref;
+    ref.initial = loaded.bodies();
+    ref.forces = referenceForces(ref.initial, static_cast<long double>(cfg.G), static_cast<long double>(cfg.eps2));
+
+    // reference run: long double state and pair terms, the scalar loop
+    NBodySystem2D<long double> refRun;
+    setupSystem(cfg, ref.initial, false, refRun);
+    for(long long step = 1; step <= cfg.steps; ++step){
+        stepMethod(refRun, cfg.method, static_cast<long double>(cfg.dt));
+    }
+    const std::vector<Body2D<long double>> &refEnd = refRun.bodies();
+    long double mass = 0.0L;
+    Vec2<long double> com;
+    for(std::size_t i = 0; i < ref.initial.size(); ++i){
+        ref.finalPositions.push_back(refEnd[i].r);
+        mass += ref.initial[i].m;
+        com = com.add(ref.initial[i].r.scale(ref.initial[i].m));
+    }
+    com = com.scale(mass != 0.0L ? 1.0L / mass : 0.0L);
+    long double r2 = 0.0L;
+    for(std::size_t i = 0; i < ref.initial.size(); ++i){
+        const Vec2<long double> d = ref.initial[i].r.sub(com);
+        r2 += d.x * d.x + d.y * d.y;
+    }
+    ref.radius = std::sqrt(r2 / static_cast<long double>(ref.initial.size()));
+    if(!(ref.radius > 0.0L)){
+        ref.radius = 1.0L;
+    }
+
+    std::vector<ModeResult> results;
+    for(std::size_t k = 0; k < options.modes.size(); ++k){
+        const std::string &mode = options.modes[k];
+        std::cerr << "  " << mode << "\n";
+        if(mode == "longdouble"){
+            results.push_back(runMode<long double>(options, cfg, ref, "long double", false));
+        }
+        else if(mode == "double"){
+            results.push_back(runMode<double>(options, cfg, ref, "double", false));
+        }
+        else if(mode == "float"){
+            results.push_back(runMode<float>(options, cfg, ref, "float", false));
+        }
+        else if(mode == "double+floatpairs"){
+            results.push_back(runMode<double>(options, cfg, ref, "double + float pairs", true));
+        }
+        else{
+            results.push_back(runMode<long double>(options, cfg, ref, "long double + float pairs", true));
+        }
+    }
+
+    std::cout << "N = " << ref.initial.size() << ", method = " << cfg.method << ", dt = " << static_cast<double>(cfg.dt) << ", steps = " << cfg.steps << ", simd = " << cfg.simd << ", threads = " << cfg.threads << "\n";
+    printTable(std::cout, results, options.budget);
+    if(!options.outPath.empty()){
+        if(!writeCsv(options.outPath, results, options.budget)){
+            std::cerr << "Could not open output file " << options.outPath << ".\n";
+            return 1;
+        }
+        std::cerr << "wrote " << results.size() << " modes to " << options.outPath << "\n";
+    }
+    for(std::size_t k = 0; k < results.size(); ++k){
+        if(results[k].cacheError > results[k].cacheTolerance){
+            std::cerr << results[k].mode << ": energy from the force pass potential differs from the pair sum by " << results[k].cacheError << ".\n";
+            return 3;
+        }
+    }
+    for(std::size_t k = 0; k < results.size(); ++k){
+        if(results[k].drift > options.budget){
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief print usage
+ *
+ */
+void printUsage(){
+    std::cerr << "usage: precision_report <config.txt> [options]\n"
+              << "  bodiesFile, G, eps2, method, dt, steps, simd, storage and threads come from the config,\n"
+              << "  the direct sum is used and precision is ignored, every mode is measured against long double\n"
+              << "  --modes LIST     longdouble,double,float,double+floatpairs,longdouble+floatpairs (default all,\n"
+              << "                   speedups are relative to the first one)\n"
+              << "  --budget X       largest acceptable relative energy drift (default 1e-6), exit code 2 if exceeded\n"
+              << "  every mode also checks totalEnergy() before and after a force pass, exit code 3 if they differ\n"
+              << "  --checks K       energy checks spread over the run (default 16)\n"
+              << "  --min-seconds S  time force passes for at least S seconds per mode (default 0.5)\n"
+              << "  --out FILE       also write the table as csv\n";
+}
+
+/**
+ * @brief usage: precision_report <config.txt> [--modes LIST] [--budget X] [--checks K] [--min-seconds S] [--out FILE]
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    ReportOptions options;
+    options.modes = splitList("longdouble,double,float,double+floatpairs,longdouble+floatpairs");
+    options.budget = 1e-6;
+    options.checks = 16;
+    options.minSeconds = 0.5;
+
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(arg == "--help" || arg == "-h"){
+            printUsage();
+            return 0;
+        }
+        else if(arg == "--modes" && hasValue){
+            options.modes = splitList(argv[++i]);
+        }
+        else if(arg == "--budget" && hasValue){
+            options.budget = std::atof(argv[++i]);
+        }
+        else if(arg == "--checks" && hasValue){
+            options.checks = std::atoi(argv[++i]);
+        }
+        else if(arg == "--min-seconds" && hasValue){
+            options.minSeconds = std::atof(argv[++i]);
+        }
+        else if(arg == "--out" && hasValue){
+            options.outPath = argv[++i];
+        }
+        else if(!arg.empty() && arg[0] != '-' && options.configPath.empty()){
+            options.configPath = arg;
+        }
+        else{
+            std::cerr << "unknown option " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if(options.configPath.empty()){
+        printUsage();
+        return 1;
+    }
+    if(options.budget <= 0.0 || options.checks < 1 || options.minSeconds < 0.0){
+        std::cerr << "--budget must be greater than 0, --checks at least 1, --min-seconds not negative.\n";
+        return 1;
+    }
+    for(std::size_t k = 0; k < options.modes.size(); ++k){
+        const std::string &m = options.modes[k];
+        if(m != "longdouble" && m != "double" && m != "float" && m != "double+floatpairs" && m != "longdouble+floatpairs"){
+            std::cerr << "Mode must be 'longdouble' or 'double' or 'float' or 'double+floatpairs' or 'longdouble+floatpairs'.\n";
+            return 1;
+        }
+    }
+
+    SimulationConfig cfg;
+    if(!cfg.loadFromFile(options.configPath)){
+        std::cerr << "Failed to load config file: " << options.configPath << "\n";
+        return 1;
+    }
+    if(!cfg.validate(std::cerr)){
+        return 1;
+    }
+    if(cfg.method == "hermite"){
+        std::cerr << "hermite computes its own jerk sum, float pairs do not apply to it.\n";
+        return 1;
+    }
+    return runReport(options, cfg);
+}
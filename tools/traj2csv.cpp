@@ -0,0 +1,144 @@
+// traj2csv, converts a binary or compressed trajectory file back to the csv layout
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compressed_trajectory.h"
+#include "trajectory_file.h"
+
+/**
+ * @brief write the csv header row, same columns as RunLogger::writeHeader
+ *
+ * @param out output file
+ * @param bodyCount number of bodies
+ * @param energy frames carry E_total
+ */
+void writeColumns(FILE *out, std::uint64_t bodyCount, bool energy){
+    std::fputs("t", out);
+    for(std::uint64_t i = 1; i <= bodyCount; ++i){
+        std::fprintf(out, ",x%llu,y%llu,vx%llu,vy%llu", static_cast<unsigned long long>(i), static_cast<unsigned long long>(i), static_cast<unsigned long long>(i), static_cast<unsigned long long>(i));
+    }
+    if(energy){
+        std::fputs(",E_total", out);
+    }
+    std::fputs("\n", out);
+}
+
+/**
+ * @brief write one frame as a csv row
+ *        %g with 6 digits matches the default ostream formatting of the csv logger
+ *
+ * @param out output file
+ * @param values frame values
+ * @param count number of values
+ */
+void writeRow(FILE *out, const double *values, std::size_t count){
+    for(std::size_t v = 0; v < count; ++v){
+        std::fprintf(out, v == 0 ? "%g" : ",%g", values[v]);
+    }
+    std::fputs("\n", out);
+}
+
+/**
+ * @brief write the frames of a binary or compressed trajectory as the csv RunLogger would have written
+ *        usage: traj2csv <input> [output.csv] [firstFrame] [lastFrame]
+ *        the format is told apart by the magic at the start of the file
+ *        output defaults to stdout, frame range defaults to all frames
+ *        values are printed with 6 significant digits like the csv logger, so the plot scripts read them unchanged
+ *        compressed files decode only the blocks holding the frame range
+ *
+ * @param argc argument count
+ * @param argv arguments
+ * @return int process exit code
+ */
+int main(int argc, char *argv[]){
+    if(argc < 2){
+        std::cerr << "usage: traj2csv <input.bin|input.ctrj> [output.csv] [firstFrame] [lastFrame]\n";
+        return 1;
+    }
+
+    char magic[8] = {};
+    {
+        std::ifstream probe(argv[1], std::ios::in | std::ios::binary);
+        probe.read(magic, sizeof(magic));
+    }
+    const bool compressed = std::memcmp(magic, "NBODYCTJ", 8) == 0;
+
+    TrajectoryReader reader;
+    CompressedTrajectoryReader compressedReader;
+    if(compressed ? !compressedReader.open(argv[1], std::cerr) : !reader.open(argv[1], std::cerr)){
+        return 1;
+    }
+    const std::size_t frames = compressed ? compressedReader.frameCount() : reader.frameCount();
+
+    std::size_t first = 0;
+    std::size_t last = frames;
+    if(argc > 3){
+        first = static_cast<std::size_t>(std::stoull(argv[3]));
+    }
+    if(argc > 4){
+        last = static_cast<std::size_t>(std::stoull(argv[4])) + 1;
+    }
+    if(last > frames){
+        last = frames;
+    }
+
+    FILE *out = stdout;
+    if(argc > 2 && std::string(argv[2]) != "-"){
+        out = std::fopen(argv[2], "w");
+        if(out == nullptr){
+            std::cerr << "Could not open output file " << argv[2] << ".\n";
+            return 1;
+        }
+    }
+
+    const std::uint32_t fields = compressed ? compressedReader.header().fields : reader.header().fields;
+    const std::uint64_t bodyCount = compressed ? compressedReader.header().bodyCount : reader.header().bodyCount;
+    writeColumns(out, bodyCount, (fields & static_cast<std::uint32_t>(TrajectoryField::Energy)) != 0U);
+
+    int status = 0;
+    std::size_t written = 0;
+    if(compressed){
+        const std::size_t values = compressedReader.valuesPerFrame();
+        for(std::size_t k = first; k < last; ++k){
+            const double *frame = compressedReader.frame(k, std::cerr);
+            if(frame == nullptr){
+                status = 1;
+                break;
+            }
+            writeRow(out, frame, values);
+            ++written;
+        }
+    }
+    else{
+        const std::size_t values = reader.valuesPerFrame();
+        std::vector<double> frame(values);
+        for(std::size_t k = first; k < last; ++k){
+            for(std::size_t v = 0; v < values; ++v){
+                frame[v] = reader.value(k, v);
+            }
+            writeRow(out, frame.data(), values);
+            ++written;
+        }
+    }
+
+    if(out != stdout){
+        std::fclose(out);
+    }
+    if(compressed){
+        const CompressedTrajectoryHeader &header = compressedReader.header();
+        std::cerr << "converted " << written << " of " << frames << " frames, N = " << header.bodyCount << ", dt = " << header.dt << ", outputEvery = " << header.outputEvery
+                  << ", position error <= " << header.positionError << ", velocity error <= " << header.velocityError
+                  << ", " << compressedReader.blockCount() << " blocks of up to " << header.keyframeEvery << " frames, " << trajectoryCodecName(static_cast<TrajectoryCodec>(header.codec)) << " codec\n";
+    }
+    else{
+        const TrajectoryHeader &header = reader.header();
+        std::cerr << "converted " << written << " of " << frames << " frames, N = " << header.bodyCount << ", dt = " << header.dt << ", outputEvery = " << header.outputEvery << "\n";
+    }
+    return status;
+}